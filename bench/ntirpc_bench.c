@@ -0,0 +1,1382 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file ntirpc_bench.c
+ * @brief Microbenchmarks
+ *
+ * @section DESCRIPTION
+ *
+ * Times the hot paths of the library in isolation: XDR on xdrmem and on
+ * multi-segment xdr_ioq streams, work_pool_submit(), svc_xprt_lookup(),
+ * rbtree_x, checksums, the authgss context hash, and null calls end to
+ * end over a socketpair and over svc_loop.
+ *
+ * Each benchmark is calibrated until one run takes at least --min-time,
+ * then repeated --repeat times at that count.  The median ns/op (and the
+ * range) is reported; benchmarks that sample latency also report the
+ * median p50 and p99.  Inputs come from a fixed seed, so runs on the same
+ * host are comparable.  --json writes the results for regression
+ * tracking across releases.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rpc/types.h>
+#include <misc/city.h>
+#include <misc/portable.h>
+#include <misc/rbtree_x.h>
+#include <rpc/rpc.h>
+#include <rpc/rpc_cksum.h>
+#include <rpc/svc.h>
+#include <rpc/svc_auth.h>
+#include <rpc/svc_rqst.h>
+#include <rpc/work_pool.h>
+#include <rpc/xdr_inline.h>
+#include <rpc/xdr_ioq.h>
+#ifdef _HAVE_GSSAPI
+#include <rpc/gss_internal.h>
+#endif
+#include <ntirpc/version.h>
+
+#include "rpc_dplx_internal.h"
+#include "svc_xprt.h"
+
+#define BENCH_REPEAT		5
+#define BENCH_MIN_TIME_MS	200
+#define BENCH_QUICK_TIME_MS	10
+#define BENCH_SAMPLES		65536	/* latency samples per run */
+#define BENCH_KEYS		4096	/* random index sequence */
+
+struct bench_run {
+	uint64_t iters;
+	uint64_t start_ns;
+	uint64_t stop_ns;
+	uint64_t stride;	/* ops per latency sample */
+	uint64_t *samples;
+	uint32_t nsamples;
+	uint32_t param;
+};
+
+struct bench {
+	const char *name;
+	uint32_t param;
+	uint64_t max_iters;	/* 0: unlimited */
+	bool (*setup)(void **);
+	bool (*run)(struct bench_run *, void *);
+	void (*teardown)(void *);
+};
+
+struct bench_result {
+	const char *name;
+	uint64_t iters;
+	double ns_per_op;	/* median of repetitions */
+	double ns_min;
+	double ns_max;
+	uint64_t p50_ns;	/* 0: not sampled */
+	uint64_t p99_ns;
+};
+
+static uint32_t bench_keys[BENCH_KEYS];
+static volatile uint64_t bench_sink;
+
+static inline uint64_t
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static inline void
+bench_start(struct bench_run *br)
+{
+	br->start_ns = bench_now();
+}
+
+static inline void
+bench_stop(struct bench_run *br)
+{
+	br->stop_ns = bench_now();
+}
+
+static inline void
+bench_sample(struct bench_run *br, uint64_t ns)
+{
+	uint32_t ix = atomic_postinc_uint32_t(&br->nsamples);
+
+	if (ix < BENCH_SAMPLES)
+		br->samples[ix] = ns;
+}
+
+/* xorshift64*, fixed seed */
+static uint64_t bench_seed = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t
+bench_random(void)
+{
+	bench_seed ^= bench_seed >> 12;
+	bench_seed ^= bench_seed << 25;
+	bench_seed ^= bench_seed >> 27;
+	return (bench_seed * 0x2545f4914f6cdd1dULL);
+}
+
+static void
+bench_fill(void *buf, size_t len)
+{
+	uint8_t *p = buf;
+
+	while (len--)
+		*p++ = (uint8_t) bench_random();
+}
+
+/*
+ * XDR
+ */
+
+#define BENCH_FH_MAX		64
+#define BENCH_NAME_MAX		255
+#define BENCH_IOQ_RECS		512	/* about 40K per stream */
+#define BENCH_IOQ_BSIZE		4096
+
+struct bench_rec {
+	uint32_t type;
+	uint32_t mode;
+	uint64_t size;
+	uint64_t mtime;
+	u_int fh_len;
+	char *fh;
+	char *name;
+};
+
+static bool
+xdr_bench_rec(XDR *xdrs, struct bench_rec *objp)
+{
+	if (!xdr_uint32_t(xdrs, &objp->type))
+		return (false);
+	if (!xdr_uint32_t(xdrs, &objp->mode))
+		return (false);
+	if (!xdr_uint64_t(xdrs, &objp->size))
+		return (false);
+	if (!xdr_uint64_t(xdrs, &objp->mtime))
+		return (false);
+	if (!xdr_bytes(xdrs, &objp->fh, &objp->fh_len, BENCH_FH_MAX))
+		return (false);
+	return (xdr_string(xdrs, &objp->name, BENCH_NAME_MAX));
+}
+
+struct bench_xdr {
+	struct bench_rec in;
+	struct bench_rec out;	/* decoded in place, without allocation */
+	char fh[BENCH_FH_MAX];
+	char name[BENCH_NAME_MAX + 1];
+	char out_fh[BENCH_FH_MAX];
+	char out_name[BENCH_NAME_MAX + 1];
+	char buf[512];		/* one encoded record */
+	struct xdr_ioq *xioq;	/* BENCH_IOQ_RECS encoded records */
+};
+
+static bool
+bench_xdr_equal(struct bench_xdr *bx)
+{
+	return (bx->out.type == bx->in.type
+		&& bx->out.mode == bx->in.mode
+		&& bx->out.size == bx->in.size
+		&& bx->out.mtime == bx->in.mtime
+		&& bx->out.fh_len == bx->in.fh_len
+		&& !memcmp(bx->out.fh, bx->in.fh, bx->in.fh_len)
+		&& !strcmp(bx->out.name, bx->in.name));
+}
+
+static bool
+bench_xdr_setup(void **arg)
+{
+	struct bench_xdr *bx = calloc(1, sizeof(*bx));
+	XDR xdrs[1];
+	int ix;
+
+	bx->in.type = 1;
+	bx->in.mode = 0644;
+	bx->in.size = bench_random();
+	bx->in.mtime = bench_random();
+	bx->in.fh_len = 32;
+	bx->in.fh = bx->fh;
+	bench_fill(bx->fh, sizeof(bx->fh));
+	bx->in.name = bx->name;
+	snprintf(bx->name, sizeof(bx->name), "bench-%016" PRIx64,
+		 bench_random());
+	bx->out.fh = bx->out_fh;
+	bx->out.name = bx->out_name;
+
+	xdrmem_ncreate(xdrs, bx->buf, sizeof(bx->buf), XDR_ENCODE);
+	if (!xdr_bench_rec(xdrs, &bx->in))
+		goto fail;
+
+	bx->xioq = xdr_ioq_create(BENCH_IOQ_BSIZE, BENCH_IOQ_BSIZE * 4,
+				  UIO_FLAG_FREE);
+	for (ix = 0; ix < BENCH_IOQ_RECS; ix++) {
+		if (!xdr_bench_rec(bx->xioq->xdrs, &bx->in))
+			goto fail;
+	}
+	xdr_tail_update(bx->xioq->xdrs);
+	if (bx->xioq->ioq_uv.uvqh.qcount < 2)
+		goto fail;
+
+	/* check the decoders once */
+	xdrmem_ncreate(xdrs, bx->buf, sizeof(bx->buf), XDR_DECODE);
+	if (!xdr_bench_rec(xdrs, &bx->out) || !bench_xdr_equal(bx))
+		goto fail;
+
+	bx->xioq->xdrs[0].x_op = XDR_DECODE;
+	xdr_ioq_reset(bx->xioq, 0);
+	for (ix = 0; ix < BENCH_IOQ_RECS; ix++) {
+		memset(bx->out_name, 0, sizeof(bx->out_name));
+		if (!xdr_bench_rec(bx->xioq->xdrs, &bx->out)
+		    || !bench_xdr_equal(bx))
+			goto fail;
+	}
+
+	*arg = bx;
+	return (true);
+
+ fail:
+	if (bx->xioq)
+		XDR_DESTROY(bx->xioq->xdrs);
+	free(bx);
+	return (false);
+}
+
+static void
+bench_xdr_teardown(void *arg)
+{
+	struct bench_xdr *bx = arg;
+
+	XDR_DESTROY(bx->xioq->xdrs);
+	free(bx);
+}
+
+static bool
+bench_xdr_mem_encode(struct bench_run *br, void *arg)
+{
+	struct bench_xdr *bx = arg;
+	XDR xdrs[1];
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		xdrmem_ncreate(xdrs, bx->buf, sizeof(bx->buf), XDR_ENCODE);
+		if (!xdr_bench_rec(xdrs, &bx->in))
+			return (false);
+	}
+	bench_stop(br);
+	return (true);
+}
+
+static bool
+bench_xdr_mem_decode(struct bench_run *br, void *arg)
+{
+	struct bench_xdr *bx = arg;
+	XDR xdrs[1];
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		xdrmem_ncreate(xdrs, bx->buf, sizeof(bx->buf), XDR_DECODE);
+		if (!xdr_bench_rec(xdrs, &bx->out))
+			return (false);
+	}
+	bench_stop(br);
+	return (true);
+}
+
+/* one op is a stream of BENCH_IOQ_RECS, including its buffers */
+static bool
+bench_xdr_ioq_encode(struct bench_run *br, void *arg)
+{
+	struct bench_xdr *bx = arg;
+	struct xdr_ioq *xioq;
+	uint64_t i;
+	int ix;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		xioq = xdr_ioq_create(BENCH_IOQ_BSIZE, BENCH_IOQ_BSIZE * 4,
+				      UIO_FLAG_FREE);
+		for (ix = 0; ix < BENCH_IOQ_RECS; ix++) {
+			if (!xdr_bench_rec(xioq->xdrs, &bx->in)) {
+				XDR_DESTROY(xioq->xdrs);
+				return (false);
+			}
+		}
+		XDR_DESTROY(xioq->xdrs);
+	}
+	bench_stop(br);
+	return (true);
+}
+
+static bool
+bench_xdr_ioq_decode(struct bench_run *br, void *arg)
+{
+	struct bench_xdr *bx = arg;
+	uint64_t i;
+	int ix;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		xdr_ioq_reset(bx->xioq, 0);
+		for (ix = 0; ix < BENCH_IOQ_RECS; ix++) {
+			if (!xdr_bench_rec(bx->xioq->xdrs, &bx->out))
+				return (false);
+		}
+	}
+	bench_stop(br);
+	return (true);
+}
+
+/*
+ * work_pool
+ */
+
+#define BENCH_WP_WORKERS	4
+#define BENCH_WP_MAX_ITERS	(1 << 18)
+
+struct bench_wp {
+	struct work_pool pool;
+	struct work_pool_entry *wpe;	/* BENCH_WP_MAX_ITERS */
+	struct bench_run *br;
+	pthread_barrier_t barrier;
+	uint64_t done;
+};
+
+struct bench_wp_producer {
+	struct bench_wp *bw;
+	pthread_t thread;
+	uint64_t first;
+	uint64_t count;
+};
+
+static void
+bench_wp_fun(struct work_pool_entry *wpe)
+{
+	struct bench_wp *bw = wpe->arg;
+	struct bench_run *br = bw->br;
+
+	if (!((wpe - bw->wpe) % br->stride))
+		bench_sample(br, bench_now() - wpe->queued_ns);
+	atomic_inc_uint64_t(&bw->done);
+}
+
+static void
+bench_wp_submit(struct bench_wp_producer *wpp)
+{
+	struct bench_wp *bw = wpp->bw;
+	uint64_t i;
+
+	for (i = wpp->first; i < wpp->first + wpp->count; i++)
+		work_pool_submit(&bw->pool, &bw->wpe[i]);
+}
+
+static void *
+bench_wp_producer(void *arg)
+{
+	struct bench_wp_producer *wpp = arg;
+
+	pthread_barrier_wait(&wpp->bw->barrier);
+	bench_wp_submit(wpp);
+	return (NULL);
+}
+
+static bool
+bench_wp_setup(void **arg)
+{
+	struct bench_wp *bw = calloc(1, sizeof(*bw));
+	struct work_pool_params params = {
+		.thrd_max = BENCH_WP_WORKERS,
+		.thrd_min = BENCH_WP_WORKERS,
+	};
+
+	bw->wpe = calloc(BENCH_WP_MAX_ITERS, sizeof(*bw->wpe));
+	if (work_pool_init(&bw->pool, "bench", &params)) {
+		free(bw->wpe);
+		free(bw);
+		return (false);
+	}
+	*arg = bw;
+	return (true);
+}
+
+static void
+bench_wp_teardown(void *arg)
+{
+	struct bench_wp *bw = arg;
+
+	work_pool_shutdown(&bw->pool);
+	free(bw->wpe);
+	free(bw);
+}
+
+/* param: producer threads */
+static bool
+bench_wp(struct bench_run *br, void *arg)
+{
+	struct bench_wp *bw = arg;
+	struct bench_wp_producer wpp[br->param];
+	uint64_t i;
+	uint32_t ix;
+
+	memset(bw->wpe, 0, br->iters * sizeof(*bw->wpe));
+	for (i = 0; i < br->iters; i++) {
+		bw->wpe[i].fun = bench_wp_fun;
+		bw->wpe[i].arg = bw;
+	}
+	bw->br = br;
+	bw->done = 0;
+
+	for (ix = 0; ix < br->param; ix++) {
+		wpp[ix].bw = bw;
+		wpp[ix].first = br->iters * ix / br->param;
+		wpp[ix].count = br->iters * (ix + 1) / br->param
+			      - wpp[ix].first;
+	}
+
+	if (br->param == 1) {
+		bench_start(br);
+		bench_wp_submit(wpp);
+	} else {
+		pthread_barrier_init(&bw->barrier, NULL, br->param + 1);
+		for (ix = 0; ix < br->param; ix++)
+			pthread_create(&wpp[ix].thread, NULL,
+				       bench_wp_producer, &wpp[ix]);
+		pthread_barrier_wait(&bw->barrier);
+		bench_start(br);
+		for (ix = 0; ix < br->param; ix++)
+			pthread_join(wpp[ix].thread, NULL);
+		pthread_barrier_destroy(&bw->barrier);
+	}
+	while (atomic_fetch_uint64_t(&bw->done) < br->iters)
+		sched_yield();
+	bench_stop(br);
+	return (true);
+}
+
+/*
+ * svc_xprt_lookup
+ */
+
+#define BENCH_XPRT_COUNT	1000
+#define BENCH_XPRT_FD		(1 << 20)	/* above any real fd */
+
+struct bench_xprt {
+	SVCXPRT *xprt[BENCH_XPRT_COUNT];
+};
+
+/* svc_xprt_setup_t, for entries that are never used as transports */
+static void
+bench_xprt_rec(SVCXPRT **sxp)
+{
+	struct rpc_dplx_rec *rec;
+
+	if (*sxp) {
+		rec = REC_XPRT(*sxp);
+		rpc_dplx_lock_destroy(&rec->recv.lock);
+		mutex_destroy(&rec->xprt.xp_lock);
+		mem_free(rec, sizeof(*rec));
+		*sxp = NULL;
+		return;
+	}
+	rec = rpc_dplx_rec_zalloc(sizeof(*rec));
+	rpc_dplx_lock_init(&rec->recv.lock);
+	mutex_init(&rec->xprt.xp_lock, NULL);
+	rec->xprt.xp_refcnt = 1;
+	*sxp = &rec->xprt;
+}
+
+static bool
+bench_xprt_setup(void **arg)
+{
+	struct bench_xprt *bx = calloc(1, sizeof(*bx));
+	SVCXPRT *xprt;
+	int ix;
+
+	for (ix = 0; ix < BENCH_XPRT_COUNT; ix++) {
+		xprt = svc_xprt_lookup(BENCH_XPRT_FD + ix, bench_xprt_rec);
+		if (!xprt)
+			break;
+		rpc_dplx_rui(REC_XPRT(xprt));
+		bx->xprt[ix] = xprt;
+	}
+	*arg = bx;
+	return (ix == BENCH_XPRT_COUNT);
+}
+
+static void
+bench_xprt_teardown(void *arg)
+{
+	struct bench_xprt *bx = arg;
+	int ix;
+
+	for (ix = 0; ix < BENCH_XPRT_COUNT && bx->xprt[ix]; ix++) {
+		svc_xprt_clear(bx->xprt[ix]);
+		bench_xprt_rec(&bx->xprt[ix]);
+	}
+	free(bx);
+}
+
+static bool
+bench_xprt_lookup(struct bench_run *br, void *arg)
+{
+	SVCXPRT *xprt;
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		xprt = svc_xprt_lookup(BENCH_XPRT_FD + bench_keys[i % BENCH_KEYS]
+				       % BENCH_XPRT_COUNT, NULL);
+		if (!xprt)
+			return (false);
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+	}
+	bench_stop(br);
+	return (true);
+}
+
+/*
+ * rbtree_x, read-through cached as for the authgss hash
+ */
+
+#define BENCH_RBTX_NODES	65536
+#define BENCH_RBTX_PARTS	7
+#define BENCH_RBTX_CACHESZ	255
+
+struct bench_rbtx_node {
+	struct opr_rbtree_node node_k;
+	uint64_t k;
+};
+
+struct bench_rbtx {
+	struct rbtree_x xt;
+	struct bench_rbtx_node *node;	/* BENCH_RBTX_NODES */
+};
+
+static int
+bench_rbtx_cmpf(const struct opr_rbtree_node *lhs,
+		const struct opr_rbtree_node *rhs)
+{
+	struct bench_rbtx_node *lk, *rk;
+
+	lk = opr_containerof(lhs, struct bench_rbtx_node, node_k);
+	rk = opr_containerof(rhs, struct bench_rbtx_node, node_k);
+
+	if (lk->k < rk->k)
+		return (-1);
+	if (lk->k > rk->k)
+		return (1);
+	return (0);
+}
+
+static bool
+bench_rbtx_setup(void **arg)
+{
+	struct bench_rbtx *bt = calloc(1, sizeof(*bt));
+	struct rbtree_x_part *t;
+	int ix;
+
+	if (rbtx_init(&bt->xt, bench_rbtx_cmpf, BENCH_RBTX_PARTS,
+		      RBT_X_FLAG_ALLOC | RBT_X_FLAG_CACHE_RT)) {
+		free(bt);
+		return (false);
+	}
+	bt->xt.cachesz = BENCH_RBTX_CACHESZ;
+	for (ix = 0; ix < BENCH_RBTX_PARTS; ix++)
+		bt->xt.tree[ix].cache = calloc(BENCH_RBTX_CACHESZ,
+					       sizeof(struct opr_rbtree_node *));
+
+	bt->node = calloc(BENCH_RBTX_NODES, sizeof(*bt->node));
+	for (ix = 0; ix < BENCH_RBTX_NODES; ix++) {
+		bt->node[ix].k = bench_random();
+		t = rbtx_partition_of_scalar(&bt->xt, bt->node[ix].k);
+		rbtree_x_cached_insert(&bt->xt, t, &bt->node[ix].node_k,
+				       bt->node[ix].k);
+	}
+	*arg = bt;
+	return (true);
+}
+
+static void
+bench_rbtx_teardown(void *arg)
+{
+	struct bench_rbtx *bt = arg;
+	int ix;
+
+	for (ix = 0; ix < BENCH_RBTX_PARTS; ix++)
+		free(bt->xt.tree[ix].cache);
+	rbtx_cleanup(&bt->xt);
+	free(bt->node);
+	free(bt);
+}
+
+static bool
+bench_rbtx_lookup(struct bench_run *br, void *arg)
+{
+	struct bench_rbtx *bt = arg;
+	struct bench_rbtx_node sk;
+	struct rbtree_x_part *t;
+	struct opr_rbtree_node *nv;
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		sk.k = bt->node[bench_keys[i % BENCH_KEYS]
+				% BENCH_RBTX_NODES].k;
+		t = rbtx_partition_of_scalar(&bt->xt, sk.k);
+		mutex_lock(&t->mtx);
+		nv = rbtree_x_cached_lookup(&bt->xt, t, &sk.node_k, sk.k);
+		mutex_unlock(&t->mtx);
+		if (!nv)
+			return (false);
+	}
+	bench_stop(br);
+	return (true);
+}
+
+/* one op is a remove and a re-insert */
+static bool
+bench_rbtx_update(struct bench_run *br, void *arg)
+{
+	struct bench_rbtx *bt = arg;
+	struct bench_rbtx_node *nk;
+	struct rbtree_x_part *t;
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		nk = &bt->node[bench_keys[i % BENCH_KEYS] % BENCH_RBTX_NODES];
+		t = rbtx_partition_of_scalar(&bt->xt, nk->k);
+		mutex_lock(&t->mtx);
+		rbtree_x_cached_remove(&bt->xt, t, &nk->node_k, nk->k);
+		rbtree_x_cached_insert(&bt->xt, t, &nk->node_k, nk->k);
+		mutex_unlock(&t->mtx);
+	}
+	bench_stop(br);
+	return (true);
+}
+
+/*
+ * Checksums, as used by the DRC
+ */
+
+#define BENCH_CKSUM_MAX		4096
+
+struct bench_cksum {
+	unsigned char buf[BENCH_CKSUM_MAX];
+};
+
+static bool
+bench_cksum_setup(void **arg)
+{
+	struct bench_cksum *bc = malloc(sizeof(*bc));
+
+	bench_fill(bc->buf, sizeof(bc->buf));
+	*arg = bc;
+	return (true);
+}
+
+static void
+bench_cksum_teardown(void *arg)
+{
+	free(arg);
+}
+
+/* param: bytes */
+static bool
+bench_cksum_city(struct bench_run *br, void *arg)
+{
+	struct bench_cksum *bc = arg;
+	uint64_t sum = 0;
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++)
+		sum += CityHash64WithSeed((char *)bc->buf, br->param, 103);
+	bench_stop(br);
+	bench_sink = sum;
+	return (true);
+}
+
+static bool
+bench_cksum_crc32c(struct bench_run *br, void *arg)
+{
+	struct bench_cksum *bc = arg;
+	uint64_t sum = 0;
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++)
+		sum += calculate_crc32c(0, bc->buf, br->param);
+	bench_stop(br);
+	bench_sink = sum;
+	return (true);
+}
+
+/*
+ * authgss context hash
+ */
+
+#ifdef _HAVE_GSSAPI
+#define BENCH_GSS_CTX		4096
+
+struct bench_gss {
+	gss_union_ctx_id_desc ctx[BENCH_GSS_CTX];
+	struct rpc_gss_cred gc[BENCH_GSS_CTX];
+	struct svc_rpc_gss_data *gd[BENCH_GSS_CTX];
+};
+
+static gss_OID_desc bench_gss_mech;
+
+static bool
+bench_gss_setup(void **arg)
+{
+	struct bench_gss *bg = calloc(1, sizeof(*bg));
+	int ix;
+
+	for (ix = 0; ix < BENCH_GSS_CTX; ix++) {
+		/* never dereferenced: only hashed and compared */
+		bg->ctx[ix].mech_type = &bench_gss_mech;
+		bg->ctx[ix].internal_ctx_id =
+			(gss_ctx_id_t) (uintptr_t) (bench_random() << 4);
+		bg->gc[ix].gc_ctx.value = &bg->ctx[ix];
+		bg->gc[ix].gc_ctx.length = sizeof(bg->ctx[ix]);
+
+		bg->gd[ix] = alloc_svc_rpc_gss_data();
+		bg->gd[ix]->ctx = (gss_ctx_id_t) &bg->ctx[ix];
+		if (!authgss_ctx_hash_set(bg->gd[ix])) {
+			mutex_destroy(&bg->gd[ix]->lock);
+			mem_free(bg->gd[ix], sizeof(*bg->gd[ix]));
+			bg->gd[ix] = NULL;
+			break;
+		}
+	}
+	*arg = bg;
+	return (ix == BENCH_GSS_CTX);
+}
+
+static void
+bench_gss_teardown(void *arg)
+{
+	struct bench_gss *bg = arg;
+	int ix;
+
+	for (ix = 0; ix < BENCH_GSS_CTX && bg->gd[ix]; ix++) {
+		authgss_ctx_hash_del(bg->gd[ix]);
+		mutex_destroy(&bg->gd[ix]->lock);
+		mem_free(bg->gd[ix], sizeof(*bg->gd[ix]));
+	}
+	free(bg);
+}
+
+static bool
+bench_gss_get(struct bench_run *br, void *arg)
+{
+	struct bench_gss *bg = arg;
+	struct svc_rpc_gss_data *gd;
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		gd = authgss_ctx_hash_get(&bg->gc[bench_keys[i % BENCH_KEYS]
+						 % BENCH_GSS_CTX]);
+		if (!gd)
+			return (false);
+		atomic_dec_uint32_t(&gd->refcnt);
+	}
+	bench_stop(br);
+	return (true);
+}
+#endif				/* _HAVE_GSSAPI */
+
+/*
+ * Null calls end to end, through svc_rqst and the work pool
+ */
+
+#define BENCH_PROG		0x20000099
+#define BENCH_VERS		1
+#define BENCH_WINDOW		32	/* calls in flight */
+#define BENCH_BUFSZ		8192
+
+struct bench_e2e {
+	SVCXPRT *xprt;		/* server end */
+	CLIENT *clnt;
+	struct bench_run *br;
+	mutex_t mtx;
+	cond_t cv;
+	uint64_t done;
+	uint32_t inflight;
+	uint32_t failures;
+};
+
+struct bench_call {
+	struct clnt_req cc;	/*** 1st ***/
+	struct bench_e2e *be;
+	uint64_t start_ns;	/* 0: not sampled */
+};
+
+static struct timespec bench_timeout = { 30, 0 };
+
+static enum xprt_stat
+bench_e2e_null(struct svc_req *req)
+{
+	bool no_dispatch = false;
+
+	if (svc_auth_authenticate(req, &no_dispatch) != AUTH_OK
+	    || no_dispatch)
+		return (XPRT_IDLE);
+
+	req->rq_msg.RPCM_ack.ar_results.where = NULL;
+	req->rq_msg.RPCM_ack.ar_results.proc = (xdrproc_t) xdr_void;
+	return (svc_sendreply(req));
+}
+
+static bool
+bench_e2e_init(struct bench_e2e *be, void **arg)
+{
+	if (CLNT_FAILURE(be->clnt)) {
+		CLNT_DESTROY(be->clnt);
+		SVC_DESTROY(be->xprt);
+		SVC_RELEASE(be->xprt, SVC_RELEASE_FLAG_NONE);
+		free(be);
+		return (false);
+	}
+	be->clnt->cl_u1 = be;
+	mutex_init(&be->mtx, NULL);
+	cond_init(&be->cv, 0, NULL);
+	*arg = be;
+	return (true);
+}
+
+static bool
+bench_e2e_vc_setup(void **arg)
+{
+	struct bench_e2e *be = calloc(1, sizeof(*be));
+	struct sockaddr_storage ss;
+	struct netbuf raddr = {
+		.buf = &ss,
+		.maxlen = sizeof(ss),
+		.len = sizeof(ss)
+	};
+	int sv[2];
+
+	if (socketpair(AF_LOCAL, SOCK_STREAM, 0, sv) < 0) {
+		free(be);
+		return (false);
+	}
+
+	be->xprt = svc_fd_ncreatef(sv[0], BENCH_BUFSZ, BENCH_BUFSZ,
+				   SVC_CREATE_FLAG_CLOSE
+				   | SVC_CREATE_FLAG_XPRT_NOREG);
+	if (!be->xprt) {
+		close(sv[0]);
+		close(sv[1]);
+		free(be);
+		return (false);
+	}
+	be->xprt->xp_dispatch.process_cb = bench_e2e_null;
+	svc_rqst_evchan_reg(0, be->xprt, SVC_RQST_FLAG_CHAN_AFFINITY);
+
+	memset(&ss, 0, sizeof(ss));
+	getpeername(sv[1], (struct sockaddr *)&ss, &raddr.len);
+	be->clnt = clnt_vc_ncreatef(sv[1], &raddr, BENCH_PROG, BENCH_VERS,
+				    BENCH_BUFSZ, BENCH_BUFSZ,
+				    CLNT_CREATE_FLAG_CLOSE);
+	return (bench_e2e_init(be, arg));
+}
+
+static bool
+bench_e2e_loop_setup(void **arg)
+{
+	struct bench_e2e *be = calloc(1, sizeof(*be));
+
+	be->xprt = svc_loop_ncreate();
+	if (!be->xprt) {
+		free(be);
+		return (false);
+	}
+	be->xprt->xp_dispatch.process_cb = bench_e2e_null;
+	be->clnt = clnt_loop_ncreate(be->xprt, BENCH_PROG, BENCH_VERS);
+	return (bench_e2e_init(be, arg));
+}
+
+static void
+bench_e2e_teardown(void *arg)
+{
+	struct bench_e2e *be = arg;
+
+	CLNT_DESTROY(be->clnt);
+	SVC_DESTROY(be->xprt);
+	SVC_RELEASE(be->xprt, SVC_RELEASE_FLAG_NONE);
+	mutex_destroy(&be->mtx);
+	cond_destroy(&be->cv);
+	free(be);
+}
+
+static bool
+bench_e2e_call(struct bench_run *br, void *arg)
+{
+	struct bench_e2e *be = arg;
+	struct clnt_req *cc;
+	enum clnt_stat stat;
+	uint64_t start_ns;
+	uint64_t i;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		start_ns = bench_now();
+		cc = calloc(1, sizeof(*cc));
+		clnt_req_fill(cc, be->clnt, authnone_ncreate(), NULLPROC,
+			      (xdrproc_t) xdr_void, NULL,
+			      (xdrproc_t) xdr_void, NULL);
+		stat = clnt_req_setup(cc, bench_timeout);
+		if (stat == RPC_SUCCESS)
+			stat = CLNT_CALL_WAIT(cc);
+		clnt_req_release(cc);
+		if (stat != RPC_SUCCESS)
+			return (false);
+		if (!(i % br->stride))
+			bench_sample(br, bench_now() - start_ns);
+	}
+	bench_stop(br);
+	return (true);
+}
+
+static void
+bench_e2e_done(struct clnt_req *cc)
+{
+	struct bench_call *bc = opr_containerof(cc, struct bench_call, cc);
+	struct bench_e2e *be = bc->be;
+
+	if (cc->cc_error.re_status != RPC_SUCCESS)
+		atomic_inc_uint32_t(&be->failures);
+	else if (bc->start_ns)
+		bench_sample(be->br, bench_now() - bc->start_ns);
+	clnt_req_release(cc);
+
+	mutex_lock(&be->mtx);
+	be->inflight--;
+	be->done++;
+	cond_signal(&be->cv);
+	mutex_unlock(&be->mtx);
+}
+
+/* BENCH_WINDOW calls in flight, callbacks on completion */
+static bool
+bench_e2e_window(struct bench_run *br, void *arg)
+{
+	struct bench_e2e *be = arg;
+	struct bench_call *bc;
+	uint64_t i;
+
+	be->br = br;
+	be->done = 0;
+	be->failures = 0;
+
+	bench_start(br);
+	for (i = 0; i < br->iters; i++) {
+		mutex_lock(&be->mtx);
+		while (be->inflight >= BENCH_WINDOW)
+			cond_wait(&be->cv, &be->mtx);
+		be->inflight++;
+		mutex_unlock(&be->mtx);
+
+		bc = calloc(1, sizeof(*bc));
+		bc->be = be;
+		clnt_req_fill(&bc->cc, be->clnt, authnone_ncreate(), NULLPROC,
+			      (xdrproc_t) xdr_void, NULL,
+			      (xdrproc_t) xdr_void, NULL);
+		bc->cc.cc_size = sizeof(*bc);
+		if (!(i % br->stride))
+			bc->start_ns = bench_now();
+
+		if (clnt_req_setup(&bc->cc, bench_timeout) != RPC_SUCCESS)
+			goto fail;
+		bc->cc.cc_process_cb = bench_e2e_done;
+		bc->cc.cc_refreshes = 1;
+		if (CLNT_CALL_BACK(&bc->cc) != RPC_SUCCESS)
+			goto fail;
+	}
+
+	mutex_lock(&be->mtx);
+	while (be->done < br->iters && !be->failures)
+		cond_wait(&be->cv, &be->mtx);
+	mutex_unlock(&be->mtx);
+	bench_stop(br);
+	return (!be->failures);
+
+ fail:
+	clnt_req_release(&bc->cc);
+	mutex_lock(&be->mtx);
+	be->inflight--;
+	mutex_unlock(&be->mtx);
+	return (false);
+}
+
+static const struct bench benches[] = {
+	{ "xdr/mem/encode", 0, 0,
+	  bench_xdr_setup, bench_xdr_mem_encode, bench_xdr_teardown },
+	{ "xdr/mem/decode", 0, 0,
+	  bench_xdr_setup, bench_xdr_mem_decode, bench_xdr_teardown },
+	{ "xdr/ioq/encode_512", 0, 0,
+	  bench_xdr_setup, bench_xdr_ioq_encode, bench_xdr_teardown },
+	{ "xdr/ioq/decode_512", 0, 0,
+	  bench_xdr_setup, bench_xdr_ioq_decode, bench_xdr_teardown },
+	{ "work_pool/submit_1", 1, BENCH_WP_MAX_ITERS,
+	  bench_wp_setup, bench_wp, bench_wp_teardown },
+	{ "work_pool/submit_4", 4, BENCH_WP_MAX_ITERS,
+	  bench_wp_setup, bench_wp, bench_wp_teardown },
+	{ "svc_xprt/lookup", 0, 0,
+	  bench_xprt_setup, bench_xprt_lookup, bench_xprt_teardown },
+	{ "rbtree_x/lookup", 0, 0,
+	  bench_rbtx_setup, bench_rbtx_lookup, bench_rbtx_teardown },
+	{ "rbtree_x/remove_insert", 0, 0,
+	  bench_rbtx_setup, bench_rbtx_update, bench_rbtx_teardown },
+	{ "cksum/city64_256", 256, 0,
+	  bench_cksum_setup, bench_cksum_city, bench_cksum_teardown },
+	{ "cksum/city64_4096", 4096, 0,
+	  bench_cksum_setup, bench_cksum_city, bench_cksum_teardown },
+	{ "cksum/crc32c_256", 256, 0,
+	  bench_cksum_setup, bench_cksum_crc32c, bench_cksum_teardown },
+	{ "cksum/crc32c_4096", 4096, 0,
+	  bench_cksum_setup, bench_cksum_crc32c, bench_cksum_teardown },
+#ifdef _HAVE_GSSAPI
+	{ "authgss/ctx_hash_get", 0, 0,
+	  bench_gss_setup, bench_gss_get, bench_gss_teardown },
+#endif
+	{ "e2e/vc/null_call", 0, 0,
+	  bench_e2e_vc_setup, bench_e2e_call, bench_e2e_teardown },
+	{ "e2e/vc/null_window", 0, 0,
+	  bench_e2e_vc_setup, bench_e2e_window, bench_e2e_teardown },
+	{ "e2e/loop/null_call", 0, 0,
+	  bench_e2e_loop_setup, bench_e2e_call, bench_e2e_teardown },
+	{ "e2e/loop/null_window", 0, 0,
+	  bench_e2e_loop_setup, bench_e2e_window, bench_e2e_teardown },
+	{ NULL }
+};
+
+/*
+ * Driver
+ */
+
+static int
+bench_cmp_u64(const void *lhs, const void *rhs)
+{
+	uint64_t l = *(const uint64_t *)lhs;
+	uint64_t r = *(const uint64_t *)rhs;
+
+	return ((l > r) - (l < r));
+}
+
+static int
+bench_cmp_double(const void *lhs, const void *rhs)
+{
+	double l = *(const double *)lhs;
+	double r = *(const double *)rhs;
+
+	return ((l > r) - (l < r));
+}
+
+static bool
+bench_once(const struct bench *b, void *arg, struct bench_run *br,
+	   uint64_t iters)
+{
+	br->iters = iters;
+	br->stride = iters / BENCH_SAMPLES + 1;
+	br->nsamples = 0;
+	br->param = b->param;
+	return (b->run(br, arg));
+}
+
+static bool
+bench_measure(const struct bench *b, struct bench_result *res,
+	      uint64_t min_ns, int repeat)
+{
+	struct bench_run br;
+	double ns[repeat];
+	uint64_t p50[repeat];
+	uint64_t p99[repeat];
+	uint64_t iters = 1;
+	uint64_t elapsed;
+	uint64_t next;
+	uint32_t n;
+	void *arg;
+	int ix;
+
+	if (!b->setup(&arg)) {
+		fprintf(stderr, "%s: setup failed\n", b->name);
+		return (false);
+	}
+	memset(&br, 0, sizeof(br));
+	br.samples = calloc(BENCH_SAMPLES, sizeof(uint64_t));
+
+	/* calibrate */
+	for (;;) {
+		if (!bench_once(b, arg, &br, iters))
+			goto fail;
+		elapsed = br.stop_ns - br.start_ns;
+		if (elapsed >= min_ns
+		    || (b->max_iters && iters >= b->max_iters))
+			break;
+		/* aim past min_ns, growing at most 100 times */
+		next = elapsed ? (uint64_t) (iters * 1.2 * min_ns / elapsed)
+			       : iters * 100;
+		if (next > iters * 100)
+			next = iters * 100;
+		if (next <= iters)
+			next = iters + 1;
+		if (b->max_iters && next > b->max_iters)
+			next = b->max_iters;
+		iters = next;
+	}
+
+	for (ix = 0; ix < repeat; ix++) {
+		if (!bench_once(b, arg, &br, iters))
+			goto fail;
+		ns[ix] = (double)(br.stop_ns - br.start_ns) / iters;
+		n = br.nsamples < BENCH_SAMPLES ? br.nsamples : BENCH_SAMPLES;
+		p50[ix] = p99[ix] = 0;
+		if (n) {
+			qsort(br.samples, n, sizeof(uint64_t), bench_cmp_u64);
+			p50[ix] = br.samples[n * 50 / 100];
+			p99[ix] = br.samples[n * 99 / 100];
+		}
+	}
+	qsort(ns, repeat, sizeof(double), bench_cmp_double);
+	qsort(p50, repeat, sizeof(uint64_t), bench_cmp_u64);
+	qsort(p99, repeat, sizeof(uint64_t), bench_cmp_u64);
+
+	res->name = b->name;
+	res->iters = iters;
+	res->ns_per_op = ns[repeat / 2];
+	res->ns_min = ns[0];
+	res->ns_max = ns[repeat - 1];
+	res->p50_ns = p50[repeat / 2];
+	res->p99_ns = p99[repeat / 2];
+
+	b->teardown(arg);
+	free(br.samples);
+	return (true);
+
+ fail:
+	fprintf(stderr, "%s: run failed\n", b->name);
+	b->teardown(arg);
+	free(br.samples);
+	return (false);
+}
+
+static void
+bench_print(const struct bench_result *res)
+{
+	fprintf(stdout, "%-24s %12" PRIu64 " %12.1f %12.1f %12.1f %14.0f",
+		res->name, res->iters, res->ns_per_op, res->ns_min,
+		res->ns_max, 1e9 / res->ns_per_op);
+	if (res->p50_ns)
+		fprintf(stdout, " %10" PRIu64 " %10" PRIu64,
+			res->p50_ns, res->p99_ns);
+	fprintf(stdout, "\n");
+	fflush(stdout);
+}
+
+static bool
+bench_json(const char *path, const struct bench_result *res, int count,
+	   uint64_t min_ns, int repeat)
+{
+	FILE *fp = fopen(path, "w");
+	int ix;
+
+	if (!fp) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return (false);
+	}
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"ntirpc_bench\": 1,\n");
+	fprintf(fp, "  \"version\": \"%s\",\n", NTIRPC_VERSION);
+	fprintf(fp, "  \"timestamp\": %lld,\n", (long long)time(NULL));
+	fprintf(fp, "  \"cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+	fprintf(fp, "  \"min_time_ms\": %" PRIu64 ",\n", min_ns / 1000000);
+	fprintf(fp, "  \"repeat\": %d,\n", repeat);
+	fprintf(fp, "  \"results\": [");
+	for (ix = 0; ix < count; ix++) {
+		fprintf(fp, "%s\n    {\"name\": \"%s\", \"iterations\": %"
+			PRIu64 ", \"ns_per_op\": %.2f, \"ns_per_op_min\": %.2f"
+			", \"ns_per_op_max\": %.2f, \"ops_per_sec\": %.0f",
+			ix ? "," : "", res[ix].name, res[ix].iters,
+			res[ix].ns_per_op, res[ix].ns_min, res[ix].ns_max,
+			1e9 / res[ix].ns_per_op);
+		if (res[ix].p50_ns)
+			fprintf(fp, ", \"p50_ns\": %" PRIu64 ", \"p99_ns\": %"
+				PRIu64, res[ix].p50_ns, res[ix].p99_ns);
+		fprintf(fp, "}");
+	}
+	fprintf(fp, "\n  ]\n}\n");
+	return (!fclose(fp));
+}
+
+static struct svc_req *
+bench_alloc_request(SVCXPRT *xprt, XDR *xdrs)
+{
+	struct svc_req *req = calloc(1, sizeof(*req));
+
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	req->rq_xprt = xprt;
+	req->rq_xdrs = xdrs;
+	req->rq_refcnt = 1;
+
+	return req;
+}
+
+static void
+bench_free_request(struct svc_req *req, enum xprt_stat stat)
+{
+	SVC_RELEASE(req->rq_xprt, SVC_RELEASE_FLAG_NONE);
+	free(req);
+}
+
+static void usage(void)
+{
+	printf("Usage: ntirpc_bench [--quick] [--list] [--filter=<substring>] [--repeat=<n>] [--min-time=<ms>] [--json=<file>]\n");
+}
+
+static struct option long_options[] =
+{
+	{"filter", required_argument, NULL, 'f'},
+	{"json", required_argument, NULL, 'j'},
+	{"list", no_argument, NULL, 'l'},
+	{"min-time", required_argument, NULL, 'm'},
+	{"quick", no_argument, NULL, 'q'},
+	{"repeat", required_argument, NULL, 'r'},
+	{NULL, 0, NULL, 0}
+};
+
+int main(int argc, char *argv[])
+{
+	svc_init_params svc_params;
+	const struct bench *b;
+	struct bench_result *results;
+	const char *filter = NULL;
+	const char *json = NULL;
+	uint64_t min_ns = BENCH_MIN_TIME_MS * 1000000ULL;
+	int repeat = BENCH_REPEAT;
+	int count = 0;
+	int failed = 0;
+	int opt;
+	int ix;
+
+	while ((opt = getopt_long(argc, argv, "f:j:lm:qr:",
+				  long_options, NULL)) != -1) {
+		switch (opt)
+		{
+		case 'f':
+			filter = optarg;
+			break;
+		case 'j':
+			json = optarg;
+			break;
+		case 'l':
+			for (b = benches; b->name; b++)
+				printf("%s\n", b->name);
+			exit(0);
+		case 'm':
+			min_ns = strtoull(optarg, NULL, 10) * 1000000ULL;
+			break;
+		case 'q':
+			min_ns = BENCH_QUICK_TIME_MS * 1000000ULL;
+			repeat = 1;
+			break;
+		case 'r':
+			repeat = atoi(optarg);
+			break;
+		default:
+			usage();
+			exit(1);
+			break;
+		};
+	}
+	if (repeat < 1 || !min_ns) {
+		usage();
+		exit(1);
+	}
+
+	memset(&svc_params, 0, sizeof(svc_params));
+	svc_params.alloc_cb = bench_alloc_request;
+	svc_params.free_cb = bench_free_request;
+	svc_params.flags = SVC_INIT_EPOLL | SVC_INIT_NOREG_XPRTS;
+	svc_params.max_connections = BENCH_XPRT_COUNT * 2;
+	svc_params.max_events = 512;
+
+	if (!svc_init(&svc_params)) {
+		perror("svc_init failed");
+		exit(1);
+	}
+
+	for (ix = 0; ix < BENCH_KEYS; ix++)
+		bench_keys[ix] = (uint32_t) bench_random();
+
+	results = calloc(sizeof(benches) / sizeof(benches[0]),
+			 sizeof(*results));
+
+	fprintf(stdout, "ntirpc %s: min %" PRIu64 " ms, %d repetitions\n",
+		NTIRPC_VERSION, min_ns / 1000000, repeat);
+	fprintf(stdout, "%-24s %12s %12s %12s %12s %14s %10s %10s\n",
+		"benchmark", "iterations", "ns/op", "min", "max", "ops/s",
+		"p50 ns", "p99 ns");
+
+	for (b = benches; b->name; b++) {
+		if (filter && !strstr(b->name, filter))
+			continue;
+		if (!bench_measure(b, &results[count], min_ns, repeat)) {
+			failed++;
+			continue;
+		}
+		bench_print(&results[count++]);
+	}
+
+	if (json && !bench_json(json, results, count, min_ns, repeat))
+		failed++;
+
+	free(results);
+	(void)svc_shutdown(SVC_SHUTDOWN_FLAG_NONE);
+	return (failed ? 1 : 0);
+}
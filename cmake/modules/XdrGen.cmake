@@ -0,0 +1,24 @@
+# - Generate XDR codecs from an rpcgen-style .x file
+#
+# XDRGEN(<xfile> <basename> [xdrgen.py options...])
+#
+# Runs src/xdrgen/xdrgen.py on <xfile>, producing <basename>.c and
+# <basename>.h in the current binary directory, and sets
+# <basename>_XDRGEN_SRCS to the generated files for add_executable() or
+# add_library().  Any further arguments (--prefix, --no-types, --include,
+# --no-inline) are passed through to the generator.
+
+find_program(PYTHON3_EXECUTABLE NAMES python3)
+
+macro(XDRGEN _xfile _name)
+  set(_out_c "${CMAKE_CURRENT_BINARY_DIR}/${_name}.c")
+  set(_out_h "${CMAKE_CURRENT_BINARY_DIR}/${_name}.h")
+  add_custom_command(
+    OUTPUT ${_out_c} ${_out_h}
+    COMMAND ${PYTHON3_EXECUTABLE} "${NTIRPC_BASE_DIR}/src/xdrgen/xdrgen.py"
+      ${_xfile} -o ${_out_c} --header ${_out_h} ${ARGN}
+    DEPENDS "${NTIRPC_BASE_DIR}/src/xdrgen/xdrgen.py" ${_xfile}
+    COMMENT "Generating XDR codecs ${_name} from ${_xfile}"
+    )
+  set(${_name}_XDRGEN_SRCS ${_out_c} ${_out_h})
+endmacro(XDRGEN)
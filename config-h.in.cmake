@@ -15,6 +15,9 @@
 #cmakedefine _HAVE_GSSAPI 1
 #cmakedefine HAVE_STRING_H 1
 #cmakedefine HAVE_STRINGS_H 1
+#cmakedefine HAVE_SENDMMSG 1
+#cmakedefine HAVE_SENDFILE 1
+#cmakedefine HAVE_MEMFD_CREATE 1
 #cmakedefine LITTLEEND 1
 #cmakedefine BIGEND 1
 #cmakedefine TIRPC_EPOLL 1
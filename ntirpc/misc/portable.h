@@ -75,6 +75,7 @@ void warnx(const char *fmt, ...);
 #endif
 
 #define CACHE_PAD(_n) char __pad ## _n [CACHE_LINE_SIZE]
+#define CACHE_ALIGNED __attribute__ ((aligned(CACHE_LINE_SIZE)))
 
 /* Define bswap_## on non-GNU systems. */
 #if defined(_MSC_VER)
@@ -139,6 +139,7 @@ struct clnt_req {
 	CLIENT *cc_clnt;
 	struct xdrpair cc_call;
 	struct xdrpair cc_reply;
+	struct xdr_arena *cc_arena;	/* reply decode, NULL: mem_alloc() */
 	void (*cc_process_cb)(struct clnt_req *);
 	clnt_req_freer cc_free_cb;
 	struct timespec cc_timeout;
@@ -484,6 +485,11 @@ extern CLIENT *clnt_tli_ncreate(const int, const struct netconfig *,
 #define CLNT_CREATE_FLAG_SVCXPRT	0x40000000
 #define CLNT_CREATE_FLAG_XPRT_DOREG	SVC_CREATE_FLAG_XPRT_DOREG
 #define CLNT_CREATE_FLAG_XPRT_NOREG	SVC_CREATE_FLAG_XPRT_NOREG
+/* clnt_dg: connect the fd to the server, retransmit on an estimated
+ * timeout, and batch concurrent sends.  The fd must not be shared with
+ * clients of other servers.
+ */
+#define CLNT_CREATE_FLAG_DG_FAST	0x04000000
 
 extern CLIENT *clnt_vc_ncreatef(const int, const struct netbuf *,
 				const rpcprog_t, const rpcvers_t,
@@ -534,6 +540,31 @@ clnt_dg_ncreate(const int fd, const struct netbuf *raddr,
 				 CLNT_CREATE_FLAG_NONE));
 }
 
+/*
+ * Shared memory client for a svc_shm_ncreatef() server on this host.
+ */
+extern CLIENT *clnt_shm_ncreatef(const int, const struct netbuf *,
+				 const rpcprog_t, const rpcvers_t,
+				 const uint32_t);
+/*
+ * const int fd;    -- local stream socket
+ * const struct netbuf *svcaddr;  -- servers address
+ * const rpcprog_t program;  -- program number
+ * const rpcvers_t version;  -- version number
+ * const uint32_t flags;  -- CLNT_CREATE_FLAG_CONNECT, _CLOSE
+ */
+
+/*
+ * In-process loopback client on a svc_loop_ncreate() pair.
+ */
+extern CLIENT *clnt_loop_ncreate(SVCXPRT *, const rpcprog_t,
+				 const rpcvers_t);
+/*
+ * SVCXPRT *xprt;  -- server end of the pair
+ * const rpcprog_t program;  -- program number
+ * const rpcvers_t version;  -- version number
+ */
+
 /*
  * Memory based rpc (for speed check and testing)
  * CLIENT *
@@ -566,6 +597,7 @@ static inline void clnt_req_fill(struct clnt_req *cc, struct rpc_client *clnt,
 	cc->cc_call.where = argsp;
 	cc->cc_reply.proc = xresults;
 	cc->cc_reply.where = resultsp;
+	cc->cc_arena = NULL;
 	cc->cc_verf = _null_auth;
 
 	cc->cc_free_cb = (clnt_req_freer)__ntirpc_pkg_params.free_size_;
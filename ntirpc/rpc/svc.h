@@ -99,6 +99,8 @@ enum xprt_stat {
 #define SVC_INIT_EPOLL          0x0002
 #define SVC_INIT_NOREG_XPRTS    0x0008
 #define SVC_INIT_BLKIN          0x0010
+#define SVC_INIT_FAIR_QUEUE     0x0020	/* round robin requests by xprt */
+#define SVC_INIT_XDR_SIZEOF     0x0040	/* size send buffers by xdr_sizeof */
 
 #define SVC_SHUTDOWN_FLAG_NONE  0x0000
 
@@ -115,6 +117,7 @@ enum xprt_stat {
 #define SVCSET_XP_FREE_USER_DATA        16
 #define SVCGET_XP_UNREF_USER_DATA        17
 #define SVCSET_XP_UNREF_USER_DATA        18
+#define SVCSET_XP_DORMANT        19	/* trim a stalled record, in: NULL */
 
 /*
  * Operations for rpc_control().
@@ -131,6 +134,23 @@ typedef void (*svc_xprt_void_fun_t) (SVCXPRT *);
 typedef struct svc_req *(*svc_xprt_alloc_fun_t) (SVCXPRT *, XDR *);
 typedef void (*svc_xprt_free_fun_t) (struct svc_req *, enum xprt_stat);
 
+/*
+ * Payload placement for large stream records.
+ *
+ * Called with the first place_hdr_max bytes of a record (the RPC and
+ * program headers) and the count of record bytes that remain.  Returns an
+ * xdr_uio whose vectors, in order, receive the remainder directly from the
+ * socket (e.g., page aligned buffers for O_DIRECT), or NULL to use library
+ * buffers.  Each vector is filled from vio_tail to vio_wrap; all but the
+ * last should be a multiple of BYTES_PER_XDR_UNIT.  Any remainder past the
+ * vectors is received into a library buffer.
+ *
+ * The library consumes the returned reference, taking one more for each
+ * additional vector used; uio_release() is called once per reference.
+ */
+typedef xdr_uio *(*svc_xprt_place_fun_t) (SVCXPRT *, void *hdr,
+					   u_int hdr_len, u_int remain);
+
 typedef struct svc_init_params {
 	svc_xprt_fun_t disconnect_cb;
 	svc_xprt_alloc_fun_t alloc_cb;
@@ -153,13 +173,62 @@ typedef struct svc_init_params {
 	uint16_t nfs_rdma_port; /* Shared with Ganesha */
 	uint32_t max_rdma_connections;
 #endif
+	svc_xprt_place_fun_t place_cb;	/* stream payload placement */
+	u_int place_hdr_max;		/* header prefix before place_cb */
+	u_int max_inflight_xprt;	/* requests per stream xprt,
+					 * 0: unlimited */
+	u_int max_inflight;		/* requests in all xprts */
+	u_int max_queue_depth;		/* svc_work_pool queued entries */
+	u_int ioq_wait_target_us;	/* worker scaling, 0: idle spares */
+	u_int ioq_spawn_interval_ms;
+	u_int ioq_idle_reap_ms;
+	u_int busy_poll_us;		/* SVC_RQST_FLAG_BUSY_POLL budget */
+	u_int busy_poll_sock_us;	/* SO_BUSY_POLL on members, 0: off */
+	u_int run_budget;		/* SVC_RQST_FLAG_RUN_TO_COMPLETION */
+	u_int run_budget_us;		/*  events and time per batch */
+	u_int xdr_arena_size;		/* rq_arena chunk, 0: no arena */
+	u_int drc_max;			/* duplicate request cache, 0: off */
+	u_int drc_max_client;		/*  entries per client address and port */
+	u_int drc_partitions;
+	int32_t idle_trim_timeout;	/* seconds before trimming the receive
+					 * buffers of xprts idle within a
+					 * record, 0: off (below idle_timeout) */
 } svc_init_params;
 
 /* Svc param flags */
 #define SVC_FLAG_NONE             0x0000
 #define SVC_FLAG_NOREG_XPRTS      0x0001
+#define SVC_FLAG_FAIR_QUEUE       0x0002
+#define SVC_FLAG_XDR_SIZEOF       0x0004
 
 #define SVC_PARAM_HAS_THR_STACK_SIZE 1
+#define SVC_PARAM_HAS_PLACE_CB 1
+#define SVC_PARAM_HAS_MAX_INFLIGHT 1
+#define SVC_PARAM_HAS_IOQ_WAIT_TARGET 1
+#define SVC_PARAM_HAS_BUSY_POLL 1
+#define SVC_PARAM_HAS_RUN_BUDGET 1
+#define SVC_PARAM_HAS_XDR_ARENA 1
+#define SVC_PARAM_HAS_DRC 1
+#define SVC_PARAM_HAS_IDLE_TRIM 1
+
+/* svc_drc_stats() */
+struct svc_drc_stats {
+	uint64_t hits;		/* replies resent */
+	uint64_t busy;		/* dropped, original in progress */
+	uint64_t inserts;
+	uint64_t evicted;
+	uint32_t size;
+};
+
+/* default SVC_RQST_FLAG_BUSY_POLL spin budget */
+#define SVC_BUSY_POLL_DEFAULT_US	50
+
+/* default SVC_RQST_FLAG_RUN_TO_COMPLETION budgets per epoll batch */
+#define SVC_RUN_BUDGET_DEFAULT		16
+#define SVC_RUN_BUDGET_DEFAULT_US	1000
+
+/* default header prefix read before place_cb */
+#define SVC_PLACE_HDR_DEFAULT	512
 
 /*
  * SVCXPRT xp_flags
@@ -179,6 +248,8 @@ typedef struct svc_init_params {
 #define SVC_XPRT_TREE_LOCKED		0x0100
 #define SVC_XPRT_FLAG_REMOTE_ADDR_SET	0x0200	/* remote addr was final set */
 #define SVC_XPRT_FLAG_READY		0x0400	/* ready to use */
+#define SVC_XPRT_FLAG_DORMANT		0x0800	/* idle, trimmed if stalled */
+#define SVC_XPRT_FLAG_HANDOFF		0x1000	/* svc_xprt_handoff_send() */
 
 #define SVC_XPRT_FLAG_DESTROYED (SVC_XPRT_FLAG_DESTROYING \
 				| SVC_XPRT_FLAG_RELEASING)
@@ -220,7 +291,10 @@ typedef enum xprt_type {
 	XPRT_RDMA,
 	XPRT_RDMA_RENDEZVOUS,
 	XPRT_VSOCK,
-	XPRT_VSOCK_RENDEZVOUS
+	XPRT_VSOCK_RENDEZVOUS,
+	XPRT_SHM,
+	XPRT_SHM_RENDEZVOUS,
+	XPRT_LOOP
 } xprt_type_t;
 
 struct SVCAUTH;			/* forward decl. */
@@ -274,24 +348,32 @@ struct svc_xprt {
 		};
 		svc_xprt_fun_t rendezvous_cb;
 	}  xp_dispatch;
-	SVCXPRT *xp_parent;
-
-	char *xp_tp;		/* transport provider device name */
-	char *xp_netid;		/* network token */
 
 	void *xp_p1;		/* private: for use by svc ops */
-	void *xp_p2;		/* private: for use by svc ops */
-	void *xp_p3;		/* private: for use by svc lib */
 	void *xp_u1;		/* client user data */
 	void *xp_u2;		/* client user data */
 
+	int xp_fd;
+	int xp_fd_send;		/* Sometimes a dup of xp_fd needed for send */
+	int xp_type;		/* xprt type */
+
 #if defined(_USE_NFS_RDMA) || defined(USE_RPC_RDMA)
 	bool xp_rdma;		/* True if this xprt is RDMA enabled.
 				 * Shared with Ganesha */
 #endif
 
+	/* Above read by every event and request, within one cache line.
+	 * Below set at creation, rarely read.
+	 */
+	SVCXPRT *xp_parent;
+
+	char *xp_tp;		/* transport provider device name */
+	char *xp_netid;		/* network token */
+
+	void *xp_p2;		/* private: for use by svc ops */
+	void *xp_p3;		/* private: for use by svc lib */
+
 	struct rpc_address xp_local;	/* local address, length, port */
-	struct rpc_address xp_remote;	/* remote address, length, port */
 	struct rpc_address xp_proxy;	/* proxy address, length, port */
 
 #if defined(HAVE_BLKIN)
@@ -301,18 +383,21 @@ struct svc_xprt {
 		struct blkin_endpoint endp;
 	} blkin;
 #endif
-	/* serialize private data */
-	mutex_t xp_lock;
-
-	int xp_fd;
-	int xp_fd_send;		/* Sometimes a dup of xp_fd needed for send */
 	int xp_ifindex;		/* interface index */
 	int xp_si_type;		/* si type */
-	int xp_type;		/* xprt type */
 
+	struct rpc_address xp_remote;	/* remote address, length, port */
+
+	/* Below written by both receive and send; struct rpc_dplx_rec
+	 * continues this cache line with its other contended fields.
+	 */
 	int32_t xp_refcnt;	/* handle reference count */
 	uint16_t xp_flags;	/* flags */
 
+	/* serialize private data */
+	mutex_t xp_lock;
+
+	/* last, as its size depends on INET6 */
 	union {
 		struct in_pktinfo in;
 #ifdef INET6
@@ -393,6 +478,13 @@ struct svc_req {
 	struct blkin_trace bl_trace;
 #endif
 	uint32_t rq_refcnt;
+	uint32_t rq_reply_hint;	/* expected reply size, 0: unknown */
+
+	/* decode allocations when svc_init_params.xdr_arena_size is set;
+	 * free_cb must xdr_arena_release() it instead of XDR_FREE */
+	struct xdr_arena rq_arena;
+
+	void *rq_drc;		/* duplicate request cache entry (internal) */
 };
 
 /*
@@ -563,8 +655,11 @@ static inline void svc_destroy_it(SVCXPRT *xprt,
 	}
 
 	/* Let's shutdown the sockets so that FIN-ACK could be sent to the
-	 * client immediately. */
-	if (xprt->xp_fd != RPC_ANYFD) {
+	 * client immediately.  A per-datagram xprt shares the fd of its
+	 * rendezvous, which must stay usable, as must a socket handed off
+	 * to a successor. */
+	if (xprt->xp_fd != RPC_ANYFD && xprt->xp_type != XPRT_UDP
+	 && !(flags & SVC_XPRT_FLAG_HANDOFF)) {
 		(void)shutdown(xprt->xp_fd, SHUT_RDWR);
 		if (xprt->xp_fd_send != RPC_ANYFD)
 			(void)shutdown(xprt->xp_fd_send, SHUT_RDWR);
@@ -586,6 +681,8 @@ __BEGIN_DECLS
 extern struct work_pool svc_work_pool;
 
 bool svc_init(struct svc_init_params *);
+void svc_work_pool_stats(struct work_pool_stats *);
+void svc_drc_stats(struct svc_drc_stats *);
 __END_DECLS
 /*
  * Service shutdown (optional).
@@ -776,6 +873,57 @@ svc_dg_ncreate(const int fd, const u_int sendsize, const u_int recvsize)
 	return (svc_dg_ncreatef(fd, sendsize, recvsize, SVC_CREATE_FLAG_CLOSE));
 }
 
+/*
+ * Shared memory rings for same-host clients (clnt_shm_ncreatef), accepted
+ * on a local stream socket.  sendsize and recvsize size the rings of each
+ * connection, 0 => default.
+ */
+extern SVCXPRT *svc_shm_ncreatef(const int, const u_int, const u_int,
+				 const uint32_t);
+/*
+ *      const int fd;                           -- local socket end point
+ *      const u_int sendsize;                   -- reply ring size
+ *      const u_int recvsize;                   -- call ring size
+ *      const uint32_t flags;                   -- flags
+ */
+
+/*
+ * In-process loopback pair (clnt_loop_ncreate), for benchmarks and tests.
+ * Returns the server end, with a reference for the caller.
+ */
+extern SVCXPRT *svc_loop_ncreate(void);
+
+/*
+ * Restart without reconnecting.  svc_xprt_handoff_send() stops receiving
+ * on the stream listeners, their connections, and the datagram transports
+ * registered on event channels, waits up to timeout_ms for requests and
+ * replies in progress, then passes their sockets (SCM_RIGHTS) and any
+ * partially received record over a connected AF_UNIX socket.  The
+ * transports sent are destroyed here without shutting down their sockets;
+ * references the caller holds, as from svc_vc_ncreatef(), are still its
+ * to release.  Returns the number sent, or -1 with errno set (ETIMEDOUT:
+ * none sent, and the transports are receiving again).
+ *
+ * svc_xprt_handoff_recv() recreates them in the successor.  Connections
+ * are passed to their new listener's rendezvous_cb, as if just accepted,
+ * listeners and datagram transports to setup_cb to set their xp_dispatch,
+ * with the reference from their creation.
+ * Each is registered on the event channel with its former id when that
+ * exists, otherwise as svc_vc_rendezvous() would.  Returns the number
+ * recreated, or -1 with errno set.
+ */
+extern int svc_xprt_handoff_send(const int, const int);
+/*
+ *      const int sock;                         -- connected AF_UNIX socket
+ *      const int timeout_ms;                   -- drain timeout
+ */
+
+extern int svc_xprt_handoff_recv(const int, svc_xprt_fun_t);
+/*
+ *      const int sock;                         -- connected AF_UNIX socket
+ *      svc_xprt_fun_t setup_cb;                -- listener and dg setup
+ */
+
 /*
  * the routine takes any *open* connection
  */
@@ -53,7 +53,11 @@
 #define SVC_RQST_FLAG_SHUTDOWN		SVC_XPRT_FLAG_DESTROYING
 #define SVC_RQST_FLAG_XPRT_UREG		SVC_XPRT_FLAG_UREG
 #define SVC_RQST_FLAG_CHAN_AFFINITY	0x1000 /* bind conn to parent chan */
-#define SVC_RQST_FLAG_MASK (SVC_RQST_FLAG_CHAN_AFFINITY)
+#define SVC_RQST_FLAG_BUSY_POLL		0x2000 /* spin before sleeping */
+#define SVC_RQST_FLAG_RUN_TO_COMPLETION	0x4000 /* handle events inline */
+#define SVC_RQST_FLAG_MASK (SVC_RQST_FLAG_CHAN_AFFINITY \
+			    | SVC_RQST_FLAG_BUSY_POLL \
+			    | SVC_RQST_FLAG_RUN_TO_COMPLETION)
 
 /* uint32_t instructions */
 #define SVC_RQST_FLAG_LOCKED		SVC_XPRT_FLAG_LOCKED
@@ -68,6 +72,19 @@ int svc_rqst_evchan_reg(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags);
 int svc_rqst_thrd_signal(uint32_t chan_id, uint32_t flags);
 void svc_rqst_shutdown(void);
 
+/* SVC_RQST_FLAG_BUSY_POLL cost and effect */
+struct svc_rqst_evchan_stats {
+	uint64_t spins;		/* busy poll attempts */
+	uint64_t spin_hits;	/* found events before the budget expired */
+	uint64_t spin_ns;	/* time spent spinning */
+	uint64_t sleeps;	/* blocking epoll_wait calls */
+	uint64_t run_inline;	/* events handled on the channel thread */
+	uint64_t run_handoff;	/* events over budget, to svc_work_pool */
+};
+
+int svc_rqst_evchan_stats(uint32_t chan_id,
+			  struct svc_rqst_evchan_stats *stats);
+
 /* iterator callback prototype */
 typedef void (*svc_rqst_xprt_each_func_t) (uint32_t chan_id, SVCXPRT *xprt,
 					   void *arg);
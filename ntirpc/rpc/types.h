@@ -115,6 +115,15 @@ typedef int32_t rpc_inline_t;
 #define TIRPC_SET_DEBUG_FLAGS		3
 #define TIRPC_GET_OTHER_FLAGS		4
 #define TIRPC_SET_OTHER_FLAGS		5
+#define TIRPC_DUMP_TRACE_RING		6	/* in: mem_format_t, or NULL */
+#define TIRPC_ALLOC_PROFILE_START	7	/* before any allocation */
+#define TIRPC_DUMP_ALLOC_PROFILE	8	/* in: mem_format_t, or NULL */
+
+/*
+ * Other flags support
+ */
+
+#define TIRPC_OTHER_FLAG_TRACE_RING     0x0000001	/* binary __warnx */
 
 /*
  * Debug flags support
@@ -186,12 +195,19 @@ typedef struct tirpc_pkg_params {
 
 extern tirpc_pkg_params __ntirpc_pkg_params;
 
+/* in trace_ring.c */
+extern void __ntirpc_trace(const char *fmt, ...);
+
 #include <misc/abstract_atomic.h>
 
 #define __warnx(flags, ...) \
 	do {					   \
 		if (__ntirpc_pkg_params.debug_flags & (flags)) {	\
-			__ntirpc_pkg_params.warnx_(__VA_ARGS__);	\
+			if (__ntirpc_pkg_params.other_flags		\
+			    & TIRPC_OTHER_FLAG_TRACE_RING)		\
+				__ntirpc_trace(__VA_ARGS__);		\
+			else						\
+				__ntirpc_pkg_params.warnx_(__VA_ARGS__); \
 		}							\
 	} while (0)
 
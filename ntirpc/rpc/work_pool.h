@@ -46,18 +46,69 @@ struct work_pool_params {
 	int32_t thrd_max;
 	int32_t thrd_min;
 	uint32_t thr_stack_size;
+	uint32_t wait_target_us;	/* queue wait target, 0: spawn to keep
+					 * thrd_min idle (no controller) */
+	uint32_t spawn_interval_ms;	/* between latency-driven spawns */
+	uint32_t idle_reap_ms;		/* idle before exit, 0: default */
+};
+
+/* Controller decisions and queue state (work_pool_get_stats) */
+struct work_pool_stats {
+	uint64_t dispatched;		/* entries dequeued */
+	uint64_t spawned;		/* threads started */
+	uint64_t spawn_limited;		/* spawns deferred by interval */
+	uint64_t reaped;		/* idle threads exited */
+	uint64_t reap_held;		/* idle threads kept by hysteresis */
+	uint32_t wait_avg_us;		/* moving average of queue wait */
+	uint32_t wait_max_us;		/* since previous work_pool_get_stats */
+	uint32_t n_threads;
+	uint32_t n_idle;
+	uint32_t n_queued;
+};
+
+/* Priority lanes (work_pool_entry.prio), dequeued HIGH, NORMAL, LOW */
+#define WORK_POOL_PRIO_NORMAL	0	/* default (zeroed) */
+#define WORK_POOL_PRIO_HIGH	1	/* events, replies, timers, resume */
+#define WORK_POOL_PRIO_LOW	2	/* teardown and background */
+#define WORK_POOL_PRIOS		3
+
+/* dequeues from higher lanes before a waiting lower lane gets a turn */
+#define WORK_POOL_LANE_STARVE	32
+
+/*
+ * Deficit round robin flow.  Entries submitted with the same flow are
+ * served in order, quantum entries per round, interleaved with other
+ * flows in the same lane.  Owned (and embedded) by the submitter, and
+ * must not be released while it has entries queued.
+ */
+struct work_pool_flow {
+	TAILQ_ENTRY(work_pool_flow) wpfq;	/* active in lane */
+	struct poolq_head_s qh;			/* queued entries */
+	uint32_t quantum;			/* entries per round */
+	uint32_t deficit;
+	bool active;
+};
+
+struct work_pool_lane {
+	TAILQ_HEAD(work_pool_flow_s, work_pool_flow) flows;
+	struct work_pool_flow fifo;		/* entries without a flow */
+	uint32_t skipped;
 };
 
 struct work_pool_thread;
 
 struct work_pool {
-	struct poolq_head pqh;
+	struct poolq_head pqh;		/* qmutex, qcount: waiting threads */
 	TAILQ_HEAD(work_pool_s, work_pool_thread) wptqh;
+	struct work_pool_lane lane[WORK_POOL_PRIOS];
 	char *name;
 	pthread_attr_t attr;
 	struct work_pool_params params;
+	struct work_pool_stats stats;
+	uint64_t spawn_ns;	/* last latency-driven spawn */
 	long timeout_ms;
 	uint32_t n_threads;
+	uint32_t n_queued;	/* entries waiting in all lanes */
 	uint32_t worker_index;
 };
 
@@ -83,10 +134,23 @@ struct work_pool_entry {
 	struct work_pool_thread *wpt;
 	work_pool_fun_t fun;
 	void *arg;
+	struct work_pool_flow *flow;	/* NULL: lane fifo */
+	uint32_t prio;			/* WORK_POOL_PRIO_* */
+	uint64_t queued_ns;		/* set by work_pool_submit */
 };
 
+static inline void
+work_pool_flow_init(struct work_pool_flow *flow, uint32_t quantum)
+{
+	TAILQ_INIT(&flow->qh);
+	flow->quantum = quantum ? quantum : 1;
+	flow->deficit = 0;
+	flow->active = false;
+}
+
 int work_pool_init(struct work_pool *, const char *, struct work_pool_params *);
 int work_pool_submit(struct work_pool *, struct work_pool_entry *);
 int work_pool_shutdown(struct work_pool *);
+void work_pool_get_stats(struct work_pool *, struct work_pool_stats *);
 
 #endif				/* WORK_POOL_H */
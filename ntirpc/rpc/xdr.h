@@ -123,6 +123,7 @@ typedef enum vio_type {
 	VIO_DATA,               /* data buffer */
 	VIO_TRAILER_LEN,	/* length field for following TRAILER buffer */
 	VIO_TRAILER,            /* trailer buffer after data */
+	VIO_FILE,		/* file range, see struct xdr_vio_file */
 } vio_type;
 
 /* XDR buffer vector descriptors */
@@ -138,6 +139,21 @@ typedef struct xdr_vio {
 
 /* vio_wrap >= vio_tail >= vio_head >= vio_base */
 
+/*
+ * File range referenced by a VIO_FILE vector (xdr_uio_file_create).
+ *
+ * vio_base points here.  vio_head and vio_tail are not addresses, but
+ * positions in the range (vio_head - vio_base is the offset into it), so
+ * stream lengths and partial writes use the same arithmetic as memory.
+ * The range is read when the stream is sent (xdr_ioq), or when it is
+ * put into a memory stream (xdrmem); it must not be wrapped or
+ * checksummed (RPCSEC_GSS integrity and privacy).
+ */
+struct xdr_vio_file {
+	int fd;
+	off_t offset;
+};
+
 #define UIO_FLAG_NONE		0x0000
 #define UIO_FLAG_BUFQ		0x0001
 #define UIO_FLAG_FREE		0x0002
@@ -169,10 +185,16 @@ typedef struct xdr_uio {
 #define XDR_PUTBUFS_FLAG_NONE    0x0000
 #define XDR_PUTBUFS_FLAG_RDNLY   0x0001
 
+/* Opaques at least this long are decoded by reference, when the stream
+ * supports XDR_GETBUFS (see xdr_opaque_decode_uio).
+ */
+#define XDR_OPAQUE_REFER_MIN	(4096)
+
 #define XDR_FLAG_NONE		0x0000
 #define XDR_FLAG_CKSUM		0x0001
 #define XDR_FLAG_FREE		0x0002
 #define XDR_FLAG_VIO		0x0004
+#define XDR_FLAG_ARENA		0x0008	/* decode allocations, x_lib[0] */
 
 /*
  * The XDR handle.
@@ -203,7 +225,7 @@ typedef struct rpc_xdr {
 		void (*x_destroy)(struct rpc_xdr *);
 		bool (*x_control)(struct rpc_xdr *, int, void *);
 		/* new vector and refcounted interfaces */
-		bool (*x_getbufs)(struct rpc_xdr *, xdr_uio *, u_int);
+		bool (*x_getbufs)(struct rpc_xdr *, xdr_uio **, u_int, u_int);
 		bool (*x_putbufs)(struct rpc_xdr *, xdr_uio *, u_int);
 		/* Force a new buffer to start (or fail) */
 		bool (*x_newbuf)(struct rpc_xdr *);
@@ -227,6 +249,102 @@ typedef struct rpc_xdr {
 
 #define XDR_VIO(x) ((xdr_vio *)((x)->x_base))
 
+/*
+ * Per-request bump allocator for XDR_DECODE.
+ *
+ * When attached (XDR_FLAG_ARENA), the generic routines take the storage
+ * for NULL target pointers from the arena instead of mem_alloc().  The
+ * owner releases everything with one xdr_arena_release(), and must not
+ * XDR_FREE the decoded objects.
+ */
+#define XDR_ARENA_ALIGN		(16)
+#define XDR_ARENA_CHUNK_DEFAULT	(4096)
+
+struct xdr_arena_chunk;
+
+struct xdr_arena {
+	struct xdr_arena_chunk *chunks;	/* newest first */
+	uint8_t *next;
+	uint8_t *end;
+	u_int chunk_size;	/* 0: XDR_ARENA_CHUNK_DEFAULT */
+	u_int allocated;	/* bytes handed out */
+};
+
+__BEGIN_DECLS
+extern void *xdr_arena_more(struct xdr_arena *, size_t);
+extern void xdr_arena_release(struct xdr_arena *);
+__END_DECLS
+
+static inline void
+xdr_arena_init(struct xdr_arena *arena, u_int chunk_size)
+{
+	arena->chunks = NULL;
+	arena->next = NULL;
+	arena->end = NULL;
+	arena->chunk_size = chunk_size;
+	arena->allocated = 0;
+}
+
+static inline void *
+xdr_arena_alloc(struct xdr_arena *arena, size_t size)
+{
+	uint8_t *p = arena->next;
+
+	size = (size + XDR_ARENA_ALIGN - 1) & ~((size_t)XDR_ARENA_ALIGN - 1);
+	if (likely(size <= (size_t)(arena->end - p))) {
+		arena->next = p + size;
+		arena->allocated += size;
+		return (p);
+	}
+	return (xdr_arena_more(arena, size));
+}
+
+static inline void
+xdr_arena_attach(XDR *xdrs, struct xdr_arena *arena)
+{
+	xdrs->x_lib[0] = arena;
+	xdrs->x_flags |= XDR_FLAG_ARENA;
+}
+
+static inline void
+xdr_arena_detach(XDR *xdrs)
+{
+	xdrs->x_flags &= ~XDR_FLAG_ARENA;
+	xdrs->x_lib[0] = NULL;
+}
+
+static inline struct xdr_arena *
+xdr_arena_get(XDR *xdrs)
+{
+	return ((xdrs->x_flags & XDR_FLAG_ARENA)
+		? (struct xdr_arena *)xdrs->x_lib[0] : NULL);
+}
+
+/* storage for NULL target pointers during XDR_DECODE */
+static inline void *
+xdr_decode_alloc(XDR *xdrs, size_t size)
+{
+	if (xdrs->x_flags & XDR_FLAG_ARENA)
+		return (xdr_arena_alloc(xdrs->x_lib[0], size));
+	return (mem_alloc(size));
+}
+
+static inline void *
+xdr_decode_zalloc(XDR *xdrs, size_t size)
+{
+	if (xdrs->x_flags & XDR_FLAG_ARENA)
+		return (memset(xdr_arena_alloc(xdrs->x_lib[0], size), 0, size));
+	return (mem_zalloc(size));
+}
+
+/* undo xdr_decode_alloc() after a failed decode; arena space is kept */
+static inline void
+xdr_decode_free(XDR *xdrs, void *p, size_t size)
+{
+	if (!(xdrs->x_flags & XDR_FLAG_ARENA))
+		mem_free(p, size);
+}
+
 static inline size_t
 xdr_size_inline(XDR *xdrs)
 {
@@ -670,6 +788,7 @@ extern bool xdr_pointer(XDR *, void **, u_int, xdrproc_t);
 extern bool xdr_wrapstring(XDR *, char **);
 extern bool xdr_longlong_t(XDR *, quad_t *);
 extern bool xdr_u_longlong_t(XDR *, u_quad_t *);
+extern bool xdr_opaque_decode_uio(XDR *, xdr_uio **, u_int);
 
 __END_DECLS
 
@@ -706,6 +825,9 @@ extern void xdrmem_ncreate(XDR *, char *, u_int, enum xdr_op);
 /* intrinsic checksum (be careful) */
 extern uint64_t xdrmem_cksum(XDR *, u_int);
 
+/* XDR counting the encoded length of an object */
+extern u_long xdr_sizeof(xdrproc_t, void *);
+
 __END_DECLS
 /* For backward compatibility */
 #include <rpc/tirpc_compat.h>
@@ -52,6 +52,12 @@
 #include <rpc/types.h>
 #include <rpc/xdr.h>
 
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 /*
  * XDR integers
  */
@@ -450,6 +456,10 @@ xdr_opaque_decode(XDR *xdrs, char *cp, u_int cnt)
 	if (rndup > 0) {
 		uint32_t crud;
 
+		/* skip padding in place when it is within this buffer */
+		if (xdr_inline_decode(xdrs, BYTES_PER_XDR_UNIT - rndup))
+			return (true);
+
 		if (!XDR_GETBYTES(xdrs, (char *) &crud,
 				  BYTES_PER_XDR_UNIT - rndup)) {
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
@@ -492,6 +502,14 @@ xdr_opaque_encode(XDR *xdrs, const char *cp, u_int cnt)
 
 	if (rndup > 0) {
 		uint32_t zero = 0;
+		int32_t *buf = xdr_inline_encode(xdrs,
+						 BYTES_PER_XDR_UNIT - rndup);
+
+		/* zero padding in place when it is within this buffer */
+		if (buf) {
+			memset(buf, 0, BYTES_PER_XDR_UNIT - rndup);
+			return (true);
+		}
 
 		if (!XDR_PUTBYTES(xdrs, (char *) &zero,
 				  BYTES_PER_XDR_UNIT - rndup))
@@ -595,13 +613,13 @@ xdr_bytes_decode(XDR *xdrs, char **cpp, u_int *sizep, u_int maxsize)
 	if (!size)
 		return (true);
 	if (!sp)
-		sp = (char *)mem_alloc(size);
+		sp = (char *)xdr_decode_alloc(xdrs, size);
 
 	ret = xdr_opaque_decode(xdrs, sp, size);
 	if (!ret) {
 		if (!*cpp) {
 			/* Only free if we allocated */
-			mem_free(sp, size);
+			xdr_decode_free(xdrs, sp, size);
 		}
 		return (ret);
 	}
@@ -741,6 +759,328 @@ xdr_vector(XDR *xdrs, char *basep, u_int nelem, u_int selem,
 	return (true);
 }
 
+/*
+ * Bulk byte order conversion of XDR units.
+ *
+ * Used by the fixed-size integer vectors below to convert whole runs
+ * between user memory and the current stream buffer.  The conversion is
+ * its own inverse, so the same routine serves encode and decode.  The
+ * stream side is only guaranteed to be XDR unit (4 byte) aligned, so all
+ * loads and stores are unaligned-safe.  Little-endian hosts only; the
+ * vector shuffles always reverse.
+ */
+static inline void
+xdr_swap32_run(void *dst, const void *src, u_int n)
+{
+	const uint32_t *s = (const uint32_t *)src;
+	uint32_t *d = (uint32_t *)dst;
+	u_int i = 0;
+
+#if defined(__AVX2__)
+	const __m256i mask256 = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+
+		_mm256_storeu_si256((__m256i *)(d + i),
+				    _mm256_shuffle_epi8(v, mask256));
+	}
+#endif
+#if defined(__SSSE3__)
+	const __m128i mask128 = _mm_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+
+		_mm_storeu_si128((__m128i *)(d + i),
+				 _mm_shuffle_epi8(v, mask128));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 4 <= n; i += 4) {
+		uint8x16_t v = vld1q_u8((const uint8_t *)(s + i));
+
+		vst1q_u8((uint8_t *)(d + i), vrev32q_u8(v));
+	}
+#endif
+	for (; i < n; i++)
+		d[i] = ntohl(s[i]);
+}
+
+/*
+ * 64-bit elements are transmitted as two XDR units, most significant
+ * first; that is a plain 8 byte reversal on little-endian hosts.
+ */
+static inline void
+xdr_swap64_run(void *dst, const void *src, u_int n)
+{
+	const uint32_t *s = (const uint32_t *)src;
+	uint32_t *d = (uint32_t *)dst;
+	u_int i = 0;
+
+#if defined(__AVX2__)
+	const __m256i mask256 = _mm256_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+	for (; i + 4 <= n; i += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(s + i * 2));
+
+		_mm256_storeu_si256((__m256i *)(d + i * 2),
+				    _mm256_shuffle_epi8(v, mask256));
+	}
+#endif
+#if defined(__SSSE3__)
+	const __m128i mask128 = _mm_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+	for (; i + 2 <= n; i += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i * 2));
+
+		_mm_storeu_si128((__m128i *)(d + i * 2),
+				 _mm_shuffle_epi8(v, mask128));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 2 <= n; i += 2) {
+		uint8x16_t v = vld1q_u8((const uint8_t *)(s + i * 2));
+
+		vst1q_u8((uint8_t *)(d + i * 2), vrev64q_u8(v));
+	}
+#endif
+	for (; i < n; i++) {
+		uint32_t hi = s[i * 2];
+		uint32_t lo = s[i * 2 + 1];
+
+		d[i * 2] = ntohl(lo);
+		d[i * 2 + 1] = ntohl(hi);
+	}
+}
+
+/*
+ * XDR a fixed length array of 32-bit integers.
+ *
+ * Equivalent to xdr_vector(xdrs, basep, nelem, sizeof(uint32_t),
+ * xdr_uint32_t), but converts each run that lies within the current
+ * stream buffer in one pass.  An element straddling a buffer boundary
+ * falls back to the stream's getunit/putunit.
+ */
+static inline bool
+xdr_uint32_vector(XDR *xdrs, uint32_t *basep, u_int nelem)
+{
+	size_t n;
+
+	switch (xdrs->x_op) {
+	case XDR_DECODE:
+		while (nelem) {
+			n = xdr_tail_inline(xdrs) / BYTES_PER_XDR_UNIT;
+			if (n > nelem)
+				n = nelem;
+			if (!n) {
+				if (!XDR_GETUINT32(xdrs, basep)) {
+					__warnx(TIRPC_DEBUG_FLAG_ERROR,
+						"%s:%u ERROR remaining %u",
+						__func__, __LINE__, nelem);
+					return (false);
+				}
+				n = 1;
+			} else {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+				memcpy(basep, xdrs->x_data,
+				       n * BYTES_PER_XDR_UNIT);
+#else
+				xdr_swap32_run(basep, xdrs->x_data, n);
+#endif
+				xdrs->x_data += n * BYTES_PER_XDR_UNIT;
+			}
+			basep += n;
+			nelem -= n;
+		}
+		return (true);
+
+	case XDR_ENCODE:
+		while (nelem) {
+			n = xdr_size_inline(xdrs) / BYTES_PER_XDR_UNIT;
+			if (n > nelem)
+				n = nelem;
+			if (!n) {
+				if (!XDR_PUTUINT32(xdrs, *basep))
+					return (false);
+				n = 1;
+			} else {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+				memcpy(xdrs->x_data, basep,
+				       n * BYTES_PER_XDR_UNIT);
+#else
+				xdr_swap32_run(xdrs->x_data, basep, n);
+#endif
+				xdrs->x_data += n * BYTES_PER_XDR_UNIT;
+				xdr_tail_update(xdrs);
+			}
+			basep += n;
+			nelem -= n;
+		}
+		return (true);
+
+	case XDR_FREE:
+		return (true);
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_ERROR,
+		"%s:%u ERROR xdrs->x_op (%u)",
+		__func__, __LINE__,
+		xdrs->x_op);
+	return (false);
+}
+
+static inline bool
+xdr_int32_vector(XDR *xdrs, int32_t *basep, u_int nelem)
+{
+	return (xdr_uint32_vector(xdrs, (uint32_t *)basep, nelem));
+}
+
+/*
+ * XDR a fixed length array of 64-bit integers.
+ * (always transmitted as pairs of unsigned 32-bit)
+ */
+static inline bool
+xdr_uint64_vector(XDR *xdrs, uint64_t *basep, u_int nelem)
+{
+	size_t n;
+
+	switch (xdrs->x_op) {
+	case XDR_DECODE:
+		while (nelem) {
+			n = xdr_tail_inline(xdrs) / sizeof(uint64_t);
+			if (n > nelem)
+				n = nelem;
+			if (!n) {
+				if (!xdr_uint64_t(xdrs, basep)) {
+					__warnx(TIRPC_DEBUG_FLAG_ERROR,
+						"%s:%u ERROR remaining %u",
+						__func__, __LINE__, nelem);
+					return (false);
+				}
+				n = 1;
+			} else {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+				memcpy(basep, xdrs->x_data,
+				       n * sizeof(uint64_t));
+#else
+				xdr_swap64_run(basep, xdrs->x_data, n);
+#endif
+				xdrs->x_data += n * sizeof(uint64_t);
+			}
+			basep += n;
+			nelem -= n;
+		}
+		return (true);
+
+	case XDR_ENCODE:
+		while (nelem) {
+			n = xdr_size_inline(xdrs) / sizeof(uint64_t);
+			if (n > nelem)
+				n = nelem;
+			if (!n) {
+				if (!xdr_uint64_t(xdrs, basep))
+					return (false);
+				n = 1;
+			} else {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+				memcpy(xdrs->x_data, basep,
+				       n * sizeof(uint64_t));
+#else
+				xdr_swap64_run(xdrs->x_data, basep, n);
+#endif
+				xdrs->x_data += n * sizeof(uint64_t);
+				xdr_tail_update(xdrs);
+			}
+			basep += n;
+			nelem -= n;
+		}
+		return (true);
+
+	case XDR_FREE:
+		return (true);
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_ERROR,
+		"%s:%u ERROR xdrs->x_op (%u)",
+		__func__, __LINE__,
+		xdrs->x_op);
+	return (false);
+}
+
+static inline bool
+xdr_int64_vector(XDR *xdrs, int64_t *basep, u_int nelem)
+{
+	return (xdr_uint64_vector(xdrs, (uint64_t *)basep, nelem));
+}
+
+/*
+ * XDR a counted array of 32-bit integers (bitmaps and the like).
+ * > **cpp: pointer to the array
+ * > *sizep: number of elements
+ * > maxsize: maximum number of elements
+ *
+ * If *cpp is NULL on decode, (*sizep * sizeof(uint32_t)) bytes are allocated.
+ */
+static inline bool
+xdr_uint32_array(XDR *xdrs, uint32_t **cpp, u_int *sizep, u_int maxsize)
+{
+	uint32_t size;
+
+	switch (xdrs->x_op) {
+	case XDR_DECODE:
+		if (!XDR_GETUINT32(xdrs, &size)) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s:%u ERROR size",
+				__func__, __LINE__);
+			return (false);
+		}
+		if (size > maxsize) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s:%u ERROR size %" PRIu32 " > max %u",
+				__func__, __LINE__,
+				size, maxsize);
+			return (false);
+		}
+		*sizep = (u_int)size;		/* only valid size */
+		if (!size)
+			return (true);
+		if (!*cpp)
+			*cpp = (uint32_t *) xdr_decode_zalloc(xdrs,
+						size * sizeof(uint32_t));
+		return (xdr_uint32_vector(xdrs, *cpp, size));
+
+	case XDR_ENCODE:
+		if (*sizep > maxsize) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s:%u ERROR size %u > max %u",
+				__func__, __LINE__,
+				*sizep, maxsize);
+			return (false);
+		}
+		if (!XDR_PUTUINT32(xdrs, *sizep))
+			return (false);
+		return (xdr_uint32_vector(xdrs, *cpp, *sizep));
+
+	case XDR_FREE:
+		if (*cpp) {
+			mem_free(*cpp, *sizep * sizeof(uint32_t));
+			*cpp = NULL;
+		}
+		return (true);
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_ERROR,
+		"%s:%u ERROR xdrs->x_op (%u)",
+		__func__, __LINE__,
+		xdrs->x_op);
+	return (false);
+}
+
 /*
  * XDR an array of arbitrary elements
  * > **cpp: pointer to the array
@@ -792,7 +1132,7 @@ xdr_array_decode(XDR *xdrs, char **cpp, u_int *sizep, u_int maxsize,
 	if (!size)
 		return (true);
 	if (!target)
-		*cpp = target = (char*) mem_zalloc(size * selem);
+		*cpp = target = (char *) xdr_decode_zalloc(xdrs, size * selem);
 
 	for (; (i < size) && stat; i++) {
 		stat = (*xdr_elem) (xdrs, target);
@@ -942,11 +1282,11 @@ xdr_string_decode(XDR *xdrs, char **cpp, u_int maxsize)
 	 * now deal with the actual bytes
 	 */
 	if (!sp)
-		sp = (char *)mem_alloc(nodesize);
+		sp = (char *)xdr_decode_alloc(xdrs, nodesize);
 
 	ret = xdr_opaque_decode(xdrs, sp, size);
 	if (!ret) {
-		mem_free(sp, nodesize);
+		xdr_decode_free(xdrs, sp, nodesize);
 		return (ret);
 	}
 	sp[size] = '\0';
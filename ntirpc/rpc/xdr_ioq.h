@@ -113,6 +113,7 @@ struct xdr_ioq_uv_head {
 	size_t max_bsize;	/* multiple of min_bsize */
 	size_t plength;		/* sub-total of previous lengths, not including
 				 * any length in this xdr_ioq_uv */
+	size_t hint;		/* expected stream length, 0: unknown */
 	u_int pcount;		/* fill index (0..m) in the current stream */
 };
 
@@ -149,6 +150,11 @@ struct xdr_ioq {
 #define IOQ_FLAG_UNLOCK		0x00020000
 #define IOQ_FLAG_BALLOC		0x00040000
 
+/* Segment size classes (see xdr_ioq_size_class) */
+#define XDR_IOQ_SIZE_CLASS_MIN	(1024)
+#define XDR_IOQ_SIZE_CLASS_MAX	(1024 * 1024)
+
+extern size_t xdr_ioq_size_class(size_t size);
 extern struct xdr_ioq_uv *xdr_ioq_uv_create(size_t size, u_int uio_flags);
 extern struct poolq_entry *xdr_ioq_uv_fetch(struct xdr_ioq *xioq,
 					     struct poolq_head *ioqh,
@@ -164,6 +170,9 @@ extern void xdr_ioq_uv_release(struct xdr_ioq_uv *uv);
 
 extern struct xdr_ioq *xdr_ioq_create(size_t min_bsize, size_t max_bsize,
 				      u_int uio_flags);
+extern xdr_uio *xdr_ioq_hold(struct xdr_ioq *xioq);
+extern xdr_uio *xdr_uio_file_create(int fd, off_t offset, u_int length);
+extern struct xdr_ioq *xdr_ioq_create_refer(xdr_uio *uio);
 extern void xdr_ioq_release(struct poolq_head *ioqh);
 extern void xdr_ioq_reset(struct xdr_ioq *xioq, u_int wh_pos);
 extern void xdr_ioq_setup(struct xdr_ioq *xioq);
@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file alloc_profile.c
+ * @brief Call site allocation profiler
+ *
+ * @section DESCRIPTION
+ *
+ * tirpc_control(TIRPC_ALLOC_PROFILE_START, NULL) wraps the memory hooks
+ * in __ntirpc_pkg_params (the defaults, or the application's own) with
+ * counting versions.  Each allocation is prefixed by a small header
+ * naming its call site, so frees are charged back to the allocating
+ * site.  It must be started before the library allocates anything, as
+ * memory without a header cannot be freed through the wrappers; it is
+ * refused once svc_init() has run.  The hooks are swapped without
+ * atomics, so no other thread may be using the library meanwhile.
+ *
+ * Sites are counted in per-thread tables, without locks, except that
+ * frees (possibly by another thread) are atomic.
+ * tirpc_control(TIRPC_DUMP_ALLOC_PROFILE, out) merges and prints them.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rpc/types.h>
+#include <misc/abstract_atomic.h>
+#include <misc/portable.h>
+#include <intrinsic.h>
+#include <reentrant.h>
+#include <rpc/rpc.h>
+#include <rpc/svc.h>
+
+#include "rpc_com.h"
+#include "svc_internal.h"
+
+#define ALLOC_SITES		512	/* per thread, power of 2 */
+#define ALLOC_HIST		16	/* log2 size buckets from 16 bytes */
+
+struct alloc_site {
+	const char *file;	/* NULL: empty */
+	const char *func;
+	int line;
+	uint64_t allocs;
+	uint64_t bytes;
+	uint64_t frees;		/* atomic */
+	uint64_t freed;		/* atomic */
+	uint64_t hist[ALLOC_HIST];
+};
+
+struct alloc_table {
+	struct alloc_table *next;	/* all tables */
+	bool owned;
+	struct alloc_site overflow;	/* table full */
+	struct alloc_site site[ALLOC_SITES];
+};
+
+/* precedes each allocation, keeps 16 byte alignment */
+struct alloc_hdr {
+	struct alloc_site *site;
+	size_t size;
+	size_t offset;		/* from the underlying allocation */
+} __attribute__ ((aligned(16)));
+
+static struct {
+	pthread_mutex_t mtx;
+	pthread_once_t once;
+	pthread_key_t key;
+	struct alloc_table *tables;
+	tirpc_pkg_params real;	/* wrapped hooks */
+	bool started;
+} alloc_profile = {
+	MUTEX_INITIALIZER,
+	PTHREAD_ONCE_INIT,
+};
+
+static __thread struct alloc_table *alloc_table_mine;
+
+static void
+alloc_table_exit(void *arg)
+{
+	struct alloc_table *table = arg;
+
+	mutex_lock(&alloc_profile.mtx);
+	table->owned = false;
+	mutex_unlock(&alloc_profile.mtx);
+}
+
+static void
+alloc_table_key(void)
+{
+	(void)pthread_key_create(&alloc_profile.key, alloc_table_exit);
+}
+
+static struct alloc_table *
+alloc_table_get(void)
+{
+	struct alloc_table *table;
+
+	(void)pthread_once(&alloc_profile.once, alloc_table_key);
+
+	mutex_lock(&alloc_profile.mtx);
+	for (table = alloc_profile.tables; table; table = table->next) {
+		if (!table->owned)
+			break;
+	}
+	if (!table) {
+		/* from the real allocator, never freed */
+		table = alloc_profile.real.calloc_(1, sizeof(*table),
+						   __FILE__, __LINE__,
+						   __func__);
+		table->overflow.file = "(overflow)";
+		table->overflow.func = "";
+		table->next = alloc_profile.tables;
+		alloc_profile.tables = table;
+	}
+	table->owned = true;
+	mutex_unlock(&alloc_profile.mtx);
+
+	(void)pthread_setspecific(alloc_profile.key, table);
+	return (table);
+}
+
+static inline struct alloc_site *
+alloc_site_find(const char *file, int line, const char *func)
+{
+	struct alloc_table *table = alloc_table_mine;
+	uint32_t hash;
+	u_int ix;
+
+	if (unlikely(!table))
+		table = alloc_table_mine = alloc_table_get();
+
+	hash = ((uintptr_t)file >> 3) * 31 + line;
+	for (ix = 0; ix < ALLOC_SITES; ix++) {
+		struct alloc_site *site =
+			&table->site[(hash + ix) & (ALLOC_SITES - 1)];
+
+		if (site->file == file && site->line == line)
+			return (site);
+		if (!site->file) {
+			site->func = func;
+			site->line = line;
+			site->file = file;
+			return (site);
+		}
+	}
+	return (&table->overflow);
+}
+
+static inline void *
+alloc_charge(void *base, size_t offset, size_t size, const char *file,
+	     int line, const char *func)
+{
+	struct alloc_site *site = alloc_site_find(file, line, func);
+	struct alloc_hdr *hdr = (struct alloc_hdr *)((char *)base + offset);
+	u_int bucket = 0;
+
+	while (bucket < ALLOC_HIST - 1 && (16UL << bucket) < size)
+		bucket++;
+
+	site->allocs++;
+	site->bytes += size;
+	site->hist[bucket]++;
+
+	hdr--;
+	hdr->site = site;
+	hdr->size = size;
+	hdr->offset = offset;
+	return (hdr + 1);
+}
+
+static inline void *
+alloc_uncharge(void *p)
+{
+	struct alloc_hdr *hdr = (struct alloc_hdr *)p - 1;
+
+	atomic_inc_uint64_t(&hdr->site->frees);
+	atomic_add_uint64_t(&hdr->site->freed, hdr->size);
+	return ((char *)(hdr + 1) - hdr->offset);
+}
+
+static void
+alloc_profile_free(void *p, size_t size)
+{
+	struct alloc_hdr *hdr = (struct alloc_hdr *)p - 1;
+	size_t total;
+
+	if (!p)
+		return;
+	total = hdr->size + hdr->offset;
+	alloc_profile.real.free_size_(alloc_uncharge(p), total);
+}
+
+static void *
+alloc_profile_malloc(size_t size, const char *file, int line,
+		     const char *func)
+{
+	void *base = alloc_profile.real.malloc_(size
+						+ sizeof(struct alloc_hdr),
+						file, line, func);
+
+	return (alloc_charge(base, sizeof(struct alloc_hdr), size, file,
+			     line, func));
+}
+
+static void *
+alloc_profile_aligned(size_t alignment, size_t size, const char *file,
+		      int line, const char *func)
+{
+	size_t offset = MAX(alignment, sizeof(struct alloc_hdr));
+	void *base = alloc_profile.real.aligned_(alignment, size + offset,
+						 file, line, func);
+
+	return (alloc_charge(base, offset, size, file, line, func));
+}
+
+static void *
+alloc_profile_calloc(size_t count, size_t size, const char *file, int line,
+		     const char *func)
+{
+	void *base = alloc_profile.real.calloc_(1, count * size
+						+ sizeof(struct alloc_hdr),
+						file, line, func);
+
+	return (alloc_charge(base, sizeof(struct alloc_hdr), count * size,
+			     file, line, func));
+}
+
+static void *
+alloc_profile_realloc(void *p, size_t size, const char *file, int line,
+		      const char *func)
+{
+	struct alloc_hdr *hdr = (struct alloc_hdr *)p - 1;
+	void *base;
+
+	if (!p)
+		return (alloc_profile_malloc(size, file, line, func));
+
+	if (hdr->offset != sizeof(struct alloc_hdr)) {
+		/* aligned, cannot be moved by the real realloc */
+		void *r = alloc_profile_malloc(size, file, line, func);
+
+		memcpy(r, p, MIN(size, hdr->size));
+		alloc_profile_free(p, hdr->size);
+		return (r);
+	}
+
+	base = alloc_profile.real.realloc_(alloc_uncharge(p),
+					   size + sizeof(struct alloc_hdr),
+					   file, line, func);
+	return (alloc_charge(base, sizeof(struct alloc_hdr), size, file,
+			     line, func));
+}
+
+/*
+ * Wrap the current hooks.  Returns false if already started, or too late:
+ * svc_init() has started the work pool, whose threads allocate.
+ *
+ * svc_init() is held off by __svc_params->mtx while the hooks change.
+ */
+bool
+tirpc_alloc_profile_start(void)
+{
+	mutex_lock(&__svc_params->mtx);
+	if (__svc_params->initialized || svc_work_pool.name) {
+		mutex_unlock(&__svc_params->mtx);
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: svc_init() has run, not started", __func__);
+		return (false);
+	}
+
+	mutex_lock(&alloc_profile.mtx);
+	if (alloc_profile.started) {
+		mutex_unlock(&alloc_profile.mtx);
+		mutex_unlock(&__svc_params->mtx);
+		return (false);
+	}
+	alloc_profile.real = __ntirpc_pkg_params;
+	alloc_profile.started = true;
+	mutex_unlock(&alloc_profile.mtx);
+
+	__ntirpc_pkg_params.free_size_ = alloc_profile_free;
+	__ntirpc_pkg_params.malloc_ = alloc_profile_malloc;
+	__ntirpc_pkg_params.aligned_ = alloc_profile_aligned;
+	__ntirpc_pkg_params.calloc_ = alloc_profile_calloc;
+	__ntirpc_pkg_params.realloc_ = alloc_profile_realloc;
+	mutex_unlock(&__svc_params->mtx);
+	return (true);
+}
+
+static int
+alloc_site_cmpf(const void *lhs, const void *rhs)
+{
+	const struct alloc_site *lk = lhs;
+	const struct alloc_site *rk = rhs;
+	int rc = strcmp(lk->file, rk->file);
+
+	if (rc)
+		return (rc);
+	return (lk->line - rk->line);
+}
+
+static int
+alloc_site_bytes_cmpf(const void *lhs, const void *rhs)
+{
+	const struct alloc_site *lk = lhs;
+	const struct alloc_site *rk = rhs;
+
+	if (lk->bytes > rk->bytes)
+		return (-1);
+	return (lk->bytes < rk->bytes);
+}
+
+/*
+ * Merge the per-thread tables by call site, and print them by bytes
+ * allocated: allocations, bytes, live bytes, then the size histogram
+ * (counts of <=16, <=32, ... bytes).
+ */
+void
+tirpc_alloc_profile_dump(mem_format_t out)
+{
+	struct alloc_table *table;
+	struct alloc_site *sites;
+	size_t count = 0;
+	size_t n = 0;
+	size_t ix, jx;
+	u_int hx;
+	char hist[ALLOC_HIST * 12];
+
+	if (!out)
+		out = __ntirpc_pkg_params.warnx_;
+
+	if (!alloc_profile.started) {
+		out("%s: not started", __func__);
+		return;
+	}
+
+	mutex_lock(&alloc_profile.mtx);
+	for (table = alloc_profile.tables; table; table = table->next)
+		count += ALLOC_SITES + 1;
+
+	sites = alloc_profile.real.malloc_(count * sizeof(*sites) + 1,
+					   __FILE__, __LINE__, __func__);
+	for (table = alloc_profile.tables; table; table = table->next) {
+		for (ix = 0; ix < ALLOC_SITES; ix++) {
+			if (table->site[ix].file)
+				sites[n++] = table->site[ix];
+		}
+		if (table->overflow.allocs)
+			sites[n++] = table->overflow;
+	}
+	mutex_unlock(&alloc_profile.mtx);
+
+	/* merge the same site from different threads */
+	qsort(sites, n, sizeof(*sites), alloc_site_cmpf);
+	for (ix = 0, jx = 0; ix < n; ix++) {
+		if (jx && !alloc_site_cmpf(&sites[jx - 1], &sites[ix])) {
+			struct alloc_site *site = &sites[jx - 1];
+
+			site->allocs += sites[ix].allocs;
+			site->bytes += sites[ix].bytes;
+			site->frees += sites[ix].frees;
+			site->freed += sites[ix].freed;
+			for (hx = 0; hx < ALLOC_HIST; hx++)
+				site->hist[hx] += sites[ix].hist[hx];
+			continue;
+		}
+		sites[jx++] = sites[ix];
+	}
+	n = jx;
+
+	qsort(sites, n, sizeof(*sites), alloc_site_bytes_cmpf);
+	for (ix = 0; ix < n; ix++) {
+		struct alloc_site *site = &sites[ix];
+		size_t used = 0;
+
+		hist[0] = '\0';
+		for (hx = 0; hx < ALLOC_HIST; hx++)
+			used += snprintf(hist + used, sizeof(hist) - used,
+					 " %" PRIu64, site->hist[hx]);
+
+		out("%s:%d %s allocs %" PRIu64 " bytes %" PRIu64
+		    " live %" PRId64 " (%" PRId64 ") hist%s",
+		    site->file, site->line, site->func,
+		    site->allocs, site->bytes,
+		    (int64_t)(site->bytes - site->freed),
+		    (int64_t)(site->allocs - site->frees), hist);
+	}
+	alloc_profile.real.free_size_(sites, count * sizeof(*sites) + 1);
+}
@@ -1009,6 +1009,9 @@ xdr_rpc_gss_unwrap(XDR *xdrs, xdrproc_t xdr_func, void *xdr_ptr,
 			/* We need to create an xdrmem from the DATA buffer */
 			xdrmem_create(&tmpxdrs, gss_iov[1].buffer.value,
 				      gss_iov[1].buffer.length, XDR_DECODE);
+			if (xdr_arena_get(xdrs))
+				xdr_arena_attach(&tmpxdrs,
+						 xdr_arena_get(xdrs));
 			usexdrs = &tmpxdrs;
 		}
 	}
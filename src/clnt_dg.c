@@ -63,16 +63,26 @@
 static enum xprt_stat clnt_dg_rendezvous(SVCXPRT *xprt);
 static struct clnt_ops *clnt_dg_ops(void);
 
+/* most calls gathered into one sendmmsg() by CLNT_CREATE_FLAG_DG_FAST */
+#define CLNT_DG_SEND_BATCH		16
+
 struct cu_data {
 	struct cx_data cu_cx;
 	struct sockaddr_storage cu_raddr;	/* remote address */
 	int cu_rlen;
+
+	/* CLNT_CREATE_FLAG_DG_FAST */
+	struct clnt_rtt cu_rtt;
+	struct poolq_head cu_sendq;	/* encoded, not yet sent */
+	bool cu_sending;		/* a caller is draining cu_sendq */
+	bool cu_connected;
 };
 #define CU_DATA(p) (opr_containerof((p), struct cu_data, cu_cx))
 
 static void
 clnt_dg_data_free(struct cu_data *cu)
 {
+	poolq_head_destroy(&cu->cu_sendq);
 	clnt_data_destroy(&cu->cu_cx);
 	mem_free(cu, sizeof(struct cu_data));
 }
@@ -83,9 +93,31 @@ clnt_dg_data_zalloc(void)
 	struct cu_data *cu = mem_zalloc(sizeof(struct cu_data));
 
 	clnt_data_init(&cu->cu_cx);
+	poolq_head_setup(&cu->cu_sendq);
 	return (cu);
 }
 
+/*
+ * Fix the peer of the (shared) fd, so sends skip the per-datagram route
+ * lookup.  Every client on this fd must talk to the same server.
+ */
+static bool
+clnt_dg_connect(struct cu_data *cu, int fd)
+{
+	if (connect(fd, (struct sockaddr *)&cu->cu_raddr, cu->cu_rlen) < 0) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d connect failed (%d)",
+			__func__, fd, errno);
+		cu->cu_connected = false;
+		cu->cu_cx.cx_rtt = NULL;
+		return (false);
+	}
+	clnt_rtt_init(&cu->cu_rtt);
+	cu->cu_connected = true;
+	cu->cu_cx.cx_rtt = &cu->cu_rtt;
+	return (true);
+}
+
 /*
  * Connection less client creation returns with client handle parameters.
  * Default options are set, which the user can change using clnt_control().
@@ -156,6 +188,13 @@ clnt_dg_ncreatef(const int fd,	/* open file descriptor */
 	(void)memcpy(&cu->cu_raddr, svcaddr->buf, (size_t) svcaddr->len);
 	cu->cu_rlen = svcaddr->len;
 
+	if ((flags & CLNT_CREATE_FLAG_DG_FAST)
+	 && !clnt_dg_connect(cu, fd)) {
+		clnt->cl_error.re_status = RPC_TLIERROR;
+		clnt->cl_error.re_errno = errno;
+		return (clnt);
+	}
+
 	/*
 	 * initialize call message
 	 */
@@ -205,6 +244,109 @@ clnt_dg_rendezvous(SVCXPRT *xprt)
 	return SVC_RECV(xprt);
 }
 
+/*
+ * Send a batch of encoded calls on the connected fd.  A datagram that
+ * cannot be sent is skipped, to be recovered by retransmission.
+ * Returns the errno for mine, or 0 when it was sent.
+ */
+static int
+clnt_dg_sendmmsg(int fd, struct xdr_ioq **batch, int n, struct xdr_ioq *mine)
+{
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgs[CLNT_DG_SEND_BATCH];
+#endif
+	struct iovec iov[CLNT_DG_SEND_BATCH];
+	int result = 0;
+	int sent = 0;
+	int rc;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		XDR *xdrs = batch[i]->xdrs;
+
+		iov[i].iov_base = xdrs->x_v.vio_head;
+		iov[i].iov_len = XDR_GETPOS(xdrs);
+#ifdef HAVE_SENDMMSG
+		memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+#endif
+	}
+
+	while (sent < n) {
+#ifdef HAVE_SENDMMSG
+		rc = sendmmsg(fd, &msgs[sent], n - sent, 0);
+#else
+		rc = (send(fd, iov[sent].iov_base, iov[sent].iov_len, 0) < 0)
+			? -1 : 1;
+#endif
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: fd %d send failed (%d)",
+				__func__, fd, errno);
+			if (batch[sent] == mine)
+				result = errno;
+			sent++;
+			continue;
+		}
+		sent += rc;
+	}
+	return (result);
+}
+
+/*
+ * Queue the call; the first caller to find nobody draining the queue
+ * sends everything queued behind it, up to CLNT_DG_SEND_BATCH per
+ * system call.  Others return at once, and lost sends are recovered by
+ * retransmission.
+ */
+static enum clnt_stat
+clnt_dg_send_batch(struct cu_data *cu, struct xdr_ioq *xioq)
+{
+	struct xdr_ioq *batch[CLNT_DG_SEND_BATCH];
+	struct poolq_entry *have;
+	int fd = cu->cu_cx.cx_rec->xprt.xp_fd;
+	enum clnt_stat stat = RPC_SUCCESS;
+	int code;
+	int n;
+	int i;
+
+	mutex_lock(&cu->cu_sendq.qmutex);
+	TAILQ_INSERT_TAIL(&cu->cu_sendq.qh, &xioq->ioq_s, q);
+	(cu->cu_sendq.qcount)++;
+	if (cu->cu_sending) {
+		mutex_unlock(&cu->cu_sendq.qmutex);
+		return (RPC_SUCCESS);
+	}
+	cu->cu_sending = true;
+
+	while (cu->cu_sendq.qcount > 0) {
+		for (n = 0; n < CLNT_DG_SEND_BATCH
+			    && (have = TAILQ_FIRST(&cu->cu_sendq.qh)); n++) {
+			TAILQ_REMOVE(&cu->cu_sendq.qh, have, q);
+			(cu->cu_sendq.qcount)--;
+			batch[n] = _IOQ(have);
+		}
+		mutex_unlock(&cu->cu_sendq.qmutex);
+
+		code = clnt_dg_sendmmsg(fd, batch, n, xioq);
+		if (code) {
+			cu->cu_cx.cx_c.cl_error.re_errno = code;
+			stat = RPC_CANTSEND;
+		}
+		for (i = 0; i < n; i++)
+			XDR_DESTROY(batch[i]->xdrs);
+
+		mutex_lock(&cu->cu_sendq.qmutex);
+	}
+	cu->cu_sending = false;
+	mutex_unlock(&cu->cu_sendq.qmutex);
+
+	return (stat);
+}
+
 static enum clnt_stat
 clnt_dg_call(struct clnt_req *cc)
 {
@@ -215,8 +357,13 @@ clnt_dg_call(struct clnt_req *cc)
 	SVCXPRT *xprt = &rec->xprt;
 	struct xdr_ioq *xioq;
 	XDR *xdrs;
-	u_int32_t *uint32p;
 	size_t outlen;
+	size_t max_bsize = __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT;
+	size_t bsize = RPC_MAXDATA_DEFAULT;
+
+	/* The datagram is sent from the first segment; only grow it */
+	if (__svc_params->flags & SVC_FLAG_XDR_SIZEOF)
+		bsize = MAX(bsize, xdr_ioq_size_class(clnt_req_sizeof(cc)));
 
 	/* XXX Until gss_get_mic and gss_wrap can be replaced with
 	 * iov equivalents, replies with RPCSEC_GSS security must be
@@ -225,8 +372,7 @@ clnt_dg_call(struct clnt_req *cc)
 	 * Nb, we should probably use getpagesize() on Unix.  Need
 	 * an equivalent for Windows.
 	 */
-	xioq = xdr_ioq_create(RPC_MAXDATA_DEFAULT,
-			      __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT,
+	xioq = xdr_ioq_create(MIN(bsize, max_bsize), max_bsize,
 			      (cc->cc_auth->ah_cred.oa_flavor == RPCSEC_GSS)
 			      ? UIO_FLAG_REALLOC | UIO_FLAG_FREE
 			      : UIO_FLAG_FREE);
@@ -234,17 +380,8 @@ clnt_dg_call(struct clnt_req *cc)
 	xdrs = xioq->xdrs;
 	cc->cc_error.re_status = RPC_SUCCESS;
 
-	mutex_lock(&clnt->cl_lock);
-	uint32p = (u_int32_t *)&cx->cx_mcallc[0];
-	*uint32p = htonl(cc->cc_xid);
-
-	if ((!XDR_PUTBYTES(xdrs, cx->cx_mcallc, cx->cx_mpos))
-	    || (!XDR_PUTUINT32(xdrs, cc->cc_proc))
-	    || (!AUTH_MARSHALL(cc->cc_auth, xdrs))
-	    || (!AUTH_WRAP(cc->cc_auth, xdrs,
-			   cc->cc_call.proc, cc->cc_call.where))) {
+	if (!clnt_req_encode(cc, xdrs)) {
 		/* error case */
-		mutex_unlock(&clnt->cl_lock);
 		__warnx(TIRPC_DEBUG_FLAG_CLNT_DG,
 			"%s: fd %d failed",
 			__func__, xprt->xp_fd);
@@ -252,7 +389,9 @@ clnt_dg_call(struct clnt_req *cc)
 		return (RPC_CANTENCODEARGS);
 	}
 	outlen = (size_t) XDR_GETPOS(xdrs);
-	mutex_unlock(&clnt->cl_lock);
+
+	if (cu->cu_connected)
+		return (clnt_dg_send_batch(cu, xioq));
 
 	if (sendto(xprt->xp_fd, xdrs->x_v.vio_head, outlen, 0,
 		   (struct sockaddr *)&cu->cu_raddr, cu->cu_rlen) != outlen) {
@@ -339,6 +478,8 @@ clnt_dg_control(CLIENT *clnt, u_int request, void *info)
 		}
 		(void)memcpy(&cu->cu_raddr, addr->buf, addr->len);
 		cu->cu_rlen = addr->len;
+		if (cu->cu_connected)
+			rslt = clnt_dg_connect(cu, rec->xprt.xp_fd);
 		break;
 
 	case CLGET_XID:
@@ -492,6 +492,65 @@ clnt_req_refresh(struct clnt_req *cc)
 	return (RPC_SUCCESS);
 }
 
+/*
+ * Encode the call header, credentials and arguments.
+ *
+ * The prebuilt header is copied under cl_lock (CLSET_PROG and CLSET_VERS
+ * rewrite it), and the rest is encoded unlocked.  RPCSEC_GSS keeps the
+ * lock through AUTH_WRAP, as the sequence number it puts in the
+ * credential must also be the one used to wrap the arguments.
+ */
+bool
+clnt_req_encode(struct clnt_req *cc, XDR *xdrs)
+{
+	CLIENT *clnt = cc->cc_clnt;
+	struct cx_data *cx = CX_DATA(clnt);
+	char mcallc[MCALL_MSG_SIZE];
+	u_int32_t *uint32p;
+	u_int mpos;
+	bool serial = (cc->cc_auth->ah_cred.oa_flavor == RPCSEC_GSS);
+	bool rslt;
+
+	mutex_lock(&clnt->cl_lock);
+	/* CLGET_XID reports the latest call */
+	uint32p = (u_int32_t *)&cx->cx_mcallc[0];
+	*uint32p = htonl(cc->cc_xid);
+	mpos = cx->cx_mpos;
+	memcpy(mcallc, cx->cx_mcallc, mpos);
+	if (!serial)
+		mutex_unlock(&clnt->cl_lock);
+
+	rslt = XDR_PUTBYTES(xdrs, mcallc, mpos)
+	    && XDR_PUTUINT32(xdrs, cc->cc_proc)
+	    && AUTH_MARSHALL(cc->cc_auth, xdrs)
+	    && AUTH_WRAP(cc->cc_auth, xdrs,
+			 cc->cc_call.proc, cc->cc_call.where);
+
+	if (serial)
+		mutex_unlock(&clnt->cl_lock);
+	return (rslt);
+}
+
+/*
+ * Expected length of the encoded call, for sizing the send buffer.
+ *
+ * Only the arguments are counted; the credential and verifier are taken
+ * at their maximum, and RPCSEC_GSS may add a sequence number and a
+ * checksum (or wrap token) of similar size around the arguments.
+ */
+size_t
+clnt_req_sizeof(struct clnt_req *cc)
+{
+	struct cx_data *cx = CX_DATA(cc->cc_clnt);
+	size_t size = cx->cx_mpos + BYTES_PER_XDR_UNIT
+		    + 2 * (2 * BYTES_PER_XDR_UNIT + MAX_AUTH_BYTES)
+		    + xdr_sizeof(cc->cc_call.proc, cc->cc_call.where);
+
+	if (cc->cc_auth->ah_cred.oa_flavor == RPCSEC_GSS)
+		size += 2 * BYTES_PER_XDR_UNIT + MAX_AUTH_BYTES;
+	return (size);
+}
+
 void
 clnt_req_reset(struct clnt_req *cc)
 {
@@ -604,12 +663,18 @@ clnt_req_process_reply(SVCXPRT *xprt, struct svc_req *req)
 		if (!AUTH_VALIDATE(cc->cc_auth, &(cc->cc_verf))) {
 			cc->cc_error.re_status = RPC_AUTHERROR;
 			cc->cc_error.re_why = AUTH_INVALIDRESP;
-		} else if (cc->cc_reply.proc
-			   && !AUTH_UNWRAP(cc->cc_auth, xdrs,
-					   cc->cc_reply.proc,
-					   cc->cc_reply.where)) {
-			if (cc->cc_error.re_status == RPC_SUCCESS)
+		} else if (cc->cc_reply.proc) {
+			/* never the rq_arena of svc_request() */
+			if (cc->cc_arena)
+				xdr_arena_attach(xdrs, cc->cc_arena);
+			else
+				xdr_arena_detach(xdrs);
+			if (!AUTH_UNWRAP(cc->cc_auth, xdrs,
+					 cc->cc_reply.proc,
+					 cc->cc_reply.where)
+			    && cc->cc_error.re_status == RPC_SUCCESS)
 				cc->cc_error.re_status = RPC_CANTDECODERES;
+			xdr_arena_detach(xdrs);
 		}
 		cc->cc_refreshes = 0;
 	}
@@ -623,6 +688,90 @@ clnt_req_process_reply(SVCXPRT *xprt, struct svc_req *req)
 	return SVC_STAT(xprt);
 }
 
+/*
+ * Retransmit on the estimated timeout, backing off, until the caller
+ * timeout has elapsed.  Only calls answered without a retransmission
+ * update the estimate (Karn).
+ */
+static enum clnt_stat
+clnt_req_wait_rto(struct clnt_req *cc, struct clnt_rtt *rtt)
+{
+	struct cx_data *cx = CX_DATA(cc->cc_clnt);
+	struct rpc_dplx_rec *rec = cx->cx_rec;
+	struct timespec deadline;
+	struct timespec sent;
+	struct timespec now;
+	struct timespec ts;
+	uint32_t rto = rtt->rto_us;
+	bool retransmitted = false;
+	int code;
+
+	(void)clock_gettime(CLOCK_REALTIME_FAST, &deadline);
+	timespecadd(&deadline, &cc->cc_timeout, &deadline);
+
+ call_again:
+	cc->cc_error.re_status = CLNT_CALL_ONCE(cc);
+	if (cc->cc_error.re_status != RPC_SUCCESS) {
+		return (cc->cc_error.re_status);
+	}
+	(void)clock_gettime(CLOCK_MONOTONIC, &sent);
+
+	(void)clock_gettime(CLOCK_REALTIME_FAST, &ts);
+	now.tv_sec = rto / 1000000;
+	now.tv_nsec = (rto % 1000000) * 1000;
+	timespecadd(&ts, &now, &ts);
+	if (timespeccmp(&ts, &deadline, >))
+		ts = deadline;
+
+	do {
+		code = cond_timedwait(&cc->cc_we.cv, &cc->cc_we.mtx, &ts);
+		if (atomic_fetch_uint16_t(&cc->cc_flags)
+		    & CLNT_REQ_FLAG_ACKSYNC)
+			break;
+	} while (code != ETIMEDOUT);
+
+	if (atomic_fetch_uint16_t(&cc->cc_flags) & CLNT_REQ_FLAG_ACKSYNC) {
+		if (!retransmitted) {
+			(void)clock_gettime(CLOCK_MONOTONIC, &now);
+			timespecsub(&now, &sent, &now);
+			clnt_rtt_update(rtt, now.tv_sec * 1000000
+					     + now.tv_nsec / 1000);
+		}
+		if (cc->cc_error.re_status == RPC_AUTHERROR
+		 && cc->cc_refreshes-- > 0) {
+			if (!AUTH_REFRESH(cc->cc_auth, NULL)) {
+				return (RPC_AUTHERROR);
+			}
+			if (clnt_req_refresh(cc) != RPC_SUCCESS) {
+				return (cc->cc_error.re_status);
+			}
+			atomic_clear_uint16_t_bits(&cc->cc_flags,
+						   CLNT_REQ_FLAG_ACKSYNC);
+			retransmitted = false;
+			goto call_again;
+		}
+		__warnx(TIRPC_DEBUG_FLAG_CLNT_DG,
+			"%s: %p fd %d result=%d rto %" PRIu32 "us",
+			__func__, &rec->xprt, rec->xprt.xp_fd,
+			cc->cc_error.re_status, rtt->rto_us);
+		return (cc->cc_error.re_status);
+	}
+
+	(void)clock_gettime(CLOCK_REALTIME_FAST, &now);
+	if ((rec->xprt.xp_flags & SVC_XPRT_FLAG_DESTROYED)
+	 || !timespeccmp(&now, &deadline, <)) {
+		__warnx(TIRPC_DEBUG_FLAG_CLNT_DG,
+			"%s: %p fd %d ETIMEDOUT",
+			__func__, &rec->xprt, rec->xprt.xp_fd);
+		cc->cc_error.re_status = RPC_TIMEDOUT;
+		return (RPC_TIMEDOUT);
+	}
+
+	rto = clnt_rtt_backoff(rtt, rto);
+	retransmitted = true;
+	goto call_again;
+}
+
 enum clnt_stat
 clnt_req_wait_reply(struct clnt_req *cc)
 {
@@ -636,6 +785,9 @@ clnt_req_wait_reply(struct clnt_req *cc)
 		__func__, &rec->xprt, rec->xprt.xp_fd, cc->cc_xid,
 		cc->cc_timeout.tv_sec, cc->cc_timeout.tv_nsec);
 
+	if (cx->cx_rtt && timespecisset(&cc->cc_timeout))
+		return (clnt_req_wait_rto(cc, cx->cx_rtt));
+
  call_again:
 	cc->cc_error.re_status = CLNT_CALL_ONCE(cc);
 	if (cc->cc_error.re_status != RPC_SUCCESS) {
@@ -32,9 +32,26 @@
 
 #define MCALL_MSG_SIZE 24
 
+/*
+ * Retransmit timer state (Jacobson/Karels), in microseconds.
+ *
+ * Updated without a lock:  samples from concurrent calls may race, and
+ * the result is only a hint for the next timer.
+ */
+#define CLNT_RTO_INIT_US	1000000		/* before the first sample */
+#define CLNT_RTO_MIN_US		20000
+#define CLNT_RTO_MAX_US		60000000
+
+struct clnt_rtt {
+	uint32_t srtt_us;		/* smoothed round trip */
+	uint32_t rttvar_us;		/* mean deviation */
+	uint32_t rto_us;		/* current retransmit timeout */
+};
+
 struct cx_data {
 	struct rpc_client cx_c;		/**< Transport Independent handle */
 	struct rpc_dplx_rec *cx_rec;	/* unified sync */
+	struct clnt_rtt *cx_rtt;	/* NULL: fixed caller timeout */
 
 	char cx_mcallc[MCALL_MSG_SIZE];	/* marshalled callmsg */
 	u_int cx_mpos;		/* pos after marshal */
@@ -61,6 +78,61 @@ clnt_data_destroy(struct cx_data *cx)
 		mem_free(cx->cx_c.cl_tp, strlen(cx->cx_c.cl_tp) + 1);
 }
 
+static inline void
+clnt_rtt_init(struct clnt_rtt *rtt)
+{
+	rtt->srtt_us = 0;
+	rtt->rttvar_us = 0;
+	rtt->rto_us = CLNT_RTO_INIT_US;
+}
+
+static inline uint32_t
+clnt_rtt_clamp(uint64_t rto)
+{
+	if (rto < CLNT_RTO_MIN_US)
+		return (CLNT_RTO_MIN_US);
+	if (rto > CLNT_RTO_MAX_US)
+		return (CLNT_RTO_MAX_US);
+	return (rto);
+}
+
+/* RFC 6298 section 2, with alpha 1/8 and beta 1/4 */
+static inline void
+clnt_rtt_update(struct clnt_rtt *rtt, uint32_t m)
+{
+	int32_t srtt = rtt->srtt_us;
+	int32_t rttvar = rtt->rttvar_us;
+	int32_t delta;
+
+	if (!srtt) {
+		srtt = m;
+		rttvar = m / 2;
+	} else {
+		delta = (int32_t)m - srtt;
+		srtt += delta / 8;
+		if (delta < 0)
+			delta = -delta;
+		rttvar += (delta - rttvar) / 4;
+	}
+	rtt->srtt_us = srtt;
+	rtt->rttvar_us = rttvar;
+	rtt->rto_us = clnt_rtt_clamp((uint64_t)srtt + 4 * (uint64_t)rttvar);
+}
+
+/* exponential backoff; kept until the next valid sample */
+static inline uint32_t
+clnt_rtt_backoff(struct clnt_rtt *rtt, uint32_t rto)
+{
+	rto = clnt_rtt_clamp((uint64_t)rto * 2);
+	if (rtt->rto_us < rto)
+		rtt->rto_us = rto;
+	return (rto);
+}
+
+/* in clnt_generic.c */
+bool clnt_req_encode(struct clnt_req *, XDR *);
+size_t clnt_req_sizeof(struct clnt_req *);
+
 /* in svc_rqst.c */
 void svc_rqst_expire_insert(struct clnt_req *);
 void svc_rqst_expire_remove(struct clnt_req *);
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file clnt_loop.c
+ * @brief In-process loopback client
+ *
+ * @section DESCRIPTION
+ *
+ * Makes calls on the client end of a svc_loop_ncreate() pair
+ * (svc_loop.c).  Calls are queued and written as clnt_vc does, and the
+ * replies are matched to calls the same way; only the socket is
+ * missing.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <rpc/types.h>
+#include <misc/portable.h>
+#include <reentrant.h>
+#include <rpc/rpc.h>
+#include "rpc_com.h"
+#include <rpc/xdr_ioq.h>
+#include "clnt_internal.h"
+#include "svc_internal.h"
+#include "svc_ioq.h"
+#include "svc_loop.h"
+
+static enum xprt_stat clnt_loop_process(struct svc_req *req);
+static struct clnt_ops *clnt_loop_ops(void);
+
+static void
+clnt_loop_data_free(struct cx_data *cx)
+{
+	clnt_data_destroy(cx);
+	mem_free(cx, sizeof(struct cx_data));
+}
+
+static struct cx_data *
+clnt_loop_data_zalloc(void)
+{
+	struct cx_data *cx = mem_zalloc(sizeof(struct cx_data));
+
+	clnt_data_init(cx);
+	return (cx);
+}
+
+/*
+ * Create a client handle on the other end of a loopback pair.
+ *
+ * Only one client may be made on each pair.  The client holds its own
+ * reference; destroying it closes the pair.
+ */
+CLIENT *
+clnt_loop_ncreate(SVCXPRT *svc,		/* server end */
+		  const rpcprog_t prog,	/* program number */
+		  const rpcvers_t vers)	/* version number */
+{
+	struct cx_data *cx = clnt_loop_data_zalloc();
+	CLIENT *clnt = &cx->cx_c;
+	SVCXPRT *xprt;
+	struct rpc_msg call_msg;
+	XDR cx_xdrs[1];		/* temp XDR stream */
+
+	clnt->cl_ops = clnt_loop_ops();
+
+	/* ref+1 */
+	xprt = svc_loop_claim(svc);
+	if (!xprt) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p not an open loopback pair, or already claimed",
+			__func__, svc);
+		clnt->cl_error.re_status = RPC_TLIERROR;
+		return (clnt);
+	}
+	xprt->xp_dispatch.process_cb = clnt_loop_process;
+	cx->cx_rec = REC_XPRT(xprt);
+
+	/* no events, but CLNT_CALL_BACK() expires calls on the channel */
+	if (svc_rqst_xprt_register(xprt, NULL)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p no event channel",
+			__func__, svc);
+		clnt->cl_error.re_status = RPC_SYSTEMERROR;
+		return (clnt);
+	}
+
+	/*
+	 * initialize call message
+	 */
+	call_msg.rm_xid = cx->cx_rec->call_xid;
+	call_msg.rm_direction = CALL;
+	call_msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
+	call_msg.cb_prog = prog;
+	call_msg.cb_vers = vers;
+
+	/*
+	 * pre-serialize the static part of the call msg and stash it away
+	 */
+	xdrmem_create(cx_xdrs, cx->cx_mcallc, MCALL_MSG_SIZE, XDR_ENCODE);
+	if (!xdr_callhdr(cx_xdrs, &call_msg)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: xdr_callhdr failed",
+			__func__);
+		clnt->cl_error.re_status = RPC_CANTENCODEARGS;
+		XDR_DESTROY(cx_xdrs);
+		return (clnt);
+	}
+	cx->cx_mpos = XDR_GETPOS(cx_xdrs);
+	XDR_DESTROY(cx_xdrs);
+
+	__warnx(TIRPC_DEBUG_FLAG_CLNT_VC,
+		"%s: %p completed (xprt %p)",
+		__func__, svc, xprt);
+	return (clnt);
+}
+
+static enum xprt_stat
+clnt_loop_process(struct svc_req *req)
+{
+	SVCXPRT *xprt = req->rq_xprt;
+
+	__warnx(TIRPC_DEBUG_FLAG_WARN,
+		"%s: %p unexpected CALL",
+		__func__, xprt);
+	return SVC_STAT(xprt);
+}
+
+static enum clnt_stat
+clnt_loop_call(struct clnt_req *cc)
+{
+	CLIENT *clnt = cc->cc_clnt;
+	struct cx_data *cx = CX_DATA(clnt);
+	SVCXPRT *xprt = &cx->cx_rec->xprt;
+	struct xdr_ioq *xioq;
+	XDR *xdrs;
+	size_t max_bsize = __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT;
+	size_t bsize = RPC_MAXDATA_DEFAULT;
+
+	/* sized as clnt_vc_call() */
+	if (__svc_params->flags & SVC_FLAG_XDR_SIZEOF)
+		bsize = xdr_ioq_size_class(clnt_req_sizeof(cc));
+
+	xioq = xdr_ioq_create(MIN(bsize, max_bsize), max_bsize,
+			      (cc->cc_auth->ah_cred.oa_flavor == RPCSEC_GSS)
+			      ? UIO_FLAG_REALLOC | UIO_FLAG_FREE
+			      : UIO_FLAG_FREE);
+
+	xdrs = xioq->xdrs;
+	cc->cc_error.re_status = RPC_SUCCESS;
+
+	if (!clnt_req_encode(cc, xdrs)) {
+		/* error case */
+		__warnx(TIRPC_DEBUG_FLAG_CLNT_VC,
+			"%s: %p failed",
+			__func__, xprt);
+		XDR_DESTROY(xdrs);
+		return (RPC_CANTENCODEARGS);
+	}
+
+	xdrs->x_lib[1] = (void *)xprt;
+	svc_ioq_write_submit(xprt, xioq);
+
+	return (RPC_SUCCESS);
+}
+
+static bool
+clnt_loop_freeres(CLIENT *clnt, xdrproc_t xdr_res, void *res_ptr)
+{
+	return (xdr_free(xdr_res, res_ptr));
+}
+
+ /*ARGSUSED*/
+static void
+clnt_loop_abort(CLIENT *clnt)
+{
+}
+
+static bool
+clnt_loop_control(CLIENT *clnt, u_int request, void *info)
+{
+	struct cx_data *cx = CX_DATA(clnt);
+	struct rpc_dplx_rec *rec = cx->cx_rec;
+	u_int32_t *uint32p;
+	bool rslt = true;
+
+	/* for other requests which use info */
+	if (info == NULL || rec == NULL)
+		return (false);
+
+	/* always take recv lock first if taking together */
+	rpc_dplx_rli(rec);
+	mutex_lock(&clnt->cl_lock);
+
+	switch (request) {
+	case CLGET_XID:
+		/* xid is the first element in the call structure */
+		uint32p = (u_int32_t *)&cx->cx_mcallc[0];
+		*(u_int32_t *)info = ntohl(*uint32p);
+		break;
+
+	case CLSET_XID:
+		/* This will set the xid of the NEXT call */
+		rec->call_xid = htonl(*(u_int32_t *) info - 1);
+		/* decrement by 1 as clnt_req_setup() increments once */
+		break;
+
+	case CLGET_VERS:
+		/* version is the fifth field of the call header */
+		uint32p = (u_int32_t *)&cx->cx_mcallc[4 * BYTES_PER_XDR_UNIT];
+		*(u_int32_t *)info = ntohl(*uint32p);
+		break;
+
+	case CLSET_VERS:
+		uint32p = (u_int32_t *)&cx->cx_mcallc[4 * BYTES_PER_XDR_UNIT];
+		*uint32p = htonl(*(u_int32_t *)info);
+		break;
+
+	case CLGET_PROG:
+		/* program is the fourth field of the call header */
+		uint32p = (u_int32_t *)&cx->cx_mcallc[3 * BYTES_PER_XDR_UNIT];
+		*(u_int32_t *)info = ntohl(*uint32p);
+		break;
+
+	case CLSET_PROG:
+		uint32p = (u_int32_t *)&cx->cx_mcallc[3 * BYTES_PER_XDR_UNIT];
+		*uint32p = htonl(*(u_int32_t *)info);
+		break;
+
+	default:
+		rslt = false;
+		break;
+	}
+
+	rpc_dplx_rui(rec);
+	mutex_unlock(&clnt->cl_lock);
+
+	return (rslt);
+}
+
+static void
+clnt_loop_destroy(CLIENT *clnt)
+{
+	struct cx_data *cx = CX_DATA(clnt);
+
+	if (cx->cx_rec) {
+		/* the transport is never shared */
+		SVC_DESTROY(&cx->cx_rec->xprt);
+		SVC_RELEASE(&cx->cx_rec->xprt, SVC_RELEASE_FLAG_NONE);
+	}
+	clnt_loop_data_free(cx);
+}
+
+static struct clnt_ops *
+clnt_loop_ops(void)
+{
+	static struct clnt_ops ops;
+	extern mutex_t ops_lock;
+	sigset_t mask, newmask;
+
+	/* VARIABLES PROTECTED BY ops_lock: ops */
+
+	sigfillset(&newmask);
+	thr_sigsetmask(SIG_SETMASK, &newmask, &mask);
+	mutex_lock(&ops_lock);
+	if (ops.cl_call == NULL) {
+		ops.cl_call = clnt_loop_call;
+		ops.cl_abort = clnt_loop_abort;
+		ops.cl_freeres = clnt_loop_freeres;
+		ops.cl_destroy = clnt_loop_destroy;
+		ops.cl_control = clnt_loop_control;
+	}
+	mutex_unlock(&ops_lock);
+	thr_sigsetmask(SIG_SETMASK, &(mask), NULL);
+	return (&ops);
+}
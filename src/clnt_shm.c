@@ -0,0 +1,493 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file clnt_shm.c
+ * @brief Shared memory client for same-host servers
+ *
+ * @section DESCRIPTION
+ *
+ * Connects to a svc_shm_ncreatef() socket, receives the region and
+ * eventfds, and then makes calls through the rings (svc_shm.c).  Replies
+ * arrive on a transport registered on the default event channel, and
+ * are matched to calls as clnt_vc does.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <rpc/types.h>
+#include <misc/portable.h>
+#include <reentrant.h>
+#include <rpc/rpc.h>
+#include "rpc_com.h"
+#include <rpc/svc_rqst.h>
+#include <rpc/xdr_ioq.h>
+#include "clnt_internal.h"
+#include "svc_internal.h"
+#include "svc_shm.h"
+
+static enum xprt_stat clnt_shm_process(struct svc_req *req);
+static struct clnt_ops *clnt_shm_ops(void);
+
+struct cs_data {
+	struct cx_data cs_cx;
+	struct sockaddr_storage cs_raddr;	/* remote addr */
+	int cs_rlen;
+};
+#define CS_DATA(p) (opr_containerof((p), struct cs_data, cs_cx))
+
+static void
+clnt_shm_data_free(struct cs_data *cs)
+{
+	clnt_data_destroy(&cs->cs_cx);
+	mem_free(cs, sizeof(struct cs_data));
+}
+
+static struct cs_data *
+clnt_shm_data_zalloc(void)
+{
+	struct cs_data *cs = mem_zalloc(sizeof(struct cs_data));
+
+	clnt_data_init(&cs->cs_cx);
+	return (cs);
+}
+
+/*
+ * Wait for the server's hello (svc_shm_hello).
+ *
+ * Returns 0, or an errno.
+ */
+static int
+clnt_shm_hello(int fd, struct svc_shm_hello *hello, int *fds)
+{
+	union {
+		struct cmsghdr cmsg;
+		char buf[CMSG_SPACE(sizeof(int) * SVC_SHM_NFDS)];
+	} u;
+	struct iovec iov = {
+		.iov_base = hello,
+		.iov_len = sizeof(*hello),
+	};
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t rlen;
+	int ix;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = u.buf;
+	msg.msg_controllen = sizeof(u.buf);
+
+	do {
+		rlen = recvmsg(fd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+	} while (rlen < 0 && errno == EINTR);
+
+	if (rlen < 0)
+		return (errno);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg
+	 || cmsg->cmsg_level != SOL_SOCKET
+	 || cmsg->cmsg_type != SCM_RIGHTS) {
+		/* nothing to close */
+		return (EPROTO);
+	}
+	if (cmsg->cmsg_len != CMSG_LEN(sizeof(int) * SVC_SHM_NFDS)) {
+		int n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+		for (ix = 0; ix < n; ix++)
+			close(((int *)CMSG_DATA(cmsg))[ix]);
+		return (EPROTO);
+	}
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * SVC_SHM_NFDS);
+
+	if (rlen != sizeof(*hello)
+	 || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+	 || hello->sh_magic != SVC_SHM_MAGIC
+	 || hello->sh_version != SVC_SHM_VERSION) {
+		for (ix = 0; ix < SVC_SHM_NFDS; ix++)
+			close(fds[ix]);
+		return (EPROTO);
+	}
+	return (0);
+}
+
+/*
+ * Create a client handle for a svc_shm server.
+ *
+ * fd is a local stream socket, connected here with
+ * CLNT_CREATE_FLAG_CONNECT.  The server sizes the rings.  The socket is
+ * only watched for hangup after this; with CLNT_CREATE_FLAG_CLOSE it is
+ * closed with the client, otherwise the caller may close it at any time.
+ */
+CLIENT *
+clnt_shm_ncreatef(const int fd,	/* open file descriptor */
+		  const struct netbuf *raddr,	/* servers address */
+		  const rpcprog_t prog,	/* program number */
+		  const rpcvers_t vers,	/* version number */
+		  const uint32_t flags)
+{
+	struct cs_data *cs = clnt_shm_data_zalloc();
+	CLIENT *clnt = &cs->cs_cx.cx_c;
+	SVCXPRT *xprt;
+	struct svc_shm_hdr *hdr;
+	struct svc_shm_hello hello;
+	struct rpc_msg call_msg;
+	sigset_t mask, newmask;
+	struct sockaddr_storage ss;
+	XDR cs_xdrs[1];		/* temp XDR stream */
+	socklen_t slen;
+	int fds[SVC_SHM_NFDS];
+	int sock;
+	int code;
+
+	clnt->cl_ops = clnt_shm_ops();
+
+	if (raddr == NULL) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d called with missing servers address",
+			__func__, fd);
+		clnt->cl_error.re_status = RPC_UNKNOWNADDR;
+		return (clnt);
+	}
+	if (sizeof(struct sockaddr_storage) < raddr->len) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d called with invalid address length"
+			" (max %z < %u len)",
+			__func__, fd,
+			sizeof(struct sockaddr_storage),
+			raddr->len);
+		clnt->cl_error.re_status = RPC_UNKNOWNADDR;
+		return (clnt);
+	}
+
+	sigfillset(&newmask);
+	thr_sigsetmask(SIG_SETMASK, &newmask, &mask);
+
+	if (flags & CLNT_CREATE_FLAG_CONNECT) {
+		slen = sizeof(ss);
+		if (getpeername(fd, (struct sockaddr *)&ss, &slen) < 0) {
+			if (errno != ENOTCONN) {
+				clnt->cl_error.re_status = RPC_SYSTEMERROR;
+				clnt->cl_error.re_errno = errno;
+				goto err;
+			}
+			if (connect
+			    (fd, (struct sockaddr *)raddr->buf,
+			     raddr->len) < 0) {
+				clnt->cl_error.re_status = RPC_SYSTEMERROR;
+				clnt->cl_error.re_errno = errno;
+				goto err;
+			}
+		}
+	}
+
+	code = clnt_shm_hello(fd, &hello, fds);
+	if (code) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d hello failed (%d)",
+			__func__, fd, code);
+		clnt->cl_error.re_status = RPC_SYSTEMERROR;
+		clnt->cl_error.re_errno = code;
+		goto err;
+	}
+
+	/* the mapping holds the region */
+	hdr = svc_shm_map(fds[0], hello.sh_length);
+	code = errno;
+	close(fds[0]);
+	if (!hdr) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d region failed (%d)",
+			__func__, fd, code);
+		clnt->cl_error.re_status = RPC_SYSTEMERROR;
+		clnt->cl_error.re_errno = code;
+		goto err_efd;
+	}
+
+	sock = (flags & CLNT_CREATE_FLAG_CLOSE)
+		? fd : fcntl(fd, F_DUPFD_CLOEXEC, 0);
+
+	/* replies arrive on the server to client ring; ref+1 */
+	xprt = svc_shm_attach(fds[2], fds[1], sock, hdr, hello.sh_length,
+			      SVC_SHM_S2C);
+	if (!xprt) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d svc_shm_attach failed",
+			__func__, fd);
+		clnt->cl_error.re_status = RPC_TLIERROR;
+		munmap(hdr, hello.sh_length);
+		if (sock != fd && sock >= 0)
+			close(sock);
+		goto err_efd;
+	}
+
+	__rpc_address_setup(&xprt->xp_local);
+	slen = sizeof(ss);
+	if (!getsockname(fd, (struct sockaddr *)&ss, &slen)) {
+		memcpy(xprt->xp_local.nb.buf, &ss, slen);
+		xprt->xp_local.nb.len = slen;
+	}
+	__rpc_address_setup(&xprt->xp_remote);
+	memcpy(xprt->xp_remote.nb.buf, raddr->buf, raddr->len);
+	xprt->xp_remote.nb.len = raddr->len;
+
+	xprt->xp_dispatch.process_cb = clnt_shm_process;
+	svc_rqst_evchan_reg(__svc_params->ev_u.evchan.id, xprt,
+			    SVC_RQST_FLAG_CHAN_AFFINITY);
+	cs->cs_cx.cx_rec = REC_XPRT(xprt);
+
+	memcpy(&cs->cs_raddr, raddr->buf, raddr->len);
+	cs->cs_rlen = raddr->len;
+
+	/*
+	 * initialize call message
+	 */
+	call_msg.rm_xid = cs->cs_cx.cx_rec->call_xid;
+	call_msg.rm_direction = CALL;
+	call_msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
+	call_msg.cb_prog = prog;
+	call_msg.cb_vers = vers;
+
+	/*
+	 * pre-serialize the static part of the call msg and stash it away
+	 */
+	xdrmem_create(cs_xdrs, cs->cs_cx.cx_mcallc, MCALL_MSG_SIZE,
+		      XDR_ENCODE);
+	if (!xdr_callhdr(cs_xdrs, &call_msg)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d xdr_callhdr failed",
+			__func__, fd);
+		clnt->cl_error.re_status = RPC_CANTENCODEARGS;
+		XDR_DESTROY(cs_xdrs);
+		goto err;
+	}
+	cs->cs_cx.cx_mpos = XDR_GETPOS(cs_xdrs);
+	XDR_DESTROY(cs_xdrs);
+
+	__warnx(TIRPC_DEBUG_FLAG_CLNT_VC,
+		"%s: fd %d completed (xprt fd %d)",
+		__func__, fd, xprt->xp_fd);
+	goto err;
+
+ err_efd:
+	close(fds[1]);
+	close(fds[2]);
+ err:
+	thr_sigsetmask(SIG_SETMASK, &(mask), NULL);
+	return (clnt);
+}
+
+static enum xprt_stat
+clnt_shm_process(struct svc_req *req)
+{
+	SVCXPRT *xprt = req->rq_xprt;
+
+	__warnx(TIRPC_DEBUG_FLAG_WARN,
+		"%s: %p fd %d unexpected CALL",
+		__func__, xprt, xprt->xp_fd);
+	return SVC_STAT(xprt);
+}
+
+static enum clnt_stat
+clnt_shm_call(struct clnt_req *cc)
+{
+	CLIENT *clnt = cc->cc_clnt;
+	struct cx_data *cx = CX_DATA(clnt);
+	SVCXPRT *xprt = &cx->cx_rec->xprt;
+	struct xdr_ioq *xioq;
+	XDR *xdrs;
+	size_t max_bsize = __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT;
+	size_t bsize = RPC_MAXDATA_DEFAULT;
+
+	/* sized as clnt_vc_call() */
+	if (__svc_params->flags & SVC_FLAG_XDR_SIZEOF)
+		bsize = xdr_ioq_size_class(clnt_req_sizeof(cc));
+
+	xioq = xdr_ioq_create(MIN(bsize, max_bsize), max_bsize,
+			      (cc->cc_auth->ah_cred.oa_flavor == RPCSEC_GSS)
+			      ? UIO_FLAG_REALLOC | UIO_FLAG_FREE
+			      : UIO_FLAG_FREE);
+
+	xdrs = xioq->xdrs;
+	cc->cc_error.re_status = RPC_SUCCESS;
+
+	if (!clnt_req_encode(cc, xdrs)) {
+		/* error case */
+		__warnx(TIRPC_DEBUG_FLAG_CLNT_VC,
+			"%s: fd %d failed",
+			__func__, xprt->xp_fd);
+		XDR_DESTROY(xdrs);
+		return (RPC_CANTENCODEARGS);
+	}
+
+	/* copied into the ring, or queued until the server makes room */
+	if (!svc_shm_send(xprt, xioq)) {
+		SVC_DESTROY(xprt);
+		return (RPC_CANTSEND);
+	}
+
+	return (RPC_SUCCESS);
+}
+
+static bool
+clnt_shm_freeres(CLIENT *clnt, xdrproc_t xdr_res, void *res_ptr)
+{
+	return (xdr_free(xdr_res, res_ptr));
+}
+
+ /*ARGSUSED*/
+static void
+clnt_shm_abort(CLIENT *clnt)
+{
+}
+
+static bool
+clnt_shm_control(CLIENT *clnt, u_int request, void *info)
+{
+	struct cx_data *cx = CX_DATA(clnt);
+	struct cs_data *cs = CS_DATA(cx);
+	struct rpc_dplx_rec *rec = cx->cx_rec;
+	struct netbuf *addr;
+	u_int32_t *uint32p;
+	bool rslt = true;
+
+	/* for other requests which use info */
+	if (info == NULL)
+		return (false);
+
+	/* always take recv lock first if taking together */
+	rpc_dplx_rli(rec);
+	mutex_lock(&clnt->cl_lock);
+
+	switch (request) {
+	case CLGET_SERVER_ADDR:
+		/* Now obsolete. Only for backward compatibility */
+		(void)memcpy(info, &cs->cs_raddr, (size_t) cs->cs_rlen);
+		break;
+	case CLGET_FD:
+		*(int *)info = rec->xprt.xp_fd;
+		break;
+	case CLGET_SVC_ADDR:
+		/* The caller should not free this memory area */
+		addr = (struct netbuf *)info;
+		addr->buf = &cs->cs_raddr;
+		addr->len = cs->cs_rlen;
+		addr->maxlen = sizeof(cs->cs_raddr);
+		break;
+
+	case CLGET_XID:
+		/* xid is the first element in the call structure */
+		uint32p = (u_int32_t *)&cx->cx_mcallc[0];
+		*(u_int32_t *)info = ntohl(*uint32p);
+		break;
+
+	case CLSET_XID:
+		/* This will set the xid of the NEXT call */
+		rec->call_xid = htonl(*(u_int32_t *) info - 1);
+		/* decrement by 1 as clnt_req_setup() increments once */
+		break;
+
+	case CLGET_VERS:
+		/* version is the fifth field of the call header */
+		uint32p = (u_int32_t *)&cx->cx_mcallc[4 * BYTES_PER_XDR_UNIT];
+		*(u_int32_t *)info = ntohl(*uint32p);
+		break;
+
+	case CLSET_VERS:
+		uint32p = (u_int32_t *)&cx->cx_mcallc[4 * BYTES_PER_XDR_UNIT];
+		*uint32p = htonl(*(u_int32_t *)info);
+		break;
+
+	case CLGET_PROG:
+		/* program is the fourth field of the call header */
+		uint32p = (u_int32_t *)&cx->cx_mcallc[3 * BYTES_PER_XDR_UNIT];
+		*(u_int32_t *)info = ntohl(*uint32p);
+		break;
+
+	case CLSET_PROG:
+		uint32p = (u_int32_t *)&cx->cx_mcallc[3 * BYTES_PER_XDR_UNIT];
+		*uint32p = htonl(*(u_int32_t *)info);
+		break;
+
+	default:
+		rslt = false;
+		break;
+	}
+
+	rpc_dplx_rui(rec);
+	mutex_unlock(&clnt->cl_lock);
+
+	return (rslt);
+}
+
+static void
+clnt_shm_destroy(CLIENT *clnt)
+{
+	struct cx_data *cx = CX_DATA(clnt);
+
+	if (cx->cx_rec) {
+		/* the transport is never shared */
+		SVC_DESTROY(&cx->cx_rec->xprt);
+		SVC_RELEASE(&cx->cx_rec->xprt, SVC_RELEASE_FLAG_NONE);
+	}
+	clnt_shm_data_free(CS_DATA(cx));
+}
+
+static struct clnt_ops *
+clnt_shm_ops(void)
+{
+	static struct clnt_ops ops;
+	extern mutex_t ops_lock;
+	sigset_t mask, newmask;
+
+	/* VARIABLES PROTECTED BY ops_lock: ops */
+
+	sigfillset(&newmask);
+	thr_sigsetmask(SIG_SETMASK, &newmask, &mask);
+	mutex_lock(&ops_lock);
+	if (ops.cl_call == NULL) {
+		ops.cl_call = clnt_shm_call;
+		ops.cl_abort = clnt_shm_abort;
+		ops.cl_freeres = clnt_shm_freeres;
+		ops.cl_destroy = clnt_shm_destroy;
+		ops.cl_control = clnt_shm_control;
+	}
+	mutex_unlock(&ops_lock);
+	thr_sigsetmask(SIG_SETMASK, &(mask), NULL);
+	return (&ops);
+}
@@ -308,7 +308,14 @@ clnt_vc_call(struct clnt_req *cc)
 	SVCXPRT *xprt = &rec->xprt;
 	struct xdr_ioq *xioq;
 	XDR *xdrs;
-	u_int32_t *uint32p;
+	size_t max_bsize = __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT;
+	size_t bsize = RPC_MAXDATA_DEFAULT;
+
+	/* One segment of the counted size, so neither the segment chain
+	 * nor (RPCSEC_GSS) the realloc path below is taken.
+	 */
+	if (__svc_params->flags & SVC_FLAG_XDR_SIZEOF)
+		bsize = xdr_ioq_size_class(clnt_req_sizeof(cc));
 
 	/* XXX Until gss_get_mic and gss_wrap can be replaced with
 	 * iov equivalents, replies with RPCSEC_GSS security must be
@@ -317,8 +324,7 @@ clnt_vc_call(struct clnt_req *cc)
 	 * Nb, we should probably use getpagesize() on Unix.  Need
 	 * an equivalent for Windows.
 	 */
-	xioq = xdr_ioq_create(RPC_MAXDATA_DEFAULT,
-			      __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT,
+	xioq = xdr_ioq_create(MIN(bsize, max_bsize), max_bsize,
 			      (cc->cc_auth->ah_cred.oa_flavor == RPCSEC_GSS)
 			      ? UIO_FLAG_REALLOC | UIO_FLAG_FREE
 			      : UIO_FLAG_FREE);
@@ -326,24 +332,14 @@ clnt_vc_call(struct clnt_req *cc)
 	xdrs = xioq->xdrs;
 	cc->cc_error.re_status = RPC_SUCCESS;
 
-	mutex_lock(&clnt->cl_lock);
-	uint32p = (u_int32_t *)&cx->cx_mcallc[0];
-	*uint32p = htonl(cc->cc_xid);
-
-	if ((!XDR_PUTBYTES(xdrs, cx->cx_mcallc, cx->cx_mpos))
-	    || (!XDR_PUTUINT32(xdrs, cc->cc_proc))
-	    || (!AUTH_MARSHALL(cc->cc_auth, xdrs))
-	    || (!AUTH_WRAP(cc->cc_auth, xdrs,
-			   cc->cc_call.proc, cc->cc_call.where))) {
+	if (!clnt_req_encode(cc, xdrs)) {
 		/* error case */
-		mutex_unlock(&clnt->cl_lock);
 		__warnx(TIRPC_DEBUG_FLAG_CLNT_VC,
 			"%s: fd %d failed",
 			__func__, xprt->xp_fd);
 		XDR_DESTROY(xdrs);
 		return (RPC_CANTENCODEARGS);
 	}
-	mutex_unlock(&clnt->cl_lock);
 
 	xdrs->x_lib[1] = (void *)xprt;
 	svc_ioq_write_submit(xprt, xioq);
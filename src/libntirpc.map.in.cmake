@@ -2,6 +2,7 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
   global:
     # __*
     __ntirpc_pkg_params;
+    __ntirpc_trace;
     __rpc_address_port;
     __rpc_address_set_length;
     __rpc_dtbsize;
@@ -56,6 +57,7 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
     clnt_ncreate_timed;
     clnt_ncreate_vers_timed;
     clnt_dg_ncreatef;
+    clnt_loop_ncreate;
     clnt_perrno;
     clnt_raw_ncreate;
     clnt_req_callback;
@@ -64,6 +66,7 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
     clnt_req_reset;
     clnt_req_setup;
     clnt_req_wait_reply;
+    clnt_shm_ncreatef;
     clnt_sperrno;
     clnt_tli_create;
     clnt_tp_ncreate_timed;
@@ -132,25 +135,32 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
     svc_auth_authenticate;
     svc_auth_reg;
     svc_dg_ncreatef;
+    svc_drc_stats;
     svc_fd_ncreatef;
     svc_init;
+    svc_loop_ncreate;
     svc_ncreate;
     svc_raw_ncreate;
     svc_reg;
     svc_resume;
     svc_rqst_new_evchan;
     svc_rqst_evchan_reg;
+    svc_rqst_evchan_stats;
     svc_rqst_evchan_unreg;
     svc_rqst_shutdown;
     svc_rqst_thrd_run;
     svc_rqst_thrd_signal;
     svc_sendreply;
+    svc_shm_ncreatef;
     svc_shutdown;
     svc_tli_ncreate;
     svc_tp_ncreate;
     svc_unreg;
     svc_validate_xprt_list;
     svc_vc_ncreatef;
+    svc_work_pool_stats;
+    svc_xprt_handoff_recv;
+    svc_xprt_handoff_send;
     svc_xprt_trace;
     svcauth_gss_acquire_cred;
     svcauth_gss_destroy;
@@ -176,6 +186,8 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
     uaddr2taddr;
 
     # x*
+    xdr_arena_more;
+    xdr_arena_release;
     xdr_authunix_parms;
     xdr_call_decode;
     xdr_call_encode;
@@ -185,6 +197,8 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
     xdr_float;
     xdr_free_null_stream;
     xdr_int;
+    xdr_ioq_create;
+    xdr_ioq_reset;
     xdr_long;
     xdr_longlong_t;
     xdr_naccepted_reply;
@@ -194,11 +208,13 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
     xdr_nnetobj;
     xdr_nrejected_reply;
     xdr_nreplymsg;
+    xdr_opaque_decode_uio;
     xdr_pmap;
     xdr_pmaplist;
     xdr_pmaplist_ptr;
     xdr_pointer;
     xdr_reference;
+    xdr_reply_encode;
     xdr_rmtcall_args;
     xdr_rmtcallres;
     xdr_rpc_gss_cred;
@@ -218,9 +234,11 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
     xdr_rpcbs_proc;
     xdr_rpcbs_rmtcalllist;
     xdr_rpcbs_rmtcalllist_ptr;
+    xdr_sizeof;
     xdr_u_int;
     xdr_u_long;
     xdr_u_longlong_t;
+    xdr_uio_file_create;
     xdr_void;
     xdr_wrapstring;
     xdrmem_ncreate;
@@ -233,4 +251,15 @@ NTIRPC_${NTIRPC_VERSION_BASE} {
 NTIRPC_PRIVATE {
   global:
   global_foo_bar;
+  # internals for bench/ntirpc_bench.c
+  authgss_ctx_hash_del;
+  authgss_ctx_hash_get;
+  authgss_ctx_hash_set;
+  calculate_crc32c;
+  CityHash64WithSeed;
+  svc_xprt_clear;
+  svc_xprt_lookup;
+  work_pool_init;
+  work_pool_shutdown;
+  work_pool_submit;
 };
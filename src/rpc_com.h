@@ -74,6 +74,13 @@ int __rpc_socktype2seman(int);
 void *rpc_nullproc(CLIENT *);
 int __rpc_sockisbound(int);
 
+/* trace_ring.c */
+void tirpc_trace_dump(mem_format_t);
+
+/* alloc_profile.c */
+bool tirpc_alloc_profile_start(void);
+void tirpc_alloc_profile_dump(mem_format_t);
+
 struct netbuf *__rpcb_findaddr(rpcprog_t, rpcvers_t, const struct netconfig *,
 			       const char *, CLIENT **);
 struct netbuf *__rpcb_findaddr_timed(rpcprog_t, rpcvers_t,
@@ -27,6 +27,9 @@
 #ifndef RPC_DPLX_INTERNAL_H
 #define RPC_DPLX_INTERNAL_H
 
+#include <stddef.h>
+#include <string.h>
+#include <misc/portable.h>
 #include <misc/queue.h>
 #include <misc/rbtree.h>
 #include <misc/wait_queue.h>
@@ -50,32 +53,26 @@ typedef struct rpc_dplx_lock {
 
 struct svc_rqst_rec;
 
-/* new unified state */
+/* new unified state
+ *
+ * Laid out by who writes:  the SVCXPRT read-mostly fields fill the first
+ * cache line, and its contended atomics end it, followed by ours.  The
+ * read-mostly, send and receive sections then each start a cache line,
+ * so receive and send tasks on one connection do not false share.
+ * Transport extensions follow the receive section, as they are mostly
+ * receive state.
+ *
+ * Allocate with rpc_dplx_rec_zalloc() for the alignment.
+ */
 struct rpc_dplx_rec {
 	struct svc_xprt xprt;		/**< Transport Independent handle */
-	struct xdr_ioq ioq;
-	struct poolq_head writeq;	/**< poolq for write requests */
-	struct opr_rbtree call_replies;
-	struct opr_rbtree_node fd_node;
-	struct {
-		rpc_dplx_lock_t lock;
-		struct timespec ts;
-	} recv;
 
-	/*
-	 * union of event processor types
-	 */
-	union {
-#if defined(TIRPC_EPOLL)
-		struct {
-			struct epoll_event event_recv;
-			struct epoll_event event_send;
-			struct xdr_ioq *xioq_send;
-		} epoll;
-#endif
-	} ev_u;
-	struct svc_rqst_rec *ev_p;	/* struct svc_rqst_rec (internal) */
+	/* contended, after xprt.xp_refcnt and xprt.xp_flags */
+	uint32_t inflight;		/**< atomic count of requests */
+	uint32_t ev_count;		/**< atomic count of receive events */
 
+	/* read-mostly */
+	struct svc_rqst_rec *ev_p CACHE_ALIGNED; /* struct svc_rqst_rec */
 	size_t maxrec;
 	long pagesz;
 #ifdef USE_RPC_RDMA
@@ -84,12 +81,74 @@ struct rpc_dplx_rec {
 #endif
 	u_int recvsz;
 	u_int sendsz;
+	struct opr_rbtree_node fd_node;
+
+	/* send:  replies, and calls */
+	struct poolq_head writeq CACHE_ALIGNED;	/**< poolq for write requests */
+	union {
+#if defined(TIRPC_EPOLL)
+		struct {
+			struct epoll_event event_send;
+			struct xdr_ioq *xioq_send;
+		} epoll;
+#endif
+	} ev_w;
 	uint32_t call_xid;		/**< current call xid */
-	uint32_t ev_count;		/**< atomic count of waiting events */
+	uint32_t reply_avg;		/**< moving average of reply sizes */
+
+	/* receive */
+	struct {
+		rpc_dplx_lock_t lock;
+		struct timespec ts;
+	} recv CACHE_ALIGNED;
+	union {
+#if defined(TIRPC_EPOLL)
+		struct {
+			struct epoll_event event_recv;
+		} epoll;
+#endif
+	} ev_u;
+	struct xdr_ioq ioq;
+	struct opr_rbtree call_replies;
+	TAILQ_ENTRY(rpc_dplx_rec) throttle_q;	/* waiting for quota */
+	struct work_pool_flow flow;	/* receive tasks, SVC_FLAG_FAIR_QUEUE */
 	struct svc_req *svc_req;	/**< svc_req we are processing */
 };
 #define REC_XPRT(p) (opr_containerof((p), struct rpc_dplx_rec, xprt))
 
+_Static_assert(offsetof(struct svc_xprt, xp_parent) <= CACHE_LINE_SIZE,
+	       "SVCXPRT read-mostly fields exceed a cache line");
+_Static_assert(offsetof(struct svc_xprt, xp_refcnt) >= CACHE_LINE_SIZE,
+	       "SVCXPRT contended fields share the read-mostly cache line");
+_Static_assert(offsetof(struct rpc_dplx_rec, inflight)
+	       < offsetof(struct rpc_dplx_rec, ev_p),
+	       "rpc_dplx_rec contended fields not with SVCXPRT atomics");
+_Static_assert(offsetof(struct rpc_dplx_rec, ev_p) % CACHE_LINE_SIZE == 0
+	       && offsetof(struct rpc_dplx_rec, writeq) % CACHE_LINE_SIZE == 0
+	       && offsetof(struct rpc_dplx_rec, recv) % CACHE_LINE_SIZE == 0,
+	       "rpc_dplx_rec sections not cache line aligned");
+_Static_assert(offsetof(struct rpc_dplx_rec, ev_p)
+	       < offsetof(struct rpc_dplx_rec, writeq)
+	       && offsetof(struct rpc_dplx_rec, writeq)
+	       < offsetof(struct rpc_dplx_rec, recv),
+	       "rpc_dplx_rec sections out of order");
+
+/* zeroed, aligned for the CACHE_ALIGNED sections; released by mem_free().
+ * aligned_alloc() wants a multiple of the alignment, and svc_dg and
+ * svc_raw append their buffers.
+ */
+static inline void *
+rpc_dplx_rec_zalloc(size_t size)
+{
+	void *p;
+
+	size = (size + CACHE_LINE_SIZE - 1) & ~((size_t)CACHE_LINE_SIZE - 1);
+	p = mem_aligned(CACHE_LINE_SIZE, size);
+
+	memset(p, 0, size);
+	return (p);
+}
+
 /* > SVC_XPRT_FLAG_LOCKED */
 #define RPC_DPLX_LOCKED		0x00100000
 #define RPC_DPLX_UNLOCK		0x00200000
@@ -122,6 +181,7 @@ rpc_dplx_rec_init(struct rpc_dplx_rec *rec)
 	TAILQ_INIT(&rec->writeq.qh);
 	mutex_init(&rec->writeq.qmutex, NULL);
 	rec->writeq.qcount = 0;
+	work_pool_flow_init(&rec->flow, 1);
 	/* Stop this xprt being cleaned immediately */
 	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &(rec->recv.ts));
 
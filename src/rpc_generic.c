@@ -161,6 +161,14 @@ tirpc_control(const u_int rq, void *in)
 	case TIRPC_SET_OTHER_FLAGS:
 		__ntirpc_pkg_params.other_flags = *(int *)in;
 		break;
+	case TIRPC_DUMP_TRACE_RING:
+		tirpc_trace_dump((mem_format_t)in);
+		break;
+	case TIRPC_ALLOC_PROFILE_START:
+		return (tirpc_alloc_profile_start());
+	case TIRPC_DUMP_ALLOC_PROFILE:
+		tirpc_alloc_profile_dump((mem_format_t)in);
+		break;
 	default:
 		return (false);
 	}
@@ -1603,7 +1603,7 @@ rpc_rdma_allocate(const struct rpc_rdma_attr *xa)
 		return NULL;
 	}
 
-	rdma_xprt = mem_zalloc(sizeof(*rdma_xprt));
+	rdma_xprt = rpc_dplx_rec_zalloc(sizeof(*rdma_xprt));
 
 	rdma_xprt->sm_dr.xprt.xp_type = XPRT_RDMA;
 	rdma_xprt->sm_dr.xprt.xp_ops = &rpc_rdma_ops;
@@ -76,6 +76,7 @@
 #include "rpc_rdma.h"
 #endif
 #include "svc_ioq.h"
+#include "svc_drc.h"
 
 #define SVC_VERSQUIET 0x0001	/* keep quiet about vers mismatch */
 #define version_keepquiet(xp) ((u_long)(xp)->xp_p3 & SVC_VERSQUIET)
@@ -141,10 +142,36 @@ svc_init(svc_init_params *params)
 	__svc_params->disconnect_cb = params->disconnect_cb;
 	__svc_params->alloc_cb = params->alloc_cb;
 	__svc_params->free_cb = params->free_cb;
+	__svc_params->place_cb = params->place_cb;
+	__svc_params->place_hdr_max = RNDUP(params->place_hdr_max
+					    ? params->place_hdr_max
+					    : SVC_PLACE_HDR_DEFAULT);
 
 	__svc_params->max_connections =
 	    (params->max_connections) ? params->max_connections : FD_SETSIZE;
 
+	/* in-flight quotas, 0: unlimited */
+	__svc_params->max_inflight_xprt = params->max_inflight_xprt;
+	__svc_params->max_inflight = params->max_inflight;
+	__svc_params->max_queue_depth = params->max_queue_depth;
+
+	__svc_params->busy_poll_us = (params->busy_poll_us)
+		? params->busy_poll_us : SVC_BUSY_POLL_DEFAULT_US;
+	__svc_params->busy_poll_sock_us = params->busy_poll_sock_us;
+
+	__svc_params->run_budget = (params->run_budget)
+		? params->run_budget : SVC_RUN_BUDGET_DEFAULT;
+	__svc_params->run_budget_us = (params->run_budget_us)
+		? params->run_budget_us : SVC_RUN_BUDGET_DEFAULT_US;
+
+	/* per-request decode arena, 0: mem_alloc() */
+	__svc_params->xdr_arena_size = params->xdr_arena_size;
+
+	/* duplicate request cache, 0: off */
+	__svc_params->drc.max = params->drc_max;
+	__svc_params->drc.max_client = params->drc_max_client;
+	__svc_params->drc.partitions = params->drc_partitions;
+
 #if defined(HAVE_BLKIN)
 	if (params->flags & SVC_INIT_BLKIN) {
 		int r = blkin_init();
@@ -166,11 +193,20 @@ svc_init(svc_init_params *params)
 	 * event systems, reworked select, etc. */
 #endif
 	__svc_params->idle_timeout = params->idle_timeout;
+	__svc_params->idle_trim_timeout = params->idle_trim_timeout;
 
 	/* allow consumers to manage all xprt registration */
 	if (params->flags & SVC_INIT_NOREG_XPRTS)
 		__svc_params->flags |= SVC_FLAG_NOREG_XPRTS;
 
+	/* per-xprt round robin of receive tasks */
+	if (params->flags & SVC_INIT_FAIR_QUEUE)
+		__svc_params->flags |= SVC_FLAG_FAIR_QUEUE;
+
+	/* pre-count replies and calls to allocate a single segment */
+	if (params->flags & SVC_INIT_XDR_SIZEOF)
+		__svc_params->flags |= SVC_FLAG_XDR_SIZEOF;
+
 	if (params->ioq_send_max)
 		__svc_params->ioq.send_max = params->ioq_send_max;
 	else
@@ -187,6 +223,9 @@ svc_init(svc_init_params *params)
 	work_pool_params.thrd_min = __svc_params->ioq.thrd_min;
 	work_pool_params.thrd_max = __svc_params->ioq.thrd_max;
 	work_pool_params.thr_stack_size = params->thr_stack_size;
+	work_pool_params.wait_target_us = params->ioq_wait_target_us;
+	work_pool_params.spawn_interval_ms = params->ioq_spawn_interval_ms;
+	work_pool_params.idle_reap_ms = params->ioq_idle_reap_ms;
 	/*
 	 * thrd_max should > channels.
 	 */
@@ -208,6 +247,8 @@ svc_init(svc_init_params *params)
 		return false;
 	}
 
+	svc_drc_init();
+
 	if (params->gss_ctx_hash_partitions)
 		__svc_params->gss.ctx_hash_partitions =
 		    params->gss_ctx_hash_partitions;
@@ -254,6 +295,15 @@ svc_init(svc_init_params *params)
 	return true;
 }
 
+/*
+ * Worker scaling counters and queue state, for monitoring.
+ */
+void
+svc_work_pool_stats(struct work_pool_stats *stats)
+{
+	work_pool_get_stats(&svc_work_pool, stats);
+}
+
 /* ***************  SVCXPRT related stuff **************** */
 
 /*
@@ -757,6 +807,9 @@ svc_shutdown(u_long flags)
 	/* release workers after event channels */
 	work_pool_shutdown(&svc_work_pool);
 
+	/* retained replies, after workers */
+	svc_drc_shutdown();
+
 	/* XXX assert quiescent */
 
 	return (code);
@@ -331,11 +331,13 @@ svcauth_gss_accept_sec_context(struct svc_req *req,
 			       struct rpc_gss_init_res *gr)
 {
 	struct rpc_gss_cred *gc;
+	struct xdr_arena *arena;
 	gss_buffer_desc recv_tok, seqbuf, checksum;
 	gss_OID mech;
 	OM_uint32 maj_stat = 0, min_stat = 0, ret_flags, seq;
 #define INDEF_EXPIRE 60*60*24	/* from mit k5 src/lib/rpc/svc_auth_gssapi.c */
 	OM_uint32 time_rec;
+	bool unwrapped;
 
 	gc = (struct rpc_gss_cred *)req->rq_msg.rq_cred_body;
 	memset(gr, 0, sizeof(*gr));
@@ -345,7 +347,15 @@ svcauth_gss_accept_sec_context(struct svc_req *req,
 
 	req->rq_msg.rm_xdr.where = &recv_tok;
 	req->rq_msg.rm_xdr.proc = (xdrproc_t)xdr_rpc_gss_init_args;
-	if (!SVCAUTH_UNWRAP(req)) {
+
+	/* recv_tok is released by xdr_free(), not with the arena */
+	arena = xdr_arena_get(req->rq_xdrs);
+	xdr_arena_detach(req->rq_xdrs);
+	unwrapped = SVCAUTH_UNWRAP(req);
+	if (arena)
+		xdr_arena_attach(req->rq_xdrs, arena);
+
+	if (!unwrapped) {
 		xdr_free((xdrproc_t)xdr_rpc_gss_init_args, (void *)&recv_tok);
 		return (false);
 	}
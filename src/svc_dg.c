@@ -65,6 +65,7 @@
 
 #include "rpc_com.h"
 #include "svc_internal.h"
+#include "svc_drc.h"
 #include "svc_xprt.h"
 #include <rpc/svc_rqst.h>
 #include <misc/city.h>
@@ -99,7 +100,8 @@ svc_dg_xprt_free(struct svc_dg_xprt *su)
 static struct svc_dg_xprt *
 svc_dg_xprt_zalloc(size_t iosz)
 {
-	struct svc_dg_xprt *su = mem_zalloc(sizeof(struct svc_dg_xprt) + iosz);
+	struct svc_dg_xprt *su = rpc_dplx_rec_zalloc(sizeof(struct svc_dg_xprt)
+						     + iosz);
 
 	/* Init SVCXPRT locks, etc */
 	rpc_dplx_rec_init(&su->su_dr);
@@ -273,9 +275,12 @@ svc_dg_rendezvous(SVCXPRT *xprt)
 	if (rlen == -1 && errno == EINTR)
 		goto again;
 
-	if (unlikely(svc_rqst_rearm_events(xprt, SVC_XPRT_FLAG_ADDED_RECV))) {
+	/* stop receiving while globally over quota, datagrams queue in
+	 * the socket buffer (or drop, to be retransmitted)
+	 */
+	if (unlikely(svc_rqst_rearm_recv(xprt, 0))) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
-			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+			"%s: %p fd %d svc_rqst_rearm_recv failed (will set dead)",
 			__func__, xprt, xprt->xp_fd);
 		svc_dg_xprt_free(su);
 		return (XPRT_DIED);
@@ -347,11 +352,72 @@ svc_dg_recv(SVCXPRT *xprt)
 	return (stat);
 }
 
+/*
+ * Send to the remote address, from the local address of the call.
+ */
+static bool
+svc_dg_sendmsg(SVCXPRT *xprt, struct iovec *iov, int iovcnt, size_t slen)
+{
+	struct svc_dg_xprt *su = DG_DR(REC_XPRT(xprt));
+	struct msghdr *msg = &su->su_msghdr;
+	struct cmsghdr* cmsg;
+        char msg_control[sizeof(struct cmsghdr) + sizeof(struct in6_pktinfo)];
+
+	msg->msg_iov = iov;
+	msg->msg_iovlen = iovcnt;
+	msg->msg_name = (struct sockaddr *)&xprt->xp_remote.ss;
+	msg->msg_namelen = sizeof(struct sockaddr_storage);
+	msg->msg_control = msg_control;
+	msg->msg_controllen = sizeof(msg_control);
+	msg->msg_flags = 0;
+
+	cmsg = CMSG_FIRSTHDR(msg);
+	cmsg->cmsg_level = (xprt->xp_local.ss.ss_family == AF_INET)
+		? IPPROTO_IP : IPPROTO_IPV6; /* a.k.a. SOL_IP and SOL_IPV6 */
+	cmsg->cmsg_type = (xprt->xp_local.ss.ss_family == AF_INET)
+		? IP_PKTINFO : IPV6_PKTINFO;
+	if (xprt->xp_local.ss.ss_family == AF_INET)
+		*(struct in_pktinfo*)CMSG_DATA(cmsg) =
+			*(struct in_pktinfo*) &xprt->xp_pktinfo;
+	else
+		*(struct in6_pktinfo*)CMSG_DATA(cmsg) =
+			*(struct in6_pktinfo*) &xprt->xp_pktinfo;
+	cmsg->cmsg_len = (xprt->xp_local.ss.ss_family == AF_INET)
+		? CMSG_LEN(sizeof(struct in_pktinfo))
+		: CMSG_LEN(sizeof(struct in6_pktinfo));
+	msg->msg_controllen = (xprt->xp_local.ss.ss_family == AF_INET)
+		? CMSG_SPACE(sizeof(struct in_pktinfo))
+		: CMSG_SPACE(sizeof(struct in6_pktinfo));
+
+	return (sendmsg(xprt->xp_fd, msg, 0) == (ssize_t) slen);
+}
+
+/*
+ * Resend a reply retained by the duplicate request cache.
+ */
+static void
+svc_dg_resend(SVCXPRT *xprt, xdr_uio *reply)
+{
+	struct iovec iov;
+
+	iov.iov_base = reply->uio_vio[0].vio_head;
+	iov.iov_len = reply->uio_vio[0].vio_length;
+
+	if (xprt->xp_remote.nb.len
+	 && !svc_dg_sendmsg(xprt, &iov, 1, iov.iov_len)) {
+		__warnx(TIRPC_DEBUG_FLAG_WARN,
+			"%s: %p fd %d err %d sendmsg failed",
+			__func__, xprt, xprt->xp_fd, errno);
+	}
+	reply->uio_release(reply, UIO_FLAG_NONE);
+}
+
 static enum xprt_stat
 svc_dg_decode(struct svc_req *req)
 {
 	XDR *xdrs = req->rq_xdrs;
 	SVCXPRT *xprt = req->rq_xprt;
+	xdr_uio *reply;
 
 	xdrs->x_op = XDR_DECODE;
 	XDR_SETPOS(xdrs, 0);
@@ -366,8 +432,17 @@ svc_dg_decode(struct svc_req *req)
 
 	/* in order of likelihood */
 	if (req->rq_msg.rm_direction == CALL) {
-		/* an ordinary call header */
-		return xprt->xp_dispatch.process_cb(req);
+		switch (svc_drc_lookup(req, &reply)) {
+		case SVC_DRC_NEW:
+			/* an ordinary call header */
+			return xprt->xp_dispatch.process_cb(req);
+		case SVC_DRC_HIT:
+			svc_dg_resend(xprt, reply);
+			break;
+		case SVC_DRC_BUSY:
+			break;
+		}
+		return SVC_STAT(xprt);
 	}
 
 	if (req->rq_msg.rm_direction == REPLY) {
@@ -403,11 +478,8 @@ svc_dg_reply(struct svc_req *req)
 	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
 	XDR *xdrs = rec->ioq.xdrs;
 	struct svc_dg_xprt *su = DG_DR(rec);
-	struct msghdr *msg = &su->su_msghdr;
-	struct cmsghdr* cmsg;
 	struct iovec iov;
 	size_t slen;
-        char msg_control[sizeof(struct cmsghdr) + sizeof(struct in6_pktinfo)];
 
 	if (!xprt->xp_remote.nb.len) {
 		__warnx(TIRPC_DEBUG_FLAG_WARN,
@@ -436,33 +508,11 @@ svc_dg_reply(struct svc_req *req)
 	}
 	iov.iov_base = &su[1];
 	iov.iov_len = slen = XDR_GETPOS(xdrs);
-	msg->msg_iov = &iov;
-	msg->msg_iovlen = 1;
-	msg->msg_name = (struct sockaddr *)&xprt->xp_remote.ss;
-	msg->msg_namelen = sizeof(struct sockaddr_storage);
-	msg->msg_control = msg_control;
-	msg->msg_controllen = sizeof(msg_control);
-	msg->msg_flags = 0;
 
-	cmsg = CMSG_FIRSTHDR(msg);
-	cmsg->cmsg_level = (xprt->xp_local.ss.ss_family == AF_INET)
-		? IPPROTO_IP : IPPROTO_IPV6; /* a.k.a. SOL_IP and SOL_IPV6 */
-	cmsg->cmsg_type = (xprt->xp_local.ss.ss_family == AF_INET)
-		? IP_PKTINFO : IPV6_PKTINFO;
-	if (xprt->xp_local.ss.ss_family == AF_INET)
-		*(struct in_pktinfo*)CMSG_DATA(cmsg) =
-			*(struct in_pktinfo*) &xprt->xp_pktinfo;
-	else
-		*(struct in6_pktinfo*)CMSG_DATA(cmsg) =
-			*(struct in6_pktinfo*) &xprt->xp_pktinfo;
-	cmsg->cmsg_len = (xprt->xp_local.ss.ss_family == AF_INET)
-		? CMSG_LEN(sizeof(struct in_pktinfo))
-		: CMSG_LEN(sizeof(struct in6_pktinfo));
-	msg->msg_controllen = (xprt->xp_local.ss.ss_family == AF_INET)
-		? CMSG_SPACE(sizeof(struct in_pktinfo))
-		: CMSG_SPACE(sizeof(struct in6_pktinfo));
+	if (req->rq_drc)
+		svc_drc_retain(req, svc_drc_uio_copy(iov.iov_base, slen));
 
-	if (sendmsg(xprt->xp_fd, msg, 0) != (ssize_t) slen) {
+	if (!svc_dg_sendmsg(xprt, &iov, 1, slen)) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
 			"%s: %p fd %d err %d sendmsg failed (will set dead)",
 			__func__, xprt, xprt->xp_fd, errno);
@@ -552,6 +602,8 @@ svc_dg_destroy_it(SVCXPRT *xprt, u_int flags, const char *tag, const int line)
 	}
 
 	REC_XPRT(xprt)->ioq.ioq_wpe.fun = svc_dg_destroy_task;
+	REC_XPRT(xprt)->ioq.ioq_wpe.prio = WORK_POOL_PRIO_LOW;
+	REC_XPRT(xprt)->ioq.ioq_wpe.flow = NULL;
 	work_pool_submit(&svc_work_pool, &(REC_XPRT(xprt)->ioq.ioq_wpe));
 }
 
@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file svc_drc.c
+ * @brief Duplicate request cache
+ *
+ * @section DESCRIPTION
+ *
+ * Enabled by svc_init_params.drc_max.  Calls are keyed by client address
+ * and port, xid, program, version, procedure, credential, and the
+ * transport checksum of the first arguments.  A client retransmitting
+ * over a new connection must reconnect from the same port to match (as
+ * NFS clients do).
+ *
+ * Partitions are chosen by a hash of the client address, so the entries
+ * of a client share a partition lock and its per-client limit is
+ * enforced locally.  Within a partition, clients are found by a tree
+ * ordered by that hash.  The global limit is divided among the
+ * partitions (as authgss_hash).
+ *
+ * Replies are retained as counted xdr_uio references to the encoded
+ * buffers, and resent from the receive path without re-encoding or
+ * reaching process_cb.  A retransmit of a call still in progress is
+ * dropped.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rpc/types.h>
+#include <misc/abstract_atomic.h>
+#include <misc/city.h>
+#include <misc/queue.h>
+#include <misc/rbtree_x.h>
+#include <rpc/rpc.h>
+#include <rpc/svc.h>
+#include "svc_internal.h"
+#include "svc_drc.h"
+
+#define SVC_DRC_PARTITIONS_DEFAULT 13
+
+struct svc_drc_client;
+
+struct svc_drc_entry {
+	struct opr_rbtree_node node_k;
+	TAILQ_ENTRY(svc_drc_entry) lru_q;	/* partition, oldest first */
+	TAILQ_ENTRY(svc_drc_entry) client_q;	/* client, oldest first */
+	struct svc_drc_client *client;
+	xdr_uio *reply;		/* NULL: in progress */
+	uint64_t cksum;
+	uint64_t cred;
+	rpcprog_t prog;
+	rpcvers_t vers;
+	rpcproc_t proc;
+	uint32_t xid;
+};
+
+struct svc_drc_client {
+	struct opr_rbtree_node node_k;
+	TAILQ_HEAD(drc_client_tailq, svc_drc_entry) entries;
+	struct sockaddr_storage addr;	/* address and port only */
+	uint64_t hk;
+	uint32_t size;
+};
+
+struct svc_drc_part {
+	TAILQ_HEAD(drc_lru_tailq, svc_drc_entry) lru_q;
+	struct opr_rbtree clients;
+	uint32_t size;
+};
+
+static struct svc_drc_st {
+	mutex_t lock;
+	struct rbtree_x xt;
+	uint32_t max_part;
+	uint32_t max_client;
+	bool initialized;
+	struct svc_drc_stats stats;
+} svc_drc_st = {
+	.lock = MUTEX_INITIALIZER,
+	.xt = {
+		.npart = 0,
+		.flags = RBT_X_FLAG_NONE,
+		.cachesz = 0,
+		.tree = NULL,
+	},
+	.initialized = false,
+};
+
+static int
+svc_drc_cmpf(const struct opr_rbtree_node *lhs,
+	     const struct opr_rbtree_node *rhs)
+{
+	struct svc_drc_entry *lk, *rk;
+
+	lk = opr_containerof(lhs, struct svc_drc_entry, node_k);
+	rk = opr_containerof(rhs, struct svc_drc_entry, node_k);
+
+	if (lk->xid != rk->xid)
+		return (lk->xid < rk->xid) ? -1 : 1;
+	if (lk->cksum != rk->cksum)
+		return (lk->cksum < rk->cksum) ? -1 : 1;
+	if (lk->cred != rk->cred)
+		return (lk->cred < rk->cred) ? -1 : 1;
+	if (lk->client != rk->client)
+		return ((uintptr_t)lk->client < (uintptr_t)rk->client)
+			? -1 : 1;
+	if (lk->proc != rk->proc)
+		return (lk->proc < rk->proc) ? -1 : 1;
+	if (lk->vers != rk->vers)
+		return (lk->vers < rk->vers) ? -1 : 1;
+	if (lk->prog != rk->prog)
+		return (lk->prog < rk->prog) ? -1 : 1;
+	return (0);
+}
+
+static int
+svc_drc_client_cmpf(const struct opr_rbtree_node *lhs,
+		    const struct opr_rbtree_node *rhs)
+{
+	struct svc_drc_client *lk, *rk;
+
+	lk = opr_containerof(lhs, struct svc_drc_client, node_k);
+	rk = opr_containerof(rhs, struct svc_drc_client, node_k);
+
+	if (lk->hk != rk->hk)
+		return (lk->hk < rk->hk) ? -1 : 1;
+	return memcmp(&lk->addr, &rk->addr, sizeof(lk->addr));
+}
+
+void
+svc_drc_init(void)
+{
+	uint32_t npart = __svc_params->drc.partitions
+		? __svc_params->drc.partitions : SVC_DRC_PARTITIONS_DEFAULT;
+	int ix;
+
+	mutex_lock(&svc_drc_st.lock);
+	if (svc_drc_st.initialized || !__svc_params->drc.max) {
+		mutex_unlock(&svc_drc_st.lock);
+		return;
+	}
+
+	if (rbtx_init(&svc_drc_st.xt, svc_drc_cmpf, npart,
+		      RBT_X_FLAG_ALLOC)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: rbtx_init failed", __func__);
+		mutex_unlock(&svc_drc_st.lock);
+		return;
+	}
+
+	for (ix = 0; ix < npart; ++ix) {
+		struct rbtree_x_part *xp = &(svc_drc_st.xt.tree[ix]);
+		struct svc_drc_part *dp = mem_zalloc(sizeof(*dp));
+
+		TAILQ_INIT(&dp->lru_q);
+		opr_rbtree_init(&dp->clients, svc_drc_client_cmpf);
+		xp->u1 = dp;
+	}
+
+	svc_drc_st.max_part = __svc_params->drc.max / npart;
+	if (!svc_drc_st.max_part)
+		svc_drc_st.max_part = 1;
+	svc_drc_st.max_client = __svc_params->drc.max_client
+		? __svc_params->drc.max_client : svc_drc_st.max_part;
+	svc_drc_st.initialized = true;
+
+	mutex_unlock(&svc_drc_st.lock);
+}
+
+/*
+ * partition locked
+ */
+static void
+svc_drc_remove(struct rbtree_x_part *t, struct svc_drc_entry *dv)
+{
+	struct svc_drc_part *dp = t->u1;
+	struct svc_drc_client *dc = dv->client;
+
+	opr_rbtree_remove(&t->t, &dv->node_k);
+	TAILQ_REMOVE(&dp->lru_q, dv, lru_q);
+	TAILQ_REMOVE(&dc->entries, dv, client_q);
+	dp->size--;
+	atomic_dec_uint32_t(&svc_drc_st.stats.size);
+
+	if (!--(dc->size)) {
+		opr_rbtree_remove(&dp->clients, &dc->node_k);
+		mem_free(dc, sizeof(*dc));
+	}
+
+	if (dv->reply)
+		dv->reply->uio_release(dv->reply, UIO_FLAG_NONE);
+	mem_free(dv, sizeof(*dv));
+}
+
+/*
+ * partition locked; in progress entries are never evicted
+ */
+static void
+svc_drc_evict(struct rbtree_x_part *t, struct svc_drc_client *dc)
+{
+	struct svc_drc_part *dp = t->u1;
+	struct svc_drc_entry *dv, *dv_next;
+
+	dv = TAILQ_FIRST(&dc->entries);
+	while (dv && dc->size > svc_drc_st.max_client) {
+		dv_next = TAILQ_NEXT(dv, client_q);
+		if (dv->reply) {
+			/* max_client >= 1, so dc is never freed here */
+			svc_drc_remove(t, dv);
+			atomic_inc_uint64_t(&svc_drc_st.stats.evicted);
+		}
+		dv = dv_next;
+	}
+
+	dv = TAILQ_FIRST(&dp->lru_q);
+	while (dv && dp->size > svc_drc_st.max_part) {
+		dv_next = TAILQ_NEXT(dv, lru_q);
+		if (dv->reply) {
+			svc_drc_remove(t, dv);
+			atomic_inc_uint64_t(&svc_drc_st.stats.evicted);
+		}
+		dv = dv_next;
+	}
+}
+
+static void
+svc_drc_addr(struct sockaddr_storage *addr, const struct sockaddr_storage *ss)
+{
+	memset(addr, 0, sizeof(*addr));
+
+	switch (ss->ss_family) {
+	case AF_INET:
+		addr->ss_family = AF_INET;
+		((struct sockaddr_in *)addr)->sin_addr =
+			((const struct sockaddr_in *)ss)->sin_addr;
+		((struct sockaddr_in *)addr)->sin_port =
+			((const struct sockaddr_in *)ss)->sin_port;
+		break;
+	case AF_INET6:
+		addr->ss_family = AF_INET6;
+		((struct sockaddr_in6 *)addr)->sin6_addr =
+			((const struct sockaddr_in6 *)ss)->sin6_addr;
+		((struct sockaddr_in6 *)addr)->sin6_port =
+			((const struct sockaddr_in6 *)ss)->sin6_port;
+		break;
+	default:
+		/* AF_LOCAL peers are (usually) unnamed: one client */
+		addr->ss_family = ss->ss_family;
+		break;
+	}
+}
+
+/*
+ * The RPCSEC_GSS credential carries a sequence number that changes on
+ * each retransmission, so only its flavor is keyed.
+ */
+static uint64_t
+svc_drc_cred(const struct opaque_auth *cred)
+{
+	if (cred->oa_flavor == RPCSEC_GSS || !cred->oa_length)
+		return (cred->oa_flavor);
+	return (CityHash64WithSeed(cred->oa_body, cred->oa_length,
+				   cred->oa_flavor));
+}
+
+/*
+ * Look up a decoded call header.
+ *
+ * On SVC_DRC_HIT, *reply holds a reference that the caller must drop with
+ * uio_release() after resending it.  On SVC_DRC_NEW, the call is tracked
+ * as in progress until svc_drc_retain() or svc_drc_done().
+ */
+enum svc_drc_stat
+svc_drc_lookup(struct svc_req *req, xdr_uio **reply)
+{
+	SVCXPRT *xprt = req->rq_xprt;
+	XDR *xdrs = req->rq_xdrs;
+	struct svc_drc_client ck, *dc;
+	struct svc_drc_entry dk, *dv;
+	struct opr_rbtree_node *nv;
+	struct rbtree_x_part *t;
+	struct svc_drc_part *dp;
+
+	*reply = NULL;
+	if (!svc_drc_st.initialized || !xprt->xp_ops->xp_checksum)
+		return (SVC_DRC_NEW);
+
+	SVC_CHECKSUM(req, xdrs->x_data, xdr_tail_inline(xdrs));
+
+	svc_drc_addr(&ck.addr, &xprt->xp_remote.ss);
+	ck.hk = CityHash64WithSeed((char *)&ck.addr, sizeof(ck.addr), 103);
+	t = rbtx_partition_of_scalar(&svc_drc_st.xt, ck.hk);
+	dp = t->u1;
+
+	dk.xid = req->rq_msg.rm_xid;
+	dk.cksum = req->rq_cksum;
+	dk.cred = svc_drc_cred(&req->rq_msg.cb_cred);
+	dk.prog = req->rq_msg.cb_prog;
+	dk.vers = req->rq_msg.cb_vers;
+	dk.proc = req->rq_msg.cb_proc;
+
+	mutex_lock(&t->mtx);
+	nv = opr_rbtree_lookup(&dp->clients, &ck.node_k);
+	if (nv) {
+		dc = opr_containerof(nv, struct svc_drc_client, node_k);
+		dk.client = dc;
+		nv = opr_rbtree_lookup(&t->t, &dk.node_k);
+		if (nv) {
+			dv = opr_containerof(nv, struct svc_drc_entry, node_k);
+			if (!dv->reply) {
+				mutex_unlock(&t->mtx);
+				atomic_inc_uint64_t(&svc_drc_st.stats.busy);
+				return (SVC_DRC_BUSY);
+			}
+			atomic_inc_int32_t(&dv->reply->uio_references);
+			*reply = dv->reply;
+			mutex_unlock(&t->mtx);
+			atomic_inc_uint64_t(&svc_drc_st.stats.hits);
+			return (SVC_DRC_HIT);
+		}
+	} else {
+		dc = mem_zalloc(sizeof(*dc));
+		TAILQ_INIT(&dc->entries);
+		dc->addr = ck.addr;
+		dc->hk = ck.hk;
+		(void)opr_rbtree_insert(&dp->clients, &dc->node_k);
+	}
+
+	dv = mem_zalloc(sizeof(*dv));
+	dv->client = dc;
+	dv->xid = dk.xid;
+	dv->cksum = dk.cksum;
+	dv->cred = dk.cred;
+	dv->prog = dk.prog;
+	dv->vers = dk.vers;
+	dv->proc = dk.proc;
+	(void)opr_rbtree_insert(&t->t, &dv->node_k);
+	TAILQ_INSERT_TAIL(&dp->lru_q, dv, lru_q);
+	TAILQ_INSERT_TAIL(&dc->entries, dv, client_q);
+	dc->size++;
+	dp->size++;
+	atomic_inc_uint32_t(&svc_drc_st.stats.size);
+
+	svc_drc_evict(t, dc);
+	mutex_unlock(&t->mtx);
+
+	atomic_inc_uint64_t(&svc_drc_st.stats.inserts);
+	req->rq_drc = dv;
+	return (SVC_DRC_NEW);
+}
+
+static inline struct rbtree_x_part *
+svc_drc_partition(struct svc_drc_entry *dv)
+{
+	return (rbtx_partition_of_scalar(&svc_drc_st.xt, dv->client->hk));
+}
+
+/*
+ * Keep the encoded reply (consumes the caller's reference).
+ *
+ * A NULL reply could not be held (see xdr_ioq_hold); the call is forgotten
+ * as by svc_drc_done(), and a retry is executed again.
+ */
+void
+svc_drc_retain(struct svc_req *req, xdr_uio *reply)
+{
+	struct svc_drc_entry *dv = req->rq_drc;
+	struct rbtree_x_part *t;
+
+	if (unlikely(!reply)) {
+		svc_drc_done(req);
+		return;
+	}
+
+	t = svc_drc_partition(dv);
+	mutex_lock(&t->mtx);
+	dv->reply = reply;
+	mutex_unlock(&t->mtx);
+	req->rq_drc = NULL;
+}
+
+/*
+ * Forget a call finished without a reply; it may be retried.
+ */
+void
+svc_drc_done(struct svc_req *req)
+{
+	struct svc_drc_entry *dv = req->rq_drc;
+	struct rbtree_x_part *t;
+
+	if (likely(!dv))
+		return;
+
+	t = svc_drc_partition(dv);
+	mutex_lock(&t->mtx);
+	svc_drc_remove(t, dv);
+	mutex_unlock(&t->mtx);
+	req->rq_drc = NULL;
+}
+
+static void
+svc_drc_uio_release(struct xdr_uio *uio, u_int flags)
+{
+	if (atomic_dec_int32_t(&uio->uio_references))
+		return;
+
+	mem_free(uio, sizeof(*uio) + sizeof(xdr_vio)
+		      + uio->uio_vio[0].vio_length);
+}
+
+/*
+ * Counted single buffer copy of a contiguous reply (datagrams).
+ */
+xdr_uio *
+svc_drc_uio_copy(void *data, size_t length)
+{
+	xdr_uio *uio = mem_alloc(sizeof(*uio) + sizeof(xdr_vio) + length);
+	uint8_t *base = (uint8_t *)&uio->uio_vio[1];
+
+	memset(uio, 0, sizeof(*uio) + sizeof(xdr_vio));
+	memcpy(base, data, length);
+	uio->uio_release = svc_drc_uio_release;
+	uio->uio_count = 1;
+	uio->uio_references = 1;
+	uio->uio_vio[0].vio_base =
+	uio->uio_vio[0].vio_head = base;
+	uio->uio_vio[0].vio_tail =
+	uio->uio_vio[0].vio_wrap = base + length;
+	uio->uio_vio[0].vio_length = length;
+	uio->uio_vio[0].vio_type = VIO_DATA;
+	return (uio);
+}
+
+void
+svc_drc_stats(struct svc_drc_stats *stats)
+{
+	stats->hits = atomic_fetch_uint64_t(&svc_drc_st.stats.hits);
+	stats->busy = atomic_fetch_uint64_t(&svc_drc_st.stats.busy);
+	stats->inserts = atomic_fetch_uint64_t(&svc_drc_st.stats.inserts);
+	stats->evicted = atomic_fetch_uint64_t(&svc_drc_st.stats.evicted);
+	stats->size = atomic_fetch_uint32_t(&svc_drc_st.stats.size);
+}
+
+void
+svc_drc_shutdown(void)
+{
+	struct rbtree_x_part *t;
+	struct svc_drc_part *dp;
+	int ix;
+
+	mutex_lock(&svc_drc_st.lock);
+	if (!svc_drc_st.initialized) {
+		mutex_unlock(&svc_drc_st.lock);
+		return;
+	}
+	svc_drc_st.initialized = false;
+
+	for (ix = 0; ix < svc_drc_st.xt.npart; ++ix) {
+		t = &(svc_drc_st.xt.tree[ix]);
+		dp = t->u1;
+
+		mutex_lock(&t->mtx);
+		while (!TAILQ_EMPTY(&dp->lru_q))
+			svc_drc_remove(t, TAILQ_FIRST(&dp->lru_q));
+		mutex_unlock(&t->mtx);
+		mem_free(dp, sizeof(*dp));
+		t->u1 = NULL;
+	}
+	rbtx_cleanup(&svc_drc_st.xt);
+	mutex_unlock(&svc_drc_st.lock);
+}
@@ -0,0 +1,649 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file svc_handoff.c
+ * @brief Live transport handoff to a successor process
+ *
+ * @section DESCRIPTION
+ *
+ * svc_xprt_handoff_send() marks the transports to go with
+ * SVC_XPRT_FLAG_HANDOFF, so a receive task ending parks its transport
+ * instead of rearming it, then holds each one (svc_rqst_xprt_hold) when
+ * it is parked or idle.  It waits until no receive events (ev_count),
+ * requests (inflight), replies (writeq) or calls (call_replies) remain,
+ * rescanning for connections accepted meanwhile, before sending any.
+ *
+ * Listeners and datagram transports are sent first, so that each
+ * connection can name its listener by the predecessor's fd.  A record
+ * partially received goes with its connection, see svc_handoff.h.
+ *
+ * Both processes have the socket until the predecessor destroys its
+ * transport, which closes it without shutdown(2) for HANDOFF.  Only the
+ * successor uses it meanwhile.
+ *
+ * Connections without a listener, such as those of clnt_vc, stay:  their
+ * calls are in CLIENT handles that cannot go.  Shared memory, loopback
+ * and RDMA transports stay too.  Datagram requests in progress are not
+ * waited for; their replies are sent by the predecessor.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rpc/types.h>
+#include <misc/portable.h>
+#include <rpc/rpc.h>
+#include <rpc/svc.h>
+#include <rpc/svc_rqst.h>
+
+#include "rpc_com.h"
+#include "svc_internal.h"
+#include "svc_xprt.h"
+#include "rpc_dplx_internal.h"
+#include "svc_handoff.h"
+
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+#define SVC_HANDOFF_PASS_NS	1000000		/* between drain passes */
+
+struct svc_handoff_ent {
+	SVCXPRT *xprt;
+	uint32_t chan_id;
+	bool held;
+	bool sent;
+};
+
+struct svc_handoff_set {
+	struct svc_handoff_ent *ent;
+	u_int count;
+	u_int size;
+	u_int added;			/* this pass */
+};
+
+/* in the successor, listeners by predecessor fd */
+struct svc_handoff_listener {
+	SVCXPRT *xprt;
+	int fd;
+};
+
+static mutex_t svc_handoff_mtx = MUTEX_INITIALIZER;
+
+static enum svc_handoff_kind
+svc_handoff_kind(SVCXPRT *xprt)
+{
+	switch (xprt->xp_type) {
+	case XPRT_TCP_RENDEZVOUS:
+	case XPRT_VSOCK_RENDEZVOUS:
+		return (SVC_HANDOFF_LISTEN);
+	case XPRT_UDP_RENDEZVOUS:
+		return (SVC_HANDOFF_DG);
+	case XPRT_TCP:
+	case XPRT_VSOCK:
+		/* accepted on a listener going too */
+		if (xprt->xp_parent
+		 && (atomic_fetch_uint16_t(&xprt->xp_parent->xp_flags)
+		     & SVC_XPRT_FLAG_HANDOFF))
+			return (SVC_HANDOFF_CONN);
+		break;
+	default:
+		break;
+	};
+	return (SVC_HANDOFF_END);
+}
+
+/* svc_xprt_foreach() callback, with the tree locked */
+static bool
+svc_handoff_collect(SVCXPRT *xprt, void *arg)
+{
+	struct svc_handoff_set *set = arg;
+	uint16_t xp_flags = atomic_fetch_uint16_t(&xprt->xp_flags);
+
+	if (!xprt->xp_ops
+	 || (xp_flags & (SVC_XPRT_FLAG_DESTROYED | SVC_XPRT_FLAG_HANDOFF))
+	 || !REC_XPRT(xprt)->ev_p
+	 || svc_handoff_kind(xprt) == SVC_HANDOFF_END)
+		return (false);
+
+	if (set->count == set->size) {
+		set->size = set->size ? set->size * 2 : 64;
+		set->ent = mem_realloc(set->ent,
+				       set->size * sizeof(*set->ent));
+	}
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	atomic_set_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_HANDOFF);
+	memset(&set->ent[set->count], 0, sizeof(*set->ent));
+	set->ent[set->count++].xprt = xprt;
+	set->added++;
+	return (false);
+}
+
+/*
+ * Held, with nothing running or queued.  Nothing new starts once held,
+ * other than sending calls, so each is checked after those it starts.
+ */
+static bool
+svc_handoff_quiet(struct svc_handoff_ent *ent)
+{
+	SVCXPRT *xprt = ent->xprt;
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	bool empty;
+
+	if (!ent->held
+	 && !(ent->held = svc_rqst_xprt_hold(xprt, &ent->chan_id)))
+		return (false);
+
+	if (atomic_fetch_uint32_t(&rec->ev_count)
+	 || atomic_fetch_uint32_t(&rec->inflight))
+		return (false);
+
+	mutex_lock(&rec->writeq.qmutex);
+	empty = TAILQ_EMPTY(&rec->writeq.qh);
+	mutex_unlock(&rec->writeq.qmutex);
+
+	return (empty
+		&& !(atomic_fetch_uint16_t(&xprt->xp_flags)
+		     & SVC_XPRT_FLAG_ADDED_SEND)
+		&& !opr_rbtree_size(&rec->call_replies));
+}
+
+/* one pass, dropping those destroyed meanwhile; true when all quiet */
+static bool
+svc_handoff_drain(struct svc_handoff_set *set)
+{
+	struct svc_handoff_ent *ent;
+	bool quiet = true;
+	u_int ix = 0;
+
+	while (ix < set->count) {
+		ent = &set->ent[ix];
+		if (atomic_fetch_uint16_t(&ent->xprt->xp_flags)
+		    & SVC_XPRT_FLAG_DESTROYED) {
+			SVC_RELEASE(ent->xprt, SVC_RELEASE_FLAG_NONE);
+			*ent = set->ent[--set->count];
+			continue;
+		}
+		if (!svc_handoff_quiet(ent))
+			quiet = false;
+		ix++;
+	}
+	return (quiet);
+}
+
+static void
+svc_handoff_hdr_init(struct svc_handoff_hdr *ho, enum svc_handoff_kind kind)
+{
+	memset(ho, 0, sizeof(*ho));
+	ho->ho_magic = SVC_HANDOFF_MAGIC;
+	ho->ho_version = SVC_HANDOFF_VERSION;
+	ho->ho_kind = kind;
+	ho->ho_fd = RPC_ANYFD;
+	ho->ho_parent_fd = RPC_ANYFD;
+}
+
+/* the socket (if any) goes with the first byte */
+static int
+svc_handoff_write(int sock, struct svc_handoff_hdr *ho, int fd,
+		  uint8_t *record)
+{
+	union {
+		struct cmsghdr cmsg;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} u;
+	struct iovec iov[2];
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t n;
+
+	iov[0].iov_base = ho;
+	iov[0].iov_len = sizeof(*ho);
+	iov[1].iov_base = record;
+	iov[1].iov_len = ho->ho_record_len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = ho->ho_record_len ? 2 : 1;
+	if (fd >= 0) {
+		memset(&u, 0, sizeof(u));
+		msg.msg_control = u.buf;
+		msg.msg_controllen = sizeof(u.buf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	while (msg.msg_iovlen) {
+		n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return (errno);
+		}
+		msg.msg_control = NULL;
+		msg.msg_controllen = 0;
+		while (msg.msg_iovlen && n >= msg.msg_iov->iov_len) {
+			n -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen) {
+			msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+			msg.msg_iov->iov_len -= n;
+		}
+	}
+	return (0);
+}
+
+static int
+svc_handoff_readn(int sock, void *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = recv(sock, buf, len, MSG_WAITALL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return (errno);
+		}
+		if (!n)
+			return (EPIPE);
+		buf = (char *)buf + n;
+		len -= n;
+	}
+	return (0);
+}
+
+/* on success, *fd is the socket received or RPC_ANYFD */
+static int
+svc_handoff_read(int sock, struct svc_handoff_hdr *ho, int *fd)
+{
+	union {
+		struct cmsghdr cmsg;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} u;
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t n;
+	int code = 0;
+
+	*fd = RPC_ANYFD;
+	iov.iov_base = ho;
+	iov.iov_len = sizeof(*ho);
+
+	memset(&u, 0, sizeof(u));
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = u.buf;
+	msg.msg_controllen = sizeof(u.buf);
+
+	do {
+		n = recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+	} while (n < 0 && errno == EINTR);
+	if (n < 0)
+		return (errno);
+	if (!n)
+		return (EPIPE);
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET
+		 && cmsg->cmsg_type == SCM_RIGHTS
+		 && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+
+	if (msg.msg_flags & MSG_CTRUNC)
+		code = EPROTO;
+	else if (n < sizeof(*ho))
+		code = svc_handoff_readn(sock, (char *)ho + n,
+					 sizeof(*ho) - n);
+	if (!code
+	 && (ho->ho_magic != SVC_HANDOFF_MAGIC
+	  || ho->ho_version != SVC_HANDOFF_VERSION
+	  || ho->ho_kind > SVC_HANDOFF_CONN
+	  || (ho->ho_kind == SVC_HANDOFF_END) != (*fd < 0)
+	  || ho->ho_record_len > ho->ho_maxrec
+	  || ho->ho_remote_len > sizeof(ho->ho_remote)
+	  || ho->ho_proxy_len > sizeof(ho->ho_proxy)))
+		code = EPROTO;
+
+	if (code && *fd >= 0) {
+		close(*fd);
+		*fd = RPC_ANYFD;
+	}
+	return (code);
+}
+
+static int
+svc_handoff_send_one(int sock, struct svc_handoff_ent *ent,
+		     enum svc_handoff_kind kind)
+{
+	SVCXPRT *xprt = ent->xprt;
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_handoff_hdr ho;
+	uint8_t *record = NULL;
+	int code;
+
+	svc_handoff_hdr_init(&ho, kind);
+	ho.ho_fd = xprt->xp_fd;
+	ho.ho_chan_id = ent->chan_id;
+	ho.ho_xp_flags = atomic_fetch_uint16_t(&xprt->xp_flags)
+		& (SVC_XPRT_FLAG_CLOSE | SVC_XPRT_FLAG_REMOTE_ADDR_SET);
+	ho.ho_sendsz = rec->sendsz;
+	ho.ho_recvsz = rec->recvsz;
+	ho.ho_maxrec = rec->maxrec;
+
+	if (kind == SVC_HANDOFF_CONN) {
+		ho.ho_parent_fd = xprt->xp_parent->xp_fd;
+		ho.ho_remote_len = MIN(xprt->xp_remote.nb.len,
+				       sizeof(ho.ho_remote));
+		memcpy(&ho.ho_remote, xprt->xp_remote.nb.buf,
+		       ho.ho_remote_len);
+		ho.ho_proxy_len = MIN(xprt->xp_proxy.nb.len,
+				      sizeof(ho.ho_proxy));
+		memcpy(&ho.ho_proxy, xprt->xp_proxy.nb.buf, ho.ho_proxy_len);
+		record = svc_vc_handoff_record(xprt, &ho);
+	}
+
+	code = svc_handoff_write(sock, &ho, xprt->xp_fd, record);
+	if (record)
+		mem_free(record, ho.ho_record_len);
+	if (code) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d failed (%d)",
+			__func__, xprt, xprt->xp_fd, code);
+		return (code);
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+		"%s: %p fd %d kind %d channel %" PRIu32 " record %" PRIu32,
+		__func__, xprt, xprt->xp_fd, kind, ent->chan_id,
+		ho.ho_record_len);
+	ent->sent = true;
+	return (0);
+}
+
+int
+svc_xprt_handoff_send(const int sock, const int timeout_ms)
+{
+	struct svc_handoff_set set;
+	struct svc_handoff_hdr ho;
+	struct timespec start;
+	struct timespec now;
+	struct timespec pass_ts = { 0, SVC_HANDOFF_PASS_NS };
+	struct svc_handoff_ent *ent;
+	enum svc_handoff_kind kind;
+	int64_t elapsed_ms;
+	u_int ix;
+	int sent = 0;
+	int code = 0;
+	bool rescan;
+
+	if (mutex_trylock(&svc_handoff_mtx)) {
+		errno = EBUSY;
+		return (-1);
+	}
+	memset(&set, 0, sizeof(set));
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &start);
+
+	for (;;) {
+		set.added = 0;
+		/* incomplete when the tree kept changing */
+		rescan = svc_xprt_foreach(svc_handoff_collect, &set) > 0;
+		if (svc_handoff_drain(&set) && !set.added && !rescan)
+			break;
+
+		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &now);
+		elapsed_ms = (now.tv_sec - start.tv_sec) * 1000
+			   + (now.tv_nsec - start.tv_nsec) / 1000000;
+		if (elapsed_ms >= timeout_ms) {
+			code = ETIMEDOUT;
+			break;
+		}
+		nanosleep(&pass_ts, NULL);
+	}
+
+	for (kind = SVC_HANDOFF_LISTEN; !code && kind <= SVC_HANDOFF_CONN;
+	     kind++) {
+		for (ix = 0; !code && ix < set.count; ix++) {
+			if (svc_handoff_kind(set.ent[ix].xprt) != kind)
+				continue;
+			code = svc_handoff_send_one(sock, &set.ent[ix], kind);
+			if (!code)
+				sent++;
+		}
+	}
+
+	if (!code) {
+		svc_handoff_hdr_init(&ho, SVC_HANDOFF_END);
+		ho.ho_fd = sent;
+		code = svc_handoff_write(sock, &ho, RPC_ANYFD, NULL);
+	}
+
+	for (ix = 0; ix < set.count; ix++) {
+		ent = &set.ent[ix];
+		if (ent->sent)
+			SVC_DESTROY(ent->xprt);
+		else
+			svc_rqst_xprt_unhold(ent->xprt, ent->held);
+		SVC_RELEASE(ent->xprt, SVC_RELEASE_FLAG_NONE);
+	}
+	if (set.ent)
+		mem_free(set.ent, set.size * sizeof(*set.ent));
+	mutex_unlock(&svc_handoff_mtx);
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+		"%s: sent %d of %u (%d)",
+		__func__, sent, set.count, code);
+	if (code) {
+		errno = code;
+		return (-1);
+	}
+	return (sent);
+}
+
+/*
+ * Channel ids are assigned in creation order, so a successor creating
+ * its channels as before has the same ones.  Id 0 would create the
+ * legacy channel in svc_rqst_evchan_reg(), so is not reused.
+ */
+static int
+svc_handoff_register(SVCXPRT *xprt, SVCXPRT *parent, uint32_t chan_id)
+{
+	int code = ENOENT;
+
+	if (chan_id)
+		code = svc_rqst_evchan_reg(chan_id, xprt, SVC_RQST_FLAG_NONE);
+	if (code == ENOENT)
+		code = svc_rqst_xprt_register(xprt, parent);
+	return (code);
+}
+
+/* returns with a reference, or NULL having closed fd */
+static SVCXPRT *
+svc_handoff_create(const struct svc_handoff_hdr *ho, int fd,
+		   const uint8_t *record, SVCXPRT *parent,
+		   svc_xprt_fun_t setup_cb)
+{
+	uint32_t flags = (ho->ho_xp_flags & SVC_XPRT_FLAG_CLOSE)
+		       | SVC_CREATE_FLAG_XPRT_NOREG;
+	SVCXPRT *xprt;
+	enum xprt_stat stat;
+
+	switch (ho->ho_kind) {
+	case SVC_HANDOFF_LISTEN:
+		xprt = svc_vc_ncreatef(fd, ho->ho_sendsz, ho->ho_recvsz, flags);
+		break;
+	case SVC_HANDOFF_DG:
+		xprt = svc_dg_ncreatef(fd, ho->ho_sendsz, ho->ho_recvsz, flags);
+		break;
+	case SVC_HANDOFF_CONN:
+		if (!parent) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: fd %d listener fd %d not received",
+				__func__, ho->ho_fd, ho->ho_parent_fd);
+			close(fd);
+			return (NULL);
+		}
+		xprt = svc_vc_handoff_accept(fd, parent, ho, record);
+		break;
+	default:
+		xprt = NULL;
+		break;
+	};
+	if (!xprt) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d (was %d) not taken over",
+			__func__, fd, ho->ho_fd);
+		if (ho->ho_kind != SVC_HANDOFF_CONN)
+			close(fd);
+		return (NULL);
+	}
+	/* svc_dg sizes its buffer by maxrec */
+	if (ho->ho_kind == SVC_HANDOFF_LISTEN)
+		REC_XPRT(xprt)->maxrec = ho->ho_maxrec;
+
+	stat = (ho->ho_kind == SVC_HANDOFF_CONN)
+		? parent->xp_dispatch.rendezvous_cb(xprt)
+		: setup_cb(xprt);
+	if (stat || svc_handoff_register(xprt, parent, ho->ho_chan_id)) {
+		/* Was never added to epoll */
+		SVC_DESTROY(xprt);
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		return (NULL);
+	}
+	atomic_set_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_READY);
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+		"%s: %p fd %d (was %d) kind %d",
+		__func__, xprt, fd, ho->ho_fd, ho->ho_kind);
+	return (xprt);
+}
+
+int
+svc_xprt_handoff_recv(const int sock, svc_xprt_fun_t setup_cb)
+{
+	struct svc_handoff_listener *listeners = NULL;
+	struct svc_handoff_hdr ho;
+	SVCXPRT *parent;
+	SVCXPRT *xprt;
+	uint8_t *record;
+	u_int nlisteners = 0;
+	u_int size = 0;
+	u_int ix;
+	int received = 0;
+	int code;
+	int fd;
+
+	if (!setup_cb) {
+		errno = EINVAL;
+		return (-1);
+	}
+
+	for (;;) {
+		code = svc_handoff_read(sock, &ho, &fd);
+		if (code || ho.ho_kind == SVC_HANDOFF_END)
+			break;
+
+		record = NULL;
+		if (ho.ho_record_len) {
+			record = mem_alloc(ho.ho_record_len);
+			code = svc_handoff_readn(sock, record,
+						 ho.ho_record_len);
+			if (code) {
+				mem_free(record, ho.ho_record_len);
+				close(fd);
+				break;
+			}
+		}
+
+		parent = NULL;
+		for (ix = 0; ix < nlisteners; ix++) {
+			if (listeners[ix].fd == ho.ho_parent_fd) {
+				parent = listeners[ix].xprt;
+				break;
+			}
+		}
+
+		xprt = svc_handoff_create(&ho, fd, record, parent, setup_cb);
+		if (record)
+			mem_free(record, ho.ho_record_len);
+		if (!xprt)
+			continue;
+		received++;
+
+		switch (ho.ho_kind) {
+		case SVC_HANDOFF_LISTEN:
+			/* the reference from creation is the caller's */
+			if (nlisteners == size) {
+				size = size ? size * 2 : 16;
+				listeners = mem_realloc(listeners,
+						size * sizeof(*listeners));
+			}
+			SVC_REF(xprt, SVC_REF_FLAG_NONE);
+			listeners[nlisteners].xprt = xprt;
+			listeners[nlisteners++].fd = ho.ho_fd;
+			break;
+		case SVC_HANDOFF_CONN:
+			/* epoll does not hold a reference */
+			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+			break;
+		default:
+			break;
+		};
+	}
+
+	for (ix = 0; ix < nlisteners; ix++)
+		SVC_RELEASE(listeners[ix].xprt, SVC_RELEASE_FLAG_NONE);
+	if (listeners)
+		mem_free(listeners, size * sizeof(*listeners));
+
+	if (!code && ho.ho_fd != received)
+		__warnx(TIRPC_DEBUG_FLAG_WARN,
+			"%s: took over %d of %d",
+			__func__, received, ho.ho_fd);
+	if (code) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: failed after %d (%d)",
+			__func__, received, code);
+		errno = code;
+		return (-1);
+	}
+	return (received);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SVC_HANDOFF_H
+#define SVC_HANDOFF_H
+
+#include <sys/socket.h>
+#include <rpc/svc.h>
+
+/*
+ * One transport, followed by ho_record_len bytes of its partial record,
+ * with its socket attached to the first byte.  Both ends are the same
+ * library on the same host, so native byte order and layout.
+ */
+#define SVC_HANDOFF_MAGIC	0x6e74686f	/* "ntho" */
+#define SVC_HANDOFF_VERSION	1
+
+enum svc_handoff_kind {
+	SVC_HANDOFF_END = 0,		/* no socket, ho_fd is the count */
+	SVC_HANDOFF_LISTEN,
+	SVC_HANDOFF_DG,
+	SVC_HANDOFF_CONN
+};
+
+struct svc_handoff_hdr {
+	uint32_t ho_magic;
+	uint16_t ho_version;
+	uint16_t ho_kind;
+	int32_t ho_fd;			/* predecessor xp_fd */
+	int32_t ho_parent_fd;		/* predecessor listener xp_fd */
+	uint32_t ho_chan_id;		/* predecessor event channel */
+	uint32_t ho_xp_flags;		/* CLOSE, REMOTE_ADDR_SET */
+	uint32_t ho_sendsz;
+	uint32_t ho_recvsz;
+	uint32_t ho_maxrec;
+	uint32_t ho_fbtbc;		/* fragment bytes to be consumed */
+	uint32_t ho_frag_flags;		/* UIO_FLAG_MORE: not last fragment */
+	uint32_t ho_record_len;		/* partial record bytes following */
+	uint32_t ho_remote_len;
+	uint32_t ho_proxy_len;
+	struct sockaddr_storage ho_remote;
+	struct sockaddr_storage ho_proxy;
+};
+
+/* in svc_vc.c */
+uint8_t *svc_vc_handoff_record(SVCXPRT *, struct svc_handoff_hdr *);
+SVCXPRT *svc_vc_handoff_accept(const int, SVCXPRT *,
+			       const struct svc_handoff_hdr *, const uint8_t *);
+
+#endif				/* SVC_HANDOFF_H */
@@ -65,6 +65,7 @@ struct svc_params {
 	svc_xprt_fun_t disconnect_cb;
 	svc_xprt_alloc_fun_t alloc_cb;
 	svc_xprt_free_fun_t free_cb;
+	svc_xprt_place_fun_t place_cb;
 
 	struct {
 		int ctx_hash_partitions;
@@ -81,7 +82,23 @@ struct svc_params {
 
 	u_long flags;
 	u_int max_connections;
+	u_int max_inflight_xprt;
+	u_int max_inflight;
+	u_int max_queue_depth;
+	u_int busy_poll_us;
+	u_int busy_poll_sock_us;
+	u_int run_budget;
+	u_int run_budget_us;
+	u_int xdr_arena_size;
+
+	struct {
+		u_int max;
+		u_int max_client;
+		u_int partitions;
+	} drc;
+	u_int place_hdr_max;
 	int32_t idle_timeout;
+	int32_t idle_trim_timeout;
 #if defined(_USE_NFS_RDMA) || defined(USE_RPC_RDMA)
 	uint16_t nfs_rdma_port;
 	u_int max_rdma_connections;
@@ -128,6 +145,9 @@ struct svc_dg_xprt {
 struct svc_vc_xprt {
 	struct rpc_dplx_rec sx_dr;	/* SVCXPRT indexed by fd */
 	int32_t sx_fbtbc;		/* fragment bytes to be consumed */
+	u_int sx_place_ix;		/* next sx_place_uio vector */
+	xdr_uio *sx_place_uio;		/* from place_cb, while receiving */
+	u_int sx_dormant_size;		/* trimmed receive buffer, 0: none */
 };
 #define VC_DR(p) (opr_containerof((p), struct svc_vc_xprt, sx_dr))
 
@@ -153,6 +173,22 @@ extern void __rpc_set_blkin_endpoint(SVCXPRT *xprt, const char *tag);
 
 enum xprt_stat svc_rendezvous_stat(SVCXPRT *);
 
+/*
+ * Expected length of the encoded reply (SVC_INIT_XDR_SIZEOF), for sizing
+ * the send buffer.  xdr_reply_encode() leaves the results to SVCAUTH_WRAP;
+ * xdr_nreplymsg() counts the same header and the results together.
+ */
+static inline size_t
+svc_reply_sizeof(struct svc_req *req)
+{
+	size_t size = xdr_sizeof((xdrproc_t) xdr_nreplymsg, &req->rq_msg);
+
+	/* RPCSEC_GSS sequence number and checksum or wrap token */
+	if (size && req->rq_msg.cb_cred.oa_flavor == RPCSEC_GSS)
+		size += 2 * BYTES_PER_XDR_UNIT + MAX_AUTH_BYTES;
+	return (size);
+}
+
 static inline void
 svc_override_ops(struct xp_ops *ops, SVCXPRT *rendezvous)
 {
@@ -183,6 +219,8 @@ static inline int svc_rqst_rearm_events(SVCXPRT *xprt, uint16_t ev_flags)
 	return code;
 }
 
+int svc_rqst_rearm_recv(SVCXPRT *, uint32_t);
+
 int svc_rqst_xprt_register(SVCXPRT *, SVCXPRT *);
 void svc_rqst_xprt_unregister(SVCXPRT *, uint32_t);
 
@@ -193,6 +231,8 @@ void svc_rqst_xprt_unregister_rdma(SVCXPRT *, uint32_t);
 int svc_rqst_evchan_write(SVCXPRT *, struct xdr_ioq *, bool);
 void svc_rqst_xprt_send_complete(SVCXPRT *);
 void svc_rqst_unhook(SVCXPRT *);
+bool svc_rqst_xprt_hold(SVCXPRT *, uint32_t *);
+void svc_rqst_xprt_unhold(SVCXPRT *, bool);
 
 typedef struct sockaddr_storage sockaddr_t;
 int svc_get_port(sockaddr_t *);
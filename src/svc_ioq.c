@@ -34,6 +34,11 @@
 #include <sys/un.h>
 #include <sys/time.h>
 #include <sys/uio.h>
+#ifdef HAVE_SENDFILE
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/sockios.h>
+#endif
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 
@@ -64,11 +69,96 @@
 #include <getpeereid.h>
 #include <misc/opr.h>
 #include "svc_ioq.h"
+#include "svc_loop.h"
 
 #define LAST_FRAG ((u_int32_t)(1 << 31))
 #define LAST_FRAG_XDR_UNITS ((LAST_FRAG - 1) & ~(BYTES_PER_XDR_UNIT - 1))
 #define MAXALLOCA (256)
 
+#ifndef MSG_MORE
+#define MSG_MORE 0
+#endif
+
+/* largest VIO_FILE chunk per call (see svc_ioq_sendfile) */
+#define SVC_IOQ_SENDFILE_MAX (64 * 1024)
+
+/*
+ * Send (the start of) a VIO_FILE segment.
+ *
+ * The socket stays blocking (svc_vc_recv relies on MSG_WAITALL), and
+ * sendfile() has no MSG_DONTWAIT, so check for room first and bound the
+ * chunk by the free space in the send buffer.  When the socket is full
+ * this fails with EWOULDBLOCK, as sendmsg would, and the write resumes
+ * from write_start.
+ */
+static inline ssize_t
+svc_ioq_sendfile(SVCXPRT *xprt, struct xdr_vio *v)
+{
+	struct xdr_vio_file *file = (struct xdr_vio_file *)v->vio_base;
+	off_t offset = file->offset
+		     + ((uintptr_t)v->vio_head - (uintptr_t)v->vio_base);
+	size_t len = MIN(v->vio_length, SVC_IOQ_SENDFILE_MAX);
+	struct pollfd pfd = {
+		.fd = xprt->xp_fd,
+		.events = POLLOUT,
+	};
+	ssize_t result;
+	int n;
+
+	n = poll(&pfd, 1, 0);
+	if (n < 0) {
+		if (errno == EINTR)
+			errno = EWOULDBLOCK;
+		return (-1);
+	}
+	if (!n || !(pfd.revents & POLLOUT)) {
+		/* error or hangup without room: fail the write */
+		errno = (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+			? EPIPE : EWOULDBLOCK;
+		return (-1);
+	}
+#ifdef HAVE_SENDFILE
+	{
+		socklen_t optlen = sizeof(int);
+		int sndbuf;
+		int outq;
+
+		/* the kernel doubles SO_SNDBUF to cover its overhead; only
+		 * half of it is payload
+		 */
+		if (!getsockopt(xprt->xp_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+				&optlen)
+		    && !ioctl(xprt->xp_fd, SIOCOUTQ, &outq)) {
+			sndbuf /= 2;
+			if (outq >= sndbuf) {
+				errno = EWOULDBLOCK;
+				return (-1);
+			}
+			len = MIN(len, (size_t)(sndbuf - outq));
+		}
+	}
+	result = sendfile(xprt->xp_fd, file->fd, &offset, len);
+#else
+	{
+		uint8_t buf[RPC_MAXDATA_DEFAULT];
+
+		result = pread(file->fd, buf, MIN(len, sizeof(buf)), offset);
+		if (result > 0)
+			result = send(xprt->xp_fd, buf, result, MSG_DONTWAIT);
+	}
+#endif
+	if (!result) {
+		/* file is shorter than the segment, the record is broken */
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d file fd %d short at %lld",
+			__func__, xprt, xprt->xp_fd, file->fd,
+			(long long) offset);
+		errno = EIO;
+		return (-1);
+	}
+	return (result);
+}
+
 /* Returns 0 on success, EWOULDBLOCK if would block, <0 on error */
 static inline int
 svc_ioq_flushv(SVCXPRT *xprt, struct xdr_ioq *xioq)
@@ -76,6 +166,7 @@ svc_ioq_flushv(SVCXPRT *xprt, struct xdr_ioq *xioq)
 	struct msghdr msg;
 	struct iovec *iov;
 	struct xdr_vio *vio;
+	struct xdr_vio *file;
 	ssize_t result;
 	u_int32_t frag_header;
 	u_int32_t fbytes;
@@ -150,12 +241,11 @@ svc_ioq_flushv(SVCXPRT *xprt, struct xdr_ioq *xioq)
 		 * don't walk more of the ioq than we need to. But that adds a
 		 * lot of complexity, and just saves walking a linked list.
 		 *
-		 * A more relevant improvement here might actually be to use
-		 * larger buffers than 8k. Optionally, when we do more to
-		 * implement zero copy, the largest responses which are
-		 * READ and READDIR will be adding a single buffer, or a small
-		 * number of buffers to the ioq instead of copying into the
-		 * 8k byte buffers.
+		 * Reply segments are sized by class from the reply hint (or
+		 * grow geometrically, see xdr_ioq_uv_append), so large READ
+		 * and READDIR replies span only a few buffers here.
+		 * File-backed data (VIO_FILE, xdr_uio_file_create) is a
+		 * single segment, sent without a user space copy.
 		 */
 		iov_count = XDR_IOVCOUNT(xioq->xdrs, xioq->write_start, fbytes);
 
@@ -201,6 +291,18 @@ svc_ioq_flushv(SVCXPRT *xprt, struct xdr_ioq *xioq)
 			iov_count = PRESUMED_UIO_MAXIOV - frag_needed;
 		}
 
+		/* Memory up to a file segment is sent by sendmsg (MSG_MORE,
+		 * the file data follows), then the file segment by itself.
+		 */
+		file = NULL;
+		for (i = 0; i < iov_count; i++) {
+			if (vio[i].vio_type == VIO_FILE) {
+				file = &vio[i];
+				iov_count = i;
+				break;
+			}
+		}
+
 		/* Convert the xdr_vio to an iovec */
 		for (i = 0; i < iov_count; i++) {
 			iov[i + frag_needed].iov_base = vio[i].vio_head;
@@ -223,7 +325,11 @@ again:
 
 		/* non-blocking write */
 		errno = 0;
-		result = sendmsg(xprt->xp_fd, &msg, MSG_DONTWAIT);
+		if (file && !iov_count && !frag_hdr_size)
+			result = svc_ioq_sendfile(xprt, file);
+		else
+			result = sendmsg(xprt->xp_fd, &msg,
+					 MSG_DONTWAIT | (file ? MSG_MORE : 0));
 		error = errno;
 
 		__warnx((error == EWOULDBLOCK || error == EAGAIN || error == 0)
@@ -342,7 +448,10 @@ void svc_ioq_write(SVCXPRT *xprt)
 		if (svc_work_pool.params.thrd_max
 		 && !(xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)) {
 			/* all systems are go! */
-			rc = svc_ioq_flushv(xprt, xioq);
+			if (xprt->xp_type == XPRT_LOOP)
+				rc = svc_loop_flush(xprt, xioq);
+			else
+				rc = svc_ioq_flushv(xprt, xioq);
 		}
 
 		mutex_lock(&rec->writeq.qmutex);
@@ -482,6 +591,8 @@ svc_ioq_write_submit(SVCXPRT *xprt, struct xdr_ioq *xioq)
 	if (was_empty) {
 		/* Schedule work to process output for this duplex record. */
 		xioq->ioq_wpe.fun = svc_ioq_write_callback;
+		xioq->ioq_wpe.prio = WORK_POOL_PRIO_HIGH;
+		xioq->ioq_wpe.flow = NULL;
 		work_pool_submit(&svc_work_pool, &xioq->ioq_wpe);
 	}
 }
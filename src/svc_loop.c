@@ -0,0 +1,591 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file svc_loop.c
+ * @brief In-process loopback transport
+ *
+ * @section DESCRIPTION
+ *
+ * svc_loop_ncreate() makes a connected pair of transports in this
+ * process; clnt_loop_ncreate() (clnt_loop.c) makes calls on the other
+ * end.  Unlike svc_raw, any number of pairs may be in use at once, and
+ * each carries any number of concurrent calls.
+ *
+ * Calls and replies are queued by svc_ioq_write() as for a socket, but
+ * svc_loop_flush() moves the encoded buffers to the other end instead of
+ * sending them, and submits that end's receive task: svc_request() on
+ * the work pool, as svc_rqst does for socket events.  There is no fd,
+ * no copy (except of file-backed segments), and no system call.
+ *
+ * Closing either end closes the pair, as a socket hangup would.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rpc/types.h>
+#include <misc/city.h>
+#include <misc/portable.h>
+#include <rpc/rpc.h>
+#include <rpc/svc.h>
+#include <rpc/svc_auth.h>
+#include <rpc/xdr_ioq.h>
+
+#include "rpc_com.h"
+#include "clnt_internal.h"
+#include "svc_internal.h"
+#include "svc_xprt.h"
+#include "rpc_dplx_internal.h"
+#include "svc_drc.h"
+#include "svc_ioq.h"
+#include "svc_loop.h"
+
+static void svc_loop_ops(SVCXPRT *);
+
+static inline struct svc_loop_xprt *
+svc_loop_peer(struct svc_loop_xprt *lp)
+{
+	struct svc_loop_pair *pair = lp->lp_pair;
+
+	return (&pair->lp_end[(lp == &pair->lp_end[SVC_LOOP_SVC])
+			      ? SVC_LOOP_CLNT : SVC_LOOP_SVC]);
+}
+
+static void
+svc_loop_end_init(struct svc_loop_pair *pair, int end)
+{
+	struct svc_loop_xprt *lp = &pair->lp_end[end];
+	struct rpc_dplx_rec *rec = &lp->lp_dr;
+	SVCXPRT *xprt = &rec->xprt;
+
+	/* Init SVCXPRT locks, etc */
+	rpc_dplx_rec_init(rec);
+	xdr_ioq_setup(&rec->ioq);
+	lp->lp_pair = pair;
+
+	xprt->xp_fd = RPC_ANYFD;
+	xprt->xp_fd_send = RPC_ANYFD;
+	__rpc_address_setup(&xprt->xp_local);
+	__rpc_address_setup(&xprt->xp_remote);
+
+	/* buffers are passed by reference; only the record size matters */
+	rec->sendsz =
+	rec->recvsz = __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT;
+	rec->pagesz = sysconf(_SC_PAGESIZE);
+	rec->maxrec = __svc_maxrec;
+
+	svc_loop_ops(xprt);
+	(void)atomic_postset_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_INITIALIZED
+					   | SVC_XPRT_FLAG_READY);
+	XPRT_TRACE(xprt, __func__, __func__, __LINE__);
+}
+
+/*
+ * Create a loopback pair; returns the server end.
+ *
+ * Set xp_dispatch.process_cb before making calls.  Returns with a
+ * reference for the caller: SVC_DESTROY() closes the pair (and any
+ * CLIENT on it), SVC_RELEASE() drops the reference.
+ */
+SVCXPRT *
+svc_loop_ncreate(void)
+{
+	struct svc_loop_pair *pair =
+		rpc_dplx_rec_zalloc(sizeof(struct svc_loop_pair));
+	SVCXPRT *xprt;
+
+	mutex_init(&pair->lp_lock, NULL);
+	pair->lp_refs = 2;
+	svc_loop_end_init(pair, SVC_LOOP_SVC);
+	svc_loop_end_init(pair, SVC_LOOP_CLNT);
+
+	/* ref+1 for the caller */
+	xprt = &pair->lp_end[SVC_LOOP_SVC].lp_dr.xprt;
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+
+#if defined(HAVE_BLKIN)
+	__rpc_set_blkin_endpoint(xprt, "svc_loop");
+#endif
+	return (xprt);
+}
+
+/*
+ * Take the client end of a pair, once; ref+1.
+ */
+SVCXPRT *
+svc_loop_claim(SVCXPRT *xprt)
+{
+	struct svc_loop_xprt *lp;
+	struct svc_loop_xprt *peer;
+	SVCXPRT *result = NULL;
+
+	if (xprt->xp_type != XPRT_LOOP)
+		return (NULL);
+
+	lp = LOOP_DR(REC_XPRT(xprt));
+	peer = svc_loop_peer(lp);
+
+	mutex_lock(&lp->lp_pair->lp_lock);
+	if (lp == &lp->lp_pair->lp_end[SVC_LOOP_SVC]
+	 && !lp->lp_closed && !peer->lp_closed && !peer->lp_claimed) {
+		peer->lp_claimed = true;
+		result = &peer->lp_dr.xprt;
+		SVC_REF(result, SVC_REF_FLAG_NONE);
+	}
+	mutex_unlock(&lp->lp_pair->lp_lock);
+
+	return (result);
+}
+
+static void
+svc_loop_recv_task(struct work_pool_entry *wpe)
+{
+	struct xdr_ioq *xioq = opr_containerof(wpe, struct xdr_ioq, ioq_wpe);
+	struct rpc_dplx_rec *rec = xioq->rec;
+
+	if (!(rec->xprt.xp_flags & SVC_XPRT_FLAG_DESTROYED)) {
+		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &rec->recv.ts);
+		(void)svc_request(&rec->xprt, xioq->xdrs);
+	} else {
+		XDR_DESTROY(xioq->xdrs);
+	}
+
+	/* Release the ref taken by svc_loop_flush() */
+	SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
+}
+
+/*
+ * A file-backed segment is read into memory; the receiver decodes it.
+ */
+static struct xdr_ioq_uv *
+svc_loop_file(struct xdr_ioq_uv *fuv)
+{
+	struct xdr_vio_file *file = (struct xdr_vio_file *)fuv->v.vio_base;
+	size_t len = ioquv_length(fuv);
+	off_t offset = file->offset
+		+ ((uintptr_t)fuv->v.vio_head - (uintptr_t)fuv->v.vio_base);
+	struct xdr_ioq_uv *uv = xdr_ioq_uv_create(len, UIO_FLAG_FREE);
+	ssize_t n;
+
+	while (len) {
+		n = pread(file->fd, uv->v.vio_tail, len, offset);
+		if (n <= 0) {
+			/* file is shorter than the segment */
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: file fd %d short at %lld (%d)",
+				__func__, file->fd, (long long) offset, errno);
+			xdr_ioq_uv_release(uv);
+			return (NULL);
+		}
+		uv->v.vio_tail += n;
+		offset += n;
+		len -= n;
+	}
+	return (uv);
+}
+
+/*
+ * Deliver a record to the other end (called by svc_ioq_write).
+ *
+ * The encoded buffers are moved to a new stream, leaving xioq empty
+ * for its XDR_DESTROY().  Returns 0 on success, <0 when the other end
+ * has gone (as a socket error).
+ */
+int
+svc_loop_flush(SVCXPRT *xprt, struct xdr_ioq *xioq)
+{
+	struct svc_loop_xprt *lp = LOOP_DR(REC_XPRT(xprt));
+	struct svc_loop_xprt *peer = svc_loop_peer(lp);
+	struct rpc_dplx_rec *rec = &peer->lp_dr;
+	struct xdr_ioq *rxioq;
+	struct xdr_ioq_uv *uv;
+	struct poolq_entry *have;
+	struct poolq_entry *next;
+
+	mutex_lock(&lp->lp_pair->lp_lock);
+	if (unlikely(peer->lp_closed)) {
+		mutex_unlock(&lp->lp_pair->lp_lock);
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: %p other end closed",
+			__func__, xprt);
+		return (-EPIPE);
+	}
+	/* for the receive task */
+	SVC_REF(&rec->xprt, SVC_REF_FLAG_NONE);
+	mutex_unlock(&lp->lp_pair->lp_lock);
+
+	/* update the most recent data length, just in case */
+	xdr_tail_update(xioq->xdrs);
+
+	rxioq = xdr_ioq_create(0, 0, UIO_FLAG_BUFQ);
+
+	TAILQ_FOREACH_SAFE(have, &xioq->ioq_uv.uvqh.qh, q, next) {
+		uv = IOQ_(have);
+		if (!ioquv_length(uv))
+			continue;
+
+		if (unlikely(uv->v.vio_type == VIO_FILE)) {
+			uv = svc_loop_file(uv);
+			if (!uv) {
+				XDR_DESTROY(rxioq->xdrs);
+				SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
+				return (-EIO);
+			}
+		} else {
+			TAILQ_REMOVE(&xioq->ioq_uv.uvqh.qh, have, q);
+			(xioq->ioq_uv.uvqh.qcount)--;
+		}
+		(rxioq->ioq_uv.uvqh.qcount)++;
+		TAILQ_INSERT_TAIL(&rxioq->ioq_uv.uvqh.qh, &uv->uvq, q);
+	}
+
+	if (unlikely(!rxioq->ioq_uv.uvqh.qcount)) {
+		/* nothing to send */
+		XDR_DESTROY(rxioq->xdrs);
+		SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
+		return (0);
+	}
+
+	/* positioned at the start of the record */
+	uv = IOQ_(TAILQ_FIRST(&rxioq->ioq_uv.uvqh.qh));
+	xdr_ioq_reset(rxioq, (uintptr_t)uv->v.vio_head
+			     - (uintptr_t)uv->v.vio_base);
+	rxioq->xdrs[0].x_op = XDR_DECODE;
+
+	/* as svc_rqst does for a socket receive event */
+	rxioq->rec = rec;
+	rxioq->ioq_wpe.fun = svc_loop_recv_task;
+	rxioq->ioq_wpe.prio = WORK_POOL_PRIO_NORMAL;
+	rxioq->ioq_wpe.flow = (__svc_params->flags & SVC_FLAG_FAIR_QUEUE)
+				? &rec->flow : NULL;
+	work_pool_submit(&svc_work_pool, &rxioq->ioq_wpe);
+	return (0);
+}
+
+static void
+svc_loop_destroy_task(struct work_pool_entry *wpe)
+{
+	struct rpc_dplx_rec *rec =
+			opr_containerof(wpe, struct rpc_dplx_rec, ioq.ioq_wpe);
+	struct svc_loop_pair *pair = LOOP_DR(rec)->lp_pair;
+
+	const int32_t xp_refcnt = atomic_fetch_int32_t(&rec->xprt.xp_refcnt);
+	__warnx(TIRPC_DEBUG_FLAG_REFCNT,
+		"%s() %p xp_refcnt %" PRId32,
+		__func__, rec, xp_refcnt);
+
+	if (xp_refcnt > 0) {
+		/* instead of nanosleep */
+		work_pool_submit(&svc_work_pool, &(rec->ioq.ioq_wpe));
+		return;
+	} else if (unlikely(xp_refcnt < 0)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s() negative refcnt: %p xp_refcnt %" PRId32,
+			__func__, rec, xp_refcnt);
+		abort();
+	}
+
+	if (rec->xprt.xp_ops->xp_free_user_data)
+		rec->xprt.xp_ops->xp_free_user_data(&rec->xprt);
+
+	if (rec->xprt.xp_tp)
+		mem_free(rec->xprt.xp_tp, 0);
+	if (rec->xprt.xp_netid)
+		mem_free(rec->xprt.xp_netid, 0);
+
+	if (rec->xprt.xp_parent)
+		SVC_RELEASE(rec->xprt.xp_parent, SVC_RELEASE_FLAG_NONE);
+
+	XDR_DESTROY(rec->ioq.xdrs);
+	rpc_dplx_rec_destroy(rec);
+
+	/* the pair is freed with its second end */
+	if (atomic_dec_int32_t(&pair->lp_refs))
+		return;
+	mutex_destroy(&pair->lp_lock);
+	mem_free(pair, sizeof(struct svc_loop_pair));
+}
+
+/*
+ * Closing one end closes the other, as a socket hangup.
+ */
+static void
+svc_loop_unlink_it(SVCXPRT *xprt, u_int flags, const char *tag, const int line)
+{
+	struct svc_loop_xprt *lp = LOOP_DR(REC_XPRT(xprt));
+	struct svc_loop_xprt *peer = svc_loop_peer(lp);
+	bool hangup;
+
+	svc_rqst_xprt_unregister(xprt, flags);
+
+	mutex_lock(&lp->lp_pair->lp_lock);
+	lp->lp_closed = true;
+	hangup = !peer->lp_closed;
+	if (hangup)
+		SVC_REF(&peer->lp_dr.xprt, SVC_REF_FLAG_NONE);
+	mutex_unlock(&lp->lp_pair->lp_lock);
+
+	if (hangup) {
+		SVC_DESTROY(&peer->lp_dr.xprt);
+		SVC_RELEASE(&peer->lp_dr.xprt, SVC_RELEASE_FLAG_NONE);
+	}
+}
+
+static void
+svc_loop_destroy_it(SVCXPRT *xprt, u_int flags, const char *tag,
+		    const int line)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct timespec ts = {
+		.tv_sec = 0,
+		.tv_nsec = 0,
+	};
+
+	__warnx(TIRPC_DEBUG_FLAG_REFCNT,
+		"%s() %p xp_refcnt %" PRId32 " @%s:%d",
+		__func__, xprt, xprt->xp_refcnt, tag, line);
+
+	while (atomic_postset_uint16_t_bits(&(rec->ioq.ioq_s.qflags),
+					    IOQ_FLAG_WORKING)
+	       & IOQ_FLAG_WORKING) {
+		nanosleep(&ts, NULL);
+	}
+
+	rec->ioq.ioq_wpe.fun = svc_loop_destroy_task;
+	rec->ioq.ioq_wpe.prio = WORK_POOL_PRIO_LOW;
+	rec->ioq.ioq_wpe.flow = NULL;
+	work_pool_submit(&svc_work_pool, &(rec->ioq.ioq_wpe));
+}
+
+extern mutex_t ops_lock;
+
+ /*ARGSUSED*/
+static bool
+svc_loop_control(SVCXPRT *xprt, const u_int rq, void *in)
+{
+	switch (rq) {
+	case SVCGET_XP_FLAGS:
+		*(u_int *) in = xprt->xp_flags;
+		break;
+	case SVCSET_XP_FLAGS:
+		xprt->xp_flags = *(u_int *) in;
+		break;
+	case SVCGET_XP_UNREF_USER_DATA:
+		mutex_lock(&ops_lock);
+		*(svc_xprt_void_fun_t *) in = xprt->xp_ops->xp_unref_user_data;
+		mutex_unlock(&ops_lock);
+		break;
+	case SVCSET_XP_UNREF_USER_DATA:
+		mutex_lock(&ops_lock);
+		xprt->xp_ops->xp_unref_user_data = *(svc_xprt_void_fun_t) in;
+		mutex_unlock(&ops_lock);
+		break;
+	case SVCGET_XP_FREE_USER_DATA:
+		mutex_lock(&ops_lock);
+		*(svc_xprt_fun_t *) in = xprt->xp_ops->xp_free_user_data;
+		mutex_unlock(&ops_lock);
+		break;
+	case SVCSET_XP_FREE_USER_DATA:
+		mutex_lock(&ops_lock);
+		xprt->xp_ops->xp_free_user_data = *(svc_xprt_fun_t) in;
+		mutex_unlock(&ops_lock);
+		break;
+	default:
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+static enum xprt_stat
+svc_loop_stat(SVCXPRT *xprt)
+{
+	if (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		return (XPRT_DESTROYED);
+
+	return (XPRT_IDLE);
+}
+
+/*
+ * Records are delivered by svc_loop_flush(); there is nothing to poll.
+ */
+static enum xprt_stat
+svc_loop_recv(SVCXPRT *xprt)
+{
+	return SVC_STAT(xprt);
+}
+
+/*
+ * Resend a reply retained by the duplicate request cache.
+ */
+static void
+svc_loop_resend(SVCXPRT *xprt, xdr_uio *reply)
+{
+	struct xdr_ioq *xioq = xdr_ioq_create_refer(reply);
+
+	/* the segments hold their own references */
+	reply->uio_release(reply, UIO_FLAG_NONE);
+
+	xioq->xdrs[0].x_lib[1] = (void *)xprt;
+	svc_ioq_write_now(xprt, xioq);
+}
+
+static enum xprt_stat
+svc_loop_decode(struct svc_req *req)
+{
+	XDR *xdrs = req->rq_xdrs;
+	SVCXPRT *xprt = req->rq_xprt;
+	xdr_uio *reply;
+
+	xdrs->x_op = XDR_DECODE;
+	rpc_msg_init(&req->rq_msg);
+
+	if (!xdr_dplx_decode(xdrs, &req->rq_msg)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p failed (will set dead)",
+			__func__, xprt);
+		SVC_DESTROY(xprt);
+		return SVC_STAT(xprt);
+	}
+
+	/* in order of likelihood */
+	if (req->rq_msg.rm_direction == CALL) {
+		switch (svc_drc_lookup(req, &reply)) {
+		case SVC_DRC_NEW:
+			/* an ordinary call header */
+			return xprt->xp_dispatch.process_cb(req);
+		case SVC_DRC_HIT:
+			svc_loop_resend(xprt, reply);
+			break;
+		case SVC_DRC_BUSY:
+			break;
+		}
+		return SVC_STAT(xprt);
+	}
+
+	if (req->rq_msg.rm_direction == REPLY) {
+		/* reply header (xprt OK) */
+		return clnt_req_process_reply(xprt, req);
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_WARN,
+		"%s: %p failed direction %" PRIu32
+		" (will set dead)",
+		__func__, xprt, req->rq_msg.rm_direction);
+	SVC_DESTROY(xprt);
+	return SVC_STAT(xprt);
+}
+
+static void
+svc_loop_checksum(struct svc_req *req, void *data, size_t length)
+{
+	req->rq_cksum = CityHash64WithSeed(data, MIN(256, length), 103);
+}
+
+static enum xprt_stat
+svc_loop_reply(struct svc_req *req)
+{
+	SVCXPRT *xprt = req->rq_xprt;
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct xdr_ioq *xioq;
+	size_t max_bsize = __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT;
+	size_t hint = req->rq_reply_hint;
+	size_t bsize;
+	u_int len;
+
+	/* sized as svc_vc_reply() */
+	if (!hint && (__svc_params->flags & SVC_FLAG_XDR_SIZEOF))
+		hint = svc_reply_sizeof(req);
+	if (!hint)
+		hint = rec->reply_avg;
+	bsize = xdr_ioq_size_class(hint ? hint : RPC_MAXDATA_DEFAULT);
+	xioq = xdr_ioq_create(MIN(bsize, max_bsize), max_bsize, UIO_FLAG_FREE);
+	xioq->ioq_uv.hint = hint;
+
+	if (!xdr_reply_encode(xioq->xdrs, &req->rq_msg)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p xdr_reply_encode failed (will set dead)",
+			__func__, xprt);
+		XDR_DESTROY(xioq->xdrs);
+		return (XPRT_DIED);
+	}
+	xdr_tail_update(xioq->xdrs);
+
+	if (req->rq_msg.rm_reply.rp_stat == MSG_ACCEPTED
+	 && req->rq_msg.rm_reply.rp_acpt.ar_stat == SUCCESS
+	 && req->rq_auth
+	 && !SVCAUTH_WRAP(req, xioq->xdrs)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p SVCAUTH_WRAP failed (will set dead)",
+			__func__, xprt);
+		XDR_DESTROY(xioq->xdrs);
+		return (XPRT_DIED);
+	}
+	xdr_tail_update(xioq->xdrs);
+
+	/* racy, but only a hint (1/8 weight) */
+	len = XDR_GETPOS(xioq->xdrs);
+	rec->reply_avg = rec->reply_avg - (rec->reply_avg >> 3) + (len >> 3);
+
+	if (req->rq_drc)
+		svc_drc_retain(req, xdr_ioq_hold(xioq));
+
+	xioq->xdrs[0].x_lib[1] = (void *)xprt;
+	svc_ioq_write_now(xprt, xioq);
+	return (XPRT_IDLE);
+}
+
+static void
+svc_loop_ops(SVCXPRT *xprt)
+{
+	static struct xp_ops ops;
+
+	/* VARIABLES PROTECTED BY ops_lock: ops, xp_type */
+	mutex_lock(&ops_lock);
+
+	xprt->xp_type = XPRT_LOOP;
+
+	if (ops.xp_recv == NULL) {
+		ops.xp_recv = svc_loop_recv;
+		ops.xp_stat = svc_loop_stat;
+		ops.xp_decode = svc_loop_decode;
+		ops.xp_reply = svc_loop_reply;
+		ops.xp_checksum = svc_loop_checksum;
+		ops.xp_unlink = svc_loop_unlink_it;
+		ops.xp_unref_user_data = NULL;	/* no default */
+		ops.xp_destroy = svc_loop_destroy_it;
+		ops.xp_control = svc_loop_control;
+		ops.xp_free_user_data = NULL;	/* no default */
+	}
+	xprt->xp_ops = &ops;
+	mutex_unlock(&ops_lock);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SVC_LOOP_H
+#define SVC_LOOP_H
+
+#include <rpc/svc.h>
+#include <rpc/xdr_ioq.h>
+#include "rpc_dplx_internal.h"
+
+struct svc_loop_pair;
+
+/**
+ * \struct svc_loop_xprt
+ * In-process loopback transport instance
+ *
+ * Wraps struct rpc_dplx_rec; one of the two ends of a svc_loop_pair.
+ * There is no fd (xp_fd is RPC_ANYFD).
+ */
+struct svc_loop_xprt {
+	struct rpc_dplx_rec lp_dr;	/* SVCXPRT */
+	struct svc_loop_pair *lp_pair;
+	bool lp_closed;			/* protected by lp_pair->lp_lock */
+	bool lp_claimed;		/* end has been given to a CLIENT */
+};
+#define LOOP_DR(p) (opr_containerof((p), struct svc_loop_xprt, lp_dr))
+
+struct svc_loop_pair {
+	mutex_t lp_lock;
+	int32_t lp_refs;		/* ends not yet freed */
+	struct svc_loop_xprt lp_end[2];
+};
+
+/* ends of a pair */
+#define SVC_LOOP_SVC		0
+#define SVC_LOOP_CLNT		1
+
+SVCXPRT *svc_loop_claim(SVCXPRT *);
+int svc_loop_flush(SVCXPRT *, struct xdr_ioq *);
+
+#endif				/* SVC_LOOP_H */
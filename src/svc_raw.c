@@ -72,7 +72,8 @@ svc_raw_xprt_free(struct rpc_raw_xprt *srp)
 static struct rpc_raw_xprt *
 svc_raw_xprt_zalloc(size_t sz)
 {
-	struct rpc_raw_xprt *srp = mem_zalloc(sizeof(struct rpc_raw_xprt) + sz);
+	struct rpc_raw_xprt *srp = rpc_dplx_rec_zalloc(sizeof(struct rpc_raw_xprt)
+						       + sz);
 
 	/* Init SVCXPRT locks, etc */
 	rpc_dplx_rec_init(&srp->raw_dr);
@@ -50,6 +50,7 @@
 #include "svc_xprt.h"
 #include <rpc/svc_auth.h>
 #include "svc_ioq.h"
+#include "svc_drc.h"
 
 #ifdef USE_RPC_RDMA
 #include "rpc_rdma.h"
@@ -109,6 +110,9 @@ struct svc_rqst_rec {
 	int32_t ev_refcnt;
 	uint16_t ev_flags;
 	struct xdr_ioq *xioq; /* IOQ for floating sr_rec */
+
+	/* updated only by the (single) running event loop */
+	struct svc_rqst_evchan_stats stats;
 };
 
 void svc_rqst_rec_init(struct svc_rqst_rec *sr_rec)
@@ -489,11 +493,13 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 
 	sr_rec->id_k = n_id;
 	sr_rec->ev_flags = flags & SVC_RQST_FLAG_MASK;
+	memset(&sr_rec->stats, 0, sizeof(sr_rec->stats));
 	opr_rbtree_init(&sr_rec->call_expires, svc_rqst_expire_cmpf);
 	atomic_inc_int32_t(&sr_rec->ev_refcnt);
 	ref_rec++;
 	sr_rec->ev_wpe.fun = fun;
 	sr_rec->ev_wpe.arg = u_data;
+	sr_rec->ev_wpe.prio = WORK_POOL_PRIO_HIGH;
 	work_pool_submit(&svc_work_pool, &sr_rec->ev_wpe);
 
 	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
@@ -585,7 +591,7 @@ svc_rqst_unhook_events(struct rpc_dplx_rec *rec, struct svc_rqst_rec *sr_rec,
 		}
 
 		if (ev_flags & SVC_XPRT_FLAG_ADDED_SEND) {
-			ev = &rec->ev_u.epoll.event_send;
+			ev = &rec->ev_w.epoll.event_send;
 
 			/* clear epoll vector */
 			code = epoll_ctl(sr_rec->ev_u.epoll.epoll_fd,
@@ -667,6 +673,16 @@ svc_rqst_rearm_events_locked(SVCXPRT *xprt, uint16_t ev_flags)
 	if (is_xprt_destroyed || is_rec_shutdown)
 		return (0);
 
+	if (unlikely(xprt->xp_flags & SVC_XPRT_FLAG_HANDOFF)
+	    && (ev_flags & SVC_XPRT_FLAG_ADDED_RECV)) {
+		/* park for svc_rqst_xprt_hold(), disarmed in the channel */
+		atomic_set_uint16_t_bits(&xprt->xp_flags,
+					 SVC_XPRT_FLAG_ADDED_RECV);
+		ev_flags &= ~SVC_XPRT_FLAG_ADDED_RECV;
+		if (!ev_flags)
+			return (0);
+	}
+
 	/* Don't take a ref on the xprt.  We take a ref in hook, and release it
 	 * in unhook. */
 
@@ -718,7 +734,7 @@ svc_rqst_rearm_events_locked(SVCXPRT *xprt, uint16_t ev_flags)
 		}
 
 		if (ev_flags & SVC_XPRT_FLAG_ADDED_SEND) {
-			ev = &rec->ev_u.epoll.event_send;
+			ev = &rec->ev_w.epoll.event_send;
 
 			/* wait for write events, edge triggered, oneshot */
 			ev->events = EPOLLONESHOT | EPOLLOUT | EPOLLET;
@@ -768,6 +784,35 @@ svc_rqst_rearm_events_locked(SVCXPRT *xprt, uint16_t ev_flags)
 	return (code);
 }
 
+#if defined(TIRPC_EPOLL)
+/*
+ * Let the driver poll the device queue on behalf of a busy polling
+ * channel.  Not fatal, raising SO_BUSY_POLL above net.core.busy_read
+ * needs CAP_NET_ADMIN.
+ */
+static inline void
+svc_rqst_busy_poll_sock(struct rpc_dplx_rec *rec)
+{
+#if defined(SO_BUSY_POLL)
+	int us = __svc_params->busy_poll_sock_us;
+
+	if (!us)
+		return;
+
+	if (setsockopt(rec->xprt.xp_fd, SOL_SOCKET, SO_BUSY_POLL,
+		       &us, sizeof(us)))
+		__warnx(TIRPC_DEBUG_FLAG_WARN,
+			"%s: %p fd %d SO_BUSY_POLL failed (%d)",
+			__func__, &rec->xprt, rec->xprt.xp_fd, errno);
+#if defined(SO_PREFER_BUSY_POLL)
+	us = 1;
+	(void)setsockopt(rec->xprt.xp_fd, SOL_SOCKET, SO_PREFER_BUSY_POLL,
+			 &us, sizeof(us));
+#endif
+#endif
+}
+#endif
+
 /*
  * RPC_DPLX_LOCKED, and SVC_XPRT_FLAG_ADDED set
  */
@@ -817,6 +862,9 @@ svc_rqst_hook_events(struct rpc_dplx_rec *rec, struct svc_rqst_rec *sr_rec,
 			/* wait for read events, level triggered, oneshot */
 			ev->events = EPOLLONESHOT | EPOLLIN;
 
+			if (sr_rec->ev_flags & SVC_RQST_FLAG_BUSY_POLL)
+				svc_rqst_busy_poll_sock(rec);
+
 			/* add to epoll vector */
 			code = epoll_ctl(sr_rec->ev_u.epoll.epoll_fd,
 					 EPOLL_CTL_ADD, rec->xprt.xp_fd, ev);
@@ -849,7 +897,7 @@ svc_rqst_hook_events(struct rpc_dplx_rec *rec, struct svc_rqst_rec *sr_rec,
 		}
 
 		if (ev_flags & SVC_XPRT_FLAG_ADDED_SEND) {
-			ev = &rec->ev_u.epoll.event_send;
+			ev = &rec->ev_w.epoll.event_send;
 
 			/* set up epoll user data.  Lookup needs the primary FD */
 			ev->data.fd = rec->xprt.xp_fd;
@@ -975,7 +1023,7 @@ svc_rqst_evchan_write(SVCXPRT *xprt, struct xdr_ioq *xioq, bool has_blocked)
 		return (ENOENT);
 	}
 
-	rec->ev_u.epoll.xioq_send = xioq;
+	rec->ev_w.epoll.xioq_send = xioq;
 
 #if defined(TIRPC_EPOLL)
 	if (sr_rec->ev_type == SVC_EVENT_EPOLL) {
@@ -1080,8 +1128,11 @@ svc_rqst_evchan_reg(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags)
 	/* link from xprt */
 	rec->ev_p = sr_rec;
 
-	/* register sr_rec on event channel */
-	code = svc_rqst_hook_events(rec, sr_rec, bits);
+	/* register sr_rec on event channel; without an fd (svc_loop), the
+	 * channel only runs CLNT_CALL_BACK() expiry
+	 */
+	code = (xprt->xp_fd == RPC_ANYFD)
+		? 0 : svc_rqst_hook_events(rec, sr_rec, bits);
 
 	if (!(flags & RPC_DPLX_LOCKED))
 		rpc_dplx_rui(rec);
@@ -1207,21 +1258,171 @@ svc_rqst_xprt_task_recv(struct work_pool_entry *wpe)
 		 * xp_refcnt need more than 1 (this task).
 		 */
 		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &rec->recv.ts);
+		atomic_clear_uint16_t_bits(&rec->xprt.xp_flags,
+					   SVC_XPRT_FLAG_DORMANT);
 		(void)SVC_RECV(&rec->xprt);
 	}
+	atomic_dec_uint32_t(&rec->ev_count);
 
 	/* Release the ref taken on the event */
 	SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
 }
 
+/*
+ * In-flight quotas.  Transports over quota are not rearmed for receive,
+ * leaving further requests in the kernel socket buffers (and the TCP
+ * window closing) until a request completes.
+ *
+ * Each datagram is its own xprt, so only the global limits apply to
+ * datagram transports, parking the shared socket.
+ */
+struct svc_rqst_throttle {
+	mutex_t mtx;
+	TAILQ_HEAD(svc_rqst_throttle_head, rpc_dplx_rec) qh;
+	uint32_t waiting;	/* atomic count of qh entries (approximate) */
+	uint32_t inflight;	/* atomic count of requests in all xprts */
+};
+
+static struct svc_rqst_throttle svc_rqst_throttle = {
+	MUTEX_INITIALIZER,
+	TAILQ_HEAD_INITIALIZER(svc_rqst_throttle.qh),
+	0,
+	0,
+};
+
+/*
+ * Each limit is only applied when some request is (or will be) in flight,
+ * so that its completion is guaranteed to resume the waiting xprt.
+ */
+static inline bool
+svc_rqst_over_quota(struct rpc_dplx_rec *rec, uint32_t pending)
+{
+	uint32_t inflight = atomic_fetch_uint32_t(&svc_rqst_throttle.inflight)
+			  + pending;
+
+	if (__svc_params->max_inflight_xprt
+	    && atomic_fetch_uint32_t(&rec->inflight) + pending
+	       >= __svc_params->max_inflight_xprt)
+		return (true);
+
+	if (!inflight)
+		return (false);
+
+	if (__svc_params->max_inflight
+	    && inflight >= __svc_params->max_inflight)
+		return (true);
+
+	if (__svc_params->max_queue_depth
+	    && atomic_fetch_uint32_t(&svc_work_pool.n_queued)
+	       >= __svc_params->max_queue_depth)
+		return (true);
+
+	return (false);
+}
+
+/*
+ * Rearm receive events, unless over quota.  pending is the number of
+ * requests already received by the caller, but not yet dispatched.
+ *
+ * rpc_dplx_rec lock must NOT be held
+ */
+int
+svc_rqst_rearm_recv(SVCXPRT *xprt, uint32_t pending)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+
+	if (!__svc_params->max_inflight_xprt
+	    && !__svc_params->max_inflight
+	    && !__svc_params->max_queue_depth)
+		return (svc_rqst_rearm_events(xprt, SVC_XPRT_FLAG_ADDED_RECV));
+
+	/* raise waiting before testing, so a completing request cannot
+	 * miss this xprt between the test and the insert
+	 */
+	atomic_inc_uint32_t(&svc_rqst_throttle.waiting);
+	mutex_lock(&svc_rqst_throttle.mtx);
+	if (svc_rqst_over_quota(rec, pending)) {
+		SVC_REF(xprt, SVC_REF_FLAG_NONE);
+		TAILQ_INSERT_TAIL(&svc_rqst_throttle.qh, rec, throttle_q);
+		mutex_unlock(&svc_rqst_throttle.mtx);
+
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: %p fd %d throttled (inflight %" PRIu32
+			" total %" PRIu32 " queued %" PRIu32 ")",
+			__func__, xprt, xprt->xp_fd, rec->inflight,
+			svc_rqst_throttle.inflight, svc_work_pool.n_queued);
+		return (0);
+	}
+	mutex_unlock(&svc_rqst_throttle.mtx);
+	atomic_dec_uint32_t(&svc_rqst_throttle.waiting);
+
+	return (svc_rqst_rearm_events(xprt, SVC_XPRT_FLAG_ADDED_RECV));
+}
+
+static inline void
+svc_rqst_request_start(struct rpc_dplx_rec *rec)
+{
+	atomic_inc_uint32_t(&rec->inflight);
+	atomic_inc_uint32_t(&svc_rqst_throttle.inflight);
+}
+
+/*
+ * Called before free_cb, while the request still holds its xprt.
+ */
+static void
+svc_rqst_request_done(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct rpc_dplx_rec *wait, *next;
+	TAILQ_HEAD(, rpc_dplx_rec) resume = TAILQ_HEAD_INITIALIZER(resume);
+
+	atomic_dec_uint32_t(&rec->inflight);
+	atomic_dec_uint32_t(&svc_rqst_throttle.inflight);
+
+	if (likely(!atomic_fetch_uint32_t(&svc_rqst_throttle.waiting)))
+		return;
+
+	mutex_lock(&svc_rqst_throttle.mtx);
+	TAILQ_FOREACH_SAFE(wait, &svc_rqst_throttle.qh, throttle_q, next) {
+		if (!(wait->xprt.xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		    && svc_rqst_over_quota(wait, 0))
+			continue;
+		TAILQ_REMOVE(&svc_rqst_throttle.qh, wait, throttle_q);
+		TAILQ_INSERT_TAIL(&resume, wait, throttle_q);
+		atomic_dec_uint32_t(&svc_rqst_throttle.waiting);
+	}
+	mutex_unlock(&svc_rqst_throttle.mtx);
+
+	/* rearm outside the throttle lock, it takes the recv lock */
+	TAILQ_FOREACH_SAFE(wait, &resume, throttle_q, next) {
+		if (unlikely(svc_rqst_rearm_events(&wait->xprt,
+						   SVC_XPRT_FLAG_ADDED_RECV))) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+				__func__, &wait->xprt, wait->xprt.xp_fd);
+			SVC_DESTROY(&wait->xprt);
+		}
+		SVC_RELEASE(&wait->xprt, SVC_RELEASE_FLAG_NONE);
+	}
+}
+
 enum xprt_stat svc_request(SVCXPRT *xprt, XDR *xdrs)
 {
 	enum xprt_stat stat;
 	struct svc_req *req = __svc_params->alloc_cb(xprt, xdrs);
 	struct rpc_dplx_rec *rpc_dplx_rec = REC_XPRT(xprt);
 
+	svc_rqst_request_start(rpc_dplx_rec);
+
 	/* Track the request we are processing */
 	rpc_dplx_rec->svc_req = req;
+	req->rq_drc = NULL;
+	req->rq_reply_hint = 0;
+
+	if (__svc_params->xdr_arena_size) {
+		xdr_arena_init(&req->rq_arena, __svc_params->xdr_arena_size);
+		xdr_arena_attach(req->rq_xdrs, &req->rq_arena);
+	}
 
 	/* All decode functions basically do a
 	 * return xprt->xp_dispatch.process_cb(req);
@@ -1241,6 +1442,8 @@ enum xprt_stat svc_request(SVCXPRT *xprt, XDR *xdrs)
 
 	XDR_DESTROY(req->rq_xdrs);
 
+	svc_drc_done(req);
+	svc_rqst_request_done(req->rq_xprt);
 	__svc_params->free_cb(req, stat);
 
 	return stat;
@@ -1268,12 +1471,16 @@ static void svc_resume_task(struct work_pool_entry *wpe)
 
 	XDR_DESTROY(req->rq_xdrs);
 
+	svc_drc_done(req);
+	svc_rqst_request_done(req->rq_xprt);
 	__svc_params->free_cb(req, stat);
 }
 
 void svc_resume(struct svc_req *req)
 {
 	req->rq_wpe.fun = svc_resume_task;
+	req->rq_wpe.prio = WORK_POOL_PRIO_HIGH;
+	req->rq_wpe.flow = NULL;
 	work_pool_submit(&svc_work_pool, &req->rq_wpe);
 }
 
@@ -1301,6 +1508,150 @@ svc_rqst_xprt_task_send(struct work_pool_entry *wpe)
 	SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
 }
 
+/*
+ * Trim an idle xprt stalled within a record.
+ *
+ * Claiming the armed receive event excludes any receive task, as an
+ * event firing meanwhile finds SVC_XPRT_FLAG_ADDED_RECV already clear.
+ * The transport cuts the receive buffer of the stalled record
+ * (SVCSET_XP_DORMANT), and regrows it on its next receive.  An xprt idle
+ * between records has nothing to trim.  SVC_XPRT_FLAG_DORMANT is set
+ * either way, so it is not looked at again until it receives.  The dup
+ * of xp_fd for blocked writes is closed when no write is waiting.
+ * Returns true when the transport released memory.
+ */
+static bool
+svc_rqst_xprt_trim(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_rqst_rec *sr_rec = rec->ev_p;
+	uint16_t xp_flags;
+	bool trimmed;
+	int code;
+
+	if (!sr_rec)
+		return (false);
+
+	rpc_dplx_rli(rec);
+	xp_flags = atomic_postclear_uint16_t_bits(&xprt->xp_flags,
+						  SVC_XPRT_FLAG_ADDED_RECV);
+	if (!(xp_flags & SVC_XPRT_FLAG_ADDED_RECV)) {
+		/* receiving, or over quota */
+		rpc_dplx_rui(rec);
+		return (false);
+	}
+
+	trimmed = SVC_CONTROL(xprt, SVCSET_XP_DORMANT, NULL);
+	atomic_set_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_DORMANT);
+
+	/* any data arriving meanwhile is signalled by the rearm */
+	code = svc_rqst_rearm_events_locked(xprt, SVC_XPRT_FLAG_ADDED_RECV);
+	rpc_dplx_rui(rec);
+
+	if (unlikely(code)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		SVC_DESTROY(xprt);
+		return (false);
+	}
+
+	mutex_lock(&rec->writeq.qmutex);
+	if (xprt->xp_fd_send != RPC_ANYFD && TAILQ_EMPTY(&rec->writeq.qh)) {
+		/* normally closed by svc_rqst_xprt_send_complete() */
+		(void)svc_rqst_unhook_events(rec, sr_rec,
+					     SVC_XPRT_FLAG_ADDED_SEND);
+		if (xprt->xp_fd_send != RPC_ANYFD) {
+			close(xprt->xp_fd_send);
+			xprt->xp_fd_send = RPC_ANYFD;
+		}
+	}
+	mutex_unlock(&rec->writeq.qmutex);
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+		"%s: %p fd %d dormant%s",
+		__func__, xprt, xprt->xp_fd, trimmed ? ", trimmed" : "");
+	return (trimmed);
+}
+
+/*
+ * Stop receiving on a transport for svc_xprt_handoff_send(), once
+ * SVC_XPRT_FLAG_HANDOFF is set.  As for events, whoever clears
+ * SVC_XPRT_FLAG_ADDED_RECV owns it:  here the transport is removed from
+ * its channel.  Otherwise a receive is running, or over quota, and will
+ * park the transport instead of rearming it.  Returns true when removed,
+ * with the channel id.
+ */
+bool
+svc_rqst_xprt_hold(SVCXPRT *xprt, uint32_t *chan_id)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_rqst_rec *sr_rec;
+	uint16_t xp_flags;
+
+	rpc_dplx_rli(rec);
+	sr_rec = rec->ev_p;
+	if (!sr_rec) {
+		/* unregistered, destroying */
+		rpc_dplx_rui(rec);
+		return (false);
+	}
+
+	xp_flags = atomic_postclear_uint16_t_bits(&xprt->xp_flags,
+						  SVC_XPRT_FLAG_ADDED_RECV);
+	if (!(xp_flags & SVC_XPRT_FLAG_ADDED_RECV)) {
+		rpc_dplx_rui(rec);
+		return (false);
+	}
+
+	(void)svc_rqst_unhook_events(rec, sr_rec, SVC_XPRT_FLAG_ADDED_RECV);
+	*chan_id = sr_rec->id_k;
+	rpc_dplx_rui(rec);
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+		"%s: %p fd %d held evchan %" PRIu32,
+		__func__, xprt, xprt->xp_fd, *chan_id);
+	return (true);
+}
+
+/*
+ * Resume receiving on a transport that svc_xprt_handoff_send() kept.
+ */
+void
+svc_rqst_xprt_unhold(SVCXPRT *xprt, bool held)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	uint16_t xp_flags;
+	int code = 0;
+
+	rpc_dplx_rli(rec);
+	xp_flags = atomic_postclear_uint16_t_bits(&xprt->xp_flags,
+						  SVC_XPRT_FLAG_HANDOFF);
+	if (!rec->ev_p || (xp_flags & SVC_XPRT_FLAG_DESTROYED)) {
+		rpc_dplx_rui(rec);
+		return;
+	}
+
+	if (held) {
+		code = svc_rqst_hook_events(rec, rec->ev_p,
+					    SVC_XPRT_FLAG_ADDED_RECV);
+	} else if (atomic_postclear_uint16_t_bits(&xprt->xp_flags,
+						  SVC_XPRT_FLAG_ADDED_RECV)
+		   & SVC_XPRT_FLAG_ADDED_RECV) {
+		/* parked, or armed (again is harmless) */
+		code = svc_rqst_rearm_events_locked(xprt,
+						    SVC_XPRT_FLAG_ADDED_RECV);
+	}
+	rpc_dplx_rui(rec);
+
+	if (unlikely(code)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		SVC_DESTROY(xprt);
+	}
+}
+
 /*
  * Like __svc_clean_idle but event-type independent.  For now no cleanfds.
  */
@@ -1308,13 +1659,16 @@ svc_rqst_xprt_task_send(struct work_pool_entry *wpe)
 struct svc_rqst_clean_arg {
 	struct timespec ts;
 	int timeout;
+	int trim_timeout;
 	int cleaned;
+	int trimmed;
 };
 
 static bool
 svc_rqst_clean_func(SVCXPRT *xprt, void *arg)
 {
 	struct svc_rqst_clean_arg *acc = (struct svc_rqst_clean_arg *)arg;
+	time_t idle;
 
 	if (xprt->xp_ops == NULL)
 		return (false);
@@ -1323,13 +1677,23 @@ svc_rqst_clean_func(SVCXPRT *xprt, void *arg)
 		return (false);
 
 	/* Make sure recv.ts is initialized */
-	if (REC_XPRT(xprt)->recv.ts.tv_sec &&
-	    ((acc->ts.tv_sec - REC_XPRT(xprt)->recv.ts.tv_sec) < acc->timeout))
-		return (false);
+	if (!REC_XPRT(xprt)->recv.ts.tv_sec)
+		idle = acc->timeout;
+	else
+		idle = acc->ts.tv_sec - REC_XPRT(xprt)->recv.ts.tv_sec;
+
+	if (acc->timeout > 0 && idle >= acc->timeout) {
+		SVC_DESTROY(xprt);
+		acc->cleaned++;
+		return (true);
+	}
 
-	SVC_DESTROY(xprt);
-	acc->cleaned++;
-	return (true);
+	if (acc->trim_timeout > 0 && idle >= acc->trim_timeout
+	    && !(xprt->xp_flags & SVC_XPRT_FLAG_DORMANT)
+	    && svc_rqst_xprt_trim(xprt))
+		acc->trimmed++;
+
+	return (false);
 }
 
 void authgss_ctx_gc_idle(void);
@@ -1354,22 +1718,49 @@ svc_rqst_clean_idle(int timeout)
 	authgss_ctx_gc_idle();
 #endif /* _HAVE_GSSAPI */
 
-	if (timeout <= 0)
+	if (timeout <= 0 && __svc_params->idle_trim_timeout <= 0)
 		goto unlock;
 
 	/* trim xprts (not sorted, not aggressive [but self limiting]) */
 	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &acc.ts);
 	acc.timeout = timeout;
+	acc.trim_timeout = __svc_params->idle_trim_timeout;
 	acc.cleaned = 0;
+	acc.trimmed = 0;
 
 	svc_xprt_foreach(svc_rqst_clean_func, (void *)&acc);
 
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+		"%s: cleaned %d trimmed %d",
+		__func__, acc.cleaned, acc.trimmed);
+
  unlock:
 	--active;
 	mutex_unlock(&active_mtx);
 	return;
 }
 
+/*
+ * Idle epoll timeouts sweep for trimming at most every idle_trim_timeout/2
+ * seconds, as every quiet channel times out on its own.
+ */
+static void
+svc_rqst_trim_idle(void)
+{
+	static uint64_t next;
+	struct timespec ts;
+	uint64_t now;
+
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
+	now = ts.tv_sec;
+	if (now < atomic_fetch_uint64_t(&next))
+		return;
+	atomic_store_uint64_t(&next,
+			      now + MAX(__svc_params->idle_trim_timeout / 2, 1));
+
+	svc_rqst_clean_idle(__svc_params->idle_timeout);
+}
+
 #ifdef TIRPC_EPOLL
 
 static struct xdr_ioq *
@@ -1421,7 +1812,7 @@ svc_rqst_epoll_event(struct svc_rqst_rec *sr_rec, struct epoll_event *ev)
 	} else if (ev->events & EPOLLOUT) {
 		/* This is a SEND event */
 		ev_flag = SVC_XPRT_FLAG_ADDED_SEND;
-		ioq = rec->ev_u.epoll.xioq_send;
+		ioq = rec->ev_w.epoll.xioq_send;
 		fun = svc_rqst_xprt_task_send;
 	} else {
 		/* This is some other event... */
@@ -1458,6 +1849,17 @@ svc_rqst_epoll_event(struct svc_rqst_rec *sr_rec, struct epoll_event *ev)
 		 * xp_refcnt need more than 1 (this event).
 		 */
 		ioq->ioq_wpe.fun = fun;
+		if (ev_flag & SVC_XPRT_FLAG_ADDED_RECV) {
+			atomic_inc_uint32_t(&rec->ev_count);
+			ioq->ioq_wpe.prio = WORK_POOL_PRIO_NORMAL;
+			ioq->ioq_wpe.flow =
+				(__svc_params->flags & SVC_FLAG_FAIR_QUEUE)
+				? &rec->flow : NULL;
+		} else {
+			/* flushing replies */
+			ioq->ioq_wpe.prio = WORK_POOL_PRIO_HIGH;
+			ioq->ioq_wpe.flow = NULL;
+		}
 		ioq->rec = rec;
 		return ioq;
 	}
@@ -1506,6 +1908,83 @@ svc_rqst_epoll_events(struct svc_rqst_rec *sr_rec, int n_events)
 	return ioq;
 }
 
+/*
+ * Poll without blocking for up to busy_poll_us, trading a core for
+ * wakeup latency.  Returns the number of events, 0 when the budget
+ * expired (or epoll_wait failed, repeated by the blocking call).
+ */
+static int
+svc_rqst_epoll_spin(struct svc_rqst_rec *sr_rec)
+{
+	struct timespec start, now;
+	uint64_t budget_ns = __svc_params->busy_poll_us * 1000ULL;
+	uint64_t spun_ns;
+	int n_events;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		n_events = epoll_wait(sr_rec->ev_u.epoll.epoll_fd,
+				      sr_rec->ev_u.epoll.events,
+				      sr_rec->ev_u.epoll.max_events, 0);
+
+		(void)clock_gettime(CLOCK_MONOTONIC, &now);
+		timespecsub(&now, &start, &now);
+		spun_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+		if (n_events || spun_ns >= budget_ns)
+			break;
+	}
+
+	sr_rec->stats.spins++;
+	sr_rec->stats.spin_ns += spun_ns;
+	if (n_events > 0) {
+		sr_rec->stats.spin_hits++;
+		return (n_events);
+	}
+	return (0);
+}
+
+/*
+ * Run to completion: handle ready events on the channel thread, up to
+ * run_budget events or run_budget_us, handing the remainder (and any
+ * request that suspends) to svc_work_pool.  Saves a thread handoff and
+ * queue lock per event, at the cost of not waiting for events while
+ * running, so only suitable for short requests.
+ */
+static void
+svc_rqst_epoll_run(struct svc_rqst_rec *sr_rec, int n_events)
+{
+	struct timespec start, now;
+	uint64_t budget_ns = __svc_params->run_budget_us * 1000ULL;
+	u_int budget = __svc_params->run_budget;
+	u_int done = 0;
+	int ix;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &start);
+	for (ix = 0; ix < n_events; ix++) {
+		struct xdr_ioq *ioq = svc_rqst_epoll_event(sr_rec,
+					&sr_rec->ev_u.epoll.events[ix]);
+
+		if (!ioq)
+			continue;
+
+		if (done >= budget) {
+			sr_rec->stats.run_handoff++;
+			work_pool_submit(&svc_work_pool, &ioq->ioq_wpe);
+			continue;
+		}
+
+		ioq->ioq_wpe.fun(&ioq->ioq_wpe);
+		sr_rec->stats.run_inline++;
+		done++;
+
+		(void)clock_gettime(CLOCK_MONOTONIC, &now);
+		timespecsub(&now, &start, &now);
+		if (now.tv_sec * 1000000000ULL + now.tv_nsec >= budget_ns)
+			done = budget;
+	}
+}
+
 static void svc_rqst_epoll_loop(struct work_pool_entry *wpe)
 {
 	struct svc_rqst_rec *sr_rec = 
@@ -1544,6 +2023,8 @@ static void svc_rqst_epoll_loop(struct work_pool_entry *wpe)
 			atomic_inc_uint32_t(&cc->cc_refcnt);
 			cc->cc_wpe.fun = svc_rqst_expire_task;
 			cc->cc_wpe.arg = NULL;
+			cc->cc_wpe.prio = WORK_POOL_PRIO_HIGH;
+			cc->cc_wpe.flow = NULL;
 			work_pool_submit(&svc_work_pool, &cc->cc_wpe);
 		}
 		mutex_unlock(&sr_rec->ev_lock);
@@ -1554,10 +2035,17 @@ static void svc_rqst_epoll_loop(struct work_pool_entry *wpe)
 			sr_rec->ev_u.epoll.epoll_fd,
 			timeout_ms);
 
-		n_events = epoll_wait(sr_rec->ev_u.epoll.epoll_fd,
-				      sr_rec->ev_u.epoll.events,
-				      sr_rec->ev_u.epoll.max_events,
-				      timeout_ms);
+		n_events = 0;
+		if (sr_rec->ev_flags & SVC_RQST_FLAG_BUSY_POLL)
+			n_events = svc_rqst_epoll_spin(sr_rec);
+
+		if (!n_events) {
+			sr_rec->stats.sleeps++;
+			n_events = epoll_wait(sr_rec->ev_u.epoll.epoll_fd,
+					      sr_rec->ev_u.epoll.events,
+					      sr_rec->ev_u.epoll.max_events,
+					      timeout_ms);
+		}
 
 		if (unlikely(sr_rec->ev_flags & SVC_RQST_FLAG_SHUTDOWN)) {
 			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
@@ -1580,6 +2068,19 @@ static void svc_rqst_epoll_loop(struct work_pool_entry *wpe)
 			atomic_add_uint32_t(&wakeups, n_events);
 			struct xdr_ioq *ioq;
 
+			if (sr_rec->ev_flags
+			    & SVC_RQST_FLAG_RUN_TO_COMPLETION) {
+				svc_rqst_epoll_run(sr_rec, n_events);
+
+				if (atomic_postclear_uint32_t_bits(
+					&wakeups, ~SVC_RQST_WAKEUPS)
+				    > SVC_RQST_WAKEUPS) {
+					svc_rqst_clean_idle(
+						__svc_params->idle_timeout);
+				}
+				continue;
+			}
+
 			ioq = svc_rqst_epoll_events(sr_rec, n_events);
 
 			if (ioq != NULL) {
@@ -1608,6 +2109,10 @@ static void svc_rqst_epoll_loop(struct work_pool_entry *wpe)
 				sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
 				sr_rec->ev_u.epoll.epoll_fd);
 			atomic_inc_uint32_t(&wakeups);
+
+			/* quiet channels may never reach SVC_RQST_WAKEUPS */
+			if (__svc_params->idle_trim_timeout > 0)
+				svc_rqst_trim_idle();
 			continue;
 		}
 		n_events = errno;
@@ -1676,6 +2181,21 @@ svc_rqst_thrd_signal(uint32_t chan_id, uint32_t flags)
 	return (0);
 }
 
+int
+svc_rqst_evchan_stats(uint32_t chan_id, struct svc_rqst_evchan_stats *stats)
+{
+	struct svc_rqst_rec *sr_rec;
+
+	sr_rec = svc_rqst_lookup_chan(chan_id);
+	if (!sr_rec)
+		return (ENOENT);
+
+	*stats = sr_rec->stats;
+
+	svc_rqst_release(sr_rec);
+	return (0);
+}
+
 static int
 svc_rqst_delete_evchan(uint32_t chan_id)
 {
@@ -0,0 +1,1304 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file svc_shm.c
+ * @brief Shared memory transport for same-host clients
+ *
+ * @section DESCRIPTION
+ *
+ * A listening Unix socket (svc_shm_ncreatef) accepts connections as
+ * svc_vc does, but instead of carrying records, each connection is sent
+ * a shared memory region holding two rings and two eventfds
+ * (SCM_RIGHTS), see svc_shm.h.  The client side is clnt_shm.c.
+ *
+ * Records are copied through the rings in fragments, so a record may be
+ * larger than its ring.  The reader's eventfd is registered on a normal
+ * svc_rqst channel, in place of a socket.  The writer only rings it when
+ * the reader has said it is going to sleep (sr_waiting), so a busy
+ * connection makes no system calls per record.
+ *
+ * Everything read from the region is validated before use; the peer may
+ * be any local process that can connect to the socket.
+ *
+ * A record that does not fit waits on the duplex record's writeq, as in
+ * svc_vc, rather than holding a worker.  The writer sets sr_blocked, and
+ * the reader rings the writer's eventfd when it next frees room; the
+ * writer's receive task then flushes the queue.  A peer that exits
+ * without closing its transport is noticed when a record is sent while
+ * the queue is stalled (the Unix socket is checked for hangup), not when
+ * it is idle.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rpc/types.h>
+#include <misc/city.h>
+#include <misc/portable.h>
+#include <rpc/rpc.h>
+#include <rpc/svc.h>
+#include <rpc/svc_auth.h>
+#include <rpc/svc_rqst.h>
+#include <rpc/xdr_ioq.h>
+
+#include "rpc_com.h"
+#include "clnt_internal.h"
+#include "svc_internal.h"
+#include "svc_xprt.h"
+#include "rpc_dplx_internal.h"
+#include "svc_drc.h"
+#include "svc_shm.h"
+
+#define LAST_FRAG ((u_int32_t)(1 << 31))
+
+/* smallest fragment worth waiting for while the ring is full */
+#define SVC_SHM_FRAG_MIN	(4096)
+
+/* give up on a reader that stops draining, in seconds (cf. SO_SNDTIMEO) */
+#define SVC_SHM_SEND_TIMEOUT	(5)
+
+static void svc_shm_rendezvous_ops(SVCXPRT *);
+static void svc_shm_override_ops(SVCXPRT *, SVCXPRT *);
+
+static void
+svc_shm_xprt_free(struct svc_shm_xprt *sm)
+{
+	XDR_DESTROY(sm->sm_dr.ioq.xdrs);
+	rpc_dplx_rec_destroy(&sm->sm_dr);
+	mem_free(sm, sizeof(struct svc_shm_xprt));
+}
+
+static struct svc_shm_xprt *
+svc_shm_xprt_zalloc(void)
+{
+	struct svc_shm_xprt *sm = rpc_dplx_rec_zalloc(sizeof(struct svc_shm_xprt));
+
+	/* Init SVCXPRT locks, etc */
+	rpc_dplx_rec_init(&sm->sm_dr);
+	xdr_ioq_setup(&sm->sm_dr.ioq);
+	sm->sm_tx_efd = -1;
+	sm->sm_sock = -1;
+	return (sm);
+}
+
+static void
+svc_shm_xprt_setup(SVCXPRT **sxpp)
+{
+	if (unlikely(*sxpp)) {
+		svc_shm_xprt_free(SHM_DR(REC_XPRT(*sxpp)));
+		*sxpp = NULL;
+	} else {
+		struct svc_shm_xprt *sm = svc_shm_xprt_zalloc();
+
+		*sxpp = &sm->sm_dr.xprt;
+	}
+}
+
+/*
+ * Ring sizes are powers of 2, 0 => default.
+ */
+static uint32_t
+svc_shm_ring_size(u_int size)
+{
+	uint32_t ring = SVC_SHM_RING_MIN;
+
+	if (!size)
+		return (SVC_SHM_RING_DEFAULT);
+
+	while (ring < size && ring < SVC_SHM_RING_MAX)
+		ring <<= 1;
+	return (ring);
+}
+
+/*
+ * Create and map a region for one connection.
+ *
+ * Returns the region fd, or -1 with errno set.
+ */
+static int
+svc_shm_region(uint32_t c2s, uint32_t s2c, struct svc_shm_hdr **hdrp,
+	       size_t *lenp)
+{
+	long pagesz = sysconf(_SC_PAGESIZE);
+	size_t offset = ((sizeof(struct svc_shm_hdr) + pagesz - 1) / pagesz)
+		      * pagesz;
+	size_t length = offset + c2s + s2c;
+	struct svc_shm_hdr *hdr;
+	int code;
+	int fd;
+
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create("ntirpc-shm", MFD_CLOEXEC);
+#else
+	{
+		char path[] = "/dev/shm/ntirpc-shm-XXXXXX";
+
+		fd = mkostemp(path, O_CLOEXEC);
+		if (fd >= 0)
+			(void)unlink(path);
+	}
+#endif
+	if (fd < 0)
+		return (-1);
+
+	if (ftruncate(fd, length) < 0)
+		goto err;
+
+	hdr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED)
+		goto err;
+
+	/* zero filled by ftruncate */
+	hdr->sh_magic = SVC_SHM_MAGIC;
+	hdr->sh_version = SVC_SHM_VERSION;
+	hdr->sh_size[SVC_SHM_C2S] = c2s;
+	hdr->sh_size[SVC_SHM_S2C] = s2c;
+	hdr->sh_offset[SVC_SHM_C2S] = offset;
+	hdr->sh_offset[SVC_SHM_S2C] = offset + c2s;
+
+	/* neither side has read yet, so the first record rings */
+	hdr->sh_ring[SVC_SHM_C2S].sr_waiting = 1;
+	hdr->sh_ring[SVC_SHM_S2C].sr_waiting = 1;
+
+	*hdrp = hdr;
+	*lenp = length;
+	return (fd);
+
+ err:
+	code = errno;
+	close(fd);
+	errno = code;
+	return (-1);
+}
+
+/*
+ * Map a region received from the server, and check its layout.
+ */
+struct svc_shm_hdr *
+svc_shm_map(int fd, size_t length)
+{
+	struct svc_shm_hdr *hdr;
+	struct stat st;
+	int ix;
+
+	if (length < sizeof(struct svc_shm_hdr)
+	 || fstat(fd, &st) < 0
+	 || st.st_size < length) {
+		errno = EPROTO;
+		return (NULL);
+	}
+
+	hdr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED)
+		return (NULL);
+
+	if (hdr->sh_magic != SVC_SHM_MAGIC
+	 || hdr->sh_version != SVC_SHM_VERSION)
+		goto err;
+
+	for (ix = SVC_SHM_C2S; ix <= SVC_SHM_S2C; ix++) {
+		uint32_t size = hdr->sh_size[ix];
+
+		if (size < SVC_SHM_RING_MIN
+		 || size > SVC_SHM_RING_MAX
+		 || (size & (size - 1))
+		 || hdr->sh_offset[ix] < sizeof(struct svc_shm_hdr)
+		 || (size_t)hdr->sh_offset[ix] + size > length)
+			goto err;
+	}
+	return (hdr);
+
+ err:
+	munmap(hdr, length);
+	errno = EPROTO;
+	return (NULL);
+}
+
+/*
+ * Make a transport for one end of a region.
+ *
+ * rx is the ring this end reads (SVC_SHM_C2S on the server).  On success,
+ * the transport owns both eventfds, the socket, and the mapping.
+ */
+SVCXPRT *
+svc_shm_attach(int efd_rx, int efd_tx, int sock, struct svc_shm_hdr *hdr,
+	       size_t length, int rx)
+{
+	SVCXPRT *xprt;
+	struct rpc_dplx_rec *rec;
+	struct svc_shm_xprt *sm;
+	int tx = rx ^ 1;
+
+	/* atomically find or create shared fd state; ref+1; locked */
+	xprt = svc_xprt_lookup(efd_rx, svc_shm_xprt_setup);
+	if (!xprt) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d svc_xprt_lookup failed",
+			__func__, efd_rx);
+		return (NULL);
+	}
+
+	if (!(xprt->xp_flags & SVC_XPRT_FLAG_INITIAL)) {
+		/* cannot happen, the eventfd is new */
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d already in use",
+			__func__, efd_rx);
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		return (NULL);
+	}
+	rec = REC_XPRT(xprt);
+
+	/* the sizes and offsets were checked, but keep private copies */
+	sm = SHM_DR(rec);
+	sm->sm_hdr = hdr;
+	sm->sm_length = length;
+	sm->sm_rx = &hdr->sh_ring[rx];
+	sm->sm_tx = &hdr->sh_ring[tx];
+	sm->sm_rx_size = hdr->sh_size[rx];
+	sm->sm_tx_size = hdr->sh_size[tx];
+	sm->sm_rx_data = (uint8_t *)hdr + hdr->sh_offset[rx];
+	sm->sm_tx_data = (uint8_t *)hdr + hdr->sh_offset[tx];
+	sm->sm_rx_head = atomic_fetch_uint64_t(&sm->sm_rx->sr_head);
+	sm->sm_tx_efd = efd_tx;
+	sm->sm_sock = sock;
+
+	rec->sendsz = sm->sm_tx_size;
+	rec->recvsz = sm->sm_rx_size;
+	rec->pagesz = sysconf(_SC_PAGESIZE);
+	rec->maxrec = __svc_maxrec;
+
+	(void)atomic_postset_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_CLOSE
+					   | SVC_XPRT_FLAG_INITIALIZED);
+	svc_shm_override_ops(xprt, NULL);
+
+	/* release */
+	rpc_dplx_rui(rec);
+	XPRT_TRACE(xprt, __func__, __func__, __LINE__);
+
+	return (xprt);
+}
+
+SVCXPRT *
+svc_shm_ncreatef(const int fd, const u_int sendsz, const u_int recvsz,
+		 const uint32_t flags)
+{
+	struct __rpc_sockinfo si;
+	SVCXPRT *xprt;
+	struct rpc_dplx_rec *rec;
+	const char *netid;
+	u_int xp_flags;
+	int rc;
+
+	/* atomically find or create shared fd state; ref+1; locked */
+	xprt = svc_xprt_lookup(fd, svc_shm_xprt_setup);
+	if (!xprt) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d svc_xprt_lookup failed",
+			__func__, fd);
+		return (NULL);
+	}
+	rec = REC_XPRT(xprt);
+
+	xp_flags = atomic_postset_uint16_t_bits(&xprt->xp_flags,
+						(flags & SVC_XPRT_FLAG_CLOSE)
+						| SVC_XPRT_FLAG_INITIALIZED);
+	if (xp_flags & SVC_XPRT_FLAG_INITIALIZED) {
+		rpc_dplx_rui(rec);
+		XPRT_TRACE(xprt, __func__, __func__, __LINE__);
+		return (xprt);
+	}
+
+	if (!__rpc_fd2sockinfo(fd, &si)
+	 || si.si_af != AF_LOCAL
+	 || si.si_socktype != SOCK_STREAM) {
+		atomic_clear_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_INITIALIZED);
+		rpc_dplx_rui(rec);
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d is not a local stream socket",
+			__func__, fd);
+		return (NULL);
+	}
+
+	if (!__rpc_sockinfo2netid(&si, &netid)) {
+		atomic_clear_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_INITIALIZED);
+		rpc_dplx_rui(rec);
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d could not get network information",
+			__func__, fd);
+		return (NULL);
+	}
+
+	/* ring sizes for each connection */
+	rec->sendsz = svc_shm_ring_size(sendsz);
+	rec->recvsz = svc_shm_ring_size(recvsz);
+	rec->pagesz = sysconf(_SC_PAGESIZE);
+	rec->maxrec = __svc_maxrec;
+
+	/* duplex streams are not used by the rendezvous transport */
+	xdrmem_create(rec->ioq.xdrs, NULL, 0, XDR_ENCODE);
+
+	svc_shm_rendezvous_ops(xprt);
+
+	/* caller should know what it's doing */
+	if (flags & SVC_CREATE_FLAG_LISTEN) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d listen",
+			 __func__, fd);
+		listen(fd, SOMAXCONN);
+	}
+
+	__rpc_address_setup(&xprt->xp_local);
+	rc = getsockname(fd, xprt->xp_local.nb.buf, &xprt->xp_local.nb.len);
+	if (rc < 0) {
+		atomic_clear_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_INITIALIZED);
+		rpc_dplx_rui(rec);
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d getsockname failed (%d)",
+			 __func__, fd, rc);
+		return (NULL);
+	}
+
+	xprt->xp_netid = mem_strdup(netid);
+
+	/* Conditional register */
+	if ((!(__svc_params->flags & SVC_FLAG_NOREG_XPRTS)
+	     && !(flags & SVC_CREATE_FLAG_XPRT_NOREG))
+	    || (flags & SVC_CREATE_FLAG_XPRT_DOREG))
+		svc_rqst_evchan_reg(__svc_params->ev_u.evchan.id, xprt,
+				    RPC_DPLX_LOCKED |
+				    SVC_RQST_FLAG_CHAN_AFFINITY);
+
+	atomic_set_uint16_t_bits(&xprt->xp_flags,
+	    SVC_XPRT_FLAG_READY);
+
+	/* release */
+	rpc_dplx_rui(rec);
+	XPRT_TRACE(xprt, __func__, __func__, __LINE__);
+
+	return (xprt);
+}
+
+/*
+ * Send the region and eventfds to a new client.  The socket is new, so
+ * there is always room.
+ */
+static bool
+svc_shm_hello(int fd, size_t length, int *fds)
+{
+	union {
+		struct cmsghdr cmsg;
+		char buf[CMSG_SPACE(sizeof(int) * SVC_SHM_NFDS)];
+	} u;
+	struct svc_shm_hello hello = {
+		.sh_magic = SVC_SHM_MAGIC,
+		.sh_version = SVC_SHM_VERSION,
+		.sh_length = length,
+	};
+	struct iovec iov = {
+		.iov_base = &hello,
+		.iov_len = sizeof(hello),
+	};
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	memset(&u, 0, sizeof(u));
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = u.buf;
+	msg.msg_controllen = sizeof(u.buf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * SVC_SHM_NFDS);
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * SVC_SHM_NFDS);
+
+	return (sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL)
+		== sizeof(hello));
+}
+
+ /*ARGSUSED*/
+static enum xprt_stat
+svc_shm_rendezvous(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *req_rec = REC_XPRT(xprt);
+	SVCXPRT *newxprt;
+	struct svc_shm_hdr *hdr = NULL;
+	struct sockaddr_storage addr;
+	size_t length = 0;
+	socklen_t len;
+	int fds[SVC_SHM_NFDS] = { -1, -1, -1 };
+	int fd;
+	int ix;
+	int rc;
+
+ again:
+	len = sizeof(addr);
+	fd = accept(xprt->xp_fd, (struct sockaddr *)(void *)&addr, &len);
+	if (fd < 0) {
+		if (errno == EINTR)
+			goto again;
+		return (XPRT_DIED);
+	}
+	/* stop accepting while globally over quota */
+	if (unlikely(svc_rqst_rearm_recv(xprt, 0))) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d svc_rqst_rearm_recv failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		close(fd);
+		return (XPRT_DIED);
+	}
+
+	fds[0] = svc_shm_region(req_rec->recvsz, req_rec->sendsz,
+				&hdr, &length);
+	if (fds[0] < 0) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d region failed (%d)",
+			__func__, fd, errno);
+		goto err;
+	}
+
+	fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	fds[2] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fds[1] < 0 || fds[2] < 0) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d eventfd failed (%d)",
+			__func__, fd, errno);
+		goto err;
+	}
+
+	if (!svc_shm_hello(fd, length, fds)) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d hello failed (%d)",
+			__func__, fd, errno);
+		goto err;
+	}
+
+	/* the mapping holds the region */
+	close(fds[0]);
+	fds[0] = -1;
+
+	newxprt = svc_shm_attach(fds[1], fds[2], fd, hdr, length,
+				 SVC_SHM_C2S);
+	if (!newxprt)
+		goto err;
+
+	svc_shm_override_ops(newxprt, xprt);
+
+	__rpc_address_setup(&newxprt->xp_remote);
+	memcpy(newxprt->xp_remote.nb.buf, &addr, len);
+	newxprt->xp_remote.nb.len = len;
+
+	__rpc_address_setup(&newxprt->xp_local);
+	rc = getsockname(fd, newxprt->xp_local.nb.buf,
+			 &newxprt->xp_local.nb.len);
+	if (rc < 0) {
+		newxprt->xp_local.nb.len = sizeof(struct sockaddr_storage);
+		memset(newxprt->xp_local.nb.buf, 0xfe,
+		       newxprt->xp_local.nb.len);
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d getsockname failed (%d)",
+			 __func__, fd, rc);
+	}
+	XPRT_TRACE(newxprt, __func__, __func__, __LINE__);
+
+	REC_XPRT(newxprt)->maxrec = req_rec->maxrec;
+
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	newxprt->xp_parent = xprt;
+	if (xprt->xp_dispatch.rendezvous_cb(newxprt)
+	 || svc_rqst_xprt_register(newxprt, xprt)) {
+		// Note xp_parent is released in svc_shm_destroy_task
+		SVC_DESTROY(newxprt);
+		/* Was never added to epoll */
+		SVC_RELEASE(newxprt, SVC_RELEASE_FLAG_NONE);
+		return (XPRT_DESTROYED);
+	}
+
+	atomic_set_uint16_t_bits(&newxprt->xp_flags,
+	    SVC_XPRT_FLAG_READY);
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+		"New shm client connected "
+		"xprt %p, fd %d, sock %d",
+		newxprt, newxprt->xp_fd, fd);
+
+	/* Drop the lookup reference, as svc_vc_rendezvous() */
+	SVC_RELEASE(newxprt, SVC_RELEASE_FLAG_NONE);
+	return (XPRT_IDLE);
+
+ err:
+	/* only this connection failed */
+	for (ix = 0; ix < SVC_SHM_NFDS; ix++) {
+		if (fds[ix] >= 0)
+			close(fds[ix]);
+	}
+	if (hdr)
+		munmap(hdr, length);
+	close(fd);
+	return (XPRT_IDLE);
+}
+
+static void
+svc_shm_destroy_task(struct work_pool_entry *wpe)
+{
+	struct rpc_dplx_rec *rec =
+			opr_containerof(wpe, struct rpc_dplx_rec, ioq.ioq_wpe);
+	struct svc_shm_xprt *sm = SHM_DR(rec);
+	struct poolq_entry *have;
+	uint16_t xp_flags;
+
+	const int32_t xp_refcnt = atomic_fetch_int32_t(&rec->xprt.xp_refcnt);
+	__warnx(TIRPC_DEBUG_FLAG_REFCNT,
+		"%s() %p fd %d xp_refcnt %" PRId32,
+		__func__, rec, rec->xprt.xp_fd, xp_refcnt);
+
+	if (xp_refcnt > 0) {
+		/* instead of nanosleep */
+		work_pool_submit(&svc_work_pool, &(rec->ioq.ioq_wpe));
+		return;
+	} else if (unlikely(xp_refcnt < 0)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s() negative refcnt: %p fd %d xp_refcnt %" PRId32,
+			__func__, rec, rec->xprt.xp_fd, xp_refcnt);
+		abort();
+	}
+
+	xp_flags = atomic_postclear_uint16_t_bits(&rec->xprt.xp_flags,
+						  SVC_XPRT_FLAG_CLOSE);
+
+	if (rec->xprt.xp_ops->xp_free_user_data)
+		rec->xprt.xp_ops->xp_free_user_data(&rec->xprt);
+
+	/* no references are left, as svc_vc_destroy_task() */
+	if ((xp_flags & SVC_XPRT_FLAG_CLOSE) && rec->xprt.xp_fd != RPC_ANYFD) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d close",
+			 __func__, rec->xprt.xp_fd);
+		(void)close(rec->xprt.xp_fd);
+		rec->xprt.xp_fd = RPC_ANYFD;
+	}
+	if (sm->sm_tx_efd >= 0)
+		(void)close(sm->sm_tx_efd);
+	if (sm->sm_sock >= 0)
+		(void)close(sm->sm_sock);
+	if (sm->sm_hdr)
+		(void)munmap(sm->sm_hdr, sm->sm_length);
+
+	if (rec->xprt.xp_tp)
+		mem_free(rec->xprt.xp_tp, 0);
+	if (rec->xprt.xp_netid)
+		mem_free(rec->xprt.xp_netid, 0);
+
+	if (rec->xprt.xp_parent)
+		SVC_RELEASE(rec->xprt.xp_parent, SVC_RELEASE_FLAG_NONE);
+
+	/* records the reader never made room for */
+	while ((have = TAILQ_FIRST(&rec->writeq.qh))) {
+		TAILQ_REMOVE(&rec->writeq.qh, have, q);
+		(rec->writeq.qcount)--;
+		XDR_DESTROY(_IOQ(have)->xdrs);
+	}
+
+	svc_shm_xprt_free(sm);
+}
+
+static void
+svc_shm_unlink_it(SVCXPRT *xprt, u_int flags, const char *tag, const int line)
+{
+	svc_rqst_xprt_unregister(xprt, flags);
+}
+
+static void
+svc_shm_destroy_it(SVCXPRT *xprt, u_int flags, const char *tag,
+		   const int line)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_shm_xprt *sm = SHM_DR(rec);
+	struct timespec ts = {
+		.tv_sec = 0,
+		.tv_nsec = 0,
+	};
+
+	__warnx(TIRPC_DEBUG_FLAG_REFCNT,
+		"%s() %p fd %d xp_refcnt %" PRId32 " @%s:%d",
+		__func__, xprt, xprt->xp_fd, xprt->xp_refcnt, tag, line);
+
+	if (sm->sm_hdr) {
+		/* tell the peer, which is otherwise only woken by records */
+		atomic_store_uint32_t(&sm->sm_tx->sr_closed, 1);
+		(void)eventfd_write(sm->sm_tx_efd, 1);
+	}
+
+	while (atomic_postset_uint16_t_bits(&(rec->ioq.ioq_s.qflags),
+					    IOQ_FLAG_WORKING)
+	       & IOQ_FLAG_WORKING) {
+		nanosleep(&ts, NULL);
+	}
+
+	rec->ioq.ioq_wpe.fun = svc_shm_destroy_task;
+	rec->ioq.ioq_wpe.prio = WORK_POOL_PRIO_LOW;
+	rec->ioq.ioq_wpe.flow = NULL;
+	work_pool_submit(&svc_work_pool, &(rec->ioq.ioq_wpe));
+}
+
+extern mutex_t ops_lock;
+
+ /*ARGSUSED*/
+static bool
+svc_shm_control(SVCXPRT *xprt, const u_int rq, void *in)
+{
+	switch (rq) {
+	case SVCGET_XP_FLAGS:
+		*(u_int *) in = xprt->xp_flags;
+		break;
+	case SVCSET_XP_FLAGS:
+		xprt->xp_flags = *(u_int *) in;
+		break;
+	case SVCGET_XP_UNREF_USER_DATA:
+		mutex_lock(&ops_lock);
+		*(svc_xprt_void_fun_t *) in = xprt->xp_ops->xp_unref_user_data;
+		mutex_unlock(&ops_lock);
+		break;
+	case SVCSET_XP_UNREF_USER_DATA:
+		mutex_lock(&ops_lock);
+		xprt->xp_ops->xp_unref_user_data = *(svc_xprt_void_fun_t) in;
+		mutex_unlock(&ops_lock);
+		break;
+	case SVCGET_XP_FREE_USER_DATA:
+		mutex_lock(&ops_lock);
+		*(svc_xprt_fun_t *) in = xprt->xp_ops->xp_free_user_data;
+		mutex_unlock(&ops_lock);
+		break;
+	case SVCSET_XP_FREE_USER_DATA:
+		mutex_lock(&ops_lock);
+		xprt->xp_ops->xp_free_user_data = *(svc_xprt_fun_t) in;
+		mutex_unlock(&ops_lock);
+		break;
+	default:
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+static bool
+svc_shm_rendezvous_control(SVCXPRT *xprt, const u_int rq, void *in)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+
+	switch (rq) {
+	case SVCGET_CONNMAXREC:
+		*(int *)in = rec->maxrec;
+		break;
+	case SVCSET_CONNMAXREC:
+		rec->maxrec = *(int *)in;
+		break;
+	default:
+		return (svc_shm_control(xprt, rq, in));
+	}
+	return (TRUE);
+}
+
+static enum xprt_stat
+svc_shm_stat(SVCXPRT *xprt)
+{
+	if (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		return (XPRT_DESTROYED);
+
+	return (XPRT_IDLE);
+}
+
+/*
+ * Copy len bytes of a record, from the segment at *have + *off, into the
+ * send ring at pos.
+ */
+static bool
+svc_shm_copy(struct svc_shm_xprt *sm, uint32_t pos, struct poolq_entry **have,
+	     u_int *off, uint32_t len)
+{
+	uint32_t mask = sm->sm_tx_size - 1;
+
+	while (len) {
+		struct xdr_ioq_uv *uv;
+		ssize_t n;
+
+		if (unlikely(!*have))
+			return (false);
+
+		uv = IOQ_(*have);
+		n = ioquv_length(uv) - *off;
+		if (!n) {
+			*have = TAILQ_NEXT(*have, q);
+			*off = 0;
+			continue;
+		}
+		n = MIN(n, len);
+		n = MIN(n, sm->sm_tx_size - pos);
+
+		if (uv->v.vio_type == VIO_FILE) {
+			struct xdr_vio_file *file =
+				(struct xdr_vio_file *)uv->v.vio_base;
+			off_t offset = file->offset + *off
+				+ ((uintptr_t)uv->v.vio_head
+				   - (uintptr_t)uv->v.vio_base);
+
+			n = pread(file->fd, sm->sm_tx_data + pos, n, offset);
+			if (n <= 0) {
+				/* file is shorter than the segment */
+				__warnx(TIRPC_DEBUG_FLAG_ERROR,
+					"%s: file fd %d short at %lld (%d)",
+					__func__, file->fd,
+					(long long) offset, errno);
+				return (false);
+			}
+		} else {
+			memcpy(sm->sm_tx_data + pos, uv->v.vio_head + *off, n);
+		}
+
+		*off += n;
+		len -= n;
+		pos = (pos + n) & mask;
+	}
+	return (true);
+}
+
+/*
+ * Copy as much of a record as the send ring has room for, from
+ * write_start on, and ring the reader if it is sleeping.  Called with the
+ * writeq locked.  Returns 0 when the whole record is in the ring,
+ * EWOULDBLOCK when the ring is full, or EIO.
+ */
+static int
+svc_shm_push(SVCXPRT *xprt, struct xdr_ioq *xioq)
+{
+	struct svc_shm_xprt *sm = SHM_DR(REC_XPRT(xprt));
+	struct svc_shm_ring *ring = sm->sm_tx;
+	struct poolq_entry *have;
+	uint32_t mask = sm->sm_tx_size - 1;
+	uint64_t head, tail;
+	uint32_t remaining, room, len, frag;
+	u_int off = xioq->write_start;
+
+	remaining = XDR_GETPOS(xioq->xdrs) - xioq->write_start;
+
+	/* find where the last call stopped */
+	have = TAILQ_FIRST(&xioq->ioq_uv.uvqh.qh);
+	while (have && off >= ioquv_length(IOQ_(have))) {
+		off -= ioquv_length(IOQ_(have));
+		have = TAILQ_NEXT(have, q);
+	}
+
+	tail = atomic_fetch_uint64_t(&ring->sr_tail);
+
+	while (remaining) {
+		head = atomic_fetch_uint64_t(&ring->sr_head);
+		if (unlikely(tail - head > sm->sm_tx_size)) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p fd %d ring corrupt (will set dead)",
+				__func__, xprt, xprt->xp_fd);
+			return (EIO);
+		}
+
+		room = sm->sm_tx_size - (tail - head);
+		if (room < BYTES_PER_XDR_UNIT
+			   + MIN(RNDUP(remaining), SVC_SHM_FRAG_MIN))
+			return (EWOULDBLOCK);
+
+		len = MIN(remaining, (room - BYTES_PER_XDR_UNIT)
+				     & ~(BYTES_PER_XDR_UNIT - 1));
+		frag = (len == remaining) ? (len | LAST_FRAG) : len;
+
+		/* the header never straddles the wrap */
+		memcpy(sm->sm_tx_data + (tail & mask), &frag, sizeof(frag));
+		if (!svc_shm_copy(sm, (tail + BYTES_PER_XDR_UNIT) & mask,
+				  &have, &off, len))
+			return (EIO);
+
+		tail += BYTES_PER_XDR_UNIT + RNDUP(len);
+		remaining -= len;
+		xioq->write_start += len;
+		atomic_store_uint64_t(&ring->sr_tail, tail);
+
+		if (atomic_fetch_uint32_t(&ring->sr_waiting)) {
+			atomic_store_uint32_t(&ring->sr_waiting, 0);
+			(void)eventfd_write(sm->sm_tx_efd, 1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Copy queued records into the send ring until it is full.  Called with
+ * the writeq locked.  Returns false when the transport is broken.
+ */
+static bool
+svc_shm_flush_locked(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_shm_xprt *sm = SHM_DR(rec);
+	struct poolq_entry *have;
+	struct xdr_ioq *xioq;
+
+	while ((have = TAILQ_FIRST(&rec->writeq.qh))) {
+		xioq = _IOQ(have);
+
+		switch (svc_shm_push(xprt, xioq)) {
+		case 0:
+			break;
+		case EWOULDBLOCK:
+			if (atomic_fetch_uint32_t(&sm->sm_tx->sr_blocked))
+				return (true);
+			/* ask the reader to ring when it makes room, then
+			 * look again, as it may have just done so.
+			 */
+			atomic_store_uint32_t(&sm->sm_tx->sr_blocked, 1);
+			continue;
+		default:
+			return (false);
+		}
+
+		TAILQ_REMOVE(&rec->writeq.qh, have, q);
+		(rec->writeq.qcount)--;
+		XDR_DESTROY(xioq->xdrs);
+		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &sm->sm_tx_ts);
+	}
+	return (true);
+}
+
+/*
+ * The writeq has not moved: give up on a reader that has gone, or has
+ * made no room for SVC_SHM_SEND_TIMEOUT.
+ */
+static bool
+svc_shm_stalled(SVCXPRT *xprt)
+{
+	struct svc_shm_xprt *sm = SHM_DR(REC_XPRT(xprt));
+	struct pollfd pfd = {
+		.fd = sm->sm_sock,
+		.events = POLLRDHUP,
+	};
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
+	if (ts.tv_sec - sm->sm_tx_ts.tv_sec >= SVC_SHM_SEND_TIMEOUT) {
+		__warnx(TIRPC_DEBUG_FLAG_WARN,
+			"%s: %p fd %d ring full (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		return (true);
+	}
+
+	if (poll(&pfd, 1, 0) > 0
+	 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR))) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: %p fd %d peer closed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		return (true);
+	}
+	return (false);
+}
+
+/*
+ * Queue a record for the send ring, and copy in what fits now.  The rest
+ * is sent by svc_shm_recv() when the reader rings back.  Consumes the
+ * xdr_ioq.
+ */
+bool
+svc_shm_send(SVCXPRT *xprt, struct xdr_ioq *xioq)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_shm_xprt *sm = SHM_DR(rec);
+	bool rslt;
+
+	xdr_tail_update(xioq->xdrs);
+	xioq->write_start = 0;
+
+	mutex_lock(&rec->writeq.qmutex);
+	if (TAILQ_FIRST(&rec->writeq.qh)) {
+		if (svc_shm_stalled(xprt)) {
+			mutex_unlock(&rec->writeq.qmutex);
+			XDR_DESTROY(xioq->xdrs);
+			return (false);
+		}
+	} else {
+		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &sm->sm_tx_ts);
+	}
+
+	TAILQ_INSERT_TAIL(&rec->writeq.qh, &xioq->ioq_s, q);
+	(rec->writeq.qcount)++;
+
+	rslt = svc_shm_flush_locked(xprt);
+	mutex_unlock(&rec->writeq.qmutex);
+	return (rslt);
+}
+
+/*
+ * The reader has made room (or the peer has sent), resume the writeq.
+ */
+static bool
+svc_shm_flush(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	bool rslt;
+
+	/* unlocked peek: a sender flushes what it queues */
+	if (!TAILQ_FIRST(&rec->writeq.qh))
+		return (true);
+
+	mutex_lock(&rec->writeq.qmutex);
+	rslt = svc_shm_flush_locked(xprt);
+	mutex_unlock(&rec->writeq.qmutex);
+	return (rslt);
+}
+
+static enum xprt_stat
+svc_shm_recv(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_shm_xprt *sm = SHM_DR(rec);
+	struct svc_shm_ring *ring = sm->sm_rx;
+	struct poolq_entry *have;
+	struct xdr_ioq_uv *uv;
+	struct xdr_ioq *xioq;
+	uint32_t mask = sm->sm_rx_size - 1;
+	uint64_t used;
+	uint32_t frag, len, pos, part;
+	eventfd_t count;
+	bool armed = false;
+
+	/* the peer also rings when it has made room in the send ring */
+	if (unlikely(!svc_shm_flush(xprt))) {
+		SVC_DESTROY(xprt);
+		return SVC_STAT(xprt);
+	}
+
+	/* no need for locking, only one svc_rqst_xprt_task() per event.
+	 * depends upon svc_rqst_rearm_events() for ordering.
+	 */
+	have = TAILQ_LAST(&rec->ioq.ioq_uv.uvqh.qh, poolq_head_s);
+	if (!have) {
+		xioq = xdr_ioq_create(rec->pagesz, rec->maxrec, UIO_FLAG_BUFQ);
+		(rec->ioq.ioq_uv.uvqh.qcount)++;
+		TAILQ_INSERT_TAIL(&rec->ioq.ioq_uv.uvqh.qh, &xioq->ioq_s, q);
+	} else {
+		xioq = _IOQ(have);
+	}
+
+	/* the eventfd stays readable until the ring is found empty, so
+	 * the writer need not ring it until then.
+	 */
+	atomic_store_uint32_t(&ring->sr_waiting, 0);
+
+	for (;;) {
+		used = atomic_fetch_uint64_t(&ring->sr_tail) - sm->sm_rx_head;
+
+		if (!used) {
+			if (atomic_fetch_uint32_t(&ring->sr_closed)) {
+				__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+					"%s: %p fd %d closed (will set dead)",
+					__func__, xprt, xprt->xp_fd);
+				SVC_DESTROY(xprt);
+				return SVC_STAT(xprt);
+			}
+			if (!armed) {
+				/* clear the eventfd, ask to be rung, and
+				 * look again before sleeping
+				 */
+				(void)eventfd_read(xprt->xp_fd, &count);
+				atomic_store_uint32_t(&ring->sr_waiting, 1);
+				armed = true;
+				continue;
+			}
+			if (unlikely(svc_rqst_rearm_events(
+						xprt,
+						SVC_XPRT_FLAG_ADDED_RECV))) {
+				__warnx(TIRPC_DEBUG_FLAG_ERROR,
+					"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+					__func__, xprt, xprt->xp_fd);
+				SVC_DESTROY(xprt);
+			}
+			return SVC_STAT(xprt);
+		}
+
+		pos = sm->sm_rx_head & mask;
+		memcpy(&frag, sm->sm_rx_data + pos, sizeof(frag));
+		len = frag & ~LAST_FRAG;
+
+		if (unlikely(used > sm->sm_rx_size
+			  || !len
+			  || (uint64_t)BYTES_PER_XDR_UNIT + RNDUP(len) > used)) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p fd %d ring corrupt, fragment %" PRIu32
+				" used %" PRIu64 " (will set dead)",
+				__func__, xprt, xprt->xp_fd, frag, used);
+			SVC_DESTROY(xprt);
+			return SVC_STAT(xprt);
+		}
+
+		/* one buffer per fragment */
+		uv = xdr_ioq_uv_create(len, (frag & LAST_FRAG)
+					    ? UIO_FLAG_FREE
+					    : UIO_FLAG_FREE | UIO_FLAG_MORE);
+		pos = (pos + BYTES_PER_XDR_UNIT) & mask;
+		part = MIN(len, sm->sm_rx_size - pos);
+		memcpy(uv->v.vio_tail, sm->sm_rx_data + pos, part);
+		memcpy(uv->v.vio_tail + part, sm->sm_rx_data, len - part);
+		uv->v.vio_tail += len;
+		(xioq->ioq_uv.uvqh.qcount)++;
+		TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
+
+		sm->sm_rx_head += BYTES_PER_XDR_UNIT + RNDUP(len);
+		atomic_store_uint64_t(&ring->sr_head, sm->sm_rx_head);
+
+		if (atomic_fetch_uint32_t(&ring->sr_blocked)) {
+			/* the peer has records waiting for this room */
+			atomic_store_uint32_t(&ring->sr_blocked, 0);
+			(void)eventfd_write(sm->sm_tx_efd, 1);
+		}
+
+		if (frag & LAST_FRAG)
+			break;
+	}
+
+	if (armed) {
+		/* raced with the writer after clearing the eventfd; make
+		 * sure whatever follows this record is noticed.
+		 */
+		atomic_store_uint32_t(&ring->sr_waiting, 0);
+		(void)eventfd_write(xprt->xp_fd, 1);
+	}
+
+	/* finished a request */
+	(rec->ioq.ioq_uv.uvqh.qcount)--;
+	TAILQ_REMOVE(&rec->ioq.ioq_uv.uvqh.qh, &xioq->ioq_s, q);
+	xdr_ioq_reset(xioq, 0);
+
+	if (unlikely(svc_rqst_rearm_recv(xprt, 1))) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d svc_rqst_rearm_recv failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		xdr_ioq_destroy(xioq, xioq->ioq_s.qsize);
+		SVC_DESTROY(xprt);
+		return SVC_STAT(xprt);
+	}
+
+	return svc_request(xprt, xioq->xdrs);
+}
+
+/*
+ * Resend a reply retained by the duplicate request cache.
+ */
+static void
+svc_shm_resend(SVCXPRT *xprt, xdr_uio *reply)
+{
+	struct xdr_ioq *xioq = xdr_ioq_create_refer(reply);
+
+	/* the segments hold their own references */
+	reply->uio_release(reply, UIO_FLAG_NONE);
+
+	if (!svc_shm_send(xprt, xioq))
+		SVC_DESTROY(xprt);
+}
+
+static enum xprt_stat
+svc_shm_decode(struct svc_req *req)
+{
+	XDR *xdrs = req->rq_xdrs;
+	SVCXPRT *xprt = req->rq_xprt;
+	xdr_uio *reply;
+
+	xdrs->x_op = XDR_DECODE;
+	rpc_msg_init(&req->rq_msg);
+
+	if (!xdr_dplx_decode(xdrs, &req->rq_msg)) {
+		/* records are whole, but the peer is broken */
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		SVC_DESTROY(xprt);
+		return SVC_STAT(xprt);
+	}
+
+	/* in order of likelihood */
+	if (req->rq_msg.rm_direction == CALL) {
+		switch (svc_drc_lookup(req, &reply)) {
+		case SVC_DRC_NEW:
+			/* an ordinary call header */
+			return xprt->xp_dispatch.process_cb(req);
+		case SVC_DRC_HIT:
+			svc_shm_resend(xprt, reply);
+			break;
+		case SVC_DRC_BUSY:
+			break;
+		}
+		return SVC_STAT(xprt);
+	}
+
+	if (req->rq_msg.rm_direction == REPLY) {
+		/* reply header (xprt OK) */
+		return clnt_req_process_reply(xprt, req);
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_WARN,
+		"%s: %p fd %d failed direction %" PRIu32
+		" (will set dead)",
+		__func__, xprt, xprt->xp_fd,
+		req->rq_msg.rm_direction);
+	SVC_DESTROY(xprt);
+	return SVC_STAT(xprt);
+}
+
+static void
+svc_shm_checksum(struct svc_req *req, void *data, size_t length)
+{
+	req->rq_cksum = CityHash64WithSeed(data, MIN(256, length), 103);
+}
+
+static enum xprt_stat
+svc_shm_reply(struct svc_req *req)
+{
+	SVCXPRT *xprt = req->rq_xprt;
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct xdr_ioq *xioq;
+	size_t max_bsize = __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT;
+	size_t hint = req->rq_reply_hint;
+	size_t bsize;
+	u_int len;
+
+	/* sized as svc_vc_reply() */
+	if (!hint && (__svc_params->flags & SVC_FLAG_XDR_SIZEOF))
+		hint = svc_reply_sizeof(req);
+	if (!hint)
+		hint = rec->reply_avg;
+	bsize = xdr_ioq_size_class(hint ? hint : RPC_MAXDATA_DEFAULT);
+	xioq = xdr_ioq_create(MIN(bsize, max_bsize), max_bsize, UIO_FLAG_FREE);
+	xioq->ioq_uv.hint = hint;
+
+	if (!xdr_reply_encode(xioq->xdrs, &req->rq_msg)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d xdr_reply_encode failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		XDR_DESTROY(xioq->xdrs);
+		return (XPRT_DIED);
+	}
+	xdr_tail_update(xioq->xdrs);
+
+	if (req->rq_msg.rm_reply.rp_stat == MSG_ACCEPTED
+	 && req->rq_msg.rm_reply.rp_acpt.ar_stat == SUCCESS
+	 && req->rq_auth
+	 && !SVCAUTH_WRAP(req, xioq->xdrs)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d SVCAUTH_WRAP failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		XDR_DESTROY(xioq->xdrs);
+		return (XPRT_DIED);
+	}
+	xdr_tail_update(xioq->xdrs);
+
+	/* racy, but only a hint (1/8 weight) */
+	len = XDR_GETPOS(xioq->xdrs);
+	rec->reply_avg = rec->reply_avg - (rec->reply_avg >> 3) + (len >> 3);
+
+	if (req->rq_drc)
+		svc_drc_retain(req, xdr_ioq_hold(xioq));
+
+	if (!svc_shm_send(xprt, xioq)) {
+		SVC_DESTROY(xprt);
+		return SVC_STAT(xprt);
+	}
+	return (XPRT_IDLE);
+}
+
+static void
+svc_shm_override_ops(SVCXPRT *xprt, SVCXPRT *rendezvous)
+{
+	static struct xp_ops ops;
+
+	/* VARIABLES PROTECTED BY ops_lock: ops, xp_type */
+	mutex_lock(&ops_lock);
+
+	xprt->xp_type = XPRT_SHM;
+
+	if (ops.xp_recv == NULL) {
+		ops.xp_recv = svc_shm_recv;
+		ops.xp_stat = svc_shm_stat;
+		ops.xp_decode = svc_shm_decode;
+		ops.xp_reply = svc_shm_reply;
+		ops.xp_checksum = svc_shm_checksum;
+		ops.xp_unlink = svc_shm_unlink_it;
+		ops.xp_unref_user_data = NULL;	/* no default */
+		ops.xp_destroy = svc_shm_destroy_it;
+		ops.xp_control = svc_shm_control;
+		ops.xp_free_user_data = NULL;	/* no default */
+	}
+	svc_override_ops(&ops, rendezvous);
+	xprt->xp_ops = &ops;
+	mutex_unlock(&ops_lock);
+}
+
+static void
+svc_shm_rendezvous_ops(SVCXPRT *xprt)
+{
+	static struct xp_ops ops;
+
+	mutex_lock(&ops_lock);
+
+	xprt->xp_type = XPRT_SHM_RENDEZVOUS;
+
+	if (ops.xp_recv == NULL) {
+		ops.xp_recv = svc_shm_rendezvous;
+		ops.xp_stat = svc_rendezvous_stat;
+		ops.xp_decode = (svc_req_fun_t)abort;
+		ops.xp_reply = (svc_req_fun_t)abort;
+		ops.xp_checksum = NULL;		/* not used */
+		ops.xp_unlink = svc_shm_unlink_it;
+		ops.xp_unref_user_data = NULL;	/* no default */
+		ops.xp_destroy = svc_shm_destroy_it;
+		ops.xp_control = svc_shm_rendezvous_control;
+		ops.xp_free_user_data = NULL;	/* no default */
+	}
+	xprt->xp_ops = &ops;
+	mutex_unlock(&ops_lock);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SVC_SHM_H
+#define SVC_SHM_H
+
+#include <rpc/svc.h>
+#include <rpc/xdr_ioq.h>
+#include "rpc_dplx_internal.h"
+
+#define SVC_SHM_MAGIC		0x4e545348	/* "NTSH" */
+#define SVC_SHM_VERSION		2
+
+/* ring data bytes per direction (power of 2) */
+#define SVC_SHM_RING_MIN	(64 * 1024)
+#define SVC_SHM_RING_DEFAULT	(1024 * 1024)
+#define SVC_SHM_RING_MAX	(64 * 1024 * 1024)
+
+/* ring index in the region, by writer */
+#define SVC_SHM_C2S		0	/* calls, client to server */
+#define SVC_SHM_S2C		1	/* replies, server to client */
+
+#define SVC_SHM_CACHELINE	64
+
+/*
+ * Single producer, single consumer ring of record fragments.
+ *
+ * Each fragment is a four-byte header (LAST_FRAG | length, host order)
+ * followed by the data padded to an XDR unit.  Positions are free
+ * running byte counts; the header never straddles the wrap.  sr_head and
+ * sr_tail are on their own cache lines, written only by the reader and
+ * the writer respectively.  The reader rings the writer's eventfd when it
+ * frees room while sr_blocked is set.
+ */
+struct svc_shm_ring {
+	uint64_t sr_head;	/* consumed (reader) */
+	uint8_t sr_pad0[SVC_SHM_CACHELINE - sizeof(uint64_t)];
+	uint64_t sr_tail;	/* produced (writer) */
+	uint8_t sr_pad1[SVC_SHM_CACHELINE - sizeof(uint64_t)];
+	uint32_t sr_waiting;	/* reader is sleeping on its eventfd */
+	uint32_t sr_closed;	/* writer has gone */
+	uint32_t sr_blocked;	/* writer is waiting for room */
+	uint8_t sr_pad2[SVC_SHM_CACHELINE - 3 * sizeof(uint32_t)];
+};
+
+/* at offset 0 of the shared region */
+struct svc_shm_hdr {
+	uint32_t sh_magic;
+	uint32_t sh_version;
+	uint32_t sh_size[2];	/* ring data bytes */
+	uint32_t sh_offset[2];	/* ring data offsets in the region */
+	uint8_t sh_pad[SVC_SHM_CACHELINE - 6 * sizeof(uint32_t)];
+	struct svc_shm_ring sh_ring[2];
+};
+
+/*
+ * Sent by the server on the Unix socket, with SCM_RIGHTS for the region
+ * (memfd), the client to server eventfd, and the server to client
+ * eventfd, in that order.
+ */
+struct svc_shm_hello {
+	uint32_t sh_magic;
+	uint32_t sh_version;
+	uint32_t sh_length;	/* region bytes */
+	uint32_t sh_pad;
+};
+
+#define SVC_SHM_NFDS		3
+
+/**
+ * \struct svc_shm_xprt
+ * Shared memory transport instance
+ *
+ * Wraps struct rpc_dplx_rec, indexed by the receive eventfd (xp_fd).
+ */
+struct svc_shm_xprt {
+	struct rpc_dplx_rec sm_dr;	/* SVCXPRT indexed by fd */
+	struct svc_shm_hdr *sm_hdr;	/* shared region */
+	size_t sm_length;
+	struct svc_shm_ring *sm_rx;
+	struct svc_shm_ring *sm_tx;
+	uint8_t *sm_rx_data;
+	uint8_t *sm_tx_data;
+	uint64_t sm_rx_head;		/* private copy of sm_rx->sr_head */
+	uint32_t sm_rx_size;
+	uint32_t sm_tx_size;
+	struct timespec sm_tx_ts;	/* writeq last moved */
+	int sm_tx_efd;			/* peer's eventfd */
+	int sm_sock;			/* negotiation socket, for liveness */
+};
+#define SHM_DR(p) (opr_containerof((p), struct svc_shm_xprt, sm_dr))
+
+struct svc_shm_hdr *svc_shm_map(int, size_t);
+SVCXPRT *svc_shm_attach(int, int, int, struct svc_shm_hdr *, size_t, int);
+bool svc_shm_send(SVCXPRT *, struct xdr_ioq *);
+
+#endif				/* SVC_SHM_H */
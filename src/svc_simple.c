@@ -230,6 +230,8 @@ universal(struct svc_req *req)
 	char *outdata;
 	char *xdrbuf;
 	struct proglst *pl;
+	struct xdr_arena *arena;
+	bool decoded;
 	extern mutex_t proglst_lock;
 
 	/*
@@ -262,7 +264,15 @@ universal(struct svc_req *req)
 			 */
 			req->rq_msg.rm_xdr.where = xdrbuf;
 			req->rq_msg.rm_xdr.proc = pl->p_inproc;
-			if (!SVCAUTH_CHECKSUM(req)) {
+
+			/* released by xdr_free(), not with the arena */
+			arena = xdr_arena_get(req->rq_xdrs);
+			xdr_arena_detach(req->rq_xdrs);
+			decoded = SVCAUTH_CHECKSUM(req);
+			if (arena)
+				xdr_arena_attach(req->rq_xdrs, arena);
+
+			if (!decoded) {
 				__warnx(TIRPC_DEBUG_FLAG_ERROR,
 					"rpc: SVCAUTH_CHECKSUM failed prog %u vers %u",
 					(unsigned)prog, (unsigned)vers);
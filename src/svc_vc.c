@@ -79,6 +79,9 @@
 #include "svc_xprt.h"
 #include "rpc_dplx_internal.h"
 #include "svc_ioq.h"
+#include "svc_drc.h"
+#include "svc_shm.h"
+#include "svc_handoff.h"
 #include "haproxy.h"
 
 static void svc_vc_rendezvous_ops(SVCXPRT *);
@@ -125,7 +128,7 @@ svc_vc_xprt_free(struct svc_vc_xprt *xd)
 static struct svc_vc_xprt *
 svc_vc_xprt_zalloc(void)
 {
-	struct svc_vc_xprt *xd = mem_zalloc(sizeof(struct svc_vc_xprt));
+	struct svc_vc_xprt *xd = rpc_dplx_rec_zalloc(sizeof(struct svc_vc_xprt));
 
 	/* Init SVCXPRT locks, etc */
 	rpc_dplx_rec_init(&xd->sx_dr);
@@ -458,9 +461,10 @@ svc_vc_rendezvous(SVCXPRT *xprt)
 		}
 		return (XPRT_DIED);
 	}
-	if (unlikely(svc_rqst_rearm_events(xprt, SVC_XPRT_FLAG_ADDED_RECV))) {
+	/* stop accepting while globally over quota */
+	if (unlikely(svc_rqst_rearm_recv(xprt, 0))) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
-			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+			"%s: %p fd %d svc_rqst_rearm_recv failed (will set dead)",
 			__func__, xprt, xprt->xp_fd);
 		close(fd);
 		return (XPRT_DIED);
@@ -557,6 +561,99 @@ svc_vc_rendezvous(SVCXPRT *xprt)
 	return (XPRT_IDLE);
 }
 
+/*
+ * Take over a connection from svc_xprt_handoff_send(), as if just
+ * accepted on rendezvous:  with its addresses as known there, and the
+ * record it was receiving.  Returns with a reference, not registered.
+ */
+SVCXPRT *
+svc_vc_handoff_accept(const int fd, SVCXPRT *rendezvous,
+		      const struct svc_handoff_hdr *ho, const uint8_t *record)
+{
+	SVCXPRT *newxprt;
+	struct rpc_dplx_rec *rec;
+	struct svc_vc_xprt *xd;
+	struct __rpc_sockinfo si;
+	struct xdr_ioq_uv *uv;
+	struct xdr_ioq *xioq;
+	int rc;
+
+	newxprt = makefd_xprt(fd, ho->ho_sendsz, ho->ho_recvsz, &si,
+			      ho->ho_xp_flags & SVC_XPRT_FLAG_CLOSE);
+	if ((!newxprt) || (!(newxprt->xp_flags & SVC_XPRT_FLAG_INITIAL))) {
+		if (newxprt) {
+			SVC_DESTROY(newxprt);
+			SVC_RELEASE(newxprt, SVC_RELEASE_FLAG_NONE);
+		} else {
+			close(fd);
+		}
+		return (NULL);
+	}
+	rec = REC_XPRT(newxprt);
+	xd = VC_DR(rec);
+
+	svc_vc_override_ops(newxprt, rendezvous);
+
+	/* socket options were set on accept, and stay with the socket */
+	__rpc_address_setup(&newxprt->xp_remote);
+	memcpy(newxprt->xp_remote.nb.buf, &ho->ho_remote, ho->ho_remote_len);
+	newxprt->xp_remote.nb.len = ho->ho_remote_len;
+
+	__rpc_address_setup(&newxprt->xp_proxy);
+	memcpy(newxprt->xp_proxy.nb.buf, &ho->ho_proxy, ho->ho_proxy_len);
+	newxprt->xp_proxy.nb.len = ho->ho_proxy_len;
+
+	__rpc_address_setup(&newxprt->xp_local);
+	rc = getsockname(fd, newxprt->xp_local.nb.buf,
+			 &newxprt->xp_local.nb.len);
+	if (rc < 0) {
+		newxprt->xp_local.nb.len = sizeof(struct sockaddr_storage);
+		memset(newxprt->xp_local.nb.buf, 0xfe,
+		       newxprt->xp_local.nb.len);
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d getsockname failed (%d)",
+			 __func__, fd, rc);
+	}
+	XPRT_TRACE(newxprt, __func__, __func__, __LINE__);
+
+#if defined(HAVE_BLKIN)
+	__rpc_set_blkin_endpoint(newxprt, "svc_vc");
+#endif
+
+	xd->sx_dr.maxrec = ho->ho_maxrec;
+	if (ho->ho_xp_flags & SVC_XPRT_FLAG_REMOTE_ADDR_SET)
+		atomic_set_uint16_t_bits(&newxprt->xp_flags,
+					 SVC_XPRT_FLAG_REMOTE_ADDR_SET);
+
+	if (ho->ho_record_len || ho->ho_fbtbc) {
+		/* fragments received are joined in one buffer, sized for
+		 * the rest of the current fragment
+		 */
+		xioq = xdr_ioq_create(xd->sx_dr.pagesz, xd->sx_dr.maxrec,
+				      UIO_FLAG_BUFQ);
+		(rec->ioq.ioq_uv.uvqh.qcount)++;
+		TAILQ_INSERT_TAIL(&rec->ioq.ioq_uv.uvqh.qh, &xioq->ioq_s, q);
+
+		uv = xdr_ioq_uv_create(ho->ho_record_len + ho->ho_fbtbc,
+				       UIO_FLAG_FREE |
+				       (ho->ho_frag_flags & UIO_FLAG_MORE));
+		memcpy(uv->v.vio_tail, record, ho->ho_record_len);
+		uv->v.vio_tail += ho->ho_record_len;
+		(xioq->ioq_uv.uvqh.qcount)++;
+		TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
+
+		xd->sx_fbtbc = ho->ho_fbtbc;
+	}
+
+	SVC_REF(rendezvous, SVC_REF_FLAG_NONE);
+	newxprt->xp_parent = rendezvous;
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+		"%s: %p fd %d record %" PRIu32 " need %" PRIu32,
+		__func__, newxprt, fd, ho->ho_record_len, ho->ho_fbtbc);
+	return (newxprt);
+}
+
 static void
 svc_vc_destroy_task(struct work_pool_entry *wpe)
 {
@@ -585,7 +682,8 @@ svc_vc_destroy_task(struct work_pool_entry *wpe)
 						  SVC_XPRT_FLAG_CLOSE);
 	close_fd = ((xp_flags & SVC_XPRT_FLAG_CLOSE) &&
 		rec->xprt.xp_fd != RPC_ANYFD);
-	if (close_fd) {
+	/* a socket handed off is still open in the successor */
+	if (close_fd && !(xp_flags & SVC_XPRT_FLAG_HANDOFF)) {
 		/* Shutting down without releasing the fd, since
 		 * xp_free_user_data() might be using it */
 		(void)shutdown(rec->xprt.xp_fd, SHUT_RDWR);
@@ -650,16 +748,155 @@ svc_vc_destroy_it(SVCXPRT *xprt, u_int flags, const char *tag, const int line)
 	}
 
 	REC_XPRT(xprt)->ioq.ioq_wpe.fun = svc_vc_destroy_task;
+	REC_XPRT(xprt)->ioq.ioq_wpe.prio = WORK_POOL_PRIO_LOW;
+	REC_XPRT(xprt)->ioq.ioq_wpe.flow = NULL;
 	work_pool_submit(&svc_work_pool, &(REC_XPRT(xprt)->ioq.ioq_wpe));
 }
 
 extern mutex_t ops_lock;
 
+/*
+ * Trim the receive buffer of a record stalled within a fragment
+ * (SVCSET_XP_DORMANT):  it is cut to the bytes already received, and
+ * regrown by svc_vc_rehydrate().
+ *
+ * A connection idle between records holds no receive buffers, as
+ * svc_vc_recv() gives up the xdr_ioq at the end of each record; only one
+ * left empty by a spurious wakeup is freed.  Called by svc_rqst holding
+ * the armed receive event, so no svc_vc_recv() is running.  Returns true
+ * when memory was released.
+ */
+static bool
+svc_vc_trim(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_vc_xprt *xd = VC_DR(rec);
+	struct poolq_entry *have = TAILQ_LAST(&rec->ioq.ioq_uv.uvqh.qh,
+					      poolq_head_s);
+	struct xdr_ioq_uv *uv;
+	struct xdr_ioq *xioq;
+	size_t size;
+	size_t len;
+
+	if (!have)
+		return (false);
+
+	xioq = _IOQ(have);
+	if (!xioq->ioq_uv.uvqh.qcount) {
+		(rec->ioq.ioq_uv.uvqh.qcount)--;
+		TAILQ_REMOVE(&rec->ioq.ioq_uv.uvqh.qh, &xioq->ioq_s, q);
+		xdr_ioq_destroy(xioq, xioq->ioq_s.qsize);
+		return (true);
+	}
+
+	/* between fragments, the buffers are full */
+	if (!xd->sx_fbtbc || xd->sx_dormant_size)
+		return (false);
+
+	uv = IOQ_(TAILQ_LAST(&xioq->ioq_uv.uvqh.qh, poolq_head_s));
+	if (!(uv->u.uio_flags & UIO_FLAG_FREE)
+	    || (uv->u.uio_flags & UIO_FLAG_REFER)
+	    || !ioquv_more(uv))
+		return (false);
+
+	size = ioquv_size(uv);
+	len = uv->v.vio_tail - uv->v.vio_base;
+	if (len) {
+		uint8_t *base = mem_realloc(uv->v.vio_base, len);
+
+		uv->v.vio_head = base + (uv->v.vio_head - uv->v.vio_base);
+		uv->v.vio_base = base;
+	} else {
+		mem_free(uv->v.vio_base, size);
+		uv->v.vio_head = uv->v.vio_base = NULL;
+	}
+	uv->v.vio_tail = uv->v.vio_base + len;
+	uv->v.vio_wrap = uv->v.vio_tail;
+	xd->sx_dormant_size = size;
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+		"%s: %p fd %d uv %p trimmed %zu to %zu",
+		__func__, xprt, xprt->xp_fd, uv, size, len);
+	return (true);
+}
+
+/*
+ * Copy out the partially received record for svc_xprt_handoff_send(),
+ * filling the ho_fbtbc, ho_frag_flags and ho_record_len of ho.  Called
+ * with receive held, so no svc_vc_recv() is running.  Returns the bytes
+ * to be released by mem_free(), or NULL when none.
+ */
+uint8_t *
+svc_vc_handoff_record(SVCXPRT *xprt, struct svc_handoff_hdr *ho)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_vc_xprt *xd = VC_DR(rec);
+	struct poolq_entry *have = TAILQ_LAST(&rec->ioq.ioq_uv.uvqh.qh,
+					      poolq_head_s);
+	struct poolq_entry *have_uv;
+	struct xdr_ioq_uv *uv;
+	struct xdr_ioq *xioq;
+	uint8_t *record;
+	uint8_t *p;
+	size_t len = 0;
+
+	ho->ho_fbtbc = xd->sx_fbtbc;
+	ho->ho_frag_flags = 0;
+	ho->ho_record_len = 0;
+
+	if (!have)
+		return (NULL);
+
+	xioq = _IOQ(have);
+	TAILQ_FOREACH(have_uv, &xioq->ioq_uv.uvqh.qh, q)
+		len += ioquv_length(IOQ_(have_uv));
+
+	/* placed segments are copied too, the successor has no place_cb
+	 * state for them
+	 */
+	have_uv = TAILQ_LAST(&xioq->ioq_uv.uvqh.qh, poolq_head_s);
+	if (have_uv && xd->sx_fbtbc)
+		ho->ho_frag_flags = IOQ_(have_uv)->u.uio_flags & UIO_FLAG_MORE;
+
+	if (!len)
+		return (NULL);
+
+	p = record = mem_alloc(len);
+	TAILQ_FOREACH(have_uv, &xioq->ioq_uv.uvqh.qh, q) {
+		uv = IOQ_(have_uv);
+		memcpy(p, uv->v.vio_head, ioquv_length(uv));
+		p += ioquv_length(uv);
+	}
+	ho->ho_record_len = len;
+	return (record);
+}
+
+/*
+ * Regrow the receive buffer cut by svc_vc_trim(), keeping its original
+ * size for payload placement.
+ */
+static void
+svc_vc_rehydrate(struct svc_vc_xprt *xd, struct xdr_ioq_uv *uv)
+{
+	size_t len = uv->v.vio_tail - uv->v.vio_base;
+	size_t head = uv->v.vio_head - uv->v.vio_base;
+	uint8_t *base = len ? mem_realloc(uv->v.vio_base, xd->sx_dormant_size)
+			    : mem_alloc(xd->sx_dormant_size);
+
+	uv->v.vio_base = base;
+	uv->v.vio_head = base + head;
+	uv->v.vio_tail = base + len;
+	uv->v.vio_wrap = base + xd->sx_dormant_size;
+	xd->sx_dormant_size = 0;
+}
+
  /*ARGSUSED*/
 static bool
 svc_vc_control(SVCXPRT *xprt, const u_int rq, void *in)
 {
 	switch (rq) {
+	case SVCSET_XP_DORMANT:
+		return (svc_vc_trim(xprt));
 	case SVCGET_XP_FLAGS:
 		*(u_int *) in = xprt->xp_flags;
 		break;
@@ -942,6 +1179,54 @@ static enum haproxy_ret_code handle_haproxy_header(SVCXPRT *xprt)
 	return ret;
 }
 
+/*
+ * Append the next receive buffer, after the current one was filled
+ * before the end of its fragment.
+ *
+ * Only happens for records split by payload placement:  the first (full)
+ * buffer holds the header prefix, passed to place_cb; the following ones
+ * refer to the application vectors, then a library buffer for any rest.
+ */
+static struct xdr_ioq_uv *
+svc_vc_recv_next(SVCXPRT *xprt, struct xdr_ioq *xioq, struct xdr_ioq_uv *uv)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	xdr_uio *uio = xd->sx_place_uio;
+
+	if (!uio && xioq->ioq_uv.uvqh.qcount == 1) {
+		uio = __svc_params->place_cb(xprt, uv->v.vio_head,
+					     ioquv_length(uv), xd->sx_fbtbc);
+		if (uio && !uio->uio_count) {
+			uio->uio_release(uio, UIO_FLAG_NONE);
+			uio = NULL;
+		}
+		xd->sx_place_uio = uio;
+		xd->sx_place_ix = 0;
+	}
+
+	if (uio && xd->sx_place_ix < uio->uio_count) {
+		uv = xdr_ioq_uv_create(0, UIO_FLAG_REFER);
+		uv->v = uio->uio_vio[xd->sx_place_ix];
+		uv->u.uio_refer = uio;
+
+		/* the first consumes the reference from place_cb */
+		if (xd->sx_place_ix++)
+			atomic_inc_int32_t(&uio->uio_references);
+	} else {
+		xd->sx_place_uio = NULL;
+		uv = xdr_ioq_uv_create(xd->sx_fbtbc, UIO_FLAG_FREE);
+	}
+
+	(xioq->ioq_uv.uvqh.qcount)++;
+	TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+		"%s: %p fd %d uv %p (%lu) need %" PRIu32,
+		__func__, xprt, xprt->xp_fd, uv,
+		(unsigned long) ioquv_more(uv), xd->sx_fbtbc);
+	return (uv);
+}
+
 static enum xprt_stat
 svc_vc_recv(SVCXPRT *xprt)
 {
@@ -1068,16 +1353,32 @@ again:
 			return SVC_STAT(xprt);
 		}
 
-		/* one buffer per fragment */
-		uv = xdr_ioq_uv_create(xd->sx_fbtbc, flags);
+		if (__svc_params->place_cb
+		 && !(flags & UIO_FLAG_MORE)
+		 && !xioq->ioq_uv.uvqh.qcount
+		 && xd->sx_fbtbc > __svc_params->place_hdr_max) {
+			/* header prefix, then svc_vc_recv_next() */
+			uv = xdr_ioq_uv_create(__svc_params->place_hdr_max,
+					       flags);
+		} else {
+			/* one buffer per fragment */
+			uv = xdr_ioq_uv_create(xd->sx_fbtbc, flags);
+		}
 		(xioq->ioq_uv.uvqh.qcount)++;
 		TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
 	} else {
 		uv = IOQ_(TAILQ_LAST(&xioq->ioq_uv.uvqh.qh, poolq_head_s));
 		flags = uv->u.uio_flags;
+		if (unlikely(xd->sx_dormant_size))
+			svc_vc_rehydrate(xd, uv);
 	}
 
-	rlen = recv(xprt->xp_fd, uv->v.vio_tail, xd->sx_fbtbc, MSG_DONTWAIT);
+more:
+	if (!ioquv_more(uv))
+		uv = svc_vc_recv_next(xprt, xioq, uv);
+
+	rlen = recv(xprt->xp_fd, uv->v.vio_tail,
+		    MIN(xd->sx_fbtbc, ioquv_more(uv)), MSG_DONTWAIT);
 
 	if (unlikely(rlen < 0)) {
 		code = errno;
@@ -1135,6 +1436,11 @@ again:
 		"%s: %p fd %d recv %zd, need %" PRIu32 ", flags %x",
 		__func__, xprt, xprt->xp_fd, rlen, xd->sx_fbtbc, flags);
 
+	if (xd->sx_fbtbc && !ioquv_more(uv)) {
+		/* placement split, more may already be waiting */
+		goto more;
+	}
+
 	if (xd->sx_fbtbc || (flags & UIO_FLAG_MORE)) {
 		if (unlikely(svc_rqst_rearm_events(xprt,
 						   SVC_XPRT_FLAG_ADDED_RECV))) {
@@ -1153,6 +1459,7 @@ again:
 	}
 
 	/* finished a request */
+	xd->sx_place_uio = NULL;
 	(rec->ioq.ioq_uv.uvqh.qcount)--;
 	TAILQ_REMOVE(&rec->ioq.ioq_uv.uvqh.qh, &xioq->ioq_s, q);
 	xdr_ioq_reset(xioq, 0);
@@ -1164,9 +1471,9 @@ again:
 		}
 	}
 
-	if (unlikely(svc_rqst_rearm_events(xprt, SVC_XPRT_FLAG_ADDED_RECV))) {
+	if (unlikely(svc_rqst_rearm_recv(xprt, 1))) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
-			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+			"%s: %p fd %d svc_rqst_rearm_recv failed (will set dead)",
 			__func__, xprt, xprt->xp_fd);
 		xdr_ioq_destroy(xioq, xioq->ioq_s.qsize);
 		SVC_DESTROY(xprt);
@@ -1183,11 +1490,27 @@ again:
 	return svc_request(xprt, xioq->xdrs);
 }
 
+/*
+ * Resend a reply retained by the duplicate request cache.
+ */
+static void
+svc_vc_resend(SVCXPRT *xprt, xdr_uio *reply)
+{
+	struct xdr_ioq *xioq = xdr_ioq_create_refer(reply);
+
+	/* the segments hold their own references */
+	reply->uio_release(reply, UIO_FLAG_NONE);
+
+	xioq->xdrs[0].x_lib[1] = (void *)xprt;
+	svc_ioq_write_now(xprt, xioq);
+}
+
 static enum xprt_stat
 svc_vc_decode(struct svc_req *req)
 {
 	XDR *xdrs = req->rq_xdrs;
 	SVCXPRT *xprt = req->rq_xprt;
+	xdr_uio *reply;
 
 	/* No need, already positioned to beginning ...
 	XDR_SETPOS(xdrs, 0);
@@ -1206,8 +1529,17 @@ svc_vc_decode(struct svc_req *req)
 
 	/* in order of likelihood */
 	if (req->rq_msg.rm_direction == CALL) {
-		/* an ordinary call header */
-		return xprt->xp_dispatch.process_cb(req);
+		switch (svc_drc_lookup(req, &reply)) {
+		case SVC_DRC_NEW:
+			/* an ordinary call header */
+			return xprt->xp_dispatch.process_cb(req);
+		case SVC_DRC_HIT:
+			svc_vc_resend(xprt, reply);
+			break;
+		case SVC_DRC_BUSY:
+			break;
+		}
+		return SVC_STAT(xprt);
 	}
 
 	if (req->rq_msg.rm_direction == REPLY) {
@@ -1241,14 +1573,25 @@ static enum xprt_stat
 svc_vc_reply(struct svc_req *req)
 {
 	SVCXPRT *xprt = req->rq_xprt;
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
 	struct xdr_ioq *xioq;
-
-	/* Nb, we should probably use getpagesize() on Unix.  Need
-	 * an equivalent for Windows.
+	size_t max_bsize = __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT;
+	size_t hint = req->rq_reply_hint;
+	size_t bsize;
+	u_int len;
+
+	/* Size the first segment from the caller's estimate, else the
+	 * counted reply (SVC_INIT_XDR_SIZEOF), else the recent replies on
+	 * this transport; further segments are sized from the remainder
+	 * of the hint (xdr_ioq_uv_append).
 	 */
-	xioq = xdr_ioq_create(RPC_MAXDATA_DEFAULT,
-			      __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT,
-			      UIO_FLAG_FREE);
+	if (!hint && (__svc_params->flags & SVC_FLAG_XDR_SIZEOF))
+		hint = svc_reply_sizeof(req);
+	if (!hint)
+		hint = rec->reply_avg;
+	bsize = xdr_ioq_size_class(hint ? hint : RPC_MAXDATA_DEFAULT);
+	xioq = xdr_ioq_create(MIN(bsize, max_bsize), max_bsize, UIO_FLAG_FREE);
+	xioq->ioq_uv.hint = hint;
 
 	if (!xdr_reply_encode(xioq->xdrs, &req->rq_msg)) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
@@ -1269,6 +1612,13 @@ svc_vc_reply(struct svc_req *req)
 	}
 	xdr_tail_update(xioq->xdrs);
 
+	/* racy, but only a hint (1/8 weight) */
+	len = XDR_GETPOS(xioq->xdrs);
+	rec->reply_avg = rec->reply_avg - (rec->reply_avg >> 3) + (len >> 3);
+
+	if (req->rq_drc)
+		svc_drc_retain(req, xdr_ioq_hold(xioq));
+
 	xioq->xdrs[0].x_lib[1] = (void *)req->rq_xprt;
 	svc_ioq_write_now(req->rq_xprt, xioq);
 	return (XPRT_IDLE);
@@ -1340,6 +1690,10 @@ __rpc_get_local_uid(SVCXPRT *transp, uid_t *uid)
 	struct sockaddr *sa;
 
 	sock = transp->xp_fd;
+	if (transp->xp_type == XPRT_SHM) {
+		/* xp_fd is an eventfd, ask the negotiation socket */
+		sock = SHM_DR(REC_XPRT(transp))->sm_sock;
+	}
 	sa = (struct sockaddr *)&transp->xp_remote.ss;
 	if (sa->sa_family == AF_LOCAL) {
 		ret = getpeereid(sock, &euid, &egid);
@@ -0,0 +1,499 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file trace_ring.c
+ * @brief Binary trace rings for __warnx()
+ *
+ * @section DESCRIPTION
+ *
+ * With TIRPC_OTHER_FLAG_TRACE_RING set, __warnx() does not format its
+ * message.  The format pointer and raw arguments are stored in a ring
+ * owned by the calling thread, without locks.  Strings are copied, as
+ * they may be gone by the time the rings are decoded.
+ *
+ * tirpc_control(TIRPC_DUMP_TRACE_RING, out) formats the records of all
+ * rings, in time order, through out (or warnx_ when NULL).
+ *
+ * Rings are never freed.  The ring of an exited thread keeps its records
+ * until a new thread takes it over, clearing them, so memory is bounded
+ * by the most threads ever tracing at once.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rpc/types.h>
+#include <misc/abstract_atomic.h>
+#include <misc/portable.h>
+#include <intrinsic.h>
+#include <reentrant.h>
+
+#define TRACE_RING_RECORDS	1024	/* per thread, power of 2 */
+#define TRACE_REC_ARGS		8
+#define TRACE_REC_STRS		48
+
+struct trace_rec {
+	uint32_t seq;		/* odd while writing */
+	uint16_t nargs;
+	uint16_t slen;		/* used in strs */
+	uint64_t ts_ns;
+	const char *fmt;	/* NULL: empty */
+	uint64_t args[TRACE_REC_ARGS];
+	char strs[TRACE_REC_STRS];
+};
+
+struct trace_ring {
+	struct trace_ring *next;	/* all rings */
+	pid_t tid;
+	bool owned;
+	uint32_t head;		/* next record, free running */
+	struct trace_rec rec[TRACE_RING_RECORDS];
+};
+
+static struct {
+	pthread_mutex_t mtx;
+	pthread_once_t once;
+	pthread_key_t key;
+	struct trace_ring *rings;
+} trace_rings = {
+	MUTEX_INITIALIZER,
+	PTHREAD_ONCE_INIT,
+};
+
+static __thread struct trace_ring *trace_ring_mine;
+
+/* argument classes, shared by capture and decode */
+enum trace_arg {
+	TRACE_ARG_NONE,
+	TRACE_ARG_INT,
+	TRACE_ARG_UINT,
+	TRACE_ARG_DOUBLE,
+	TRACE_ARG_PTR,
+	TRACE_ARG_STR,
+};
+
+struct trace_spec {
+	const char *start;	/* at '%' */
+	const char *end;	/* after conversion */
+	int stars;		/* '*' width and precision (int) arguments */
+	char lmod[3];
+	enum trace_arg arg;
+};
+
+/*
+ * Parse the next printf conversion at or after p.  Returns NULL at the end
+ * of the format.  Unknown conversions end the parse.
+ */
+static const char *
+trace_spec_next(const char *p, struct trace_spec *spec)
+{
+	int ix = 0;
+
+	for (;;) {
+		p = strchr(p, '%');
+		if (!p)
+			return (NULL);
+		if (p[1] != '%')
+			break;
+		p += 2;
+	}
+	memset(spec, 0, sizeof(*spec));
+	spec->start = p++;
+
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	if (*p == '*') {
+		spec->stars++;
+		p++;
+	}
+	while (*p >= '0' && *p <= '9')
+		p++;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->stars++;
+			p++;
+		}
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+	while (*p && strchr("hljztL", *p) && ix < 2)
+		spec->lmod[ix++] = *p++;
+
+	switch (*p) {
+	case 'd':
+	case 'i':
+		spec->arg = TRACE_ARG_INT;
+		break;
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'o':
+	case 'c':
+		spec->arg = TRACE_ARG_UINT;
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		spec->arg = TRACE_ARG_DOUBLE;
+		break;
+	case 'p':
+		spec->arg = TRACE_ARG_PTR;
+		break;
+	case 's':
+		spec->arg = TRACE_ARG_STR;
+		break;
+	default:
+		return (NULL);
+	}
+	spec->end = ++p;
+	return (p);
+}
+
+static void
+trace_ring_exit(void *arg)
+{
+	struct trace_ring *ring = arg;
+
+	mutex_lock(&trace_rings.mtx);
+	ring->owned = false;
+	mutex_unlock(&trace_rings.mtx);
+}
+
+static void
+trace_ring_key(void)
+{
+	(void)pthread_key_create(&trace_rings.key, trace_ring_exit);
+}
+
+static struct trace_ring *
+trace_ring_get(void)
+{
+	struct trace_ring *ring;
+	u_int ix;
+
+	(void)pthread_once(&trace_rings.once, trace_ring_key);
+
+	mutex_lock(&trace_rings.mtx);
+	for (ring = trace_rings.rings; ring; ring = ring->next) {
+		if (!ring->owned)
+			break;
+	}
+	if (!ring) {
+		ring = mem_zalloc(sizeof(*ring));
+		ring->next = trace_rings.rings;
+		trace_rings.rings = ring;
+	} else {
+		/* not to be dumped under the new tid */
+		for (ix = 0; ix < TRACE_RING_RECORDS; ix++)
+			ring->rec[ix].fmt = NULL;
+	}
+	ring->owned = true;
+	ring->tid = syscall(SYS_gettid);
+	mutex_unlock(&trace_rings.mtx);
+
+	(void)pthread_setspecific(trace_rings.key, ring);
+	return (ring);
+}
+
+void
+__ntirpc_trace(const char *fmt, ...)
+{
+	struct trace_ring *ring = trace_ring_mine;
+	struct trace_spec spec;
+	struct trace_rec *rec;
+	struct timespec ts;
+	const char *p = fmt;
+	va_list ap;
+	int ix;
+
+	if (unlikely(!ring))
+		ring = trace_ring_mine = trace_ring_get();
+
+	rec = &ring->rec[ring->head++ & (TRACE_RING_RECORDS - 1)];
+	atomic_inc_uint32_t(&rec->seq);
+
+	(void)clock_gettime(CLOCK_REALTIME, &ts);
+	rec->ts_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	rec->fmt = fmt;
+	rec->nargs = 0;
+	rec->slen = 0;
+
+	va_start(ap, fmt);
+	while (rec->nargs < TRACE_REC_ARGS
+	       && (p = trace_spec_next(p, &spec))) {
+		for (ix = 0; ix < spec.stars && rec->nargs < TRACE_REC_ARGS;
+		     ix++)
+			rec->args[rec->nargs++] = (int64_t)va_arg(ap, int);
+		if (rec->nargs >= TRACE_REC_ARGS)
+			break;
+
+		switch (spec.arg) {
+		case TRACE_ARG_INT:
+			if (spec.lmod[0] == 'l' && spec.lmod[1] == 'l')
+				rec->args[rec->nargs] = va_arg(ap, long long);
+			else if (spec.lmod[0] == 'l' || spec.lmod[0] == 'z'
+			      || spec.lmod[0] == 't')
+				rec->args[rec->nargs] = va_arg(ap, long);
+			else if (spec.lmod[0] == 'j')
+				rec->args[rec->nargs] = va_arg(ap, intmax_t);
+			else
+				rec->args[rec->nargs] = va_arg(ap, int);
+			break;
+		case TRACE_ARG_UINT:
+			if (spec.lmod[0] == 'l' && spec.lmod[1] == 'l')
+				rec->args[rec->nargs] =
+					va_arg(ap, unsigned long long);
+			else if (spec.lmod[0] == 'l' || spec.lmod[0] == 'z'
+			      || spec.lmod[0] == 't')
+				rec->args[rec->nargs] =
+					va_arg(ap, unsigned long);
+			else if (spec.lmod[0] == 'j')
+				rec->args[rec->nargs] = va_arg(ap, uintmax_t);
+			else
+				rec->args[rec->nargs] =
+					va_arg(ap, unsigned int);
+			break;
+		case TRACE_ARG_DOUBLE:
+		{
+			double d = (spec.lmod[0] == 'L')
+				 ? (double)va_arg(ap, long double)
+				 : va_arg(ap, double);
+
+			memcpy(&rec->args[rec->nargs], &d, sizeof(d));
+			break;
+		}
+		case TRACE_ARG_PTR:
+			rec->args[rec->nargs] =
+				(uintptr_t)va_arg(ap, void *);
+			break;
+		case TRACE_ARG_STR:
+		{
+			const char *s = va_arg(ap, const char *);
+			size_t room = TRACE_REC_STRS - rec->slen;
+			size_t len;
+
+			if (!s)
+				s = "(null)";	/* as printf */
+			len = strnlen(s, room ? room - 1 : 0);
+
+			/* offset of the (truncated) copy */
+			rec->args[rec->nargs] = rec->slen;
+			if (room) {
+				memcpy(&rec->strs[rec->slen], s, len);
+				rec->strs[rec->slen + len] = '\0';
+				rec->slen += len + 1;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+		rec->nargs++;
+	}
+	va_end(ap);
+
+	atomic_inc_uint32_t(&rec->seq);
+}
+
+/*
+ * Format one conversion with its captured argument(s).
+ */
+static int
+trace_spec_format(char *buf, size_t size, struct trace_spec *spec,
+		  const struct trace_rec *rec, int *argx)
+{
+	char conv[32];
+	int star[2] = {0, 0};
+	size_t clen = spec->end - spec->start;
+	uint64_t v;
+	int ix;
+
+	if (clen >= sizeof(conv))
+		return (0);
+	memcpy(conv, spec->start, clen);
+	conv[clen] = '\0';
+
+	for (ix = 0; ix < spec->stars; ix++) {
+		if (*argx >= rec->nargs)
+			return (snprintf(buf, size, "%%?"));
+		star[ix] = (int)rec->args[(*argx)++];
+	}
+	if (*argx >= rec->nargs)
+		return (snprintf(buf, size, "%%?"));
+	v = rec->args[(*argx)++];
+
+#define TRACE_SNPRINTF(value) \
+	(spec->stars == 2 ? snprintf(buf, size, conv, star[0], star[1], value) \
+	 : spec->stars == 1 ? snprintf(buf, size, conv, star[0], value) \
+	 : snprintf(buf, size, conv, value))
+
+	switch (spec->arg) {
+	case TRACE_ARG_INT:
+	case TRACE_ARG_UINT:
+		if (spec->lmod[0] == 'l' && spec->lmod[1] == 'l')
+			return (TRACE_SNPRINTF((long long)v));
+		if (spec->lmod[0] == 'l' || spec->lmod[0] == 'z'
+		 || spec->lmod[0] == 't')
+			return (TRACE_SNPRINTF((long)v));
+		if (spec->lmod[0] == 'j')
+			return (TRACE_SNPRINTF((intmax_t)v));
+		return (TRACE_SNPRINTF((int)v));
+	case TRACE_ARG_DOUBLE:
+	{
+		double d;
+
+		memcpy(&d, &v, sizeof(d));
+		if (spec->lmod[0] == 'L')
+			return (TRACE_SNPRINTF((long double)d));
+		return (TRACE_SNPRINTF(d));
+	}
+	case TRACE_ARG_PTR:
+		return (TRACE_SNPRINTF((void *)(uintptr_t)v));
+	case TRACE_ARG_STR:
+		return (TRACE_SNPRINTF(v < TRACE_REC_STRS
+				       ? &rec->strs[v] : "?"));
+	default:
+		break;
+	}
+#undef TRACE_SNPRINTF
+	return (0);
+}
+
+static void
+trace_rec_format(char *buf, size_t size, const struct trace_rec *rec)
+{
+	struct trace_spec spec;
+	const char *p = rec->fmt;
+	const char *q, *e;
+	size_t used = 0;
+	int argx = 0;
+	int n;
+
+	while (used < size - 1) {
+		q = trace_spec_next(p, &spec);
+
+		/* literal text, unescaping "%%" */
+		for (e = q ? spec.start : p + strlen(p);
+		     p < e && used < size - 1; p++) {
+			buf[used++] = *p;
+			if (*p == '%' && p + 1 < e && p[1] == '%')
+				p++;
+		}
+		if (!q || used >= size - 1)
+			break;
+
+		n = trace_spec_format(buf + used, size - used, &spec, rec,
+				      &argx);
+		used += (n > 0) ? n : 0;
+		if (used > size - 1)
+			used = size - 1;
+		p = q;
+	}
+	buf[used] = '\0';
+}
+
+struct trace_dump {
+	struct trace_rec rec;
+	pid_t tid;
+};
+
+static int
+trace_dump_cmpf(const void *lhs, const void *rhs)
+{
+	const struct trace_dump *lk = lhs;
+	const struct trace_dump *rk = rhs;
+
+	if (lk->rec.ts_ns < rk->rec.ts_ns)
+		return (-1);
+	return (lk->rec.ts_ns > rk->rec.ts_ns);
+}
+
+/*
+ * Decode all rings in time order.  Records being written (or overwritten)
+ * while copied are skipped.
+ */
+void
+tirpc_trace_dump(mem_format_t out)
+{
+	struct trace_ring *ring;
+	struct trace_dump *dump;
+	size_t count = 0;
+	size_t n = 0;
+	size_t ix;
+	char buf[512];
+
+	if (!out)
+		out = __ntirpc_pkg_params.warnx_;
+
+	mutex_lock(&trace_rings.mtx);
+	for (ring = trace_rings.rings; ring; ring = ring->next)
+		count += TRACE_RING_RECORDS;
+
+	dump = mem_alloc(count * sizeof(*dump) + 1);
+	for (ring = trace_rings.rings; ring; ring = ring->next) {
+		for (ix = 0; ix < TRACE_RING_RECORDS; ix++) {
+			struct trace_rec *rec = &ring->rec[ix];
+			uint32_t seq = atomic_fetch_uint32_t(&rec->seq);
+
+			if ((seq & 1) || !rec->fmt)
+				continue;
+			dump[n].rec = *rec;
+			if (atomic_fetch_uint32_t(&rec->seq) != seq)
+				continue;
+			dump[n++].tid = ring->tid;
+		}
+	}
+	mutex_unlock(&trace_rings.mtx);
+
+	qsort(dump, n, sizeof(*dump), trace_dump_cmpf);
+
+	for (ix = 0; ix < n; ix++) {
+		trace_rec_format(buf, sizeof(buf), &dump[ix].rec);
+		out("%" PRIu64 ".%09" PRIu64 " [%d] %s",
+		    dump[ix].rec.ts_ns / 1000000000ULL,
+		    dump[ix].rec.ts_ns % 1000000000ULL,
+		    (int)dump[ix].tid, buf);
+	}
+	mem_free(dump, count * sizeof(*dump) + 1);
+}
@@ -62,26 +62,52 @@
 
 #define WORK_POOL_STACK_SIZE MAX(1 * 1024 * 1024, PTHREAD_STACK_MIN)
 #define WORK_POOL_TIMEOUT_MS (31 /* seconds (prime) */ * 1000)
+#define WORK_POOL_SPAWN_INTERVAL_MS (10)
 
 /* forward declaration in lieu of moving code, was inline */
 
 static int work_pool_spawn(struct work_pool *pool);
 
+static inline uint64_t
+work_pool_now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/* lane service order */
+static const uint32_t work_pool_lane_order[WORK_POOL_PRIOS] = {
+	WORK_POOL_PRIO_HIGH,
+	WORK_POOL_PRIO_NORMAL,
+	WORK_POOL_PRIO_LOW,
+};
+
 int
 work_pool_init(struct work_pool *pool, const char *name,
 		struct work_pool_params *params)
 {
+	int ix;
 	int rc;
 
 	memset(pool, 0, sizeof(*pool));
 	poolq_head_setup(&pool->pqh);
 	TAILQ_INIT(&pool->wptqh);
 
-	pool->timeout_ms = WORK_POOL_TIMEOUT_MS;
+	for (ix = 0; ix < WORK_POOL_PRIOS; ix++) {
+		TAILQ_INIT(&pool->lane[ix].flows);
+		work_pool_flow_init(&pool->lane[ix].fifo, 1);
+	}
 
 	pool->name = mem_strdup(name);
 	pool->params = *params;
 
+	pool->timeout_ms = pool->params.idle_reap_ms
+			 ? pool->params.idle_reap_ms : WORK_POOL_TIMEOUT_MS;
+	if (!pool->params.spawn_interval_ms)
+		pool->params.spawn_interval_ms = WORK_POOL_SPAWN_INTERVAL_MS;
+
 	if (pool->params.thrd_min < 1) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
 			"%s() thrd_min (%d) < 1",
@@ -132,9 +158,168 @@ work_pool_init(struct work_pool *pool, const char *name,
 
 	/* initial spawn will spawn more threads as needed */
 	pool->n_threads = 1;
+	pool->stats.spawned = 1;
 	return work_pool_spawn(pool);
 }
 
+/**
+ * @brief Account queue wait of a dequeued entry
+ *
+ * @param[in] pool	work pool, qmutex held
+ */
+
+static inline void
+work_pool_wait(struct work_pool *pool, struct work_pool_entry *work)
+{
+	uint64_t now = work_pool_now_ns();
+	uint32_t wait_us = now > work->queued_ns
+			 ? (now - work->queued_ns) / 1000 : 0;
+	int64_t delta = (int64_t)wait_us - pool->stats.wait_avg_us;
+
+	pool->stats.dispatched++;
+	pool->stats.wait_avg_us += delta / 8;
+	if (pool->stats.wait_max_us < wait_us)
+		pool->stats.wait_max_us = wait_us;
+}
+
+/**
+ * @brief Decide whether the dequeuing thread adds another
+ *
+ * Without a wait target, keep thrd_min threads idle.  Otherwise, keep
+ * one idle thread while the queue is empty (event loops may block every
+ * worker), and add more, up to thrd_min idle, only while the measured
+ * wait is above target, no more often than spawn_interval_ms.  Entries
+ * are only left queued while every thread is busy, so finishing threads
+ * will reach this test again.
+ *
+ * @param[in] pool	work pool, qmutex held
+ */
+
+static inline bool
+work_pool_want_spawn(struct work_pool *pool)
+{
+	uint64_t now;
+
+	if (pool->n_threads >= pool->params.thrd_max)
+		return (false);
+
+	if (!pool->params.wait_target_us)
+		return (pool->pqh.qcount < pool->params.thrd_min);
+
+	if (!pool->pqh.qcount && !pool->n_queued)
+		return (true);
+
+	if (pool->pqh.qcount >= pool->params.thrd_min
+	 || pool->stats.wait_avg_us <= pool->params.wait_target_us)
+		return (false);
+
+	now = work_pool_now_ns();
+	if (now - pool->spawn_ns
+	    < pool->params.spawn_interval_ms * 1000000ULL) {
+		pool->stats.spawn_limited++;
+		return (false);
+	}
+	pool->spawn_ns = now;
+	return (true);
+}
+
+/**
+ * @brief Decide whether an idle thread stays after its timeout
+ *
+ * With a wait target, one idle thread is kept, and the others only while
+ * the average wait (halved at each idle timeout) is above half target.
+ *
+ * @param[in] pool	work pool, qmutex held
+ */
+
+static inline bool
+work_pool_keep_idle(struct work_pool *pool)
+{
+	if (!pool->params.thrd_max)
+		return (false);	/* shutdown */
+
+	if (!pool->params.wait_target_us)
+		return (pool->pqh.qcount < pool->params.thrd_min);
+
+	if (pool->pqh.qcount < 1)
+		return (true);
+
+	pool->stats.wait_avg_us /= 2;
+	if (pool->stats.wait_avg_us > pool->params.wait_target_us / 2) {
+		pool->stats.reap_held++;
+		return (true);
+	}
+	return (false);
+}
+
+/**
+ * @brief Take the next entry
+ *
+ * Lanes are strictly ordered, except that a lower lane passed over
+ * WORK_POOL_LANE_STARVE times is served next.  Within a lane, active
+ * flows are served round robin, up to quantum entries each.
+ *
+ * @param[in] pool	work pool, qmutex held
+ */
+
+static struct poolq_entry *
+work_pool_dequeue(struct work_pool *pool)
+{
+	struct work_pool_lane *lane = NULL;
+	struct work_pool_flow *flow;
+	struct poolq_entry *have;
+	int ix;
+
+	if (!pool->n_queued)
+		return (NULL);
+
+	for (ix = WORK_POOL_PRIOS - 1; ix > 0; ix--) {
+		struct work_pool_lane *wpl =
+			&pool->lane[work_pool_lane_order[ix]];
+
+		if (wpl->skipped >= WORK_POOL_LANE_STARVE
+		 && !TAILQ_EMPTY(&wpl->flows)) {
+			lane = wpl;
+			break;
+		}
+	}
+
+	for (ix = 0; !lane && ix < WORK_POOL_PRIOS; ix++) {
+		struct work_pool_lane *wpl =
+			&pool->lane[work_pool_lane_order[ix]];
+
+		if (!TAILQ_EMPTY(&wpl->flows))
+			lane = wpl;
+	}
+
+	for (ix = 0; ix < WORK_POOL_PRIOS; ix++) {
+		struct work_pool_lane *wpl =
+			&pool->lane[work_pool_lane_order[ix]];
+
+		if (wpl == lane)
+			wpl->skipped = 0;
+		else if (!TAILQ_EMPTY(&wpl->flows))
+			wpl->skipped++;
+	}
+
+	flow = TAILQ_FIRST(&lane->flows);
+	have = TAILQ_FIRST(&flow->qh);
+	TAILQ_REMOVE(&flow->qh, have, q);
+	pool->n_queued--;
+	work_pool_wait(pool, (struct work_pool_entry *)have);
+
+	if (TAILQ_EMPTY(&flow->qh)) {
+		TAILQ_REMOVE(&lane->flows, flow, wpfq);
+		flow->active = false;
+	} else if (!--(flow->deficit)) {
+		/* end of this round, to the back of the line */
+		flow->deficit = flow->quantum;
+		TAILQ_REMOVE(&lane->flows, flow, wpfq);
+		TAILQ_INSERT_TAIL(&lane->flows, flow, wpfq);
+	}
+	return (have);
+}
+
 /**
  * @brief The worker thread
  *
@@ -170,10 +355,11 @@ work_pool_thread(void *arg)
 		 */
 		if (wpt->work) {
 			wpt->work->wpt = wpt;
-			spawn = pool->pqh.qcount < pool->params.thrd_min
-			      && pool->n_threads < pool->params.thrd_max;
-			if (spawn)
+			spawn = work_pool_want_spawn(pool);
+			if (spawn) {
 				pool->n_threads++;
+				pool->stats.spawned++;
+			}
 			pthread_mutex_unlock(&pool->pqh.qmutex);
 
 			if (spawn) {
@@ -191,9 +377,8 @@ work_pool_thread(void *arg)
 		/*
 		 * Check for any queued work to avoid scheduling.
 		 */
-		have = TAILQ_FIRST(&pool->pqh.qh);
+		have = work_pool_dequeue(pool);
 		if (have) {
-			TAILQ_REMOVE(&pool->pqh.qh, have, q);
 			wpt->work = (struct work_pool_entry *)have;
 			continue;
 		}
@@ -247,10 +432,10 @@ work_pool_thread(void *arg)
 				__func__, rc);
 			break;
 		}
-	} while (wpt->work || wpt->wakeup ||
-		 pool->pqh.qcount < pool->params.thrd_min);
+	} while (wpt->work || wpt->wakeup || work_pool_keep_idle(pool));
 
 	pool->n_threads--;
+	pool->stats.reaped++;
 	pthread_mutex_unlock(&pool->pqh.qmutex);
 
 	__warnx(TIRPC_DEBUG_FLAG_WORKER,
@@ -285,6 +470,8 @@ work_pool_spawn(struct work_pool *pool)
 int
 work_pool_submit(struct work_pool *pool, struct work_pool_entry *work)
 {
+	struct work_pool_lane *lane;
+	struct work_pool_flow *flow;
 	int rc = 0;
 
 	if (unlikely(!pool->params.thrd_max)) {
@@ -292,12 +479,26 @@ work_pool_submit(struct work_pool *pool, struct work_pool_entry *work)
 		return (0);
 	}
 
+	work->queued_ns = work_pool_now_ns();
+
 	pthread_mutex_lock(&pool->pqh.qmutex);
 	/*
 	 * Insert in work queue so that running thread can
 	 * pickup without scheduling.
 	 */
-	TAILQ_INSERT_TAIL(&pool->pqh.qh, &work->pqe, q);
+	lane = &pool->lane[work->prio < WORK_POOL_PRIOS
+			   ? work->prio : WORK_POOL_PRIO_NORMAL];
+	flow = work->flow ? work->flow : &lane->fifo;
+
+	TAILQ_INSERT_TAIL(&flow->qh, &work->pqe, q);
+	pool->n_queued++;
+
+	if (!flow->active) {
+		flow->active = true;
+		flow->deficit = flow->quantum;
+		TAILQ_INSERT_TAIL(&lane->flows, flow, wpfq);
+	}
+
 	struct work_pool_thread *wpt = TAILQ_LAST(&pool->wptqh, work_pool_s);
 	if (wpt) {
 		pool->pqh.qcount--;
@@ -312,6 +513,18 @@ work_pool_submit(struct work_pool *pool, struct work_pool_entry *work)
 	return rc;
 }
 
+void
+work_pool_get_stats(struct work_pool *pool, struct work_pool_stats *stats)
+{
+	pthread_mutex_lock(&pool->pqh.qmutex);
+	*stats = pool->stats;
+	stats->n_threads = pool->n_threads;
+	stats->n_idle = pool->pqh.qcount;
+	stats->n_queued = pool->n_queued;
+	pool->stats.wait_max_us = 0;
+	pthread_mutex_unlock(&pool->pqh.qmutex);
+}
+
 int
 work_pool_shutdown(struct work_pool *pool)
 {
@@ -44,6 +44,7 @@
 #include <string.h>
 
 #include <rpc/types.h>
+#include <misc/abstract_atomic.h>
 #include <misc/portable.h>
 #include <rpc/xdr.h>
 #include <rpc/xdr_inline.h>
@@ -224,3 +225,84 @@ xdr_u_longlong_t(XDR *xdrs, u_longlong_t *ullp)
 	 */
 	return (xdr_u_int64_t(xdrs, (u_int64_t *) ullp));
 }
+
+/*
+ * Release a copied opaque from xdr_opaque_decode_uio()
+ *
+ * Drops one uio_references; frees on the last.
+ */
+static void
+xdr_opaque_uio_release(struct xdr_uio *uio, u_int flags)
+{
+	if (atomic_dec_int32_t(&uio->uio_references))
+		return;
+
+	mem_free(uio, sizeof(*uio) + sizeof(xdr_vio)
+		      + uio->uio_vio[0].vio_length);
+}
+
+/*
+ * decode opaque data into an xdr_uio
+ * Allows the specification of a fixed size sequence of opaque bytes.
+ * cnt gives the byte length.
+ *
+ * At or above XDR_OPAQUE_REFER_MIN, the uio references the stream buffers
+ * directly (when supported); otherwise, the data is copied.  Either way,
+ * the caller releases *uiop with (*uiop)->uio_release(*uiop, UIO_FLAG_NONE).
+ */
+bool
+xdr_opaque_decode_uio(XDR *xdrs, xdr_uio **uiop, u_int cnt)
+{
+	xdr_uio *uio;
+	u_int rndup;
+
+	if (cnt >= XDR_OPAQUE_REFER_MIN
+	 && xdrs->x_ops->x_getbufs
+	 && XDR_GETBUFS(xdrs, uiop, cnt, XDR_FLAG_NONE)) {
+		/* referenced in place */
+	} else {
+		uio = mem_zalloc(sizeof(*uio) + sizeof(xdr_vio) + cnt);
+		uio->uio_release = xdr_opaque_uio_release;
+		uio->uio_count = 1;
+		uio->uio_references = 1;
+		uio->uio_vio[0].vio_base =
+		uio->uio_vio[0].vio_head =
+		uio->uio_vio[0].vio_tail = (uint8_t *)&uio->uio_vio[1];
+		uio->uio_vio[0].vio_wrap = uio->uio_vio[0].vio_base + cnt;
+		uio->uio_vio[0].vio_length = cnt;
+		uio->uio_vio[0].vio_type = VIO_DATA;
+
+		if (cnt && !XDR_GETBYTES(xdrs, (char *)uio->uio_vio[0].vio_base,
+					 cnt)) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s:%u ERROR opaque",
+				__func__, __LINE__);
+			xdr_opaque_uio_release(uio, UIO_FLAG_NONE);
+			return (false);
+		}
+		uio->uio_vio[0].vio_tail = uio->uio_vio[0].vio_wrap;
+		*uiop = uio;
+	}
+
+	/*
+	 * round byte count to full xdr units
+	 */
+	rndup = cnt & (BYTES_PER_XDR_UNIT - 1);
+
+	if (rndup > 0) {
+		uint32_t crud;
+
+		if (!xdr_inline_decode(xdrs, BYTES_PER_XDR_UNIT - rndup)
+		 && !XDR_GETBYTES(xdrs, (char *) &crud,
+				  BYTES_PER_XDR_UNIT - rndup)) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s:%u ERROR crud",
+				__func__, __LINE__);
+			(*uiop)->uio_release(*uiop, UIO_FLAG_NONE);
+			*uiop = NULL;
+			return (false);
+		}
+	}
+
+	return (true);
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file xdr_arena.c
+ * @brief Per-request bump allocator for XDR_DECODE
+ *
+ * @section DESCRIPTION
+ *
+ * The fast path (xdr_arena_alloc) is inline in xdr.h.  Here are the
+ * chunk refill and the release of a whole arena.
+ *
+ * Each thread keeps one released chunk of the default size, so a steady
+ * stream of small requests does not reach mem_alloc() at all.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rpc/types.h>
+#include <rpc/xdr.h>
+#include <intrinsic.h>
+
+struct xdr_arena_chunk {
+	struct xdr_arena_chunk *next;
+	size_t size;		/* of data[] */
+	uint8_t data[] __attribute__ ((aligned(XDR_ARENA_ALIGN)));
+};
+
+static pthread_once_t xdr_arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t xdr_arena_key;
+static __thread struct xdr_arena_chunk *xdr_arena_spare;
+
+static void
+xdr_arena_spare_free(void *arg)
+{
+	struct xdr_arena_chunk *chunk = arg;
+
+	mem_free(chunk, sizeof(*chunk) + chunk->size);
+}
+
+static void
+xdr_arena_key_init(void)
+{
+	(void)pthread_key_create(&xdr_arena_key, xdr_arena_spare_free);
+}
+
+/*
+ * Start a new chunk big enough for size (already aligned), and carve
+ * size from it.  The remainder of the previous chunk is abandoned.
+ */
+void *
+xdr_arena_more(struct xdr_arena *arena, size_t size)
+{
+	struct xdr_arena_chunk *chunk;
+	size_t chunk_size = arena->chunk_size
+			  ? arena->chunk_size : XDR_ARENA_CHUNK_DEFAULT;
+
+	if (xdr_arena_spare
+	 && xdr_arena_spare->size == chunk_size
+	 && size <= chunk_size) {
+		chunk = xdr_arena_spare;
+		xdr_arena_spare = NULL;
+		(void)pthread_setspecific(xdr_arena_key, NULL);
+	} else {
+		if (chunk_size < size)
+			chunk_size = size;
+		chunk = mem_alloc(sizeof(*chunk) + chunk_size);
+		chunk->size = chunk_size;
+	}
+
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->next = chunk->data + size;
+	arena->end = chunk->data + chunk->size;
+	arena->allocated += size;
+	return (chunk->data);
+}
+
+/*
+ * Free everything handed out by the arena; it may be reused.
+ */
+void
+xdr_arena_release(struct xdr_arena *arena)
+{
+	struct xdr_arena_chunk *chunk;
+	size_t chunk_size = arena->chunk_size
+			  ? arena->chunk_size : XDR_ARENA_CHUNK_DEFAULT;
+
+	while ((chunk = arena->chunks)) {
+		arena->chunks = chunk->next;
+
+		if (!xdr_arena_spare && chunk->size == chunk_size) {
+			/* the destructor frees it when the thread exits */
+			(void)pthread_once(&xdr_arena_once,
+					   xdr_arena_key_init);
+			xdr_arena_spare = chunk;
+			(void)pthread_setspecific(xdr_arena_key, chunk);
+			continue;
+		}
+		mem_free(chunk, sizeof(*chunk) + chunk->size);
+	}
+	arena->next = NULL;
+	arena->end = NULL;
+	arena->allocated = 0;
+}
@@ -94,6 +94,34 @@ timespec_diff(const struct timespec *start,
         }
 }
 
+static const size_t xdr_ioq_size_classes[] = {
+	XDR_IOQ_SIZE_CLASS_MIN,
+	4096,
+	8192,
+	32768,
+	65536,
+	262144,
+	XDR_IOQ_SIZE_CLASS_MAX,
+};
+
+/*
+ * Round a buffer size hint up to a size class.
+ *
+ * Fewer distinct sizes keep the allocator caches warm; hints beyond the
+ * largest class are capped (the stream appends more segments).
+ */
+size_t
+xdr_ioq_size_class(size_t size)
+{
+	u_int ix;
+
+	for (ix = 0; ix < sizeof(xdr_ioq_size_classes) / sizeof(size_t); ix++) {
+		if (size <= xdr_ioq_size_classes[ix])
+			return (xdr_ioq_size_classes[ix]);
+	}
+	return (XDR_IOQ_SIZE_CLASS_MAX);
+}
+
 struct xdr_ioq_uv *
 xdr_ioq_uv_create(size_t size, u_int uio_flags)
 {
@@ -117,6 +145,53 @@ xdr_ioq_uv_create(size_t size, u_int uio_flags)
 	return (uv);
 }
 
+#define XDR_UIO_FILE_SIZE \
+	(sizeof(xdr_uio) + sizeof(xdr_vio) + sizeof(struct xdr_vio_file))
+
+static void
+xdr_uio_file_release(xdr_uio *uio, u_int flags)
+{
+	if (atomic_dec_int32_t(&uio->uio_references))
+		return;
+	mem_free(uio, XDR_UIO_FILE_SIZE);
+}
+
+/*
+ * Reference a file range, for XDR_PUTBUFS.
+ *
+ * The data is read when the stream is sent, so a READ reply can go from
+ * the page cache to the socket without a user space copy.  The fd stays
+ * owned by the caller and must remain open until the uio is released.
+ * Such replies are never held by the duplicate request cache.
+ *
+ * Returns with one reference for the caller; XDR_PUTBUFS (xdr_ioq) takes
+ * another for each segment, and the caller drops its own with
+ * uio_release().  The caller encodes the length and XDR padding, as with
+ * any opaque passed by XDR_PUTBUFS.
+ */
+xdr_uio *
+xdr_uio_file_create(int fd, off_t offset, u_int length)
+{
+	xdr_uio *uio = mem_zalloc(XDR_UIO_FILE_SIZE);
+	struct xdr_vio_file *file = (struct xdr_vio_file *)&uio->uio_vio[1];
+	xdr_vio *v = &uio->uio_vio[0];
+
+	file->fd = fd;
+	file->offset = offset;
+
+	v->vio_type = VIO_FILE;
+	v->vio_base = (uint8_t *)file;
+	v->vio_head = v->vio_base;
+	v->vio_tail = v->vio_base + length;
+	v->vio_wrap = v->vio_tail;
+	v->vio_length = length;
+
+	uio->uio_release = xdr_uio_file_release;
+	uio->uio_count = 1;
+	uio->uio_references = 1;
+	return (uio);
+}
+
 struct poolq_entry *
 xdr_ioq_uv_fetch(struct xdr_ioq *xioq, struct poolq_head *ioqh,
 		 char *comment, u_int count, u_int ioq_flags)
@@ -664,7 +739,8 @@ xdr_rdma_buf_pool_destroy_locked(struct poolq_head *ioqh,
 void
 xdr_ioq_uv_release(struct xdr_ioq_uv *uv)
 {
-	if (!(--uv->u.uio_references)) {
+	/* may be shared with xdr_ioq_getbufs() callers on other threads */
+	if (!atomic_dec_int32_t(&uv->u.uio_references)) {
 		if (uv->u.uio_release) {
 			/* handle both xdr_ioq_uv and vio */
 			uv->u.uio_release(&uv->u, UIO_FLAG_NONE);
@@ -783,6 +859,120 @@ xdr_ioq_create(size_t min_bsize, size_t max_bsize, u_int uio_flags)
 	return (xioq);
 }
 
+static void
+xdr_ioq_hold_release(struct xdr_uio *uio, u_int flags)
+{
+	struct xdr_ioq_uv **uvp = (struct xdr_ioq_uv **)uio->uio_p2;
+	size_t ix;
+
+	if (atomic_dec_int32_t(&uio->uio_references))
+		return;
+
+	for (ix = 0; ix < uio->uio_count; ++ix)
+		xdr_ioq_uv_release(uvp[ix]);
+
+	mem_free(uio, sizeof(*uio) + uio->uio_count
+		      * (sizeof(xdr_vio) + sizeof(struct xdr_ioq_uv *)));
+}
+
+/*
+ * Hold the encoded contents of a stream.
+ *
+ * Returns an xdr_uio describing every buffer in place, holding a reference
+ * on each xdr_ioq_uv, so the contents outlive the xdr_ioq.  The xdr_uio is
+ * itself counted: each uio_release() drops one uio_references.
+ *
+ * Returns NULL when the stream refers to a file range (VIO_FILE):  the fd
+ * is only valid until the owner releases its uio, which has no way to
+ * learn of a longer hold.
+ */
+xdr_uio *
+xdr_ioq_hold(struct xdr_ioq *xioq)
+{
+	struct poolq_entry *have;
+	struct xdr_ioq_uv **uvp;
+	struct xdr_ioq_uv *uv;
+	xdr_uio *uio;
+	size_t count = 0;
+	size_t ix = 0;
+
+	/* update the most recent data length, just in case */
+	xdr_tail_update(xioq->xdrs);
+
+	TAILQ_FOREACH(have, &xioq->ioq_uv.uvqh.qh, q) {
+		uv = IOQ_(have);
+		if (unlikely(uv->v.vio_type == VIO_FILE))
+			return (NULL);
+		if (ioquv_length(uv))
+			count++;
+	}
+
+	uio = mem_zalloc(sizeof(*uio) + count
+			 * (sizeof(xdr_vio) + sizeof(struct xdr_ioq_uv *)));
+	uvp = (struct xdr_ioq_uv **)&uio->uio_vio[count];
+	uio->uio_release = xdr_ioq_hold_release;
+	uio->uio_p2 = uvp;
+	uio->uio_count = count;
+	uio->uio_references = 1;
+
+	TAILQ_FOREACH(have, &xioq->ioq_uv.uvqh.qh, q) {
+		uv = IOQ_(have);
+		if (!ioquv_length(uv))
+			continue;
+
+		atomic_inc_int32_t(&uv->u.uio_references);
+		uvp[ix] = uv;
+
+		uio->uio_vio[ix].vio_base =
+		uio->uio_vio[ix].vio_head = uv->v.vio_head;
+		uio->uio_vio[ix].vio_tail =
+		uio->uio_vio[ix].vio_wrap = uv->v.vio_tail;
+		uio->uio_vio[ix].vio_length = ioquv_length(uv);
+		uio->uio_vio[ix].vio_type = VIO_DATA;
+		ix++;
+	}
+
+	return (uio);
+}
+
+/*
+ * Create an encoded stream over the buffers of uio, without copying.
+ *
+ * Each segment is a UIO_FLAG_REFER xdr_ioq_uv, taking one uio_references;
+ * xdr_ioq_uv_release() calls uio_release() for each.  Nothing more may be
+ * encoded.
+ */
+struct xdr_ioq *
+xdr_ioq_create_refer(xdr_uio *uio)
+{
+	struct xdr_ioq *xioq = xdr_ioq_create(0, 0, UIO_FLAG_BUFQ);
+	struct xdr_ioq_uv *uv = NULL;
+	size_t ix;
+
+	for (ix = 0; ix < uio->uio_count; ++ix) {
+		if (uv)
+			xioq->ioq_uv.plength += ioquv_length(uv);
+
+		uv = xdr_ioq_uv_create(0, UIO_FLAG_REFER);
+		uv->v = uio->uio_vio[ix];
+		uv->u.uio_refer = uio;
+		atomic_inc_int32_t(&uio->uio_references);
+
+		(xioq->ioq_uv.uvqh.qcount)++;
+		TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
+	}
+
+	if (uv) {
+		/* positioned at the end, as after encoding */
+		xioq->ioq_uv.pcount = uio->uio_count - 1;
+		xioq->xdrs[0].x_base = &uv->v;
+		xioq->xdrs[0].x_v = uv->v;
+		xioq->xdrs[0].x_data = uv->v.vio_tail;
+	}
+
+	return (xioq);
+}
+
 /*
  * Advance read/insert or fill position.
  *
@@ -814,6 +1004,31 @@ xdr_ioq_uv_advance(struct xdr_ioq *xioq)
 	return IOQ_(TAILQ_NEXT(&uv->uvq, q));
 }
 
+/*
+ * Size the next appended segment.
+ *
+ * With a hint, cover the expected remainder of the stream; otherwise
+ * double the previous segment, so long streams use few large segments.
+ * Note: plength already includes the previous segment (advance).
+ */
+static inline size_t
+xdr_ioq_uv_next_bsize(struct xdr_ioq *xioq, struct xdr_ioq_uv *uv)
+{
+	size_t size;
+
+	if (xioq->ioq_uv.hint > xioq->ioq_uv.plength)
+		size = xdr_ioq_size_class(xioq->ioq_uv.hint
+					  - xioq->ioq_uv.plength);
+	else
+		size = xdr_ioq_size_class(ioquv_size(uv) * 2);
+
+	if (size < xioq->ioq_uv.min_bsize)
+		size = xioq->ioq_uv.min_bsize;
+	if (xioq->ioq_uv.max_bsize && size > xioq->ioq_uv.max_bsize)
+		size = xioq->ioq_uv.max_bsize;
+	return (size);
+}
+
 /*
  * Append at read/insert or fill position.
  */
@@ -860,7 +1075,8 @@ xdr_ioq_uv_append(struct xdr_ioq *xioq, u_int ioq_flags)
 			xioq->xdrs[0].x_data = uv->v.vio_tail - delta;
 			return (uv);
 		}
-		uv = xdr_ioq_uv_create(xioq->ioq_uv.min_bsize, UIO_FLAG_FREE);
+		uv = xdr_ioq_uv_create(xdr_ioq_uv_next_bsize(xioq, uv),
+				       UIO_FLAG_FREE);
 		(xioq->ioq_uv.uvqh.qcount)++;
 		TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
 	} else {
@@ -1131,58 +1347,111 @@ xdr_ioq_putbytes(XDR *xdrs, const char *addr, u_int len)
 	return (true);
 }
 
-/* Get buffers from the queue. */
-static bool
-xdr_ioq_getbufs(XDR *xdrs, xdr_uio *uio, u_int flags)
+/*
+ * Release the references taken by xdr_ioq_getbufs().
+ *
+ * Drops one uio_references; the buffers are released on the last.  The
+ * xdr_ioq_uv pointers follow the vio array in the same allocation.
+ */
+static void
+xdr_ioq_getbufs_release(struct xdr_uio *uio, u_int flags)
 {
-    /* XXX finalize */
-#if 0
+	struct xdr_ioq_uv **uvp = (struct xdr_ioq_uv **)uio->uio_p2;
+	size_t ix;
 
-	struct xdr_ioq_uv *uv;
-	ssize_t delta;
-	int ix;
+	if (atomic_dec_int32_t(&uio->uio_references))
+		return;
 
-	/* allocate sufficient slots to empty the queue, else MAX */
-	uio->xbs_cnt = XIOQ(xdrs)->ioq_uv.uvqh.qsize - XIOQ(xdrs)->ioq_uv.pcount;
-	if (uio->xbs_cnt > VREC_MAXBUFS) {
-		uio->xbs_cnt = VREC_MAXBUFS;
-	}
+	for (ix = 0; ix < uio->uio_count; ++ix)
+		xdr_ioq_uv_release(uvp[ix]);
 
-	/* fail if no segments available */
-	if (unlikely(! uio->xbs_cnt))
-		return (FALSE);
+	mem_free(uio, sizeof(*uio) + uio->uio_count
+		      * (sizeof(xdr_vio) + sizeof(struct xdr_ioq_uv *)));
+}
 
-	uio->xbs_buf = mem_alloc(uio->xbs_cnt);
-	uio->xbs_resid = 0;
-	ix = 0;
+/* Get buffers from the queue.
+ *
+ * Returns an xdr_uio describing the next len bytes of the stream in place,
+ * holding a reference on each xdr_ioq_uv spanned, and advances the stream
+ * past them.  The buffers remain valid after the xdr_ioq is destroyed,
+ * until the caller calls uio->uio_release().
+ */
+static bool
+xdr_ioq_getbufs(XDR *xdrs, xdr_uio **uiop, u_int len, u_int flags)
+{
+	struct xdr_ioq *xioq = XIOQ(xdrs);
+	struct xdr_ioq_uv *uv = IOQV(xdrs->x_base);
+	struct xdr_ioq_uv **uvp;
+	xdr_uio *uio;
+	size_t count = 0;
+	size_t delta = xdr_tail_inline(xdrs);
+	size_t resid = len;
+	size_t ix;
+
+	if (unlikely(!len || !uv))
+		return (false);
+
+	/* count the buffers needed, fail if insufficient data */
+	for (;;) {
+		if (delta) {
+			count++;
+			if (resid <= delta)
+				break;
+			resid -= delta;
+		}
+		uv = IOQ_(TAILQ_NEXT(&uv->uvq, q));
+		if (!uv) {
+			__warnx(TIRPC_DEBUG_FLAG_XDR,
+				"%s() xioq %p short %lu of %u",
+				__func__, xioq, (unsigned long) resid, len);
+			return (false);
+		}
+		delta = ioquv_length(uv);
+	}
 
-	/* re-consuming bytes in a stream (after SETPOS/rewind) */
-	while (len > 0
-		&& XIOQ(xdrs)->ioq_uv.pcount < XIOQ(xdrs)->ioq_uv.uvqh.qcount) {
-		delta = (uintptr_t)XDR_VIO(xioq->xdrs)->vio_tail
-			- (uintptr_t)xdrs->x_data;
+	uio = mem_zalloc(sizeof(*uio) + count
+			 * (sizeof(xdr_vio) + sizeof(struct xdr_ioq_uv *)));
+	uvp = (struct xdr_ioq_uv **)&uio->uio_vio[count];
+	uio->uio_release = xdr_ioq_getbufs_release;
+	uio->uio_p2 = uvp;
+	uio->uio_count = count;
+	uio->uio_references = 1;
 
-		if (unlikely(delta > len)) {
-			delta = len;
-		} else if (unlikely(!delta)) {
-			uv = xdr_ioq_uv_advance(XIOQ(xdrs));
-			if (!uv)
-				return (false);
+	for (ix = 0; ix < count; ) {
+		delta = xdr_tail_inline(xdrs);
 
-			xdr_ioq_uv_update(XIOQ(xdrs), uv);
+		if (unlikely(!delta)) {
+			/* advance fill pointer */
+			uv = xdr_ioq_uv_advance(xioq);
+			assert(uv);
+			xdr_ioq_uv_update(xioq, uv);
 			continue;
 		}
-		(uio->xbs_buf[ix]).xb_p1 = uv;
-		uv->u.uio_references)++;
-		(uio->xbs_buf[ix]).xb_base = xdrs->x_data;
-		XIOQ(xdrs)->ioq_uv.plength += delta;
+		if (delta > len)
+			delta = len;
+
+		uv = IOQV(xdrs->x_base);
+		atomic_inc_int32_t(&uv->u.uio_references);
+		uvp[ix] = uv;
+
+		uio->uio_vio[ix].vio_base =
+		uio->uio_vio[ix].vio_head = xdrs->x_data;
+		uio->uio_vio[ix].vio_tail =
+		uio->uio_vio[ix].vio_wrap = xdrs->x_data + delta;
+		uio->uio_vio[ix].vio_length = delta;
+		uio->uio_vio[ix].vio_type = VIO_DATA;
+
 		xdrs->x_data += delta;
 		len -= delta;
+		ix++;
 	}
-#endif /* 0 */
 
-	/* assert(len == 0); */
-	return (TRUE);
+	__warnx(TIRPC_DEBUG_FLAG_XDR,
+		"%s() xioq %p uio %p count %lu",
+		__func__, xioq, uio, (unsigned long) count);
+
+	*uiop = uio;
+	return (true);
 }
 
 /* Post buffers on the queue, or, if indicated in flags, return buffers
@@ -1215,7 +1484,7 @@ xdr_ioq_putbufs(XDR *xdrs, xdr_uio *uio, u_int flags)
 
 		/* save original buffer sequence for rele */
 		uv->u.uio_refer = uio;
-		(uio->uio_references)++;
+		atomic_inc_int32_t(&uio->uio_references);
 
 		/* Now update the XDR position */
 		xdrs->x_data = uv->v.vio_tail;
@@ -1267,7 +1536,7 @@ Saved for later golden buttery results -- Matt
 		/* save original buffer sequence for rele */
 		if (ix == 0) {
 			uv->u.uio_refer = uio;
-			(uio->uio_references)++;
+			atomic_inc_int32_t(&uio->uio_references);
 		}
 	}
 
@@ -1593,7 +1862,8 @@ xdr_ioq_fillbufs(XDR *xdrs, u_int start, xdr_vio *vector, u_int datalen)
 
 		if (found) {
 			vector[idx] = uv->v;
-			vector[idx].vio_type = VIO_DATA;
+			vector[idx].vio_type = (uv->v.vio_type == VIO_FILE)
+					     ? VIO_FILE : VIO_DATA;
 
 			if (start > 0) {
 				/* The start position wasn't at the start of
@@ -1919,7 +2189,7 @@ const struct xdr_ops xdr_ioq_ops_rdma = {
 	xdr_ioq_setpos,
 	xdr_ioq_destroy_internal_rdma,
 	xdr_ioq_control,
-	xdr_ioq_getbufs,
+	NULL,			/* x_getbufs (rdma buffers recycle on release) */
 	xdr_ioq_putbufs,
 	xdr_ioq_newbuf,		/* x_newbuf */
 	xdr_ioq_iovcount,	/* x_iovcount */
@@ -47,15 +47,18 @@
 #include <netinet/in.h>
 #endif
 
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <rpc/types.h>
+#include <misc/abstract_atomic.h>
 #include <misc/portable.h>
 #include <rpc/xdr.h>
 #include "un-namespace.h"
 
 typedef bool (*dummyfunc3)(XDR *, int, void *);
-typedef bool (*dummy_getbufs)(XDR *, xdr_uio *, u_int);
+typedef bool (*dummy_getbufs)(XDR *, xdr_uio **, u_int, u_int);
 typedef bool (*dummy_newbuf)(struct rpc_xdr *);
 
 static const struct xdr_ops xdrmem_ops_aligned;
@@ -77,6 +80,7 @@ xdrmem_ncreate(XDR *xdrs, char *addr, u_int size, enum xdr_op op)
 	xdrs->x_private = NULL;
 	xdrs->x_lib[0] = NULL;
 	xdrs->x_lib[1] = NULL;
+	xdrs->x_flags = XDR_FLAG_NONE;
 	xdrs->x_data = addr;
 	xdrs->x_v.vio_base = addr;
 	xdrs->x_v.vio_head = addr;
@@ -180,6 +184,33 @@ static void xdrmem_destroy(XDR *xdrs)
 {
 }
 
+static bool
+xdrmem_putfile(XDR *xdrs, xdr_vio *v)
+{
+	struct xdr_vio_file *file = (struct xdr_vio_file *)v->vio_base;
+	off_t offset = file->offset
+		     + ((uintptr_t)v->vio_head - (uintptr_t)v->vio_base);
+	u_int len = (uintptr_t)v->vio_tail - (uintptr_t)v->vio_head;
+	uint8_t *future = xdrs->x_data + len;
+	ssize_t rlen;
+
+	if (future > xdrs->x_v.vio_wrap)
+		return (false);
+	while (xdrs->x_data < future) {
+		rlen = pread(file->fd, xdrs->x_data, future - xdrs->x_data,
+			     offset);
+		if (rlen <= 0) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s() fd %d pread failed (%d)",
+				__func__, file->fd, rlen ? errno : EIO);
+			return (false);
+		}
+		xdrs->x_data += rlen;
+		offset += rlen;
+	}
+	return (true);
+}
+
 static bool
 xdrmem_putbufs(XDR *xdrs, xdr_uio *uio, u_int flags)
 {
@@ -195,6 +226,12 @@ xdrmem_putbufs(XDR *xdrs, xdr_uio *uio, u_int flags)
 	for (ix = 0; ix < uio->uio_count; ++ix) {
 		xdr_vio *v = &(uio->uio_vio[ix]);
 
+		if (v->vio_type == VIO_FILE) {
+			/* no zero copy here, read the range in */
+			if (!xdrmem_putfile(xdrs, v))
+				return (FALSE);
+			continue;
+		}
 		if (!XDR_PUTBYTES(xdrs, v->vio_head, v->vio_length))
 			return (FALSE);
 
@@ -205,15 +242,14 @@ xdrmem_putbufs(XDR *xdrs, xdr_uio *uio, u_int flags)
 			(unsigned long) XDR_GETPOS(xdrs));
 	}
 
-	if (!(--uio->uio_references)) {
-		if (uio->uio_release) {
-			uio->uio_release(uio, UIO_FLAG_NONE);
-		} else {
-			__warnx(TIRPC_DEBUG_FLAG_ERROR,
-				"%s() memory leak, unexpected or no release flags (%u)\n",
-				__func__, uio->uio_flags);
-			abort();
-		}
+	/* the release callback drops the reference itself */
+	if (uio->uio_release) {
+		uio->uio_release(uio, UIO_FLAG_NONE);
+	} else if (!atomic_dec_int32_t(&uio->uio_references)) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s() memory leak, unexpected or no release flags (%u)\n",
+			__func__, uio->uio_flags);
+		abort();
 	}
 
 	return (TRUE);
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file xdr_sizeof.c
+ * @brief Size-counting XDR stream
+ *
+ * @section DESCRIPTION
+ *
+ * xdr_sizeof() runs an encoder over a stream that only counts bytes.
+ *
+ * The inline fast paths (xdr_putuint32, xdr_inline_encode) write into a
+ * small scratch buffer; when it fills, the ops fold the scratch length
+ * into x_handy and start over, so arbitrarily large objects are counted
+ * without allocation.  Bulk data (XDR_PUTBYTES, XDR_PUTBUFS) is counted
+ * and never copied.
+ *
+ * Unlike the other encoders, x_putbufs does not consume a uio reference:
+ * the object is expected to be encoded again for real.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <rpc/types.h>
+#include <misc/portable.h>
+#include <rpc/xdr.h>
+
+/* scratch for the inline paths, in XDR units */
+#define XDR_SIZEOF_SCRATCH 64
+
+typedef bool (*dummyfunc3)(XDR *, int, void *);
+typedef bool (*dummy_getbufs)(XDR *, xdr_uio **, u_int, u_int);
+typedef bool (*dummy_allochdrs)(XDR *, u_int, xdr_vio *, int);
+typedef bool (*dummy_fillbufs)(XDR *, u_int, xdr_vio *, u_int);
+
+/*
+ * Fold the scratch buffer into the running count.
+ */
+static inline void
+xdrsizeof_flush(XDR *xdrs)
+{
+	xdrs->x_handy += xdrs->x_data - xdrs->x_v.vio_head;
+	xdrs->x_data = xdrs->x_v.vio_head;
+	xdrs->x_v.vio_tail = xdrs->x_v.vio_head;
+}
+
+/* ARGSUSED */
+static bool
+xdrsizeof_getunit(XDR *xdrs, uint32_t *p)
+{
+	return (false);
+}
+
+/* ARGSUSED */
+static bool
+xdrsizeof_putunit(XDR *xdrs, const uint32_t v)
+{
+	xdrsizeof_flush(xdrs);
+	xdrs->x_handy += BYTES_PER_XDR_UNIT;
+	return (true);
+}
+
+/* ARGSUSED */
+static bool
+xdrsizeof_getbytes(XDR *xdrs, char *addr, u_int len)
+{
+	return (false);
+}
+
+/* ARGSUSED */
+static bool
+xdrsizeof_putbytes(XDR *xdrs, const char *addr, u_int len)
+{
+	xdrsizeof_flush(xdrs);
+	xdrs->x_handy += len;
+	return (true);
+}
+
+static u_int
+xdrsizeof_getpos(XDR *xdrs)
+{
+	return (xdrs->x_handy + (xdrs->x_data - xdrs->x_v.vio_head));
+}
+
+static u_int
+xdrsizeof_getstartdatapos(XDR *xdrs, u_int start, u_int datalen)
+{
+	return start;
+}
+
+static u_int
+xdrsizeof_getenddatapos(XDR *xdrs, u_int start, u_int datalen)
+{
+	return start + datalen;
+}
+
+/*
+ * Encoders that back-patch a length (SETPOS back, write, SETPOS forward)
+ * end up at the same position, which is all that is reported.
+ */
+static bool
+xdrsizeof_setpos(XDR *xdrs, u_int pos)
+{
+	if (pos >= xdrs->x_handy
+	 && pos - xdrs->x_handy <= xdrs->x_v.vio_wrap - xdrs->x_v.vio_head) {
+		xdrs->x_data = xdrs->x_v.vio_head + (pos - xdrs->x_handy);
+		xdr_tail_update(xdrs);
+		return (true);
+	}
+	xdrs->x_handy = pos;
+	xdrs->x_data = xdrs->x_v.vio_head;
+	xdrs->x_v.vio_tail = xdrs->x_v.vio_head;
+	return (true);
+}
+
+/* ARGSUSED */
+static void
+xdrsizeof_destroy(XDR *xdrs)
+{
+}
+
+/* ARGSUSED */
+static bool
+xdrsizeof_putbufs(XDR *xdrs, xdr_uio *uio, u_int flags)
+{
+	int ix;
+
+	xdrsizeof_flush(xdrs);
+	for (ix = 0; ix < uio->uio_count; ++ix)
+		xdrs->x_handy += uio->uio_vio[ix].vio_length;
+	return (true);
+}
+
+static bool
+xdrsizeof_newbuf(XDR *xdrs)
+{
+	xdrsizeof_flush(xdrs);
+	return (true);
+}
+
+static bool
+xdrsizeof_noop(void)
+{
+	return (false);
+}
+
+static int
+xdrsizeof_iovcount(XDR *xdrs, u_int start, u_int datalen)
+{
+	return (-1);
+}
+
+static const struct xdr_ops xdrsizeof_ops = {
+	xdrsizeof_getunit,
+	xdrsizeof_putunit,
+	xdrsizeof_getbytes,
+	xdrsizeof_putbytes,
+	xdrsizeof_getpos,
+	xdrsizeof_getstartdatapos,
+	xdrsizeof_getenddatapos,
+	xdrsizeof_setpos,
+	xdrsizeof_destroy,
+	(dummyfunc3) xdrsizeof_noop,	/* x_control */
+	(dummy_getbufs) xdrsizeof_noop,	/* x_getbufs */
+	xdrsizeof_putbufs,		/* x_putbufs */
+	xdrsizeof_newbuf,		/* x_newbuf */
+	xdrsizeof_iovcount,		/* x_iovcount */
+	(dummy_fillbufs) xdrsizeof_noop,	/* x_fillbufs */
+	(dummy_allochdrs) xdrsizeof_noop,	/* x_allochdrs */
+};
+
+/*
+ * Return the encoded length of an object, or 0 when it cannot be encoded.
+ */
+u_long
+xdr_sizeof(xdrproc_t func, void *data)
+{
+	uint32_t scratch[XDR_SIZEOF_SCRATCH];
+	XDR xdrs[1];
+
+	memset(xdrs, 0, sizeof(xdrs));
+	xdrs->x_op = XDR_ENCODE;
+	xdrs->x_ops = &xdrsizeof_ops;
+	xdrs->x_flags = XDR_FLAG_NONE;
+	xdrs->x_data = (uint8_t *)scratch;
+	xdrs->x_v.vio_base = (uint8_t *)scratch;
+	xdrs->x_v.vio_head = (uint8_t *)scratch;
+	xdrs->x_v.vio_tail = (uint8_t *)scratch;
+	xdrs->x_v.vio_wrap = (uint8_t *)&scratch[XDR_SIZEOF_SCRATCH];
+	xdrs->x_base = &xdrs->x_v;
+	xdrs->x_handy = 0;
+
+	if (!(*func)(xdrs, data))
+		return (0);
+	return (XDR_GETPOS(xdrs));
+}
@@ -0,0 +1,769 @@
+#!/usr/bin/python3
+"""Generate straight-line XDR codecs from .x (RFC 4506) definitions.
+
+The generic routines make an indirect x_ops call per 4-byte unit.  For
+each struct, union and typedef, this emits a codec that groups runs of
+consecutive fixed-size members (integers, enums, bools, hypers, fixed
+opaques, fixed arrays of these, and structs made only of these) behind a
+single xdr_inline_encode() or xdr_inline_decode() bounds check, and moves
+them with the IXDR macros.  When the run straddles a buffer boundary of
+a segmented stream, or for XDR_FREE, the codec falls back to the generic
+routine of each member.  Variable-size members always use the generic
+(mostly inline) routines.
+
+Output is a header, with the types and prototypes, and a source file:
+
+  xdrgen.py --header foo_xdr.h -o foo_xdr.c foo.x
+
+With --no-types, the header only has prototypes and includes the headers
+named by --include, for protocols whose C types are already declared
+(e.g. ntirpc/rpc/rpcb_prot.x with --include rpc/rpcb_prot.h).  Use
+--prefix to keep the codecs apart from existing xdr_* routines.
+
+Limitations: lines starting with '%' are copied to the header (only with
+types), preprocessor lines are ignored, program definitions are skipped,
+and quadruple and inline enum, struct or union type specifiers are not
+supported.
+"""
+
+import argparse
+import os
+import re
+import sys
+from typing import Dict, List, Optional, Tuple
+
+UNIT = 4
+
+
+class XdrgenError(Exception):
+  pass
+
+
+class Decl:
+  """A declaration: kind is plain, fixed, var, opt or void"""
+
+  def __init__(self, typ: str, name: str, kind: str = "plain",
+               size: Optional[str] = None):
+    self.typ = typ
+    self.name = name
+    self.kind = kind
+    self.size = size
+
+  def __repr__(self) -> str:
+    return "Decl({} {} {} {})".format(self.typ, self.name, self.kind,
+                                      self.size)
+
+
+class Definition:
+  """A named definition: what is const, enum, struct, union or typedef"""
+
+  def __init__(self, what: str, name: str):
+    self.what = what
+    self.name = name
+    self.value = None             # const
+    self.members: List[Tuple[str, Optional[str]]] = []  # enum
+    self.decls: List[Decl] = []   # struct
+    self.decl: Optional[Decl] = None      # typedef
+    self.disc: Optional[Decl] = None      # union
+    self.arms: List[Tuple[List[str], Decl]] = []
+    self.default: Optional[Decl] = None
+
+
+# Lexer
+
+TOKEN_RE = re.compile(r"\s*(?:(0[xX][0-9a-fA-F]+|-?[0-9]+)"
+                      r"|([A-Za-z_][A-Za-z0-9_]*)|(.))")
+
+
+def tokenize(text: str, passthrough: List[str]) -> List[str]:
+  text = re.sub(r"/\*.*?\*/", " ", text, flags=re.S)
+  lines = []
+  for line in text.split("\n"):
+    if line.startswith("%"):
+      passthrough.append(line[1:])
+      lines.append("")
+    elif line.lstrip().startswith("#"):
+      lines.append("")
+    else:
+      lines.append(re.sub(r"//.*", "", line))
+  text = "\n".join(lines)
+
+  tokens = []
+  pos = 0
+  while pos < len(text):
+    m = TOKEN_RE.match(text, pos)
+    if not m:
+      break
+    pos = m.end()
+    tok = m.group(1) or m.group(2) or m.group(3)
+    if tok and not tok.isspace():
+      tokens.append(tok)
+  return tokens
+
+
+# Parser
+
+class Parser:
+
+  def __init__(self, tokens: List[str]):
+    self.tokens = tokens
+    self.pos = 0
+
+  def peek(self) -> Optional[str]:
+    return self.tokens[self.pos] if self.pos < len(self.tokens) else None
+
+  def next(self) -> str:
+    tok = self.peek()
+    if tok is None:
+      raise XdrgenError("unexpected end of input")
+    self.pos += 1
+    return tok
+
+  def expect(self, want: str) -> None:
+    tok = self.next()
+    if tok != want:
+      raise XdrgenError("expected '{}', got '{}' (token {})".format(
+          want, tok, self.pos))
+
+  def ident(self) -> str:
+    tok = self.next()
+    if not re.match(r"[A-Za-z_]", tok):
+      raise XdrgenError("expected identifier, got '{}'".format(tok))
+    return tok
+
+  def value(self) -> str:
+    return self.next()
+
+  def parse(self) -> List[Definition]:
+    defs = []
+    while self.peek() is not None:
+      d = self.definition()
+      if d:
+        defs.append(d)
+    return defs
+
+  def definition(self) -> Optional[Definition]:
+    tok = self.next()
+    if tok == "const":
+      d = Definition("const", self.ident())
+      self.expect("=")
+      d.value = self.value()
+    elif tok == "enum":
+      d = Definition("enum", self.ident())
+      d.members = self.enum_body()
+    elif tok == "struct":
+      d = Definition("struct", self.ident())
+      d.decls = self.struct_body()
+    elif tok == "union":
+      d = Definition("union", self.ident())
+      self.union_body(d)
+    elif tok == "typedef":
+      decl = self.declaration()
+      d = Definition("typedef", decl.name)
+      d.decl = decl
+    elif tok == "program":
+      self.skip_program()
+      return None
+    else:
+      raise XdrgenError("unexpected '{}'".format(tok))
+    self.expect(";")
+    return d
+
+  def skip_program(self) -> None:
+    depth = 0
+    while True:
+      tok = self.next()
+      if tok == "{":
+        depth += 1
+      elif tok == "}":
+        depth -= 1
+        if not depth:
+          break
+    self.expect("=")
+    self.value()
+    self.expect(";")
+
+  def enum_body(self) -> List[Tuple[str, Optional[str]]]:
+    members = []
+    self.expect("{")
+    while True:
+      name = self.ident()
+      val = None
+      if self.peek() == "=":
+        self.next()
+        val = self.value()
+      members.append((name, val))
+      tok = self.next()
+      if tok == "}":
+        return members
+      if tok != ",":
+        raise XdrgenError("bad enum {}".format(name))
+
+  def struct_body(self) -> List[Decl]:
+    decls = []
+    self.expect("{")
+    while self.peek() != "}":
+      decls.append(self.declaration())
+      self.expect(";")
+    self.next()
+    return decls
+
+  def union_body(self, d: Definition) -> None:
+    self.expect("switch")
+    self.expect("(")
+    d.disc = self.declaration()
+    self.expect(")")
+    self.expect("{")
+    while self.peek() != "}":
+      tok = self.next()
+      if tok == "default":
+        self.expect(":")
+        d.default = self.declaration()
+        self.expect(";")
+        continue
+      if tok != "case":
+        raise XdrgenError("bad union {}".format(d.name))
+      cases = [self.value()]
+      self.expect(":")
+      while self.peek() == "case":
+        self.next()
+        cases.append(self.value())
+        self.expect(":")
+      decl = self.declaration()
+      self.expect(";")
+      d.arms.append((cases, decl))
+    self.next()
+
+  def type_specifier(self) -> str:
+    tok = self.next()
+    if tok == "unsigned":
+      if self.peek() in ("int", "hyper", "long", "short", "char"):
+        sub = self.next()
+        return "unsigned " + ("int" if sub in ("long", "short", "char")
+                              else sub)
+      return "unsigned int"
+    if tok in ("struct", "union", "enum"):
+      if self.peek() == "{" or self.peek() == "switch":
+        raise XdrgenError("inline {} definitions are not supported"
+                          .format(tok))
+      return tok + " " + self.ident()
+    if tok == "quadruple":
+      raise XdrgenError("quadruple is not supported")
+    return tok
+
+  def declaration(self) -> Decl:
+    if self.peek() == "void":
+      self.next()
+      return Decl("void", "", "void")
+    typ = self.type_specifier()
+    if self.peek() == "*":
+      self.next()
+      return Decl(typ, self.ident(), "opt")
+    name = self.ident()
+    if self.peek() == "[":
+      self.next()
+      size = self.value()
+      self.expect("]")
+      return Decl(typ, name, "fixed", size)
+    if self.peek() == "<":
+      self.next()
+      size = None
+      if self.peek() != ">":
+        size = self.value()
+      self.expect(">")
+      return Decl(typ, name, "var", size)
+    if typ == "string":
+      raise XdrgenError("string {} needs <>".format(name))
+    return Decl(typ, name)
+
+
+# Type knowledge
+
+# xdr type: (C type, codec, put, get, size)
+BASIC = {
+    "int": ("int32_t", "xdr_int32_t", "IXDR_PUT_INT32", "IXDR_GET_INT32",
+            UNIT),
+    "unsigned int": ("uint32_t", "xdr_uint32_t", "IXDR_PUT_U_INT32",
+                     "IXDR_GET_U_INT32", UNIT),
+    "bool": ("bool_t", "xdr_bool", "IXDR_PUT_BOOL", "IXDR_GET_BOOL", UNIT),
+    "hyper": ("int64_t", "xdr_int64_t", None, None, 2 * UNIT),
+    "unsigned hyper": ("uint64_t", "xdr_uint64_t", None, None, 2 * UNIT),
+    "float": ("float", "xdr_float", None, None, None),
+    "double": ("double", "xdr_double", None, None, None),
+}
+
+# C typedefs commonly named in .x files
+ALIASES = {
+    "int32_t": "int",
+    "uint32_t": "unsigned int",
+    "u_int32_t": "unsigned int",
+    "u_int": "unsigned int",
+    "int64_t": "hyper",
+    "uint64_t": "unsigned hyper",
+    "u_int64_t": "unsigned hyper",
+    "rpcprog_t": "unsigned int",
+    "rpcvers_t": "unsigned int",
+    "rpcproc_t": "unsigned int",
+    "rpcprot_t": "unsigned int",
+    "rpcport_t": "unsigned int",
+}
+
+
+def fold(a: str, b: str) -> str:
+  """Sum two C size expressions"""
+  if a.isdigit() and b.isdigit():
+    return str(int(a) + int(b))
+  if a == "0":
+    return b
+  if b == "0":
+    return a
+  return "{} + {}".format(a, b)
+
+
+def scale(count: str, size: str) -> str:
+  if count.isdigit() and size.isdigit():
+    return str(int(count) * int(size))
+  return "({}) * {}".format(count, size)
+
+
+class Generator:
+
+  def __init__(self, defs: List[Definition], prefix: str,
+               no_inline: bool = False):
+    self.defs = defs
+    self.prefix = prefix
+    self.no_inline = no_inline
+    self.by_name: Dict[str, Definition] = {d.name: d for d in defs}
+    self.consts = {d.name: d.value for d in defs if d.what == "const"}
+    self.loop_depth = 0
+    self.max_loop_depth = 0
+
+  # naming
+
+  def bare(self, typ: str) -> str:
+    for kw in ("struct ", "union ", "enum "):
+      if typ.startswith(kw):
+        return typ[len(kw):]
+    return typ
+
+  def resolve(self, typ: str) -> str:
+    typ = self.bare(typ)
+    return ALIASES.get(typ, typ)
+
+  def ctype(self, typ: str) -> str:
+    if typ in ("opaque", "string"):
+      return "char"
+    if typ.startswith(("struct ", "union ", "enum ")):
+      return typ
+    if typ in BASIC:
+      return BASIC[typ][0]
+    return typ
+
+  def codec(self, typ: str) -> str:
+    name = self.bare(typ)
+    if name in self.by_name:
+      return self.prefix + name
+    resolved = self.resolve(typ)
+    if resolved in BASIC:
+      return BASIC[resolved][1]
+    return "xdr_" + name
+
+  def is_array_typedef(self, typ: str) -> bool:
+    d = self.by_name.get(self.bare(typ))
+    return bool(d and d.what == "typedef" and d.decl.kind == "fixed")
+
+  def const_value(self, expr: str) -> Optional[int]:
+    seen = 0
+    while expr in self.consts and seen < 16:
+      expr = self.consts[expr]
+      seen += 1
+    try:
+      return int(expr, 0)
+    except ValueError:
+      return None
+
+  # fixed layouts: list of (op, ...) leaves, or None
+
+  def type_leaves(self, typ: str, expr: str) -> Optional[list]:
+    resolved = self.resolve(typ)
+    if resolved in BASIC:
+      ctype, codec, put, get, size = BASIC[resolved]
+      if size is None:
+        return None
+      if size == UNIT:
+        return [("u32", expr, self.ctype(typ), put, get)]
+      return [("u64", expr, self.ctype(typ))]
+    d = self.by_name.get(resolved)
+    if d is None:
+      return None
+    if d.what == "enum":
+      return [("enum", expr, d.name)]
+    if d.what == "typedef":
+      return self.decl_leaves(d.decl, expr)
+    if d.what == "struct":
+      leaves = []
+      for decl in d.decls:
+        sub = self.decl_leaves(decl, "{}.{}".format(expr, decl.name))
+        if sub is None:
+          return None
+        leaves += sub
+      return leaves
+    return None
+
+  def decl_leaves(self, decl: Decl, expr: str) -> Optional[list]:
+    if decl.kind == "plain":
+      return self.type_leaves(decl.typ, expr)
+    if decl.kind != "fixed":
+      return None
+    if decl.typ == "opaque":
+      n = self.const_value(decl.size)
+      if n is None:
+        return None
+      return [("opaque", expr, n)]
+    self.loop_depth += 1
+    var = "ijklmn"[self.loop_depth - 1]
+    sub = self.type_leaves(decl.typ, "{}[{}]".format(expr, var))
+    self.loop_depth -= 1
+    if sub is None:
+      return None
+    return [("loop", var, decl.size, sub)]
+
+  def leaves_depth(self, leaves: list) -> int:
+    depth = 0
+    for leaf in leaves:
+      if leaf[0] == "loop":
+        depth = max(depth, 1 + self.leaves_depth(leaf[3]))
+    return depth
+
+  def leaves_size(self, leaves: list) -> str:
+    size = "0"
+    for leaf in leaves:
+      if leaf[0] == "u32" or leaf[0] == "enum":
+        size = fold(size, str(UNIT))
+      elif leaf[0] == "u64":
+        size = fold(size, str(2 * UNIT))
+      elif leaf[0] == "opaque":
+        size = fold(size, str((leaf[2] + UNIT - 1) // UNIT * UNIT))
+      elif leaf[0] == "loop":
+        size = fold(size, scale(leaf[2], self.leaves_size(leaf[3])))
+    return size
+
+  # emitters
+
+  def put_leaves(self, out: List[str], leaves: list, indent: str) -> None:
+    for leaf in leaves:
+      op = leaf[0]
+      if op == "u32":
+        out.append("{}{}(buf, {});".format(indent, leaf[3], leaf[1]))
+      elif op == "enum":
+        out.append("{}IXDR_PUT_ENUM(buf, {});".format(indent, leaf[1]))
+      elif op == "u64":
+        out.append("{}IXDR_PUT_U_INT32(buf, (uint64_t){} >> 32);"
+                   .format(indent, leaf[1]))
+        out.append("{}IXDR_PUT_U_INT32(buf, (uint32_t){});"
+                   .format(indent, leaf[1]))
+      elif op == "opaque":
+        units = (leaf[2] + UNIT - 1) // UNIT
+        if leaf[2] % UNIT:
+          out.append("{}buf[{}] = 0;".format(indent, units - 1))
+        out.append("{}memcpy(buf, {}, {});".format(indent, leaf[1], leaf[2]))
+        out.append("{}buf += {};".format(indent, units))
+      elif op == "loop":
+        out.append("{0}for ({1} = 0; {1} < {2}; {1}++) {{"
+                   .format(indent, leaf[1], leaf[2]))
+        self.put_leaves(out, leaf[3], indent + "\t")
+        out.append(indent + "}")
+
+  def get_leaves(self, out: List[str], leaves: list, indent: str) -> None:
+    for leaf in leaves:
+      op = leaf[0]
+      if op == "u32":
+        out.append("{}{} = {}(buf);".format(indent, leaf[1], leaf[4]))
+      elif op == "enum":
+        out.append("{}{} = IXDR_GET_ENUM(buf, {});"
+                   .format(indent, leaf[1], leaf[2]))
+      elif op == "u64":
+        out.append("{}{} = ({})(((uint64_t)ntohl((uint32_t)buf[0]) << 32)"
+                   .format(indent, leaf[1], leaf[2]))
+        out.append("{}\t| ntohl((uint32_t)buf[1]));".format(indent))
+        out.append("{}buf += 2;".format(indent))
+      elif op == "opaque":
+        units = (leaf[2] + UNIT - 1) // UNIT
+        out.append("{}memcpy({}, buf, {});".format(indent, leaf[1], leaf[2]))
+        out.append("{}buf += {};".format(indent, units))
+      elif op == "loop":
+        out.append("{0}for ({1} = 0; {1} < {2}; {1}++) {{"
+                   .format(indent, leaf[1], leaf[2]))
+        self.get_leaves(out, leaf[3], indent + "\t")
+        out.append(indent + "}")
+
+  def call(self, decl: Decl, expr: str, typedef: bool) -> Optional[str]:
+    """The generic codec call for one declaration"""
+    if decl.kind == "void":
+      return None
+    if typedef:
+      val = "objp->{}_val".format(decl.name)
+      length = "objp->{}_len".format(decl.name)
+      ref = "objp"
+    else:
+      val = "{}.{}_val".format(expr, decl.name)
+      length = "{}.{}_len".format(expr, decl.name)
+      ref = "&" + expr
+    maxsize = decl.size if decl.size is not None else "~0"
+    if decl.typ == "string":
+      return "xdr_string(xdrs, {}, {})".format(ref, maxsize)
+    if decl.typ == "opaque":
+      if decl.kind == "fixed":
+        base = "objp" if typedef else expr
+        return "xdr_opaque(xdrs, {}, {})".format(base, decl.size)
+      return "xdr_bytes(xdrs, &{},\n\t\t       &{}, {})".format(
+          val, length, maxsize)
+    codec = self.codec(decl.typ)
+    ctype = self.ctype(decl.typ)
+    if decl.kind == "plain":
+      if self.is_array_typedef(decl.typ):
+        return "{}(xdrs, {})".format(codec, "objp" if typedef else expr)
+      return "{}(xdrs, {})".format(codec, ref)
+    if decl.kind == "opt":
+      return ("xdr_pointer(xdrs, (void **){},\n"
+              "\t\t\t sizeof({}), (xdrproc_t) {})"
+              .format(ref, ctype, codec))
+    if decl.kind == "fixed":
+      base = "objp" if typedef else expr
+      return ("xdr_vector(xdrs, (char *){}, {}, sizeof({}),\n"
+              "\t\t\t(xdrproc_t) {})".format(base, decl.size, ctype, codec))
+    if decl.size is None:
+      # xdr_array() refuses a bound whose byte size would overflow u_int
+      maxsize = "UINT_MAX / sizeof({})".format(ctype)
+    return ("xdr_array(xdrs, (char **)&{}, &{}, {},\n"
+            "\t\t       sizeof({}), (xdrproc_t) {})"
+            .format(val, length, maxsize, ctype, codec))
+
+  def emit_calls(self, out: List[str], decls: List[Tuple[Decl, str]],
+                 typedef: bool, indent: str) -> None:
+    for decl, expr in decls:
+      call = self.call(decl, expr, typedef)
+      if call is None:
+        continue
+      call = call.replace("\n", "\n" + indent[:-1])
+      out.append("{}if (!{})".format(indent, call))
+      out.append("{}\treturn (false);".format(indent))
+
+  def emit_run(self, out: List[str], run: List[Tuple[Decl, str, list]],
+               typedef: bool, indent: str) -> None:
+    leaves = []
+    for _, _, sub in run:
+      leaves += sub
+    if self.no_inline or (len(leaves) == 1 and leaves[0][0] != "loop"):
+      # a single unit is no cheaper inline than its own inline codec
+      self.emit_calls(out, [(d, e) for d, e, _ in run], typedef, indent)
+      return
+    size = self.leaves_size(leaves)
+    self.uses_buf = True
+    self.max_loop_depth = max(self.max_loop_depth, self.leaves_depth(leaves))
+    out.append("{}if (xdrs->x_op == XDR_ENCODE".format(indent))
+    out.append("{} && (buf = xdr_inline_encode(xdrs, {})) != NULL) {{"
+               .format(indent, size))
+    self.put_leaves(out, leaves, indent + "\t")
+    out.append("{}}} else if (xdrs->x_op == XDR_DECODE".format(indent))
+    out.append("{}\t&& (buf = xdr_inline_decode(xdrs, {})) != NULL) {{"
+               .format(indent, size))
+    self.get_leaves(out, leaves, indent + "\t")
+    out.append("{}}} else {{".format(indent))
+    self.emit_calls(out, [(d, e) for d, e, _ in run], typedef, indent + "\t")
+    out.append("{}}}".format(indent))
+
+  def emit_decls(self, out: List[str], decls: List[Tuple[Decl, str]],
+                 typedef: bool, indent: str) -> None:
+    run = []
+    for decl, expr in decls:
+      if not typedef:
+        leaf_expr = expr
+      elif decl.kind == "fixed":
+        leaf_expr = "objp"
+      else:
+        leaf_expr = "(*objp)"
+      leaves = self.decl_leaves(decl, leaf_expr)
+      if leaves is not None:
+        run.append((decl, expr, leaves))
+        continue
+      if run:
+        self.emit_run(out, run, typedef, indent)
+        run = []
+      self.emit_calls(out, [(decl, expr)], typedef, indent)
+    if run:
+      self.emit_run(out, run, typedef, indent)
+
+  def function(self, d: Definition) -> List[str]:
+    self.uses_buf = False
+    self.max_loop_depth = 0
+    body: List[str] = []
+    arg = "{} *objp".format(d.name)
+
+    if d.what == "enum":
+      body.append("\tif (!xdr_enum(xdrs, (enum_t *)objp))")
+      body.append("\t\treturn (false);")
+    elif d.what == "struct":
+      self.emit_decls(body, [(x, "objp->" + x.name) for x in d.decls],
+                      False, "\t")
+    elif d.what == "typedef":
+      if d.decl.kind == "fixed":
+        arg = "{} objp".format(d.name)
+      self.emit_decls(body, [(d.decl, "(*objp)")], True, "\t")
+    elif d.what == "union":
+      disc = d.disc
+      self.emit_decls(body, [(disc, "objp->" + disc.name)], False, "\t")
+      body.append("\tswitch (objp->{}) {{".format(disc.name))
+      union = "objp->{}_u".format(d.name)
+      for cases, decl in d.arms:
+        for case in cases:
+          body.append("\tcase {}:".format(case))
+        self.emit_decls(body, [(decl, "{}.{}".format(union, decl.name))],
+                        False, "\t\t")
+        body.append("\t\tbreak;")
+      body.append("\tdefault:")
+      if d.default is not None:
+        self.emit_decls(body, [(d.default, "{}.{}".format(
+            union, d.default.name))], False, "\t\t")
+        body.append("\t\tbreak;")
+      else:
+        body.append("\t\treturn (false);")
+      body.append("\t}")
+
+    out = ["bool", "{}{}(XDR *xdrs, {})".format(self.prefix, d.name, arg),
+           "{"]
+    decls = []
+    if self.uses_buf:
+      decls.append("\tint32_t *buf;")
+    if self.max_loop_depth:
+      decls.append("\tu_int {};".format(
+          ", ".join("ijklmn"[:self.max_loop_depth])))
+    out += decls
+    if decls:
+      out.append("")
+    out += body
+    out += ["\treturn (true);", "}", ""]
+    return out
+
+  # types
+
+  def cdecl(self, decl: Decl, indent: str) -> str:
+    ctype = self.ctype(decl.typ)
+    if decl.kind == "void":
+      return ""
+    if decl.typ == "string":
+      return "{}char *{};".format(indent, decl.name)
+    if decl.kind == "plain":
+      return "{}{} {};".format(indent, ctype, decl.name)
+    if decl.kind == "opt":
+      return "{}{} *{};".format(indent, ctype, decl.name)
+    if decl.kind == "fixed":
+      return "{}{} {}[{}];".format(indent, ctype, decl.name, decl.size)
+    return ("{0}struct {{\n{0}\tu_int {1}_len;\n{0}\t{2} *{1}_val;\n"
+            "{0}}} {1};".format(indent, decl.name, ctype))
+
+  def types(self) -> List[str]:
+    out = []
+    for d in self.defs:
+      if d.what == "const":
+        out += ["#define {} {}".format(d.name, d.value), ""]
+      elif d.what == "enum":
+        out.append("enum {} {{".format(d.name))
+        out.append(",\n".join(
+            "\t{}{}".format(n, " = " + v if v is not None else "")
+            for n, v in d.members))
+        out += ["};", "typedef enum {0} {0};".format(d.name), ""]
+      elif d.what == "struct":
+        out.append("struct {} {{".format(d.name))
+        out += [self.cdecl(x, "\t") for x in d.decls]
+        out += ["};", "typedef struct {0} {0};".format(d.name), ""]
+      elif d.what == "union":
+        out.append("struct {} {{".format(d.name))
+        out.append(self.cdecl(d.disc, "\t"))
+        out.append("\tunion {")
+        arms = [decl for _, decl in d.arms]
+        if d.default is not None:
+          arms.append(d.default)
+        out += [self.cdecl(x, "\t\t") for x in arms if x.kind != "void"]
+        out += ["\t}} {}_u;".format(d.name), "};",
+                "typedef struct {0} {0};".format(d.name), ""]
+      elif d.what == "typedef":
+        out += ["typedef " + self.cdecl(d.decl, ""), ""]
+    return out
+
+  def prototypes(self) -> List[str]:
+    out = []
+    for d in self.defs:
+      if d.what == "const":
+        continue
+      if d.what == "typedef" and d.decl.kind == "fixed":
+        arg = d.name
+      else:
+        arg = d.name + " *"
+      out.append("extern bool {}{}(XDR *, {});".format(
+          self.prefix, d.name, arg))
+    return out
+
+
+def guard_name(path: str) -> str:
+  return re.sub(r"[^A-Za-z0-9]", "_", os.path.basename(path)).upper()
+
+
+def main() -> int:
+  parser = argparse.ArgumentParser(
+      description="Generate straight-line XDR codecs from .x definitions")
+  parser.add_argument("input", help=".x file")
+  parser.add_argument("-o", "--output", required=True, help="C source")
+  parser.add_argument("--header", required=True, help="C header")
+  parser.add_argument("--prefix", default="xdr_",
+                      help="codec name prefix (default xdr_)")
+  parser.add_argument("--no-types", action="store_true",
+                      help="do not declare the C types")
+  parser.add_argument("--include", action="append", default=[],
+                      help="header for the header to include")
+  parser.add_argument("--no-inline", action="store_true",
+                      help="only call the generic routines (for testing)")
+  args = parser.parse_args()
+
+  with open(args.input) as f:
+    passthrough: List[str] = []
+    try:
+      defs = Parser(tokenize(f.read(), passthrough)).parse()
+    except XdrgenError as e:
+      print("{}: {}".format(args.input, e), file=sys.stderr)
+      return 1
+
+  gen = Generator(defs, args.prefix, args.no_inline)
+  source = os.path.basename(args.input)
+  banner = "/* Generated by xdrgen.py from {}.  Do not edit. */".format(source)
+  guard = guard_name(args.header)
+
+  header = [banner, "", "#ifndef " + guard, "#define " + guard, "",
+            "#include <rpc/types.h>", "#include <rpc/xdr.h>"]
+  header += ["#include <{}>".format(h) for h in args.include]
+  header.append("")
+  if not args.no_types:
+    header += passthrough
+    header += gen.types()
+  header += gen.prototypes()
+  header += ["", "#endif\t\t\t\t/* {} */".format(guard)]
+
+  body = []
+  for d in defs:
+    if d.what != "const":
+      body += gen.function(d)
+
+  code = [banner, "", "#include <limits.h>", "#include <string.h>",
+          "#include <rpc/xdr_inline.h>",
+          '#include "{}"'.format(os.path.basename(args.header)), ""]
+  code += body
+
+  with open(args.header, "w") as f:
+    f.write("\n".join(header) + "\n")
+  with open(args.output, "w") as f:
+    f.write("\n".join(code).rstrip("\n") + "\n")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -21,9 +21,26 @@
  *
  * Simple RPC ping test.
  *
+ * By default each thread sends --count calls as fast as it can (closed
+ * loop).  With --rate, calls are sent on a fixed schedule instead (open
+ * loop), spread over --connections, for --duration seconds; latency is
+ * measured from the scheduled time, so a server that falls behind shows
+ * its queueing rather than slowing the load (coordinated omission).
+ * --depth limits the calls in flight on each connection.
+ *
+ * Latency goes to a log-linear histogram (under 1% error), reported as
+ * percentiles, and with --json as the histogram itself.
+ *
+ * "rpcping serve" answers the null procedure, and procedure 1 with a
+ * reply of the requested size, for --request-size and --reply-size.
  */
 #include "config.h"
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/times.h>
 #include <sys/types.h>
@@ -33,30 +50,86 @@
 #include <getopt.h>
 #include <rpc/rpc.h>
 #include <rpc/svc_auth.h>
+#include <rpc/svc_rqst.h>
+#include <rpc/xdr_inline.h>
 
 #include "lttng/ntirpc_traces.h"
 #if defined(USE_LTTNG_NTIRPC) && !defined(LTTNG_PARSING)
 #include "lttng/generated_traces/rpcping.h"
 #endif
 
+/* served by "rpcping serve" */
+#define RPCPING_PROC_PAYLOAD	1
+#define RPCPING_PAYLOAD_MAX	(4 * 1024 * 1024)
+
+/*
+ * Log-linear histogram: values below HIST_SUB are exact; above, each
+ * power of two has HIST_SUB / 2 buckets.
+ */
+#define HIST_SUB_BITS	8
+#define HIST_SUB	(1 << HIST_SUB_BITS)
+#define HIST_BUCKETS	((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct histogram {
+	uint64_t counts[HIST_BUCKETS];
+	uint64_t total;
+	uint64_t sum;
+};
+
+struct payload_args {
+	uint32_t reply_size;
+	u_int len;
+	char *data;
+};
+
+struct payload_res {
+	u_int len;
+	char *data;
+};
+
 static pthread_mutex_t rpcping_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t rpcping_cond = PTHREAD_COND_INITIALIZER;
-static uint32_t rpcping_threads;
 
 static struct timespec to = {30, 0};
 
-struct state {
+struct state;
+
+struct conn {
 	CLIENT *handle;
+	struct state *s;
+	uint32_t inflight;
+};
+
+struct state {
+	struct conn *conns;
+	pthread_t thread;
 	pthread_cond_t s_cond;
 	pthread_mutex_t s_mutex;
 	struct timespec starting;
 	struct timespec stopping;
-	int count;
+	struct histogram hist;
+	struct payload_args args;
+	double interval_ns;	/* open loop, 0: closed loop */
+	uint64_t duration_ns;
+	uint64_t count;
+	uint64_t sent;
+	uint64_t responses;
+	uint64_t max_lag_ns;	/* open loop, behind schedule (after join) */
+	int nconns;
 	int proc;
 	int id;
+	uint32_t depth;		/* calls in flight per connection, 0: any */
 	uint32_t failures;
-	uint32_t responses;
 	uint32_t timeouts;
+	bool payload;
+	bool waiting;
+};
+
+struct call {
+	struct clnt_req cc;	/*** 1st ***/
+	struct conn *c;
+	uint64_t start_ns;	/* scheduled */
+	struct payload_res res;
 };
 
 static uint64_t timespec_elapsed(const struct timespec *starting,
@@ -68,6 +141,116 @@ static uint64_t timespec_elapsed(const struct timespec *starting,
 	return (elapsed * 1000000000L) + nsec;
 }
 
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static void
+sleep_until(uint64_t when_ns)
+{
+	struct timespec ts = {
+		.tv_sec = when_ns / 1000000000ULL,
+		.tv_nsec = when_ns % 1000000000ULL,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+	       == EINTR)
+		;
+}
+
+static inline uint32_t
+hist_index(uint64_t value)
+{
+	uint32_t shift;
+
+	if (value < HIST_SUB)
+		return (value);
+
+	/* value >> shift is in [HIST_SUB / 2, HIST_SUB) */
+	shift = (63 - __builtin_clzll(value)) - (HIST_SUB_BITS - 1);
+	return (shift * HIST_SUB + (value >> shift));
+}
+
+/* highest value counted in bucket ix */
+static uint64_t
+hist_value(uint32_t ix)
+{
+	uint32_t shift;
+
+	if (ix < HIST_SUB)
+		return (ix);
+
+	shift = ix / HIST_SUB;
+	return (((uint64_t)(ix % HIST_SUB) << shift) + ((1ULL << shift) - 1));
+}
+
+static inline void
+hist_record(struct histogram *h, uint64_t value)
+{
+	atomic_inc_uint64_t(&h->counts[hist_index(value)]);
+	atomic_inc_uint64_t(&h->total);
+	atomic_add_uint64_t(&h->sum, value);
+}
+
+static void
+hist_merge(struct histogram *to, const struct histogram *from)
+{
+	uint32_t ix;
+
+	for (ix = 0; ix < HIST_BUCKETS; ix++)
+		to->counts[ix] += from->counts[ix];
+	to->total += from->total;
+	to->sum += from->sum;
+}
+
+/* percentile in [0, 100]; 0 is the minimum, 100 the maximum */
+static uint64_t
+hist_percentile(const struct histogram *h, double percentile)
+{
+	uint64_t want = (uint64_t)(h->total * percentile / 100.0 + 0.5);
+	uint64_t seen = 0;
+	uint32_t ix;
+
+	if (!h->total)
+		return (0);
+	if (want < 1)
+		want = 1;
+
+	for (ix = 0; ix < HIST_BUCKETS; ix++) {
+		seen += h->counts[ix];
+		if (seen >= want)
+			return (hist_value(ix));
+	}
+	return (hist_value(HIST_BUCKETS - 1));
+}
+
+static const double percentiles[] = {0.0, 50.0, 90.0, 99.0, 99.9, 100.0};
+static const char *percentile_names[] = {
+	"min", "p50", "p90", "p99", "p99.9", "max"
+};
+#define NPERCENTILES (sizeof(percentiles) / sizeof(percentiles[0]))
+
+static bool
+xdr_payload_args(XDR *xdrs, struct payload_args *objp)
+{
+	if (!xdr_uint32_t(xdrs, &objp->reply_size))
+		return (false);
+	return (xdr_bytes(xdrs, &objp->data, &objp->len,
+			  RPCPING_PAYLOAD_MAX));
+}
+
+static bool
+xdr_payload_res(XDR *xdrs, struct payload_res *objp)
+{
+	return (xdr_bytes(xdrs, &objp->data, &objp->len,
+			  RPCPING_PAYLOAD_MAX));
+}
+
 static int
 get_conn_fd(const char *host, int hbport)
 {
@@ -126,11 +309,45 @@ done:
 	return fd;
 }
 
+static int
+get_listen_fd(const char *host, int hbport)
+{
+	struct addrinfo hints = {
+		.ai_flags = AI_PASSIVE,
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+	};
+	struct addrinfo *res, *fr;
+	char port[16];
+	int one = 1;
+	int fd = -1;
+
+	snprintf(port, sizeof(port), "%d", hbport);
+	if (getaddrinfo(host, port, &hints, &res))
+		return -1;
+	fr = res;
+
+	for (; res; res = res->ai_next) {
+		fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+		if (fd < 0)
+			continue;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (!bind(fd, res->ai_addr, res->ai_addrlen))
+			break;
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(fr);
+	return fd;
+}
+
 static void
 worker_cb(struct clnt_req *cc)
 {
-	CLIENT *clnt = cc->cc_clnt;
-	struct state *s = clnt->cl_u1;
+	struct call *call = opr_containerof(cc, struct call, cc);
+	struct conn *c = call->c;
+	struct state *s = c->s;
 
 	if (cc->cc_error.re_status != RPC_SUCCESS) {
 		if (cc->cc_error.re_status == RPC_TIMEDOUT) {
@@ -138,61 +355,112 @@ worker_cb(struct clnt_req *cc)
 		} else {
 			atomic_inc_uint32_t(&s->failures);
 		}
+	} else {
+		hist_record(&s->hist, now_ns() - call->start_ns);
 	}
 
+	if (call->res.data)
+		free(call->res.data);
 	clnt_req_release(cc);
-	if (atomic_inc_uint32_t(&s->responses) < s->count) {
-		return;
+
+	pthread_mutex_lock(&s->s_mutex);
+	c->inflight--;
+	s->responses++;
+	if (s->waiting)
+		pthread_cond_broadcast(&s->s_cond);
+	pthread_mutex_unlock(&s->s_mutex);
+}
+
+static bool
+send_call(struct state *s, struct conn *c, uint64_t start_ns)
+{
+	struct call *call = calloc(1, sizeof(*call));
+
+	call->c = c;
+	call->start_ns = start_ns;
+	if (s->payload) {
+		clnt_req_fill(&call->cc, c->handle, authnone_ncreate(), s->proc,
+			      (xdrproc_t) xdr_payload_args, &s->args,
+			      (xdrproc_t) xdr_payload_res, &call->res);
+	} else {
+		clnt_req_fill(&call->cc, c->handle, authnone_ncreate(), s->proc,
+			      (xdrproc_t) xdr_void, NULL,
+			      (xdrproc_t) xdr_void, NULL);
 	}
+	call->cc.cc_size = sizeof(*call);
 
-	pthread_cond_broadcast(&s->s_cond);
+	if (clnt_req_setup(&call->cc, to) != RPC_SUCCESS) {
+		rpc_perror(&call->cc.cc_error, "clnt_req_setup failed");
+		clnt_req_release(&call->cc);
+		return false;
+	}
+	call->cc.cc_refreshes = 1;
+	call->cc.cc_process_cb = worker_cb;
+
+	call->cc.cc_error.re_status = CLNT_CALL_BACK(&call->cc);
+	if (call->cc.cc_error.re_status != RPC_SUCCESS) {
+		rpc_perror(&call->cc.cc_error, "CLNT_CALL_BACK failed");
+		clnt_req_release(&call->cc);
+		return false;
+	}
+	return true;
 }
 
 static void *
 worker(void *arg)
 {
 	struct state *s = arg;
-	struct clnt_req *cc;
-	int i;
-
-	pthread_cond_init(&s->s_cond, NULL);
-	pthread_mutex_init(&s->s_mutex, NULL);
+	struct conn *c;
+	uint64_t start = now_ns();
+	uint64_t max_lag_ns = 0;
+	uint64_t start_ns;
+	uint64_t now;
+	uint64_t i;
 
 	clock_gettime(CLOCK_MONOTONIC, &s->starting);
-	for (i = 0; i < s->count; i++) {
-		cc = calloc(1, sizeof(*cc));
-		clnt_req_fill(cc, s->handle, authnone_ncreate(), s->proc,
-			      (xdrproc_t) xdr_void, NULL,
-			      (xdrproc_t) xdr_void, NULL);
+	for (i = 0; s->interval_ns || i < s->count; i++) {
+		if (s->interval_ns) {
+			/* open loop: on schedule, however late the replies */
+			start_ns = start + (uint64_t)(i * s->interval_ns);
+			if (start_ns - start >= s->duration_ns)
+				break;
+			sleep_until(start_ns);
+			now = now_ns();
+			if (now - start_ns > max_lag_ns)
+				max_lag_ns = now - start_ns;
+		} else {
+			start_ns = now_ns();
+		}
+		c = &s->conns[i % s->nconns];
 
-		if (clnt_req_setup(cc, to) != RPC_SUCCESS) {
-			rpc_perror(&cc->cc_error, "clnt_req_setup failed");
-			s->count = i;
-			clnt_req_release(cc);
-			break;
+		pthread_mutex_lock(&s->s_mutex);
+		while (s->depth && c->inflight >= s->depth) {
+			s->waiting = true;
+			pthread_cond_wait(&s->s_cond, &s->s_mutex);
 		}
-		cc->cc_refreshes = 1;
-		cc->cc_process_cb = worker_cb;
-
-		cc->cc_error.re_status = CLNT_CALL_BACK(cc);
-		if (cc->cc_error.re_status != RPC_SUCCESS) {
-			rpc_perror(&cc->cc_error, "CLNT_CALL_BACK failed");
-			s->count = i;
-			clnt_req_release(cc);
+		s->waiting = false;
+		c->inflight++;
+		pthread_mutex_unlock(&s->s_mutex);
+
+		if (!send_call(s, c, start_ns)) {
+			pthread_mutex_lock(&s->s_mutex);
+			c->inflight--;
+			pthread_mutex_unlock(&s->s_mutex);
 			break;
 		}
 	}
+	s->sent = i;
+	s->max_lag_ns = max_lag_ns;
 
 	pthread_mutex_lock(&s->s_mutex);
-	pthread_cond_wait(&s->s_cond, &s->s_mutex);
+	while (s->responses < s->sent) {
+		s->waiting = true;
+		pthread_cond_wait(&s->s_cond, &s->s_mutex);
+	}
+	s->waiting = false;
 	pthread_mutex_unlock(&s->s_mutex);
 	clock_gettime(CLOCK_MONOTONIC, &s->stopping);
 
-	if (atomic_dec_uint32_t(&rpcping_threads) > 0) {
-		return NULL;
-	}
-
-	pthread_cond_broadcast(&rpcping_cond);
 	return NULL;
 }
 
@@ -212,12 +480,168 @@ alloc_request(SVCXPRT *xprt, XDR *xdrs)
 static void
 free_request(struct svc_req *req, enum xprt_stat stat)
 {
+	SVC_RELEASE(req->rq_xprt, SVC_RELEASE_FLAG_NONE);
 	free(req);
 }
 
+static char *serve_zeros;
+
+static enum xprt_stat
+serve_process(struct svc_req *req)
+{
+	struct payload_args args;
+	struct payload_res res;
+	bool no_dispatch = false;
+	enum auth_stat why;
+
+	why = svc_auth_authenticate(req, &no_dispatch);
+	if (why != AUTH_OK)
+		return svcerr_auth(req, why);
+	if (no_dispatch)
+		return XPRT_IDLE;
+
+	switch (req->rq_msg.cb_proc) {
+	case NULLPROC:
+		req->rq_msg.RPCM_ack.ar_results.where = NULL;
+		req->rq_msg.RPCM_ack.ar_results.proc = (xdrproc_t) xdr_void;
+		return svc_sendreply(req);
+	case RPCPING_PROC_PAYLOAD:
+		memset(&args, 0, sizeof(args));
+		if (!xdr_payload_args(req->rq_xdrs, &args)) {
+			free(args.data);
+			return svcerr_decode(req);
+		}
+		free(args.data);
+
+		res.len = args.reply_size < RPCPING_PAYLOAD_MAX
+			? args.reply_size : RPCPING_PAYLOAD_MAX;
+		res.data = serve_zeros;
+		req->rq_msg.RPCM_ack.ar_results.where = &res;
+		req->rq_msg.RPCM_ack.ar_results.proc =
+			(xdrproc_t) xdr_payload_res;
+		return svc_sendreply(req);
+	default:
+		return svcerr_noproc(req);
+	};
+}
+
+static enum xprt_stat
+serve_rendezvous(SVCXPRT *xprt)
+{
+	xprt->xp_dispatch.process_cb = serve_process;
+	return XPRT_IDLE;
+}
+
+static int
+serve(const char *host, int port, int send_sz, int recv_sz, int duration)
+{
+	SVCXPRT *xprt;
+	int fd = get_listen_fd(host, port);
+
+	if (fd < 0) {
+		perror("get_listen_fd failed");
+		return 3;
+	}
+	serve_zeros = calloc(1, RPCPING_PAYLOAD_MAX);
+
+	xprt = svc_vc_ncreatef(fd, send_sz, recv_sz,
+			       SVC_CREATE_FLAG_CLOSE | SVC_CREATE_FLAG_LISTEN);
+	if (!xprt) {
+		fprintf(stderr, "svc_vc_ncreatef failed\n");
+		return 4;
+	}
+	xprt->xp_dispatch.rendezvous_cb = serve_rendezvous;
+	svc_rqst_evchan_reg(0, xprt, SVC_RQST_FLAG_CHAN_AFFINITY);
+
+	fprintf(stdout, "rpcping serve %s port=%d\n", host, port);
+	fflush(stdout);
+
+	if (duration) {
+		sleep(duration);
+	} else {
+		/* until killed */
+		pthread_mutex_lock(&rpcping_mutex);
+		pthread_cond_wait(&rpcping_cond, &rpcping_mutex);
+		pthread_mutex_unlock(&rpcping_mutex);
+	}
+
+	SVC_DESTROY(xprt);
+	return 0;
+}
+
+static bool
+write_json(const char *path, const char *proto, const char *host,
+	   int nthreads, int nconns,
+	   const struct histogram *hist, uint64_t sent, uint64_t responses,
+	   unsigned int failures, unsigned int timeouts, double elapsed_s,
+	   double rate, int duration, uint32_t depth, int count,
+	   int prog, int vers, int proc, u_int request_size,
+	   u_int reply_size, uint64_t max_lag_ns)
+{
+	FILE *fp = strcmp(path, "-") ? fopen(path, "w") : stdout;
+	bool first = true;
+	uint32_t ix;
+
+	if (!fp) {
+		perror(path);
+		return false;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"mode\": \"%s\",\n", rate ? "open" : "closed");
+	fprintf(fp, "  \"proto\": \"%s\",\n", proto);
+	fprintf(fp, "  \"host\": \"%s\",\n", host);
+	fprintf(fp, "  \"program\": %d,\n", prog);
+	fprintf(fp, "  \"version\": %d,\n", vers);
+	fprintf(fp, "  \"procedure\": %d,\n", proc);
+	fprintf(fp, "  \"threads\": %d,\n", nthreads);
+	fprintf(fp, "  \"connections\": %d,\n", nconns);
+	if (rate) {
+		fprintf(fp, "  \"rate\": %.0f,\n", rate);
+		fprintf(fp, "  \"duration_s\": %d,\n", duration);
+		fprintf(fp, "  \"max_lag_ns\": %" PRIu64 ",\n", max_lag_ns);
+	} else {
+		fprintf(fp, "  \"count\": %d,\n", count);
+	}
+	fprintf(fp, "  \"depth\": %u,\n", depth);
+	fprintf(fp, "  \"request_size\": %u,\n", request_size);
+	fprintf(fp, "  \"reply_size\": %u,\n", reply_size);
+	fprintf(fp, "  \"sent\": %" PRIu64 ",\n", sent);
+	fprintf(fp, "  \"responses\": %" PRIu64 ",\n", responses);
+	fprintf(fp, "  \"failures\": %u,\n", failures);
+	fprintf(fp, "  \"timeouts\": %u,\n", timeouts);
+	fprintf(fp, "  \"elapsed_s\": %.6f,\n", elapsed_s);
+	fprintf(fp, "  \"calls_per_sec\": %.1f,\n",
+		elapsed_s > 0 ? responses / elapsed_s : 0.0);
+	fprintf(fp, "  \"latency_ns\": {");
+	for (ix = 0; ix < NPERCENTILES; ix++)
+		fprintf(fp, "%s\"%s\": %" PRIu64, ix ? ", " : "",
+			percentile_names[ix],
+			hist_percentile(hist, percentiles[ix]));
+	fprintf(fp, ", \"mean\": %.0f},\n",
+		hist->total ? (double)hist->sum / hist->total : 0.0);
+	/* [highest value in bucket, count], non-empty buckets */
+	fprintf(fp, "  \"histogram_ns\": [");
+	for (ix = 0; ix < HIST_BUCKETS; ix++) {
+		if (!hist->counts[ix])
+			continue;
+		fprintf(fp, "%s[%" PRIu64 ", %" PRIu64 "]",
+			first ? "" : ", ", hist_value(ix), hist->counts[ix]);
+		first = false;
+	}
+	fprintf(fp, "]\n}\n");
+
+	if (fp == stdout) {
+		fflush(fp);
+		return true;
+	}
+	return !fclose(fp);
+}
+
 static void usage(void)
 {
-	printf("Usage: rpcping <raw|rdma|tcp|udp> <host> [--rpcbind] [--count=<n>] [--threads=<n>] [--workers=<n>] [--port=<n>] [--program=<n>] [--version=<n>] [--procedure=<n>]\n");
+	printf("Usage: rpcping <raw|rdma|tcp|udp> <host> [--rpcbind] [--count=<n>] [--threads=<n>] [--workers=<n>] [--port=<n>] [--program=<n>] [--version=<n>] [--procedure=<n>] [--rate=<calls/s> [--duration=<s>]] [--connections=<n>] [--depth=<n>] [--request-size=<n>] [--reply-size=<n>] [--json=<file|->]\n");
+	printf("       rpcping serve <host> [--port=<n>] [--workers=<n>] [--duration=<s>]\n");
 }
 
 static struct option long_options[] =
@@ -230,6 +654,13 @@ static struct option long_options[] =
 	{"version", required_argument, NULL, 'v'},
 	{"procedure", required_argument, NULL, 'x'},
 	{"rpcbind", no_argument, NULL, 'b'},
+	{"rate", required_argument, NULL, 'r'},
+	{"duration", required_argument, NULL, 'd'},
+	{"connections", required_argument, NULL, 'n'},
+	{"depth", required_argument, NULL, 'D'},
+	{"request-size", required_argument, NULL, 'q'},
+	{"reply-size", required_argument, NULL, 's'},
+	{"json", required_argument, NULL, 'j'},
 	{NULL, 0, NULL, 0}
 };
 
@@ -239,24 +670,39 @@ int main(int argc, char *argv[])
 	CLIENT *clnt;
 	struct state *s;
 	struct state *states;
+	struct conn *conns;
+	struct histogram *hist;
 	char *proto;
 	char *host;
+	char *json = NULL;
+	char *request_data = NULL;
 	double total;
 	double elapsed_ns;
+	double rate = 0.0;
+	uint64_t sent = 0;
+	uint64_t responses = 0;
+	uint64_t max_lag_ns = 0;
+	uint32_t ix;
 	int i;
 	int opt;
 	int count = 500; /* minimal concurrent requests */
 	int nthreads = 1;
 	int nworkers = 5;
+	int nconns = 0;
 	int port = 2049;
 	int prog = 100003; /* nfs */
 	int vers = 3; /* allow raw, rdma, tcp, udp by default */
-	int proc = 0;
+	int proc = -1;
+	int duration = 10;
 	int send_sz = 8192;
 	int recv_sz = 8192;
+	uint32_t depth = 0;
+	u_int request_size = 0;
+	u_int reply_size = 0;
 	unsigned int failures = 0;
 	unsigned int timeouts = 0;
 	bool rpcbind = false;
+	bool serving;
 
 	NTIRPC_AUTO_TRACEPOINT(rpcping, test, TRACE_INFO, "Boo");
 
@@ -268,9 +714,12 @@ int main(int argc, char *argv[])
 
 	proto = argv[1];
 	host = argv[2];
+	serving = !strcmp(proto, "serve");
+	if (serving)
+		duration = 0;
 
 	optind = 3;
-	while ((opt = getopt_long(argc, argv, "bc:m:p:t:v:w:x:",
+	while ((opt = getopt_long(argc, argv, "bc:d:D:j:m:n:p:q:r:s:t:v:w:x:",
 				  long_options, NULL)) != -1) {
 		switch (opt)
 		{
@@ -298,6 +747,27 @@ int main(int argc, char *argv[])
 		case 'b':
 			rpcbind = true;
 			break;
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'n':
+			nconns = atoi(optarg);
+			break;
+		case 'D':
+			depth = atoi(optarg);
+			break;
+		case 'q':
+			request_size = atoi(optarg);
+			break;
+		case 's':
+			reply_size = atoi(optarg);
+			break;
+		case 'j':
+			json = optarg;
+			break;
 		default:
 			usage();
 			exit(1);
@@ -305,11 +775,20 @@ int main(int argc, char *argv[])
 		};
 	}
 
-	states = calloc(nthreads, sizeof(struct state));
-	if (!states) {
-		perror("calloc failed");
+	if (nthreads < 1 || rate < 0.0 || duration < 0
+	    || request_size > RPCPING_PAYLOAD_MAX
+	    || reply_size > RPCPING_PAYLOAD_MAX
+	    || (rate && !duration)) {
+		usage();
 		exit(1);
 	}
+	if (nconns < nthreads)
+		nconns = nthreads;
+	if (proc < 0) {
+		/* payloads need the "rpcping serve" procedure */
+		proc = (request_size || reply_size)
+			? RPCPING_PROC_PAYLOAD : NULLPROC;
+	}
 
 	memset(&svc_params, 0, sizeof(svc_params));
 	svc_params.alloc_cb = alloc_request;
@@ -323,10 +802,22 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	rpcping_threads = nthreads;
-	for (i = 0; i < nthreads; i++) {
-		pthread_t t;
+	if (serving) {
+		i = serve(host, port, send_sz, recv_sz, duration);
+		(void)svc_shutdown(SVC_SHUTDOWN_FLAG_NONE);
+		return (i);
+	}
+
+	states = calloc(nthreads, sizeof(struct state));
+	conns = calloc(nconns, sizeof(struct conn));
+	if (!states || !conns) {
+		perror("calloc failed");
+		exit(1);
+	}
+	if (request_size)
+		request_data = calloc(1, request_size);
 
+	for (i = 0; i < nconns; i++) {
 		if (rpcbind) {
 			clnt = clnt_ncreate(host, prog, vers, proto);
 			if (CLNT_FAILURE(clnt)) {
@@ -357,38 +848,83 @@ int main(int argc, char *argv[])
 				exit(4);
 			}
 		}
-		s = &states[i];
-		clnt->cl_u1 = s;
+		conns[i].handle = clnt;
+	}
 
-		s->handle = clnt;
+	/* connections are split between the threads */
+	for (i = 0; i < nthreads; i++) {
+		s = &states[i];
 		s->id = i;
+		s->conns = &conns[nconns * i / nthreads];
+		s->nconns = nconns * (i + 1) / nthreads
+			  - nconns * i / nthreads;
 		s->count = count;
 		s->proc = proc;
-		pthread_create(&t, NULL, worker, s);
+		s->depth = depth;
+		s->payload = (proc == RPCPING_PROC_PAYLOAD);
+		s->args.reply_size = reply_size;
+		s->args.len = request_size;
+		s->args.data = request_data;
+		if (rate) {
+			s->interval_ns = 1000000000.0 * nthreads / rate;
+			s->duration_ns = duration * 1000000000ULL;
+		}
+		for (ix = 0; ix < s->nconns; ix++)
+			s->conns[ix].s = s;
+		pthread_cond_init(&s->s_cond, NULL);
+		pthread_mutex_init(&s->s_mutex, NULL);
 	}
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&states[i].thread, NULL, worker, &states[i]);
 
-	pthread_mutex_lock(&rpcping_mutex);
-	pthread_cond_wait(&rpcping_cond, &rpcping_mutex);
-	pthread_mutex_unlock(&rpcping_mutex);
-
+	hist = calloc(1, sizeof(*hist));
 	total = 0.0;
 	elapsed_ns = 0.0;
 	for (i = 0; i < nthreads; i++) {
 		s = &states[i];
+		pthread_join(s->thread, NULL);
 		failures += s->failures;
 		timeouts += s->timeouts;
+		sent += s->sent;
+		responses += s->responses;
+		if (s->max_lag_ns > max_lag_ns)
+			max_lag_ns = s->max_lag_ns;
+		hist_merge(hist, &s->hist);
 		total += s->responses;
 		elapsed_ns += timespec_elapsed(&s->starting, &s->stopping);
-		CLNT_DESTROY(s->handle);
 	}
+	for (i = 0; i < nconns; i++)
+		CLNT_DESTROY(conns[i].handle);
 	total *= 1000000000.0;
 	total /= elapsed_ns;
 
-	fprintf(stdout, "rpcping %s %s count=%d threads=%d workers=%d (port=%d program=%d version=%d procedure=%d): failures %u timeouts %u mean %2.4lf, total %2.4lf\n",
-		proto, host, count, nthreads, nworkers, port, prog, vers, proc,
-		failures, timeouts, total / nthreads, total);
+	if (rate) {
+		fprintf(stdout, "rpcping %s %s rate=%.0f duration=%d connections=%d depth=%u threads=%d workers=%d (port=%d program=%d version=%d procedure=%d request=%u reply=%u): sent %" PRIu64 " failures %u timeouts %u achieved %2.4lf, max lag %2.4lf ms\n",
+			proto, host, rate, duration, nconns, depth, nthreads,
+			nworkers, port, prog, vers, proc, request_size,
+			reply_size, sent, failures, timeouts, total * nthreads,
+			max_lag_ns / 1000000.0);
+	} else {
+		fprintf(stdout, "rpcping %s %s count=%d threads=%d workers=%d (port=%d program=%d version=%d procedure=%d): failures %u timeouts %u mean %2.4lf, total %2.4lf\n",
+			proto, host, count, nthreads, nworkers, port, prog,
+			vers, proc, failures, timeouts, total / nthreads,
+			total);
+	}
+	fprintf(stdout, "latency (us):");
+	for (ix = 0; ix < NPERCENTILES; ix++)
+		fprintf(stdout, " %s %.1lf", percentile_names[ix],
+			hist_percentile(hist, percentiles[ix]) / 1000.0);
+	fprintf(stdout, " (%" PRIu64 " replies)\n", hist->total);
 	fflush(stdout);
 
+	if (json
+	    && !write_json(json, proto, host, nthreads, nconns, hist,
+			   sent, responses, failures, timeouts,
+			   elapsed_ns / nthreads / 1000000000.0, rate,
+			   duration, depth, count, prog, vers, proc,
+			   request_size, reply_size, max_lag_ns))
+		exit(5);
+
 	(void)svc_shutdown(SVC_SHUTDOWN_FLAG_NONE);
 	return (0);
 }
@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc. and/or its affiliates.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file xdrgen_test.c
+ * @brief Check generated codecs against the generic routines
+ *
+ * @section DESCRIPTION
+ *
+ * Each value is encoded by the generic routines (the hand-written rpcbind
+ * codecs, or an xdrgen --no-inline copy of the test definitions), and by
+ * the generated codec into a flat buffer and into a stream of tiny
+ * segments, so that the inline runs and their fallback are both taken.
+ * The encodings must match byte for byte, and decoding with the generated
+ * codec must give back a value that the generic routine encodes the same.
+ *
+ * The reply count that sizes server send buffers is also checked against
+ * encoded replies.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rpc/rpc.h>
+#include <rpc/xdr_inline.h>
+#include <rpc/xdr_ioq.h>
+#include <rpc/rpcb_prot.h>
+
+#include "rpcb_prot_xdrgen.h"
+#include "xdrgen_test_xdr.h"
+#include "xdrgen_test_generic.h"
+
+#define BUFSZ 4096
+#define SEGSZ 16
+
+static int failures;
+
+static u_int
+encode_mem(xdrproc_t proc, void *objp, char *buf)
+{
+	XDR xdrs[1];
+	u_int len;
+
+	xdrmem_create(xdrs, buf, BUFSZ, XDR_ENCODE);
+	if (!proc(xdrs, objp)) {
+		XDR_DESTROY(xdrs);
+		return (0);
+	}
+	len = XDR_GETPOS(xdrs);
+	XDR_DESTROY(xdrs);
+	return (len);
+}
+
+/* encode into SEGSZ segments, then flatten them */
+static u_int
+encode_segments(xdrproc_t proc, void *objp, char *buf)
+{
+	struct xdr_ioq *xioq = xdr_ioq_create(SEGSZ, BUFSZ, UIO_FLAG_FREE);
+	struct poolq_entry *have;
+	u_int len = 0;
+
+	if (!proc(xioq->xdrs, objp)) {
+		XDR_DESTROY(xioq->xdrs);
+		return (0);
+	}
+	XDR_GETPOS(xioq->xdrs);	/* update the length of the last segment */
+
+	TAILQ_FOREACH(have, &xioq->ioq_uv.uvqh.qh, q) {
+		struct xdr_ioq_uv *uv = IOQ_(have);
+		u_int n = ioquv_length(uv);
+
+		memcpy(buf + len, uv->v.vio_head, n);
+		len += n;
+	}
+	XDR_DESTROY(xioq->xdrs);
+	return (len);
+}
+
+/* decode buf into SEGSZ segments */
+static bool
+decode_segments(xdrproc_t proc, void *objp, char *buf, u_int len)
+{
+	struct xdr_ioq *xioq = xdr_ioq_create(SEGSZ, BUFSZ, UIO_FLAG_FREE);
+	u_int off;
+	bool rslt;
+
+	for (off = 0; off < len; off += SEGSZ)
+		XDR_PUTBYTES(xioq->xdrs, buf + off,
+			     (len - off < SEGSZ) ? len - off : SEGSZ);
+	XDR_GETPOS(xioq->xdrs);
+	xdr_ioq_reset(xioq, 0);
+	xioq->xdrs->x_op = XDR_DECODE;
+
+	rslt = proc(xioq->xdrs, objp);
+	XDR_DESTROY(xioq->xdrs);
+	return (rslt);
+}
+
+static void
+check(const char *what, xdrproc_t generic, xdrproc_t gen, void *objp,
+      size_t size)
+{
+	static char want[BUFSZ], got[BUFSZ];
+	XDR xdrs[1];
+	void *obj2 = calloc(1, size);
+	u_int wlen, glen;
+
+	wlen = encode_mem(generic, objp, want);
+	if (!wlen) {
+		fprintf(stderr, "%s: generic encode failed\n", what);
+		failures++;
+		goto out;
+	}
+
+	glen = encode_mem(gen, objp, got);
+	if (glen != wlen || memcmp(want, got, wlen)) {
+		fprintf(stderr, "%s: flat encode differs (%u != %u)\n",
+			what, glen, wlen);
+		failures++;
+	}
+
+	if (xdr_sizeof(gen, objp) != wlen) {
+		fprintf(stderr, "%s: xdr_sizeof %lu != %u\n",
+			what, xdr_sizeof(gen, objp), wlen);
+		failures++;
+	}
+
+	memset(got, 0xa5, sizeof(got));
+	glen = encode_segments(gen, objp, got);
+	if (glen != wlen || memcmp(want, got, wlen)) {
+		fprintf(stderr, "%s: segmented encode differs (%u != %u)\n",
+			what, glen, wlen);
+		failures++;
+	}
+
+	xdrmem_create(xdrs, want, wlen, XDR_DECODE);
+	if (!gen(xdrs, obj2)) {
+		fprintf(stderr, "%s: flat decode failed\n", what);
+		failures++;
+		XDR_DESTROY(xdrs);
+		goto out;
+	}
+	XDR_DESTROY(xdrs);
+	glen = encode_mem(generic, obj2, got);
+	if (glen != wlen || memcmp(want, got, wlen)) {
+		fprintf(stderr, "%s: flat decode differs\n", what);
+		failures++;
+	}
+	xdr_free(gen, obj2);
+	memset(obj2, 0, size);
+
+	if (!decode_segments(gen, obj2, want, wlen)) {
+		fprintf(stderr, "%s: segmented decode failed\n", what);
+		failures++;
+		goto out;
+	}
+	glen = encode_mem(generic, obj2, got);
+	if (glen != wlen || memcmp(want, got, wlen)) {
+		fprintf(stderr, "%s: segmented decode differs\n", what);
+		failures++;
+	}
+	xdr_free(gen, obj2);
+ out:
+	free(obj2);
+	printf("%-24s %4u bytes\n", what, wlen);
+}
+
+static void
+check_rpcb(void)
+{
+	struct rpcb_entry_list entries[2];
+	struct rpcbs_addrlist addrs[2];
+	struct rpcbs_rmtcalllist calls[1];
+	struct rp__list list[3];
+	rpcblist_ptr head = &list[0];
+	rpcb_entry_list_ptr ehead = &entries[0];
+	rpcb_stat_byvers stats;
+	int i, j;
+
+	memset(list, 0, sizeof(list));
+	for (i = 0; i < 3; i++) {
+		list[i].rpcb_map.r_prog = 100000 + i;
+		list[i].rpcb_map.r_vers = i + 2;
+		list[i].rpcb_map.r_netid = i ? "udp" : "tcp6";
+		list[i].rpcb_map.r_addr = "127.0.0.1.0.111";
+		list[i].rpcb_map.r_owner = "superuser";
+		list[i].rpcb_next = (i < 2) ? &list[i + 1] : NULL;
+	}
+	check("rpcb", (xdrproc_t) xdr_rpcb, (xdrproc_t) xdrgen_rpcb,
+	      &list[0].rpcb_map, sizeof(rpcb));
+	check("rpcblist_ptr", (xdrproc_t) xdr_rpcblist_ptr,
+	      (xdrproc_t) xdrgen_rpcblist_ptr, &head, sizeof(rpcblist_ptr));
+
+	/*
+	 * rpcb_rmtcallargs and rpcb_rmtcallres are skipped: the hand-written
+	 * routines take struct r_rpcb_rmtcall*, carrying the codec for the
+	 * embedded arguments, rather than the layout declared in the .x file.
+	 */
+	for (i = 0; i < 2; i++) {
+		entries[i].rpcb_entry_map.r_maddr = "10.0.0.1.0.111";
+		entries[i].rpcb_entry_map.r_nc_netid = "tcp";
+		entries[i].rpcb_entry_map.r_nc_semantics = 2 + i;
+		entries[i].rpcb_entry_map.r_nc_protofmly = "inet";
+		entries[i].rpcb_entry_map.r_nc_proto = "tcp";
+		entries[i].rpcb_entry_next = i ? NULL : &entries[1];
+	}
+	check("rpcb_entry_list_ptr", (xdrproc_t) xdr_rpcb_entry_list_ptr,
+	      (xdrproc_t) xdrgen_rpcb_entry_list_ptr, &ehead,
+	      sizeof(rpcb_entry_list_ptr));
+
+	for (i = 0; i < 2; i++) {
+		addrs[i].prog = 100005;
+		addrs[i].vers = i + 1;
+		addrs[i].success = 10 * i;
+		addrs[i].failure = -i;
+		addrs[i].netid = "udp6";
+		addrs[i].next = i ? NULL : &addrs[1];
+	}
+	calls[0].prog = 100021;
+	calls[0].vers = 4;
+	calls[0].proc = 7;
+	calls[0].success = 1;
+	calls[0].failure = 2;
+	calls[0].indirect = 3;
+	calls[0].netid = "tcp";
+	calls[0].next = NULL;
+	for (i = 0; i < RPCBVERS_STAT; i++) {
+		for (j = 0; j < RPCBSTAT_HIGHPROC; j++)
+			stats[i].info[j] = i * 100 + j;
+		stats[i].setinfo = i;
+		stats[i].unsetinfo = -i;
+		stats[i].addrinfo = (i == 1) ? &addrs[0] : NULL;
+		stats[i].rmtinfo = (i == 2) ? &calls[0] : NULL;
+	}
+	check("rpcb_stat", (xdrproc_t) xdr_rpcb_stat,
+	      (xdrproc_t) xdrgen_rpcb_stat, &stats[1], sizeof(rpcb_stat));
+	check("rpcb_stat_byvers", (xdrproc_t) xdr_rpcb_stat_byvers,
+	      (xdrproc_t) xdrgen_rpcb_stat_byvers, stats,
+	      sizeof(rpcb_stat_byvers));
+}
+
+static void
+check_definitions(void)
+{
+	static char data[] = "some opaque data";
+	static int32_t vals[] = { 1, -2, 3, -4, 5 };
+	xt_point origin = { -1, 1, -((int64_t)1 << 40) };
+	xt_var var[2];
+	xt_point pts[4];
+	xt_path path;
+	xt_result res;
+	int i;
+
+	memset(&res, 0, sizeof(res));
+	res.status = 0;
+	res.xt_result_u.ok.id = 0xdeadbeef;
+	res.xt_result_u.ok.color = XT_BLUE;
+	res.xt_result_u.ok.flag = true;
+	res.xt_result_u.ok.stamp = 0x0123456789abcdefULL;
+	memcpy(res.xt_result_u.ok.tag, "tagtag", 6);
+	for (i = 0; i < XT_POINTS; i++) {
+		res.xt_result_u.ok.pts[i].x = i;
+		res.xt_result_u.ok.pts[i].y = -i;
+		res.xt_result_u.ok.pts[i].z = (int64_t)i << 33;
+	}
+	check("xt_fixed", (xdrproc_t) xdrgen_generic_xt_fixed,
+	      (xdrproc_t) xdrgen_xt_fixed, &res.xt_result_u.ok,
+	      sizeof(xt_fixed));
+	check("xt_result ok", (xdrproc_t) xdrgen_generic_xt_result,
+	      (xdrproc_t) xdrgen_xt_result, &res, sizeof(xt_result));
+
+	res.status = 2;
+	res.xt_result_u.why = "because";
+	check("xt_result why", (xdrproc_t) xdrgen_generic_xt_result,
+	      (xdrproc_t) xdrgen_xt_result, &res, sizeof(xt_result));
+
+	res.status = 7;
+	check("xt_result void", (xdrproc_t) xdrgen_generic_xt_result,
+	      (xdrproc_t) xdrgen_xt_result, &res, sizeof(xt_result));
+
+	memset(var, 0, sizeof(var));
+	for (i = 0; i < 2; i++) {
+		var[i].name = i ? "second" : "first";
+		var[i].vec[0] = i;
+		var[i].vec[3] = -i;
+		var[i].count = 42;
+		var[i].data.data_len = sizeof(data) - i * 5;
+		var[i].data.data_val = data;
+		var[i].vals.vals_len = 5 - i;
+		var[i].vals.vals_val = vals;
+		var[i].origin = i ? NULL : &origin;
+		var[i].next = i ? NULL : &var[1];
+	}
+	check("xt_var", (xdrproc_t) xdrgen_generic_xt_var,
+	      (xdrproc_t) xdrgen_xt_var, &var[0], sizeof(xt_var));
+
+	for (i = 0; i < 4; i++) {
+		pts[i].x = i * 3;
+		pts[i].y = i * 5;
+		pts[i].z = -i;
+	}
+	path.xt_path_len = 4;
+	path.xt_path_val = pts;
+	check("xt_path", (xdrproc_t) xdrgen_generic_xt_path,
+	      (xdrproc_t) xdrgen_xt_path, &path, sizeof(xt_path));
+}
+
+/*
+ * xdr_uint32_vector() and xdr_uint64_vector() against one element at a
+ * time, for counts around each vector width (SSSE3, AVX2, NEON).  The
+ * leading count leaves the 64-bit runs 4 byte aligned only.
+ */
+#define VEC_MAX 19
+
+struct vec {
+	u_int n;
+	uint32_t v32[VEC_MAX];
+	uint64_t v64[VEC_MAX];
+};
+
+static bool
+xdr_vec_generic(XDR *xdrs, struct vec *objp)
+{
+	u_int i;
+
+	if (!xdr_u_int(xdrs, &objp->n) || objp->n > VEC_MAX)
+		return (false);
+	for (i = 0; i < objp->n; i++)
+		if (!xdr_uint32_t(xdrs, &objp->v32[i]))
+			return (false);
+	for (i = 0; i < objp->n; i++)
+		if (!xdr_uint64_t(xdrs, &objp->v64[i]))
+			return (false);
+	return (true);
+}
+
+static bool
+xdr_vec(XDR *xdrs, struct vec *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->n) || objp->n > VEC_MAX)
+		return (false);
+	return (xdr_uint32_vector(xdrs, objp->v32, objp->n)
+		&& xdr_uint64_vector(xdrs, objp->v64, objp->n));
+}
+
+static void
+check_vectors(void)
+{
+	struct vec vec;
+	char what[32];
+	u_int i;
+
+	for (i = 0; i < VEC_MAX; i++) {
+		vec.v32[i] = 0x01020304 * (i + 1);
+		vec.v64[i] = 0x0102030405060708ULL * (i + 1);
+	}
+	for (vec.n = 0; vec.n <= VEC_MAX; vec.n++) {
+		sprintf(what, "vector %u", vec.n);
+		check(what, (xdrproc_t) xdr_vec_generic, (xdrproc_t) xdr_vec,
+		      &vec, sizeof(vec));
+	}
+}
+
+/*
+ * The reply count (svc_reply_sizeof) against a reply encoded as the
+ * server does:  xdr_reply_encode(), then the results by SVCAUTH_WRAP.
+ */
+static void
+check_reply_sizeof(void)
+{
+	static const u_int verf_lens[] = {0, 8, MAX_AUTH_BYTES};
+	static const u_int vec_lens[] = {0, 7, VEC_MAX};
+	static char buf[BUFSZ];
+	struct rpc_msg msg;
+	struct vec vec;
+	XDR xdrs[1];
+	u_long count;
+	u_int len;
+	u_int i, j;
+
+	memset(&vec, 0, sizeof(vec));
+	for (i = 0; i < sizeof(verf_lens) / sizeof(verf_lens[0]); i++) {
+		for (j = 0; j <= sizeof(vec_lens) / sizeof(vec_lens[0]); j++) {
+			memset(&msg, 0, sizeof(msg));
+			msg.rm_xid = 0x12345678;
+			msg.rm_direction = REPLY;
+			msg.rm_reply.rp_stat = MSG_ACCEPTED;
+			msg.RPCM_ack.ar_verf.oa_flavor = AUTH_NONE;
+			msg.RPCM_ack.ar_verf.oa_length = verf_lens[i];
+			if (j < sizeof(vec_lens) / sizeof(vec_lens[0])) {
+				vec.n = vec_lens[j];
+				msg.RPCM_ack.ar_stat = SUCCESS;
+				msg.RPCM_ack.ar_results.where = &vec;
+				msg.RPCM_ack.ar_results.proc =
+					(xdrproc_t) xdr_vec;
+			} else {
+				/* no results */
+				msg.RPCM_ack.ar_stat = PROG_MISMATCH;
+				msg.RPCM_ack.ar_vers.low = 2;
+				msg.RPCM_ack.ar_vers.high = 4;
+			}
+
+			xdrmem_create(xdrs, buf, BUFSZ, XDR_ENCODE);
+			if (!xdr_reply_encode(xdrs, &msg)
+			    || (msg.RPCM_ack.ar_stat == SUCCESS
+				&& !msg.RPCM_ack.ar_results.proc(xdrs,
+					msg.RPCM_ack.ar_results.where))) {
+				fprintf(stderr, "reply %u/%u: encode failed\n",
+					i, j);
+				failures++;
+				XDR_DESTROY(xdrs);
+				continue;
+			}
+			len = XDR_GETPOS(xdrs);
+			XDR_DESTROY(xdrs);
+
+			count = xdr_sizeof((xdrproc_t) xdr_nreplymsg, &msg);
+			if (count != len) {
+				fprintf(stderr,
+					"reply %u/%u: xdr_sizeof %lu != %u\n",
+					i, j, count, len);
+				failures++;
+			}
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	check_rpcb();
+	check_definitions();
+	check_vectors();
+	check_reply_sizeof();
+
+	if (failures) {
+		fprintf(stderr, "%d failures\n", failures);
+		return (1);
+	}
+	return (0);
+}
@@ -0,0 +1,52 @@
+/*
+ * Definitions exercising each construct xdrgen.py handles; the codecs
+ * generated from here are checked by xdrgen_test.c.
+ */
+
+const XT_NAME_MAX = 16;
+const XT_POINTS = 3;
+
+enum xt_color {
+	XT_RED = 1,
+	XT_GREEN = 2,
+	XT_BLUE = 4
+};
+
+struct xt_point {
+	int x;
+	int y;
+	hyper z;
+};
+
+struct xt_fixed {
+	unsigned int id;
+	xt_color color;
+	bool flag;
+	unsigned hyper stamp;
+	opaque tag[6];
+	xt_point pts[XT_POINTS];
+};
+
+typedef int xt_vec[4];
+
+struct xt_var {
+	string name<XT_NAME_MAX>;
+	xt_vec vec;
+	unsigned int count;
+	opaque data<>;
+	int vals<8>;
+	xt_point *origin;
+	struct xt_var *next;
+};
+
+typedef xt_point xt_path<>;
+
+union xt_result switch (int status) {
+case 0:
+	xt_fixed ok;
+case 1:
+case 2:
+	string why<>;
+default:
+	void;
+};